@@ -387,6 +387,10 @@ if has("syntax")
   call append("$", "synmaxcol\tmaximum column to look for syntax items")
   call append("$", "\t(local to buffer)")
   call <SID>OptionL("smc")
+  if has("reltime")
+    call append("$", "syntaxidle\tmsec slices for parsing syntax while waiting for a key")
+    call append("$", " \tset sxi=" . &sxi)
+  endif
 endif
 call append("$", "highlight\twhich highlighting to use for various occasions")
 call <SID>OptionG("hl", &hl)
@@ -990,6 +994,9 @@ call append("$", "maxmem\tmaximum amount of memory in Kbyte used for one buffer"
 call append("$", " \tset mm=" . &mm)
 call append("$", "maxmemtot\tmaximum amount of memory in Kbyte used for all buffers")
 call append("$", " \tset mmt=" . &mmt)
+call append("$", "memlimit\tmaximum amount of memory in Kbyte used for a buffer without a swap file")
+call append("$", "\t(local to buffer)")
+call <SID>OptionL("mml")
 
 
 call <SID>Header("command line editing")
@@ -572,8 +572,30 @@ buf_freeall(buf, del_buf, wipe_buf)
 # endif
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+    /* The 'hlsearch' matches cached by windows are for the old text. */
+# ifdef FEAT_WINDOWS
+    {
+	win_T		*win;
+	tabpage_T	*tp;
+
+	FOR_ALL_TAB_WINDOWS(tp, win)
+	    if (win->w_buffer == buf)
+		hlcache_free(win);
+    }
+# else
+    if (curwin->w_buffer == buf)
+	hlcache_free(curwin);
+# endif
+#endif
+
 #ifdef FEAT_TCL
     tcl_buffer_free(buf);
+#endif
+#ifdef FEAT_SYN_HL
+    /* Keep the syntax states in case the same text is loaded again. */
+    if (!del_buf && !wipe_buf)
+	syn_stack_save(buf);
 #endif
     u_blockfree(buf);		    /* free the memory allocated for undo */
     ml_close(buf, TRUE);	    /* close and delete the memline/memfile */
@@ -650,6 +672,9 @@ free_buffer_stuff(buf, free_options)
 #ifdef FEAT_SPELL
     ga_clear(&buf->b_langp);
 #endif
+#ifdef FEAT_SYN_HL
+    syn_stack_free_saved(buf);
+#endif
 }
 
 /*
@@ -1772,7 +1797,7 @@ free_buf_options(buf, free_p_ff)
 #ifdef FEAT_SPELL
     clear_string_option(&buf->b_p_spc);
     clear_string_option(&buf->b_p_spf);
-    vim_free(buf->b_cap_prog);
+    vim_regfree(buf->b_cap_prog);
     buf->b_cap_prog = NULL;
     clear_string_option(&buf->b_p_spl);
 #endif
@@ -2106,7 +2131,7 @@ buflist_findpat(pattern, pattern_end, unlisted, diffmode)
 			match = buf->b_fnum;	/* remember first match */
 		    }
 
-		vim_free(prog);
+		vim_regfree(prog);
 		if (match >= 0)			/* found one match */
 		    break;
 	    }
@@ -2215,14 +2240,14 @@ ExpandBufnames(pat, num_file, file, options)
 		*file = (char_u **)alloc((unsigned)(count * sizeof(char_u *)));
 		if (*file == NULL)
 		{
-		    vim_free(prog);
+		    vim_regfree(prog);
 		    if (patc != pat)
 			vim_free(patc);
 		    return FAIL;
 		}
 	    }
 	}
-	vim_free(prog);
+	vim_regfree(prog);
 	if (count)		/* match(es) found, break here */
 	    break;
     }
@@ -71,6 +71,9 @@ buf_init_chartab(buf, global)
     int		tilde;
     int		do_isalpha;
 
+    /* Tables made from chartab[] and b_chartab[] need to be updated. */
+    ++chartab_tick;
+
     if (global)
     {
 	/*
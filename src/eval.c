@@ -639,6 +639,8 @@ static void f_printf __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_pumvisible __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_range __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_readfile __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_regengine __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_regstats __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_reltime __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_reltimestr __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_remote_expr __ARGS((typval_T *argvars, typval_T *rettv));
@@ -654,6 +656,8 @@ static void f_reverse __ARGS((typval_T *argvars, typval_T *rettv));
 #ifdef FEAT_FLOAT
 static void f_round __ARGS((typval_T *argvars, typval_T *rettv));
 #endif
+static void f_screenattr __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_screenchar __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_search __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_searchdecl __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_searchpair __ARGS((typval_T *argvars, typval_T *rettv));
@@ -697,6 +701,7 @@ static void f_strridx __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_strtrans __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_submatch __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_substitute __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_swapstats __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synID __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synIDattr __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_synIDtrans __ARGS((typval_T *argvars, typval_T *rettv));
@@ -709,6 +714,7 @@ static void f_taglist __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_tagfiles __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_tempname __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_test __ARGS((typval_T *argvars, typval_T *rettv));
+static void f_test_override __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_tolower __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_toupper __ARGS((typval_T *argvars, typval_T *rettv));
 static void f_tr __ARGS((typval_T *argvars, typval_T *rettv));
@@ -4450,7 +4456,7 @@ eval4(arg, rettv, evaluate)
 			    if (regmatch.regprog != NULL)
 			    {
 				n1 = vim_regexec_nl(&regmatch, s1, (colnr_T)0);
-				vim_free(regmatch.regprog);
+				vim_regfree(regmatch.regprog);
 				if (type == TYPE_NOMATCH)
 				    n1 = !n1;
 			    }
@@ -6991,6 +6997,34 @@ dict_add_nr_str(d, key, nr, str)
     return OK;
 }
 
+#if (defined(FEAT_FLOAT) && defined(FEAT_PROFILE)) || defined(PROTO)
+/*
+ * Add a Float entry to dictionary "d".
+ * Returns FAIL when out of memory and when key already exists.
+ */
+    int
+dict_add_float(d, key, f)
+    dict_T	*d;
+    char	*key;
+    float_T	f;
+{
+    dictitem_T	*item;
+
+    item = dictitem_alloc((char_u *)key);
+    if (item == NULL)
+	return FAIL;
+    item->di_tv.v_lock = 0;
+    item->di_tv.v_type = VAR_FLOAT;
+    item->di_tv.vval.v_float = f;
+    if (dict_add(d, item) == FAIL)
+    {
+	dictitem_free(item);
+	return FAIL;
+    }
+    return OK;
+}
+#endif
+
 /*
  * Get the number of items in a Dictionary.
  */
@@ -7709,6 +7743,8 @@ static struct fst
     {"pumvisible",	0, 0, f_pumvisible},
     {"range",		1, 3, f_range},
     {"readfile",	1, 3, f_readfile},
+    {"regengine",	1, 1, f_regengine},
+    {"regstats",	0, 0, f_regstats},
     {"reltime",		0, 2, f_reltime},
     {"reltimestr",	1, 1, f_reltimestr},
     {"remote_expr",	2, 3, f_remote_expr},
@@ -7724,6 +7760,8 @@ static struct fst
 #ifdef FEAT_FLOAT
     {"round",		1, 1, f_round},
 #endif
+    {"screenattr",	2, 2, f_screenattr},
+    {"screenchar",	2, 2, f_screenchar},
     {"search",		1, 4, f_search},
     {"searchdecl",	1, 3, f_searchdecl},
     {"searchpair",	3, 7, f_searchpair},
@@ -7767,6 +7805,7 @@ static struct fst
     {"strtrans",	1, 1, f_strtrans},
     {"submatch",	1, 1, f_submatch},
     {"substitute",	4, 4, f_substitute},
+    {"swapstats",	0, 1, f_swapstats},
     {"synID",		3, 3, f_synID},
     {"synIDattr",	2, 3, f_synIDattr},
     {"synIDtrans",	1, 1, f_synIDtrans},
@@ -7779,6 +7818,7 @@ static struct fst
     {"taglist",		1, 1, f_taglist},
     {"tempname",	0, 0, f_tempname},
     {"test",		1, 1, f_test},
+    {"test_override",	2, 2, f_test_override},
     {"tolower",		1, 1, f_tolower},
     {"toupper",		1, 1, f_toupper},
     {"tr",		3, 3, f_tr},
@@ -11638,6 +11678,9 @@ f_has(argvars, rettv)
 #ifdef FEAT_SESSION
 	"mksession",
 #endif
+#ifdef FEAT_MMAP
+	"mmap",
+#endif
 #ifdef FEAT_MODIFY_FNAME
 	"modify_fname",
 #endif
@@ -13225,7 +13268,7 @@ find_some_match(argvars, rettv, type)
 		rettv->vval.v_number += (varnumber_T)(str - expr);
 	    }
 	}
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
     }
 
 theend:
@@ -13981,6 +14024,48 @@ list2proftime(arg, tm)
 }
 #endif /* FEAT_RELTIME */
 
+/*
+ * "regengine()" function
+ */
+    static void
+f_regengine(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    regprog_T	*prog;
+    char_u	*save_cpo;
+
+    rettv->v_type = VAR_STRING;
+    rettv->vval.v_string = NULL;
+
+    /* Make 'cpoptions' empty, the 'l' flag should not be used here. */
+    save_cpo = p_cpo;
+    p_cpo = (char_u *)"";
+    prog = vim_regcomp(get_tv_string(&argvars[0]), RE_MAGIC + RE_STRING);
+    if (prog != NULL)
+    {
+	rettv->vval.v_string = vim_strsave(re_engine(prog));
+	vim_regfree(prog);
+    }
+    p_cpo = save_cpo;
+}
+
+/*
+ * "regstats()" function
+ */
+    static void
+f_regstats(argvars, rettv)
+    typval_T	*argvars UNUSED;
+    typval_T	*rettv;
+{
+    if (rettv_list_alloc(rettv) == OK)
+    {
+#ifdef FEAT_PROFILE
+	regstat_list(rettv->vval.v_list);
+#endif
+    }
+}
+
 /*
  * "reltime()" function
  */
@@ -14873,6 +14958,57 @@ f_round(argvars, rettv)
 }
 #endif
 
+/*
+ * "screenattr()" function
+ */
+    static void
+f_screenattr(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    int		row;
+    int		col;
+    int		c;
+
+    row = get_tv_number_chk(&argvars[0], NULL) - 1;
+    col = get_tv_number_chk(&argvars[1], NULL) - 1;
+    if (row < 0 || row >= screen_Rows || col < 0 || col >= screen_Columns)
+	c = -1;
+    else
+	c = ScreenAttrs[LineOffset[row] + col];
+    rettv->vval.v_number = c;
+}
+
+/*
+ * "screenchar()" function
+ */
+    static void
+f_screenchar(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    int		row;
+    int		col;
+    int		off;
+    int		c;
+
+    row = get_tv_number_chk(&argvars[0], NULL) - 1;
+    col = get_tv_number_chk(&argvars[1], NULL) - 1;
+    if (row < 0 || row >= screen_Rows || col < 0 || col >= screen_Columns)
+	c = -1;
+    else
+    {
+	off = LineOffset[row] + col;
+#ifdef FEAT_MBYTE
+	if (enc_utf8 && ScreenLinesUC[off] != 0)
+	    c = ScreenLinesUC[off];
+	else
+#endif
+	    c = ScreenLines[off];
+    }
+    rettv->vval.v_number = c;
+}
+
 /*
  * "search()" function
  */
@@ -16180,7 +16316,7 @@ f_split(argvars, rettv)
 	    str = regmatch.endp[0];
 	}
 
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
     }
 
     p_cpo = save_cpo;
@@ -16528,6 +16664,44 @@ f_substitute(argvars, rettv)
 	rettv->vval.v_string = do_string_sub(str, pat, sub, flg);
 }
 
+/*
+ * "swapstats([expr])" function
+ */
+    static void
+f_swapstats(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv;
+{
+    buf_T	*buf = curbuf;
+    memfile_T	*mfp;
+    dict_T	*dict;
+
+    if (argvars[0].v_type != VAR_UNKNOWN)
+    {
+	(void)get_tv_number(&argvars[0]);   /* issue errmsg if type error */
+	++emsg_off;
+	buf = get_buf_tv(&argvars[0]);
+	--emsg_off;
+    }
+
+    dict = dict_alloc();
+    if (dict == NULL)
+	return;
+    rettv->v_type = VAR_DICT;
+    rettv->vval.v_dict = dict;
+    ++dict->dv_refcount;
+
+    if (buf == NULL || (mfp = buf->b_ml.ml_mfp) == NULL || mfp->mf_fd < 0)
+	return;
+    dict_add_nr_str(dict, "pending", (long)mf_pending_bytes(mfp), NULL);
+    dict_add_nr_str(dict, "syncs", mfp->mf_sync_count, NULL);
+    dict_add_nr_str(dict, "writes", mfp->mf_write_count, NULL);
+    dict_add_nr_str(dict, "blocks", mfp->mf_write_blocks, NULL);
+    dict_add_nr_str(dict, "bytes", (long)mfp->mf_write_bytes, NULL);
+    dict_add_nr_str(dict, "time", mfp->mf_sync_usec, NULL);
+    dict_add_nr_str(dict, "maxtime", mfp->mf_sync_max_usec, NULL);
+}
+
 /*
  * "synID(lnum, col, trans)" function
  */
@@ -17053,6 +17227,26 @@ f_test(argvars, rettv)
 #endif
 }
 
+/*
+ * "test_override({name}, {val})" function
+ */
+    static void
+f_test_override(argvars, rettv)
+    typval_T	*argvars;
+    typval_T	*rettv UNUSED;
+{
+    char_u	*name = get_tv_string_chk(&argvars[0]);
+    int		error = FALSE;
+    long	val = get_tv_number_chk(&argvars[1], &error);
+
+    if (name == NULL || error)
+	return;
+    if (STRCMP(name, "char_avail") == 0 || STRCMP(name, "ALL") == 0)
+	disable_char_avail_for_testing = (val != 0);
+    else
+	EMSG2(_(e_invarg2), name);
+}
+
 /*
  * "tolower(string)" function
  */
@@ -17573,6 +17767,12 @@ f_writefile(argvars, rettv)
     /* Always open the file in binary mode, library functions have a mind of
      * their own about CR-LF conversion. */
     fname = get_tv_string(&argvars[1]);
+#ifdef FEAT_MMAP
+    /* A buffer may have the file mapped, it is going to be truncated. */
+    if (*fname != NUL && ml_map_load_file(fname) == FAIL)
+	ret = -1;
+    else
+#endif
     if (*fname == NUL || (fd = mch_fopen((char *)fname, WRITEBIN)) == NULL)
     {
 	EMSG2(_(e_notcreate), *fname == NUL ? (char_u *)_("<empty>") : fname);
@@ -19728,7 +19928,7 @@ ex_function(eap)
 			    list_func_head(fp, FALSE);
 		    }
 		}
-		vim_free(regmatch.regprog);
+		vim_regfree(regmatch.regprog);
 	    }
 	}
 	if (*p == '/')
@@ -22776,7 +22976,7 @@ do_string_sub(str, pat, sub, flags)
 	if (ga.ga_data != NULL)
 	    STRCPY((char *)ga.ga_data + ga.ga_len, tail);
 
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
     }
 
     ret = vim_strsave(ga.ga_data == NULL ? str : (char_u *)ga.ga_data);
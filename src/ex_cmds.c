@@ -370,6 +370,8 @@ ex_sort(eap)
     colnr_T	end_col;
     int		sort_oct;		/* sort on octal number */
     int		sort_hex;		/* sort on hex number */
+    garray_T	ga;			/* sorted lines not appended yet */
+    linenr_T	ga_lines = 0;		/* number of lines in "ga" */
 
     /* Sorting one line is really quick! */
     if (count <= 1)
@@ -377,6 +379,7 @@ ex_sort(eap)
 
     if (u_save((linenr_T)(eap->line1 - 1), (linenr_T)(eap->line2 + 1)) == FAIL)
 	return;
+    ga_init2(&ga, 1, 0x10000);
     sortbuf1 = NULL;
     sortbuf2 = NULL;
     regmatch.regprog = NULL;
@@ -524,7 +527,8 @@ ex_sort(eap)
     if (sort_abort)
 	goto sortend;
 
-    /* Insert the lines in the sorted order below the last one. */
+    /* Insert the lines in the sorted order below the last one.  They are
+     * collected in "ga" and appended in big chunks, that is a lot faster. */
     lnum = eap->line2;
     for (i = 0; i < count; ++i)
     {
@@ -532,11 +536,24 @@ ex_sort(eap)
 	if (!unique || i == 0
 		|| (sort_ic ? STRICMP(s, sortbuf1) : STRCMP(s, sortbuf1)) != 0)
 	{
-	    if (ml_append(lnum++, s, (colnr_T)0, FALSE) == FAIL)
+	    len = (int)STRLEN(s) + 1;
+	    if (ga_grow(&ga, len) == FAIL)
 		break;
+	    mch_memmove((char_u *)ga.ga_data + ga.ga_len, s, (size_t)len);
+	    ga.ga_len += len;
+	    ++ga_lines;
 	    if (unique)
 		STRCPY(sortbuf1, s);
 	}
+	if (ga.ga_len >= 0x10000 || (i == count - 1 && ga_lines > 0))
+	{
+	    if (ml_append_lines(lnum, (char_u *)ga.ga_data, ga_lines, FALSE)
+								      == FAIL)
+		break;
+	    lnum += ga_lines;
+	    ga_lines = 0;
+	    ga.ga_len = 0;
+	}
 	fast_breakcheck();
 	if (got_int)
 	    goto sortend;
@@ -544,8 +561,7 @@ ex_sort(eap)
 
     /* delete the original lines if appending worked */
     if (i == count)
-	for (i = 0; i < count; ++i)
-	    ml_delete(eap->line1, FALSE);
+	ml_delete_lines(eap->line1, (long)count, FALSE);
     else
 	count = 0;
 
@@ -561,10 +577,11 @@ ex_sort(eap)
     beginline(BL_WHITE | BL_FIX);
 
 sortend:
+    ga_clear(&ga);
     vim_free(nrs);
     vim_free(sortbuf1);
     vim_free(sortbuf2);
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
     if (got_int)
 	EMSG(_(e_interr));
 }
@@ -4481,6 +4498,11 @@ do_sub(eap)
 #endif
 		); ++lnum)
     {
+	/* Quickly skip over lines where the pattern can't match. */
+	lnum = vim_regexec_nextline(&regmatch, curbuf, lnum, line2);
+	if (lnum > line2)
+	    break;
+
 	nmatch = vim_regexec_multi(&regmatch, curwin, curbuf, lnum,
 							    (colnr_T)0, NULL);
 	if (nmatch)
@@ -5137,7 +5159,7 @@ outofmem:
 	    EMSG2(_(e_patnotf2), get_search_pat());
     }
 
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 }
 
 /*
@@ -5214,6 +5236,7 @@ ex_global(eap)
     exarg_T	*eap;
 {
     linenr_T	lnum;		/* line number according to old situation */
+    linenr_T	skip_to;	/* first line that may match */
     int		ndone = 0;
     int		type;		/* first char of cmd: 'v' or 'g' */
     char_u	*cmd;		/* command argument */
@@ -5291,6 +5314,17 @@ ex_global(eap)
      */
     for (lnum = eap->line1; lnum <= eap->line2 && !got_int; ++lnum)
     {
+	/* Quickly skip over lines where the pattern can't match. */
+	skip_to = vim_regexec_nextline(&regmatch, curbuf, lnum, eap->line2);
+	for ( ; lnum < skip_to; ++lnum)
+	    if (type == 'v')
+	    {
+		ml_setmarked(lnum);
+		ndone++;
+	    }
+	if (lnum > eap->line2)
+	    break;
+
 	/* a match on this line? */
 	match = vim_regexec_multi(&regmatch, curwin, curbuf, lnum,
 							    (colnr_T)0, NULL);
@@ -5318,7 +5352,7 @@ ex_global(eap)
 	global_exe(cmd);
 
     ml_clearmarked();	   /* clear rest of the marks */
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 }
 
 /*
@@ -599,6 +599,8 @@ EX(CMD_menu,		"menu",		ex_menu,
 			RANGE|NOTADR|ZEROR|BANG|EXTRA|TRLBAR|NOTRLCOM|USECTRLV|CMDWIN),
 EX(CMD_menutranslate,	"menutranslate", ex_menutranslate,
 			EXTRA|TRLBAR|NOTRLCOM|USECTRLV|CMDWIN),
+EX(CMD_memstats,	"memstats",	ex_memstats,
+			TRLBAR|CMDWIN),
 EX(CMD_messages,	"messages",	ex_messages,
 			TRLBAR|CMDWIN),
 EX(CMD_mkexrc,		"mkexrc",	ex_mkrc,
@@ -749,6 +751,8 @@ EX(CMD_redrawstatus,	"redrawstatus",	ex_redrawstatus,
 			BANG|TRLBAR|CMDWIN),
 EX(CMD_registers,	"registers",	ex_display,
 			EXTRA|NOTRLCOM|TRLBAR|CMDWIN),
+EX(CMD_regstats,	"regstats",	ex_regstats,
+			EXTRA|TRLBAR|CMDWIN),
 EX(CMD_resize,		"resize",	ex_resize,
 			RANGE|NOTADR|TRLBAR|WORD1),
 EX(CMD_retab,		"retab",	ex_retab,
@@ -901,6 +905,8 @@ EX(CMD_swapname,	"swapname",	ex_swapname,
 			TRLBAR|CMDWIN),
 EX(CMD_syntax,		"syntax",	ex_syntax,
 			EXTRA|NOTRLCOM|CMDWIN),
+EX(CMD_syntime,	"syntime",	ex_syntime,
+			NEEDARG|WORD1|TRLBAR|CMDWIN),
 EX(CMD_syncbind,	"syncbind",	ex_syncbind,
 			TRLBAR),
 EX(CMD_t,		"t",		ex_copymove,
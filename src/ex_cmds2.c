@@ -659,7 +659,7 @@ ex_breakdel(eap)
 	while (gap->ga_len > 0)
 	{
 	    vim_free(DEBUGGY(gap, todel).dbg_name);
-	    vim_free(DEBUGGY(gap, todel).dbg_prog);
+	    vim_regfree(DEBUGGY(gap, todel).dbg_prog);
 	    --gap->ga_len;
 	    if (todel < gap->ga_len)
 		mch_memmove(&DEBUGGY(gap, todel), &DEBUGGY(gap, todel + 1),
@@ -961,6 +961,23 @@ profile_zero(tm)
 # endif
 }
 
+/*
+ * Return the time in "tm" in microseconds.
+ */
+    long
+profile_usec(tm)
+    proftime_T *tm;
+{
+# ifdef WIN3264
+    LARGE_INTEGER   fr;
+
+    QueryPerformanceFrequency(&fr);
+    return (long)((double)tm->QuadPart * 1000000.0 / (double)fr.QuadPart);
+# else
+    return (long)tm->tv_sec * 1000000L + (long)tm->tv_usec;
+# endif
+}
+
 # endif  /* FEAT_PROFILE || FEAT_RELTIME */
 
 # if defined(FEAT_PROFILE) || defined(PROTO)
@@ -1822,7 +1839,7 @@ do_arglist(str, what, after)
 		    --match;
 		}
 
-	    vim_free(regmatch.regprog);
+	    vim_regfree(regmatch.regprog);
 	    vim_free(p);
 	    if (!didone)
 		EMSG2(_(e_nomatch2), ((char_u **)new_ga.ga_data)[i]);
@@ -234,6 +234,9 @@ static void	ex_popup __ARGS((exarg_T *eap));
 #ifndef FEAT_SYN_HL
 # define ex_syntax		ex_ni
 #endif
+#if !defined(FEAT_SYN_HL) || !defined(FEAT_PROFILE)
+# define ex_syntime		ex_ni
+#endif
 #ifndef FEAT_SPELL
 # define ex_spell		ex_ni
 # define ex_mkspell		ex_ni
@@ -458,6 +461,7 @@ static void	ex_folddo __ARGS((exarg_T *eap));
 
 #ifndef FEAT_PROFILE
 # define ex_profile		ex_ni
+# define ex_regstats		ex_ni
 #endif
 
 /*
@@ -643,6 +647,10 @@ do_exmode(improved)
 	prev_line = curwin->w_cursor.lnum;
 #ifdef FEAT_SNIFF
 	ProcessSniffRequests();
+#endif
+#ifdef FEAT_MMAP
+	/* Load mapped files that another program changed. */
+	ml_map_check_all();
 #endif
 	if (improved)
 	{
@@ -7452,7 +7460,7 @@ ex_open(eap)
 		curwin->w_cursor.col = (colnr_T)(regmatch.startp[0] - p);
 	    else
 		EMSG(_(e_nomatch));
-	    vim_free(regmatch.regprog);
+	    vim_regfree(regmatch.regprog);
 	}
 	/* Move to the NUL, ignore any other arguments. */
 	eap->arg += STRLEN(eap->arg);
@@ -7691,7 +7699,8 @@ ex_popup(eap)
 ex_swapname(eap)
     exarg_T	*eap UNUSED;
 {
-    if (curbuf->b_ml.ml_mfp == NULL || curbuf->b_ml.ml_mfp->mf_fname == NULL)
+    if (curbuf->b_ml.ml_mfp == NULL || curbuf->b_ml.ml_mfp->mf_fname == NULL
+					       || curbuf->b_ml.ml_mfp->mf_spill)
 	MSG(_("No swap file"));
     else
 	msg(curbuf->b_ml.ml_mfp->mf_fname);
@@ -73,6 +73,49 @@ static int	calc_hist_idx __ARGS((int histype, int num));
 # endif
 #endif
 
+#ifdef FEAT_SEARCH_EXTRA
+/*
+ * The result of an 'incsearch' search for the first "ir_len" bytes of the
+ * command line.
+ */
+typedef struct
+{
+    int		ir_len;		/* length of the pattern */
+    int		ir_state;	/* IR_FOUND, IR_NOTFOUND or IR_PARTIAL */
+    pos_T	ir_pos;		/* IR_FOUND: start of the match; IR_PARTIAL:
+				   where to continue searching */
+    int		ir_wrapped;	/* "ir_pos" is after wrapping around */
+    linenr_T	ir_lines;	/* IR_FOUND: search_match_lines */
+    colnr_T	ir_endcol;	/* IR_FOUND: search_match_endcol */
+} isresult_T;
+
+# define IR_FOUND	1	/* match found at "ir_pos" */
+# define IR_NOTFOUND	2	/* there is no match */
+# define IR_PARTIAL	3	/* no match before "ir_pos" */
+
+/*
+ * Results of 'incsearch' while typing a pattern.  When a character is
+ * deleted the result for the shorter pattern can be used again.  When
+ * characters are added that can only make the pattern match less, searching
+ * can start where the shorter pattern matched.
+ */
+typedef struct
+{
+    garray_T	is_results;	/* isresult_T, shortest pattern first */
+    char_u	*is_pat;	/* command line the results are for */
+    int		is_changedtick;	/* b:changedtick for the results */
+} incsearch_T;
+
+/* Number of lines searched before checking for a typed character. */
+# define INCSEARCH_CHUNK	2000
+
+static void	incsearch_init __ARGS((incsearch_T *is));
+static void	incsearch_clear __ARGS((incsearch_T *is));
+static isresult_T *incsearch_result __ARGS((incsearch_T *is, int len));
+static int	incsearch_narrows __ARGS((char_u *pat, int oldlen, int newlen, int firstc));
+static int	incsearch_search __ARGS((incsearch_T *is, int firstc, long count, pos_T *start, int *postponed));
+#endif
+
 #ifdef FEAT_RIGHTLEFT
 static int	cmd_hkmap = 0;	/* Hebrew mapping during command line */
 #endif
@@ -167,6 +210,7 @@ getcmdline(firstc, count, indent)
     linenr_T	old_botline;
     int		did_incsearch = FALSE;
     int		incsearch_postponed = FALSE;
+    incsearch_T	is_results;
 #endif
     int		did_wild_list = FALSE;	/* did wild_list() recently */
     int		wim_index = 0;		/* index in wim_flags[] */
@@ -217,6 +261,7 @@ getcmdline(firstc, count, indent)
     old_topfill = curwin->w_topfill;
 # endif
     old_botline = curwin->w_botline;
+    incsearch_init(&is_results);
 #endif
 
     /*
@@ -1718,9 +1763,6 @@ cmdline_changed:
 	if (p_is && !cmd_silent && (firstc == '/' || firstc == '?'))
 	{
 	    pos_T	end_pos;
-#ifdef FEAT_RELTIME
-	    proftime_T	tm;
-#endif
 
 	    /* if there is a character waiting, search and redraw later */
 	    if (char_avail())
@@ -1739,18 +1781,8 @@ cmdline_changed:
 		cursor_off();		/* so the user knows we're busy */
 		out_flush();
 		++emsg_off;    /* So it doesn't beep if bad expr */
-#ifdef FEAT_RELTIME
-		/* Set the time limit to half a second. */
-		profile_setlimit(500L, &tm);
-#endif
-		i = do_search(NULL, firstc, ccline.cmdbuff, count,
-			SEARCH_KEEP + SEARCH_OPT + SEARCH_NOOF + SEARCH_PEEK,
-#ifdef FEAT_RELTIME
-			&tm
-#else
-			NULL
-#endif
-			);
+		i = incsearch_search(&is_results, firstc, count, &old_cursor,
+							&incsearch_postponed);
 		--emsg_off;
 		/* if interrupted while searching, behave like it failed */
 		if (got_int)
@@ -1759,9 +1791,6 @@ cmdline_changed:
 		    got_int = FALSE;	/* don't abandon the command line */
 		    i = 0;
 		}
-		else if (char_avail())
-		    /* cancelled searching because a char was typed */
-		    incsearch_postponed = TRUE;
 	    }
 	    if (i != 0)
 		highlight_match = TRUE;		/* highlight position */
@@ -1864,6 +1893,7 @@ returncmd:
 	validate_cursor();	/* needed for TAB */
 	redraw_later(SOME_VALID);
     }
+    incsearch_clear(&is_results);
 #endif
 
     if (ccline.cmdbuff != NULL)
@@ -1931,6 +1961,310 @@ returncmd:
     }
 }
 
+#ifdef FEAT_SEARCH_EXTRA
+    static void
+incsearch_init(is)
+    incsearch_T	*is;
+{
+    ga_init2(&is->is_results, (int)sizeof(isresult_T), 10);
+    is->is_pat = NULL;
+    is->is_changedtick = 0;
+}
+
+    static void
+incsearch_clear(is)
+    incsearch_T	*is;
+{
+    ga_clear(&is->is_results);
+    vim_free(is->is_pat);
+    is->is_pat = NULL;
+}
+
+/*
+ * Drop the results that are not valid for the current command line and
+ * return the result for the longest pattern that is left, but not longer
+ * than "len".  Returns NULL if there is none.
+ */
+    static isresult_T *
+incsearch_result(is, len)
+    incsearch_T	*is;
+    int		len;
+{
+    isresult_T	*ir = (isresult_T *)is->is_results.ga_data;
+    int		same = 0;
+    int		i;
+
+    /* Text may have been changed with an expression. */
+    if (is->is_changedtick != curbuf->b_changedtick)
+	is->is_results.ga_len = 0;
+
+    /* Keep the results for the part of the command line that didn't
+     * change.  After deleting characters the results for the longer
+     * command line are kept, it may be typed again. */
+    if (is->is_pat != NULL)
+    {
+	while (is->is_pat[same] != NUL
+				     && is->is_pat[same] == ccline.cmdbuff[same])
+	    ++same;
+	if (ccline.cmdbuff[same] != NUL)
+	    while (is->is_results.ga_len > 0
+			     && ir[is->is_results.ga_len - 1].ir_len > same)
+		--is->is_results.ga_len;
+    }
+
+    for (i = is->is_results.ga_len - 1; i >= 0; --i)
+	if (ir[i].ir_len <= len)
+	    return &ir[i];
+    return NULL;
+}
+
+/*
+ * Return TRUE when the pattern "pat" of "newlen" bytes can only match where
+ * its first "oldlen" bytes match: the added bytes are plain letters and
+ * digits that don't change the meaning of what comes before them.
+ * This is not true for "a$x", "\%d12", "\%x4a", "\{2,3" etc.  Don't bother
+ * to find out, simply require no backslash.
+ */
+    static int
+incsearch_narrows(pat, oldlen, newlen, firstc)
+    char_u	*pat;
+    int		oldlen;
+    int		newlen;
+    int		firstc;
+{
+    int		i;
+
+    if (oldlen == 0 || pat[oldlen - 1] == '$')
+	return FALSE;
+    for (i = 0; i < oldlen; ++i)
+	if (pat[i] == '\\' || pat[i] == firstc)
+	    return FALSE;
+    for ( ; i < newlen; ++i)
+	if (!(ASCII_ISALNUM(pat[i]) || pat[i] == '_' || pat[i] == ' '))
+	    return FALSE;
+    return TRUE;
+}
+
+/*
+ * Search for the pattern in the command line for 'incsearch', starting at
+ * "start".
+ * Uses the results for the pattern typed so far.  Searches in chunks of
+ * lines and stops when a character is typed, setting "*postponed".  The next
+ * time searching continues where it stopped.
+ * Returns like do_search(): 1 when found, 0 when not found or stopped.
+ */
+    static int
+incsearch_search(is, firstc, count, start, postponed)
+    incsearch_T	*is;
+    int		firstc;
+    long	count;
+    pos_T	*start;
+    int		*postponed;
+{
+    int		dir = (firstc == '/' ? FORWARD : BACKWARD);
+    isresult_T	*ir;
+    isresult_T	res;
+    pos_T	pos;
+    int		options;
+    linenr_T	last;
+    linenr_T	stop_lnum;
+    int		found;
+    int		idx;
+    int		save_called_emsg = called_emsg;
+#ifdef FEAT_RELTIME
+    proftime_T	tm;
+#endif
+
+    *postponed = FALSE;
+
+    /* With an offset or ";", a count, a pattern that depends on the cursor
+     * position or Farsi reversing use do_search() on the whole text. */
+    if (count != 1
+	    || *skip_regexp(ccline.cmdbuff, firstc, p_magic, NULL) != NUL
+	    || strstr((char *)ccline.cmdbuff, "%#") != NULL
+#ifdef FEAT_FKMAP
+	    || (p_altkeymap && curwin->w_p_rl)
+#endif
+	    )
+    {
+	incsearch_clear(is);
+#ifdef FEAT_RELTIME
+	/* Set the time limit to half a second. */
+	profile_setlimit(500L, &tm);
+#endif
+	found = do_search(NULL, firstc, ccline.cmdbuff, count,
+			SEARCH_KEEP + SEARCH_OPT + SEARCH_NOOF + SEARCH_PEEK,
+#ifdef FEAT_RELTIME
+			&tm
+#else
+			NULL
+#endif
+			);
+	/* cancelled searching because a char was typed */
+	if (!found && !got_int && char_avail())
+	    *postponed = TRUE;
+	return found;
+    }
+
+    /* Start at the cursor, like do_search().  If the cursor is in a closed
+     * fold, don't find another match in the same fold. */
+    res.ir_len = ccline.cmdlen;
+    res.ir_pos = *start;
+    res.ir_wrapped = FALSE;
+    options = SEARCH_KEEP + SEARCH_NOOF + SEARCH_PEEK;
+#ifdef FEAT_FOLDING
+    if (dir == FORWARD)
+    {
+	if (hasFolding(res.ir_pos.lnum, NULL, &res.ir_pos.lnum))
+	    res.ir_pos.col = MAXCOL - 2;
+    }
+    else
+    {
+	if (hasFolding(res.ir_pos.lnum, &res.ir_pos.lnum, NULL))
+	    res.ir_pos.col = 0;
+    }
+#endif
+
+    ir = incsearch_result(is, ccline.cmdlen);
+    if (ir != NULL && (ir->ir_len == ccline.cmdlen
+		  || incsearch_narrows(ccline.cmdbuff, ir->ir_len,
+						     ccline.cmdlen, firstc)))
+    {
+	if (ir->ir_state == IR_NOTFOUND)
+	    res.ir_state = IR_NOTFOUND;
+	else if (ir->ir_state == IR_FOUND && ir->ir_len == ccline.cmdlen)
+	    res = *ir;
+	else
+	{
+	    /* Continue where the shorter pattern matched or where searching
+	     * stopped, accepting a match at that position. */
+	    res.ir_pos = ir->ir_pos;
+	    res.ir_wrapped = ir->ir_wrapped;
+	    options |= SEARCH_START;
+	    res.ir_state = IR_PARTIAL;
+	}
+    }
+    else
+	res.ir_state = IR_PARTIAL;
+
+    /*
+     * Search the lines in chunks: up to the end of the buffer, then after
+     * wrapping around up to the start line.
+     */
+    while (res.ir_state == IR_PARTIAL)
+    {
+	if (dir == FORWARD)
+	{
+	    last = res.ir_wrapped ? start->lnum : curbuf->b_ml.ml_line_count;
+	    stop_lnum = res.ir_pos.lnum + INCSEARCH_CHUNK;
+	    if (stop_lnum > last)
+		stop_lnum = last;
+	}
+	else
+	{
+	    last = res.ir_wrapped ? start->lnum : 1;
+	    stop_lnum = res.ir_pos.lnum - INCSEARCH_CHUNK;
+	    if (stop_lnum < last)
+		stop_lnum = last;
+	}
+
+#ifdef FEAT_RELTIME
+	/* Set the time limit for a chunk to half a second. */
+	profile_setlimit(500L, &tm);
+#endif
+	pos = res.ir_pos;
+	called_emsg = FALSE;
+	found = searchit(curwin, curbuf, &pos, dir, ccline.cmdbuff, 1L,
+					       options, RE_LAST, stop_lnum,
+#ifdef FEAT_RELTIME
+					       &tm
+#else
+					       NULL
+#endif
+					       );
+	if (found == OK)
+	{
+	    res.ir_state = IR_FOUND;
+	    res.ir_pos = pos;
+	    res.ir_lines = search_match_lines;
+	    res.ir_endcol = search_match_endcol;
+	    break;
+	}
+	if (got_int || called_emsg)
+	{
+	    /* Interrupted or invalid pattern. */
+	    called_emsg |= save_called_emsg;
+	    return 0;
+	}
+	if (char_avail())
+	{
+	    /* Continue with this chunk later. */
+	    *postponed = TRUE;
+	    break;
+	}
+#ifdef FEAT_RELTIME
+	/* Taking too long, give up without remembering a result. */
+	if (profile_passed_limit(&tm))
+	    return 0;
+#endif
+
+	if (stop_lnum == last)
+	{
+	    if (res.ir_wrapped || !p_ws)
+	    {
+		res.ir_state = IR_NOTFOUND;
+		break;
+	    }
+	    res.ir_wrapped = TRUE;
+	    res.ir_pos.lnum = (dir == FORWARD ? 1 : curbuf->b_ml.ml_line_count);
+	}
+	else
+	    res.ir_pos.lnum = stop_lnum + dir;
+	res.ir_pos.col = (dir == FORWARD ? 0 : MAXCOL);
+#ifdef FEAT_VIRTUALEDIT
+	res.ir_pos.coladd = 0;
+#endif
+	options |= SEARCH_START;
+    }
+
+    called_emsg |= save_called_emsg;
+
+    /* Remember the result for this pattern, keeping the results sorted on
+     * length. */
+    if (ir != NULL && ir->ir_len == ccline.cmdlen)
+	*ir = res;
+    else
+    {
+	idx = (ir == NULL ? 0
+		     : (int)(ir - (isresult_T *)is->is_results.ga_data) + 1);
+	if (ga_grow(&is->is_results, 1) == OK)
+	{
+	    ir = (isresult_T *)is->is_results.ga_data + idx;
+	    mch_memmove(ir + 1, ir, (size_t)(is->is_results.ga_len - idx)
+							 * sizeof(isresult_T));
+	    ++is->is_results.ga_len;
+	    *ir = res;
+	}
+    }
+    if (is->is_pat == NULL || STRNCMP(is->is_pat, ccline.cmdbuff,
+						       ccline.cmdlen) != 0)
+    {
+	vim_free(is->is_pat);
+	is->is_pat = vim_strsave(ccline.cmdbuff);
+	if (is->is_pat == NULL)
+	    is->is_results.ga_len = 0;
+    }
+    is->is_changedtick = curbuf->b_changedtick;
+
+    if (res.ir_state != IR_FOUND)
+	return 0;
+    curwin->w_cursor = res.ir_pos;
+    search_match_lines = res.ir_lines;
+    search_match_endcol = res.ir_endcol;
+    return 1;
+}
+#endif
+
 #if (defined(FEAT_CRYPT) || defined(FEAT_EVAL)) || defined(PROTO)
 /*
  * Get a command line with a prompt.
@@ -4546,7 +4880,7 @@ ExpandFromContext(xp, pat, num_file, file, options)
 	    }
     }
 
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 
     return ret;
 #endif /* FEAT_CMDL_COMPL */
@@ -5534,7 +5868,7 @@ del_history_entry(histype, str)
 	if (history[histype][idx].hisstr == NULL)
 	    hisidx[histype] = -1;
     }
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
     return found;
 }
 
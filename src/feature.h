@@ -484,6 +484,16 @@
 # define FEAT_BYTEOFF
 #endif
 
+/*
+ * +mmap		Map big files into memory instead of reading them into
+ *			the buffer, see 'mmapsize'.  Needs setjmp() to catch a
+ *			SIGBUS for a file truncated by another program.
+ */
+#if defined(FEAT_NORMAL) && defined(UNIX) && defined(HAVE_MMAP) \
+	&& defined(HAVE_SYS_MMAN_H) && defined(HAVE_SETJMP_H)
+# define FEAT_MMAP
+#endif
+
 /*
  * +wildignore		'wildignore' and 'backupskip' options
  *			Needed for Unix to make "crontab -e" work.
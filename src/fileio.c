@@ -266,6 +266,9 @@ readfile(fname, sfname, from, lines_to_skip, lines_to_read, eap, flags)
     linenr_T	skip_count = 0;
     linenr_T	read_count = 0;
     int		msg_save = msg_scroll;
+#ifdef FEAT_MMAP
+    int		mapped = FALSE;		/* file mapped instead of read */
+#endif
     linenr_T	read_no_eol_lnum = 0;   /* non-zero lnum when last line of
 					 * last read was missing the eol */
     int		try_mac = (vim_strchr(p_ffs, 'm') != NULL);
@@ -1167,6 +1170,64 @@ retry:
 #endif
     }
 
+#ifdef FEAT_MMAP
+    /*
+     * When editing a big file that doesn't need any conversion: map it into
+     * memory instead of reading it, see 'mmapsize'.
+     */
+    if (p_mms > 0 && newfile && wasempty && from == 0 && lines_to_skip == 0
+	    && lines_to_read == MAXLNUM && !read_stdin && !read_buffer
+	    && !filtering && !(flags & READ_DUMMY) && !recoverymode
+# ifdef FEAT_MBYTE
+	    && !converted && tmpname == NULL
+# endif
+	    && (fileformat == EOL_UNIX
+		|| (fileformat == EOL_UNKNOWN && try_unix)))
+    {
+	int	map_flags = 0;
+	int	noeol;
+
+	if (fileformat == EOL_UNKNOWN)
+	{
+	    map_flags |= MLMAP_DETECT;
+	    if (try_dos)
+		map_flags |= MLMAP_TRY_DOS;
+	    if (try_mac)
+		map_flags |= MLMAP_TRY_MAC;
+	}
+# ifdef FEAT_MBYTE
+	if (enc_utf8 && !curbuf->b_p_bin)
+	    map_flags |= MLMAP_UTF8;
+# endif
+	if (ml_map_file(curbuf, fd, map_flags,
+# ifdef FEAT_CRYPT
+		    (char_u *)CRYPT_MAGIC,
+# else
+		    NULL,
+# endif
+		    &filesize, &noeol) == OK)
+	{
+	    if (fileformat == EOL_UNKNOWN)
+	    {
+		fileformat = EOL_UNIX;
+		if (set_options)
+		    set_fileformat(fileformat, OPT_LOCAL);
+	    }
+	    lnum = curbuf->b_ml.ml_line_count;
+	    if (noeol)
+	    {
+		/* remember for when writing */
+		if (set_options)
+		    curbuf->b_p_eol = FALSE;
+		read_no_eol_lnum = lnum;
+	    }
+	    linerest = 0;
+	    mapped = TRUE;
+	    goto failed;
+	}
+    }
+#endif
+
     while (!error && !got_int)
     {
 	/*
@@ -2132,6 +2193,52 @@ rewind_retry:
 		}
 	    }
 	}
+	else if (fileformat == EOL_UNIX && skip_count == 0)
+	{
+	    char_u	*end = ptr + size;
+	    char_u	*nl;
+	    char_u	*tail = line_start;
+	    linenr_T	count = 0;
+
+	    /*
+	     * Unix format: find the line breaks with memchr() and append all
+	     * complete lines with one call.
+	     */
+	    while (ptr < end)
+	    {
+		nl = (char_u *)memchr(ptr, NL, (size_t)(end - ptr));
+		if (nl == NULL)
+		    nl = end;
+		/* NULs are replaced by newlines! */
+		while ((p = (char_u *)memchr(ptr, NUL, (size_t)(nl - ptr)))
+								      != NULL)
+		{
+		    *p = NL;
+		    ptr = p + 1;
+		}
+		ptr = nl;
+		if (nl == end)
+		    break;
+		*nl = NUL;		/* end of line */
+		tail = ++ptr;
+		if (++count == read_count)
+		    break;
+	    }
+	    if (count > 0)
+	    {
+		if (ml_append_lines(lnum, line_start, count, newfile) == FAIL)
+		    error = TRUE;
+		else
+		{
+		    lnum += count;
+		    if ((read_count -= count) == 0)
+			error = TRUE;	    /* break loop */
+		}
+		line_start = tail;
+		if (error)
+		    ptr = line_start;	    /* nothing left to write */
+	    }
+	}
 	else
 	{
 	    --ptr;
@@ -2290,7 +2397,11 @@ failed:
     if (!recoverymode)
     {
 	/* need to delete the last line, which comes from the empty buffer */
-	if (newfile && wasempty && !(curbuf->b_ml.ml_flags & ML_EMPTY))
+	if (newfile && wasempty && !(curbuf->b_ml.ml_flags & ML_EMPTY)
+#ifdef FEAT_MMAP
+		&& !mapped
+#endif
+		)
 	{
 #ifdef FEAT_NETBEANS_INTG
 	    netbeansFireChanges = 0;
@@ -2301,6 +2412,10 @@ failed:
 #endif
 	    --linecnt;
 	}
+#ifdef FEAT_MMAP
+	else if (mapped)
+	    --linecnt;		/* the mapped file replaced the empty line */
+#endif
 	linecnt = curbuf->b_ml.ml_line_count - linecnt;
 	if (filesize == 0)
 	    linecnt = 0;
@@ -3059,6 +3174,14 @@ buf_write(buf, fname, sfname, start, end, eap, append, forceit,
     else
 	overwriting = FALSE;
 
+#ifdef FEAT_MMAP
+    /* The file is going to be changed, the text of this or another buffer
+     * must not be in it.  When not all of it could be loaded writing would
+     * lose lines. */
+    if (ml_map_load_file(fname) == FAIL)
+	return FAIL;
+#endif
+
     if (exiting)
 	settmode(TMODE_COOK);	    /* when exiting allow typahead now */
 
@@ -7607,7 +7730,7 @@ au_cleanup()
 	    if (ap->pat == NULL)
 	    {
 		*prev_ap = ap->next;
-		vim_free(ap->reg_prog);
+		vim_regfree(ap->reg_prog);
 		vim_free(ap);
 	    }
 	    else
@@ -9696,7 +9819,7 @@ match_file_pat(pattern, prog, fname, sfname, tail, allow_dirs)
 	result = TRUE;
 
     if (prog == NULL)
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
     return result;
 }
 #endif
@@ -1842,6 +1842,12 @@ char_avail()
 {
     int	    retval;
 
+#ifdef FEAT_EVAL
+    /* When test_override("char_avail", 1) was used pretend there is no
+     * typeahead. */
+    if (disable_char_avail_for_testing)
+	return FALSE;
+#endif
     ++no_mapping;
     retval = vpeekc();
     --no_mapping;
@@ -2680,6 +2686,36 @@ vgetorpeek(advance)
 		    setcursor(); /* put cursor back where it belongs */
 		}
 
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+		/* Use the time until the user types something to parse syntax
+		 * ahead.  Show what was drawn so far first.  Redraw windows
+		 * that were drawn with a shortened sync when that is done for
+		 * them.  Only in Normal and Insert mode, like CursorHold, not
+		 * at a prompt or for getchar(). */
+		if (advance && typebuf.tb_len == 0 && scriptin[curscript] == NULL
+			&& !exmode_active && p_sxi > 0
+			&& (local_State == NORMAL_BUSY
+			    || (local_State & (INSERT | CMDLINE)) == INSERT))
+		{
+		    cursor_on();
+		    out_flush();
+# ifdef FEAT_GUI
+		    if (gui.in_use)
+			gui_update_cursor(FALSE, FALSE);
+# endif
+		    if (syntax_idle()
+			    && !need_wait_return && msg_scrolled == 0
+# ifdef FEAT_INS_EXPAND
+			    && !pum_visible()
+# endif
+			    )
+		    {
+			update_screen(0);
+			setcursor(); /* put cursor back where it belongs */
+		    }
+		}
+#endif
+
 		/*
 		 * If we have a partial match (and are going to wait for more
 		 * input from the user), show the partially matched characters
@@ -991,6 +991,8 @@ EXTERN int	maptick INIT(= 0);	/* tick for each non-mapped char */
 
 EXTERN char_u	chartab[256];		/* table used in charset.c; See
 					   init_chartab() for explanation */
+EXTERN int	chartab_tick INIT(= 0);	/* incremented when chartab[] or a
+					   b_chartab[] may have changed */
 
 EXTERN int	must_redraw INIT(= 0);	    /* type of redraw necessary */
 EXTERN int	skip_redraw INIT(= FALSE);  /* skip redraw once */
@@ -1085,6 +1087,9 @@ EXTERN FILE *redir_fd INIT(= NULL);	/* message redirection file */
 #ifdef FEAT_EVAL
 EXTERN int  redir_reg INIT(= 0);	/* message redirection register */
 EXTERN int  redir_vname INIT(= 0);	/* message redirection variable */
+
+/* Set with test_override("char_avail", 1): pretend no character was typed. */
+EXTERN int  disable_char_avail_for_testing INIT(= FALSE);
 #endif
 
 #ifdef FEAT_LANGMAP
@@ -1020,6 +1020,10 @@ main_loop(cmdwin, noexmode)
 	    did_check_timestamps = FALSE;
 	    if (need_check_timestamps)
 		check_timestamps(FALSE);
+#ifdef FEAT_MMAP
+	    /* Load mapped files that another program changed. */
+	    ml_map_check_all();
+#endif
 	    if (need_wait_return)	/* if wait_return still needed ... */
 		wait_return(FALSE);	/* ... call it now */
 	    if (need_start_insertmode && goto_im()
@@ -787,6 +787,9 @@ codepage_invalid:
 	fix_arg_enc();
 #endif
 
+    /* Compiled patterns depend on the encoding. */
+    vim_regcache_clear();
+
 #ifdef FEAT_AUTOCMD
     /* Fire an autocommand to let people do custom font setup. This must be
      * after Vim has been setup for the new encoding. */
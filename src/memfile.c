@@ -70,12 +70,35 @@ extern int dos2;			/* this is in os_amiga.c */
 #endif
 
 #define MEMFILE_PAGE_SIZE 4096		/* default page size */
+#define MF_MIN_USED_COUNT 10		/* minimal nr of pages in memory */
+#define MF_WRITE_MAX 0x10000		/* max nr of bytes in one write() of
+					   mf_sync() */
 
 static long_u	total_mem_used = 0;	/* total memory used for memfiles */
+static long_u	total_zip_used = 0;	/* total memory used for compressed
+					   blocks */
+
+#define MFZ_MIN_MATCH	4		/* shortest match that is compressed */
+#define MFZ_HASH_BITS	12		/* log2 of size of hash table used for
+					   finding matches */
 
 static void mf_ins_hash __ARGS((memfile_T *, bhdr_T *));
 static void mf_rem_hash __ARGS((memfile_T *, bhdr_T *));
 static bhdr_T *mf_find_hash __ARGS((memfile_T *, blocknr_T));
+static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+	mf_bnum_compare __ARGS((const void *s1, const void *s2));
+static int mf_sync_sorted __ARGS((memfile_T *, int, int *));
+static void mf_open_spill __ARGS((memfile_T *));
+static unsigned mf_zip __ARGS((char_u *src, unsigned len, char_u *dst, unsigned maxlen));
+static int mf_unzip __ARGS((char_u *src, unsigned len, char_u *dst, unsigned dstlen));
+static void mf_zip_store __ARGS((memfile_T *, bhdr_T *));
+static int mf_zip_get __ARGS((memfile_T *, mf_zblock_T *, bhdr_T *));
+static void mf_zip_rem __ARGS((memfile_T *, mf_zblock_T *));
+static int mf_zip_free_all __ARGS((memfile_T *));
+static int mf_write_list __ARGS((memfile_T *, bhdr_T **, int, unsigned, char_u *));
 static void mf_ins_used __ARGS((memfile_T *, bhdr_T *));
 static void mf_rem_used __ARGS((memfile_T *, bhdr_T *));
 static bhdr_T *mf_release __ARGS((memfile_T *, int));
@@ -84,9 +107,18 @@ static void mf_free_bhdr __ARGS((bhdr_T *));
 static void mf_ins_free __ARGS((memfile_T *, bhdr_T *));
 static bhdr_T *mf_rem_free __ARGS((memfile_T *));
 static int  mf_read __ARGS((memfile_T *, bhdr_T *));
+static int  mf_read_ahead __ARGS((memfile_T *, off_t, char_u *, unsigned));
 static int  mf_write __ARGS((memfile_T *, bhdr_T *));
 static int  mf_trans_add __ARGS((memfile_T *, bhdr_T *));
 static void mf_do_open __ARGS((memfile_T *, char_u *, int));
+static void mf_set_used_count_max __ARGS((memfile_T *));
+static void mf_hash_init __ARGS((mf_hashtab_T *));
+static void mf_hash_free __ARGS((mf_hashtab_T *));
+static void mf_hash_free_all __ARGS((mf_hashtab_T *));
+static mf_hashitem_T *mf_hash_find __ARGS((mf_hashtab_T *, blocknr_T));
+static void mf_hash_add_item __ARGS((mf_hashtab_T *, mf_hashitem_T *));
+static void mf_hash_rem_item __ARGS((mf_hashtab_T *, mf_hashitem_T *));
+static int mf_hash_grow __ARGS((mf_hashtab_T *));
 
 /*
  * The functions for using a memfile:
@@ -102,6 +134,7 @@ static void mf_do_open __ARGS((memfile_T *, char_u *, int));
  * mf_release_all() release as much memory as possible
  * mf_trans_del()   may translate negative to positive block number
  * mf_fullname()    make file name full path (use before first :cd)
+ * mf_maxmem_changed() adjust the cache size of all memfiles for 'maxmem'
  */
 
 /*
@@ -122,7 +155,6 @@ mf_open(fname, flags)
     int		flags;
 {
     memfile_T		*mfp;
-    int			i;
     off_t		size;
 #if defined(STATFS) && defined(UNIX) && !defined(__QNX__)
 # define USE_FSTATFS
@@ -155,11 +187,29 @@ mf_open(fname, flags)
     mfp->mf_used_last = NULL;
     mfp->mf_dirty = FALSE;
     mfp->mf_used_count = 0;
-    for (i = 0; i < MEMHASHSIZE; ++i)
-    {
-	mfp->mf_hash[i] = NULL;		/* hash lists are empty */
-	mfp->mf_trans[i] = NULL;	/* trans lists are empty */
-    }
+    mfp->mf_sync_count = 0;
+    mfp->mf_write_count = 0;
+    mfp->mf_write_blocks = 0;
+    mfp->mf_write_bytes = 0;
+    mfp->mf_sync_usec = 0;
+    mfp->mf_sync_max_usec = 0;
+    mfp->mf_spill_count = 0;
+    mfp->mf_spill = FALSE;
+    mf_hash_init(&mfp->mf_zhash);
+    mfp->mf_zfirst = NULL;
+    mfp->mf_zlast = NULL;
+    mfp->mf_zcount = 0;
+    mfp->mf_zsize = 0;
+    mfp->mf_zorig = 0;
+    mfp->mf_hits = 0;
+    mfp->mf_zhits = 0;
+    mfp->mf_reads = 0;
+    mfp->mf_ra_buf = NULL;
+    mfp->mf_ra_size = 0;
+    mfp->mf_ra_off = 0;
+    mfp->mf_ra_len = 0;
+    mf_hash_init(&mfp->mf_hash);
+    mf_hash_init(&mfp->mf_trans);
     mfp->mf_page_size = MEMFILE_PAGE_SIZE;
 
 #ifdef USE_FSTATFS
@@ -186,27 +236,49 @@ mf_open(fname, flags)
     mfp->mf_blocknr_min = -1;
     mfp->mf_neg_count = 0;
     mfp->mf_infile_count = mfp->mf_blocknr_max;
+    mf_set_used_count_max(mfp);
 
-    /*
-     * Compute maximum number of pages ('maxmem' is in Kbyte):
-     *	'mammem' * 1Kbyte / page-size-in-bytes.
-     * Avoid overflow by first reducing page size as much as possible.
-     */
-    {
-	int	    shift = 10;
-	unsigned    page_size = mfp->mf_page_size;
+    return mfp;
+}
 
-	while (shift > 0 && (page_size & 1) == 0)
-	{
-	    page_size = page_size >> 1;
-	    --shift;
-	}
-	mfp->mf_used_count_max = (p_mm << shift) / page_size;
-	if (mfp->mf_used_count_max < 10)
-	    mfp->mf_used_count_max = 10;
+/*
+ * Compute the maximum number of pages kept in memory for memfile "mfp"
+ * ('maxmem' is in Kbyte):
+ *	'maxmem' * 1Kbyte / page-size-in-bytes.
+ * Also used when the page size or 'maxmem' changed.
+ */
+    static void
+mf_set_used_count_max(mfp)
+    memfile_T	*mfp;
+{
+    int		shift = 10;
+    unsigned	page_size = mfp->mf_page_size;
+
+    /* Avoid overflow by first reducing page size as much as possible. */
+    while (shift > 0 && (page_size & 1) == 0)
+    {
+	page_size = page_size >> 1;
+	--shift;
     }
+    mfp->mf_used_count_limit = (p_mm << shift) / page_size;
+    if (mfp->mf_used_count_limit < MF_MIN_USED_COUNT)
+	mfp->mf_used_count_limit = MF_MIN_USED_COUNT;
+    mfp->mf_used_count_max = mfp->mf_used_count_limit;
+}
 
-    return mfp;
+/*
+ * Called when 'maxmem' was changed: recompute the cache size for all
+ * memfiles.  Blocks over the new limit are released lazily, when the next
+ * block is needed.
+ */
+    void
+mf_maxmem_changed()
+{
+    buf_T	*buf;
+
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_mfp != NULL)
+	    mf_set_used_count_max(buf->b_ml.ml_mfp);
 }
 
 /*
@@ -233,6 +305,72 @@ mf_open_file(mfp, fname)
     return OK;
 }
 
+/*
+ * Set the maximum amount of memory used by memfile "mfp" when it has no swap
+ * file to "kbyte" Kbyte.  Zero means there is no maximum.  When over the
+ * maximum a temp file is created for blocks to be released to.
+ */
+    void
+mf_set_spill(mfp, kbyte)
+    memfile_T	*mfp;
+    long	kbyte;
+{
+    long_u	count;
+
+    if (kbyte <= 0)
+	mfp->mf_spill_count = 0;
+    else
+    {
+	count = ((long_u)kbyte << 10) / mfp->mf_page_size;
+	if (count < MF_MIN_USED_COUNT)
+	    count = MF_MIN_USED_COUNT;
+	mfp->mf_spill_count = (unsigned)count;
+    }
+}
+
+/*
+ * Read memfile "mfp" ahead in chunks of "size" bytes: when a block is read
+ * from the file the blocks following it are read with the same read() call.
+ * Useful when the blocks are going to be read in file order, e.g., when
+ * recovering.  Zero switches it off again.
+ */
+    void
+mf_set_readahead(mfp, size)
+    memfile_T	*mfp;
+    unsigned	size;
+{
+    vim_free(mfp->mf_ra_buf);
+    mfp->mf_ra_buf = NULL;
+    mfp->mf_ra_size = 0;
+    mfp->mf_ra_len = 0;
+    if (size > 0)
+    {
+	mfp->mf_ra_buf = lalloc((long_u)size, FALSE);
+	if (mfp->mf_ra_buf != NULL)
+	    mfp->mf_ra_size = size;
+    }
+}
+
+/*
+ * Open a temp file for memfile "mfp" that has no swap file, to release blocks
+ * to when it uses more memory than allowed.  Unlike a swap file it can't be
+ * used for recovery and is deleted when the memfile is closed.
+ */
+    static void
+mf_open_spill(mfp)
+    memfile_T	*mfp;
+{
+    char_u	*fname;
+
+    fname = vim_tempname('s');
+    if (fname != NULL && mf_open_file(mfp, fname) == OK) /* consumes fname! */
+    {
+	mfp->mf_spill = TRUE;
+	/* Blocks written to a previous file must be written again. */
+	mf_set_dirty(mfp);
+    }
+}
+
 /*
  * close a memory file and delete the associated file if 'del_file' is TRUE
  */
@@ -242,8 +380,6 @@ mf_close(mfp, del_file)
     int		del_file;
 {
     bhdr_T	*hp, *nextp;
-    NR_TRANS	*tp, *tpnext;
-    int		i;
 
     if (mfp == NULL)		    /* safety check */
 	return;
@@ -252,7 +388,7 @@ mf_close(mfp, del_file)
 	if (close(mfp->mf_fd) < 0)
 	    EMSG(_(e_swapclose));
     }
-    if (del_file && mfp->mf_fname != NULL)
+    if ((del_file || mfp->mf_spill) && mfp->mf_fname != NULL)
 	mch_remove(mfp->mf_fname);
 					    /* free entries in used list */
     for (hp = mfp->mf_used_first; hp != NULL; hp = nextp)
@@ -263,12 +399,11 @@ mf_close(mfp, del_file)
     }
     while (mfp->mf_free_first != NULL)	    /* free entries in free list */
 	vim_free(mf_rem_free(mfp));
-    for (i = 0; i < MEMHASHSIZE; ++i)	    /* free entries in trans lists */
-	for (tp = mfp->mf_trans[i]; tp != NULL; tp = tpnext)
-	{
-	    tpnext = tp->nt_next;
-	    vim_free(tp);
-	}
+    mf_zip_free_all(mfp);
+    mf_hash_free(&mfp->mf_zhash);
+    mf_hash_free(&mfp->mf_hash);
+    mf_hash_free_all(&mfp->mf_trans);	    /* free hashtable and its items */
+    vim_free(mfp->mf_ra_buf);
     vim_free(mfp->mf_fname);
     vim_free(mfp->mf_ffname);
     vim_free(mfp);
@@ -289,7 +424,12 @@ mf_close_file(buf, getlines)
     if (mfp == NULL || mfp->mf_fd < 0)		/* nothing to close */
 	return;
 
-    if (getlines)
+    if (getlines
+#ifdef FEAT_MMAP
+	    /* the lines of a mapped file are not in the memfile */
+	    && buf->b_ml.ml_map == NULL
+#endif
+	    )
     {
 	/* get all blocks in memory by accessing all lines (clumsy!) */
 	mf_dont_release = TRUE;
@@ -302,6 +442,12 @@ mf_close_file(buf, getlines)
     if (close(mfp->mf_fd) < 0)			/* close the file */
 	EMSG(_(e_swapclose));
     mfp->mf_fd = -1;
+    mfp->mf_spill = FALSE;
+    mfp->mf_ra_len = 0;
+
+    /* The compressed blocks are copies of blocks in the file, the numbers
+     * will be used for other blocks in a new file. */
+    mf_zip_free_all(mfp);
 
     if (mfp->mf_fname != NULL)
     {
@@ -326,6 +472,7 @@ mf_new_page_size(mfp, new_size)
      * freed with that size later on. */
     total_mem_used += new_size - mfp->mf_page_size;
     mfp->mf_page_size = new_size;
+    mf_set_used_count_max(mfp);
 }
 
 /*
@@ -442,6 +589,8 @@ mf_get(mfp, nr, page_count)
     hp = mf_find_hash(mfp, nr);
     if (hp == NULL)	/* not in the hash list */
     {
+	mf_zblock_T	*zp = NULL;
+
 	if (nr < 0 || nr >= mfp->mf_infile_count)   /* can't be in the file */
 	    return NULL;
 
@@ -459,21 +608,35 @@ mf_get(mfp, nr, page_count)
 	hp->bh_bnum = nr;
 	hp->bh_flags = 0;
 	hp->bh_page_count = page_count;
-	if (mf_read(mfp, hp) == FAIL)	    /* cannot read the block! */
+
+	/* Use the compressed copy when there is one.  Look for it only now,
+	 * mf_release() may have dropped compressed blocks. */
+	if (mfp->mf_zcount > 0)
+	    zp = (mf_zblock_T *)mf_hash_find(&mfp->mf_zhash, nr);
+	if (zp != NULL && mf_zip_get(mfp, zp, hp) == OK)
+	    ++mfp->mf_zhits;
+	else if (mf_read(mfp, hp) == FAIL)	    /* cannot read the block! */
 	{
 	    mf_free_bhdr(hp);
 	    return NULL;
 	}
+	else
+	    ++mfp->mf_reads;
+
+	/* A block had to be read back: if the cache was made smaller because
+	 * memory was short, let it grow again towards the 'maxmem' limit. */
+	if (mfp->mf_used_count_max < mfp->mf_used_count_limit)
+	    ++mfp->mf_used_count_max;
+	mf_ins_hash(mfp, hp);	/* put in the hash table */
     }
     else
     {
 	mf_rem_used(mfp, hp);	/* remove from list, insert in front below */
-	mf_rem_hash(mfp, hp);
+	++mfp->mf_hits;
     }
 
     hp->bh_flags |= BH_LOCKED;
     mf_ins_used(mfp, hp);	/* put in front of used list */
-    mf_ins_hash(mfp, hp);	/* put in front of hash list */
 
     return hp;
 }
@@ -560,11 +723,16 @@ mf_sync(mfp, flags)
     int		flags;
 {
     int		status;
+    int		done;
     bhdr_T	*hp;
 #if defined(SYNC_DUP_CLOSE) && !defined(MSDOS)
     int		fd;
 #endif
     int		got_int_save = got_int;
+#ifdef FEAT_RELTIME
+    proftime_T	start;
+    long	usec;
+#endif
 
     if (mfp->mf_fd < 0)	    /* there is no file, nothing to do */
     {
@@ -576,44 +744,57 @@ mf_sync(mfp, flags)
      * previously. */
     got_int = FALSE;
 
+#ifdef FEAT_RELTIME
+    profile_start(&start);
+#endif
+
     /*
-     * sync from last to first (may reduce the probability of an inconsistent
-     * file) If a write fails, it is very likely caused by a full filesystem.
-     * Then we only try to write blocks within the existing file. If that also
-     * fails then we give up.
+     * Normally the dirty blocks are written in the order of their position in
+     * the file, blocks next to each other with one write().
      */
     status = OK;
-    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
-	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
-		&& (hp->bh_flags & BH_DIRTY)
-		&& (status == OK || (hp->bh_bnum >= 0
-		    && hp->bh_bnum < mfp->mf_infile_count)))
-	{
-	    if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
-		continue;
-	    if (mf_write(mfp, hp) == FAIL)
-	    {
-		if (status == FAIL)	/* double error: quit syncing */
-		    break;
-		status = FAIL;
-	    }
-	    if (flags & MFS_STOP)
+    done = (flags & MFS_ZERO) ? NOTDONE : mf_sync_sorted(mfp, flags, &status);
+    if (done == NOTDONE)
+    {
+	/*
+	 * sync from last to first (may reduce the probability of an
+	 * inconsistent file) If a write fails, it is very likely caused by a
+	 * full filesystem.  Then we only try to write blocks within the
+	 * existing file. If that also fails then we give up.
+	 */
+	for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	    if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+		    && (hp->bh_flags & BH_DIRTY)
+		    && (status == OK || (hp->bh_bnum >= 0
+			&& hp->bh_bnum < mfp->mf_infile_count)))
 	    {
-		/* Stop when char available now. */
-		if (ui_char_avail())
+		if ((flags & MFS_ZERO) && hp->bh_bnum != 0)
+		    continue;
+		if (mf_write(mfp, hp) == FAIL)
+		{
+		    if (status == FAIL)	/* double error: quit syncing */
+			break;
+		    status = FAIL;
+		}
+		if (flags & MFS_STOP)
+		{
+		    /* Stop when char available now. */
+		    if (ui_char_avail())
+			break;
+		}
+		else
+		    ui_breakcheck();
+		if (got_int)
 		    break;
 	    }
-	    else
-		ui_breakcheck();
-	    if (got_int)
-		break;
-	}
+	done = (hp == NULL) ? OK : FAIL;
+    }
 
     /*
      * If the whole list is flushed, the memfile is not dirty anymore.
      * In case of an error this flag is also set, to avoid trying all the time.
      */
-    if (hp == NULL || status == FAIL)
+    if (done == OK || status == FAIL)
 	mfp->mf_dirty = FALSE;
 
     if ((flags & MFS_FLUSH) && *p_sws != NUL)
@@ -712,11 +893,211 @@ mf_sync(mfp, flags)
 #endif /* AMIGA */
     }
 
+#ifdef FEAT_RELTIME
+    profile_end(&start);
+    usec = profile_usec(&start);
+    mfp->mf_sync_usec += usec;
+    if (usec > mfp->mf_sync_max_usec)
+	mfp->mf_sync_max_usec = usec;
+#endif
+    ++mfp->mf_sync_count;
+
     got_int |= got_int_save;
 
     return status;
 }
 
+/*
+ * Compare the block numbers of two blocks, for qsort().
+ */
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+mf_bnum_compare(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    blocknr_T	n1 = (*(bhdr_T **)s1)->bh_bnum;
+    blocknr_T	n2 = (*(bhdr_T **)s2)->bh_bnum;
+
+    return n1 == n2 ? 0 : n1 > n2 ? 1 : -1;
+}
+
+/*
+ * Write the dirty blocks of memfile "mfp" for mf_sync(), in the order of
+ * their block numbers.  Blocks that are next to each other in the file are
+ * written together.  Blocks without a block number get one first, in the
+ * order mf_sync() used to write them.
+ * Sets "*statusp" to FAIL when writing fails.
+ * Returns OK when all blocks were written, FAIL when stopped early and
+ * NOTDONE when out of memory, nothing was written then.
+ */
+    static int
+mf_sync_sorted(mfp, flags, statusp)
+    memfile_T	*mfp;
+    int		flags;
+    int		*statusp;
+{
+    bhdr_T	**list;
+    bhdr_T	*hp;
+    char_u	*buf;
+    int		count = 0;
+    int		i, j;
+    unsigned	page_count;
+    int		r;
+
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						  && (hp->bh_flags & BH_DIRTY))
+	    ++count;
+    if (count == 0)
+	return OK;
+    list = (bhdr_T **)lalloc((long_u)(count * sizeof(bhdr_T *)), FALSE);
+    if (list == NULL)
+	return NOTDONE;
+
+    count = 0;
+    for (hp = mfp->mf_used_last; hp != NULL; hp = hp->bh_prev)
+	if (((flags & MFS_ALL) || hp->bh_bnum >= 0)
+						  && (hp->bh_flags & BH_DIRTY))
+	{
+	    if (hp->bh_bnum < 0 && mf_trans_add(mfp, hp) == FAIL)
+		*statusp = FAIL;
+	    else
+		list[count++] = hp;
+	}
+    qsort((void *)list, (size_t)count, sizeof(bhdr_T *), mf_bnum_compare);
+
+    /* When this fails the blocks are written one by one. */
+    buf = lalloc((long_u)MF_WRITE_MAX, FALSE);
+
+    for (i = 0; i < count; i = j)
+    {
+	hp = list[i];
+	j = i + 1;
+
+	/* After an error only try writing blocks within the existing file,
+	 * one at a time. */
+	if (*statusp == FAIL)
+	{
+	    if (hp->bh_bnum >= mfp->mf_infile_count)
+		continue;
+	    r = mf_write(mfp, hp);
+	}
+	else
+	{
+	    /* Find the blocks following this one in the file that fit in
+	     * "buf".  When the block is beyond the end of the file mf_write()
+	     * fills the gap. */
+	    page_count = hp->bh_page_count;
+	    if (buf != NULL && hp->bh_bnum <= mfp->mf_infile_count)
+		while (j < count
+			&& list[j]->bh_bnum == list[j - 1]->bh_bnum
+					       + list[j - 1]->bh_page_count
+			&& (page_count + list[j]->bh_page_count)
+					  * mfp->mf_page_size <= MF_WRITE_MAX)
+		    page_count += list[j++]->bh_page_count;
+	    if (j == i + 1)
+		r = mf_write(mfp, hp);
+	    else
+		r = mf_write_list(mfp, list + i, j - i, page_count, buf);
+	}
+	if (r == FAIL)
+	{
+	    if (*statusp == FAIL)	/* double error: quit syncing */
+		break;
+	    *statusp = FAIL;
+	}
+	if (flags & MFS_STOP)
+	{
+	    /* Stop when char available now. */
+	    if (ui_char_avail())
+		break;
+	}
+	else
+	    ui_breakcheck();
+	if (got_int)
+	    break;
+    }
+
+    vim_free(buf);
+    vim_free(list);
+    return i >= count ? OK : FAIL;
+}
+
+/*
+ * Write "count" blocks from "list", which are next to each other in the file
+ * and have "page_count" pages together, with one write() through "buf".
+ * The first block must not be beyond the end of the file.
+ *
+ * Return FAIL for failure, OK otherwise
+ */
+    static int
+mf_write_list(mfp, list, count, page_count, buf)
+    memfile_T	*mfp;
+    bhdr_T	**list;
+    int		count;
+    unsigned	page_count;
+    char_u	*buf;
+{
+    off_t	offset;
+    unsigned	size;
+    unsigned	len;
+    int		i;
+
+    size = 0;
+    for (i = 0; i < count; ++i)
+    {
+	len = mfp->mf_page_size * list[i]->bh_page_count;
+	mch_memmove(buf + size, list[i]->bh_data, (size_t)len);
+	size += len;
+    }
+
+    mfp->mf_ra_len = 0;		/* read-ahead data may be outdated */
+    offset = (off_t)mfp->mf_page_size * list[0]->bh_bnum;
+    if (lseek(mfp->mf_fd, offset, SEEK_SET) != offset)
+    {
+	PERROR(_("E296: Seek error in swap file write"));
+	return FAIL;
+    }
+    if ((unsigned)vim_write(mfp->mf_fd, buf, size) != size)
+    {
+	/* See mf_write() about the message. */
+	if (!did_swapwrite_msg)
+	    EMSG(_("E297: Write error in swap file"));
+	did_swapwrite_msg = TRUE;
+	return FAIL;
+    }
+    did_swapwrite_msg = FALSE;
+    ++mfp->mf_write_count;
+    mfp->mf_write_blocks += count;
+    mfp->mf_write_bytes += size;
+
+    for (i = 0; i < count; ++i)
+	list[i]->bh_flags &= ~BH_DIRTY;
+    if (list[0]->bh_bnum + (blocknr_T)page_count > mfp->mf_infile_count)
+	mfp->mf_infile_count = list[0]->bh_bnum + page_count;
+    return OK;
+}
+
+/*
+ * Return the number of bytes in dirty blocks of memfile "mfp", these still
+ * need to be written to the swap file.
+ */
+    long_u
+mf_pending_bytes(mfp)
+    memfile_T	*mfp;
+{
+    bhdr_T	*hp;
+    long_u	size = 0;
+
+    for (hp = mfp->mf_used_first; hp != NULL; hp = hp->bh_next)
+	if (hp->bh_flags & BH_DIRTY)
+	    size += (long_u)mfp->mf_page_size * hp->bh_page_count;
+    return size;
+}
+
 /*
  * For all blocks in memory file *mfp that have a positive block number set
  * the dirty flag.  These are blocks that need to be written to a newly
@@ -742,16 +1123,7 @@ mf_ins_hash(mfp, hp)
     memfile_T	*mfp;
     bhdr_T	*hp;
 {
-    bhdr_T	*hhp;
-    int		hash;
-
-    hash = MEMHASH(hp->bh_bnum);
-    hhp = mfp->mf_hash[hash];
-    hp->bh_hash_next = hhp;
-    hp->bh_hash_prev = NULL;
-    if (hhp != NULL)
-	hhp->bh_hash_prev = hp;
-    mfp->mf_hash[hash] = hp;
+    mf_hash_add_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
 }
 
 /*
@@ -762,13 +1134,7 @@ mf_rem_hash(mfp, hp)
     memfile_T	*mfp;
     bhdr_T	*hp;
 {
-    if (hp->bh_hash_prev == NULL)
-	mfp->mf_hash[MEMHASH(hp->bh_bnum)] = hp->bh_hash_next;
-    else
-	hp->bh_hash_prev->bh_hash_next = hp->bh_hash_next;
-
-    if (hp->bh_hash_next)
-	hp->bh_hash_next->bh_hash_prev = hp->bh_hash_prev;
+    mf_hash_rem_item(&mfp->mf_hash, (mf_hashitem_T *)hp);
 }
 
 /*
@@ -779,12 +1145,7 @@ mf_find_hash(mfp, nr)
     memfile_T	*mfp;
     blocknr_T	nr;
 {
-    bhdr_T	*hp;
-
-    for (hp = mfp->mf_hash[MEMHASH(nr)]; hp != NULL; hp = hp->bh_hash_next)
-	if (hp->bh_bnum == nr)
-	    break;
-    return hp;
+    return (bhdr_T *)mf_hash_find(&mfp->mf_hash, nr);
 }
 
 /*
@@ -853,6 +1214,17 @@ mf_release(mfp, page_count)
     need_release = ((mfp->mf_used_count >= mfp->mf_used_count_max)
 				  || (total_mem_used >> 10) >= (long_u)p_mmt);
 
+    /*
+     * Without a swap file only the limit set with mf_set_spill() counts.
+     * When it is reached create the temp file to release blocks to.
+     */
+    if (mfp->mf_spill_count > 0 && (mfp->mf_fd < 0 || mfp->mf_spill))
+    {
+	need_release = (mfp->mf_used_count >= mfp->mf_spill_count);
+	if (need_release && mfp->mf_fd < 0)
+	    mf_open_spill(mfp);
+    }
+
     /*
      * Try to create a swap file if the amount of memory used is getting too
      * high.
@@ -891,6 +1263,10 @@ mf_release(mfp, page_count)
     if ((hp->bh_flags & BH_DIRTY) && mf_write(mfp, hp) == FAIL)
 	return NULL;
 
+    /* Keep a compressed copy, if 'maxmemzip' allows. */
+    if (p_mmz > 0)
+	mf_zip_store(mfp, hp);
+
     mf_rem_used(mfp, hp);
     mf_rem_hash(mfp, hp);
 
@@ -930,6 +1306,10 @@ mf_release_all()
 	mfp = buf->b_ml.ml_mfp;
 	if (mfp != NULL)
 	{
+	    /* Compressed blocks can be read from the swap file again. */
+	    if (mf_zip_free_all(mfp))
+		retval = TRUE;
+
 	    /* If no swap file yet, may open one */
 	    if (mfp->mf_fd < 0 && buf->b_may_swap)
 		ml_open_file(buf);
@@ -952,12 +1332,391 @@ mf_release_all()
 		    else
 			hp = hp->bh_prev;
 		}
+
+		/* Memory is short: use a smaller cache for this memfile from
+		 * now on.  It grows back in mf_get() when blocks have to be
+		 * read again. */
+		mfp->mf_used_count_max /= 2;
+		if (mfp->mf_used_count_max < MF_MIN_USED_COUNT)
+		    mfp->mf_used_count_max = MF_MIN_USED_COUNT;
 	    }
 	}
     }
     return retval;
 }
 
+/*
+ * Compressed blocks.
+ *
+ * When 'maxmemzip' is not zero, a block that is released from memory is
+ * compressed and kept, up to 'maxmemzip' Kbyte for all memfiles together.
+ * When the block is needed again it is uncompressed instead of read from the
+ * swap file.  Only blocks that were written are kept, thus a compressed block
+ * can always be dropped.
+ *
+ * The compression is a simple LZ77: a sequence of a token byte with the
+ * number of literal bytes in the high four bits and the match length minus
+ * MFZ_MIN_MATCH in the low four bits, more bytes for the literal count when it
+ * is 15 or more, the literal bytes, a two byte match offset (least
+ * significant byte first) and more bytes for the match length when it is 15
+ * or more.  The last sequence only has literal bytes.  This is the same as the
+ * LZ4 block format.
+ */
+
+/*
+ * Compress "len" bytes at "src" into "dst", which has room for "maxlen"
+ * bytes.  Returns the compressed length, zero when it does not fit.
+ */
+    static unsigned
+mf_zip(src, len, dst, maxlen)
+    char_u	*src;
+    unsigned	len;
+    char_u	*dst;
+    unsigned	maxlen;
+{
+    int		table[1 << MFZ_HASH_BITS];
+    char_u	*ip = src;
+    char_u	*anchor = src;
+    char_u	*iend = src + len;
+    char_u	*op = dst;
+    char_u	*oend = dst + maxlen;
+    char_u	*ref;
+    char_u	*token;
+    long_u	h;
+    unsigned	lit;
+    unsigned	mlen;
+    unsigned	n;
+
+    vim_memset(table, 0xff, sizeof(table));	/* all entries -1 */
+
+    /* A match must start at least 12 bytes before the end and the last 5
+     * bytes are always literals, like LZ4 does. */
+    while (len >= 13 && ip < iend - 12)
+    {
+	h = (((long_u)ip[0] | ((long_u)ip[1] << 8) | ((long_u)ip[2] << 16)
+			       | ((long_u)ip[3] << 24)) * 2654435761UL)
+						    & (long_u)0xffffffffL;
+	h >>= 32 - MFZ_HASH_BITS;
+	ref = table[h] < 0 ? NULL : src + table[h];
+	table[h] = (int)(ip - src);
+	if (ref == NULL || ip - ref > 0xffff
+		|| ref[0] != ip[0] || ref[1] != ip[1]
+		|| ref[2] != ip[2] || ref[3] != ip[3])
+	{
+	    ++ip;
+	    continue;
+	}
+
+	lit = (unsigned)(ip - anchor);
+	mlen = MFZ_MIN_MATCH;
+	while (ip + mlen < iend - 5 && ip[mlen] == ref[mlen])
+	    ++mlen;
+
+	/* token, literal count, literals, offset and match length */
+	if (op + 1 + lit + lit / 255 + 1 + 2 + mlen / 255 + 1 > oend)
+	    return 0;
+	token = op++;
+	if (lit >= 15)
+	{
+	    *token = 15 << 4;
+	    for (n = lit - 15; n >= 255; n -= 255)
+		*op++ = 255;
+	    *op++ = n;
+	}
+	else
+	    *token = lit << 4;
+	mch_memmove(op, anchor, (size_t)lit);
+	op += lit;
+	n = (unsigned)(ip - ref);
+	*op++ = n & 0xff;
+	*op++ = n >> 8;
+	n = mlen - MFZ_MIN_MATCH;
+	if (n >= 15)
+	{
+	    *token |= 15;
+	    for (n -= 15; n >= 255; n -= 255)
+		*op++ = 255;
+	    *op++ = n;
+	}
+	else
+	    *token |= n;
+
+	ip += mlen;
+	anchor = ip;
+    }
+
+    /* the remaining bytes are literals */
+    lit = (unsigned)(iend - anchor);
+    if (op + 1 + lit + lit / 255 + 1 > oend)
+	return 0;
+    if (lit >= 15)
+    {
+	*op++ = 15 << 4;
+	for (n = lit - 15; n >= 255; n -= 255)
+	    *op++ = 255;
+	*op++ = n;
+    }
+    else
+	*op++ = lit << 4;
+    mch_memmove(op, anchor, (size_t)lit);
+    op += lit;
+
+    return (unsigned)(op - dst);
+}
+
+/*
+ * Uncompress "len" bytes at "src" into "dst", which must become exactly
+ * "dstlen" bytes.
+ * Return FAIL when the data is not valid, OK otherwise.
+ */
+    static int
+mf_unzip(src, len, dst, dstlen)
+    char_u	*src;
+    unsigned	len;
+    char_u	*dst;
+    unsigned	dstlen;
+{
+    char_u	*ip = src;
+    char_u	*iend = src + len;
+    char_u	*op = dst;
+    char_u	*oend = dst + dstlen;
+    char_u	*ref;
+    unsigned	token;
+    unsigned	n;
+    unsigned	off;
+
+    while (ip < iend)
+    {
+	token = *ip++;
+	n = token >> 4;
+	if (n == 15)
+	    do
+	    {
+		if (ip >= iend)
+		    return FAIL;
+		n += *ip;
+	    } while (*ip++ == 255);
+	if ((unsigned)(iend - ip) < n || (unsigned)(oend - op) < n)
+	    return FAIL;
+	mch_memmove(op, ip, (size_t)n);
+	op += n;
+	ip += n;
+	if (ip == iend)
+	    break;		/* last sequence has no match */
+
+	if (iend - ip < 2)
+	    return FAIL;
+	off = ip[0] | (ip[1] << 8);
+	ip += 2;
+	if (off == 0 || (unsigned)(op - dst) < off)
+	    return FAIL;
+	n = token & 15;
+	if (n == 15)
+	    do
+	    {
+		if (ip >= iend)
+		    return FAIL;
+		n += *ip;
+	    } while (*ip++ == 255);
+	n += MFZ_MIN_MATCH;
+	if ((unsigned)(oend - op) < n)
+	    return FAIL;
+	for (ref = op - off; n > 0; --n)	/* may overlap, copy bytes */
+	    *op++ = *ref++;
+    }
+    return op == oend ? OK : FAIL;
+}
+
+/*
+ * Keep a compressed copy of block "hp", which is about to be released.
+ * Older compressed blocks of "mfp" are dropped to stay within 'maxmemzip'.
+ * When the block does not compress well or memory is short nothing happens.
+ */
+    static void
+mf_zip_store(mfp, hp)
+    memfile_T	*mfp;
+    bhdr_T	*hp;
+{
+    static char_u   *zbuf = NULL;
+    static unsigned zbuf_len = 0;
+    unsigned	    size = mfp->mf_page_size * hp->bh_page_count;
+    unsigned	    maxlen = size - size / 8;	/* must save 1/8 at least */
+    unsigned	    len;
+    long_u	    limit = (long_u)p_mmz << 10;
+    mf_zblock_T	    *zp;
+
+    if (zbuf_len < maxlen)
+    {
+	vim_free(zbuf);
+	zbuf_len = 0;
+	zbuf = lalloc((long_u)maxlen, FALSE);
+	if (zbuf == NULL)
+	    return;
+	zbuf_len = maxlen;
+    }
+    len = mf_zip(hp->bh_data, size, zbuf, maxlen);
+    if (len == 0 || len > limit)
+	return;
+
+    /* There can't be an old copy, it is dropped when the block is
+     * uncompressed, but be safe. */
+    zp = (mf_zblock_T *)mf_hash_find(&mfp->mf_zhash, hp->bh_bnum);
+    if (zp != NULL)
+	mf_zip_rem(mfp, zp);
+
+    while (total_zip_used + len > limit && mfp->mf_zlast != NULL)
+	mf_zip_rem(mfp, mfp->mf_zlast);
+    if (total_zip_used + len > limit)
+	return;
+
+    zp = (mf_zblock_T *)lalloc((long_u)(sizeof(mf_zblock_T) + len), FALSE);
+    if (zp == NULL)
+	return;
+    zp->zb_bnum = hp->bh_bnum;
+    zp->zb_page_count = hp->bh_page_count;
+    zp->zb_len = len;
+    mch_memmove(zp->zb_data, zbuf, (size_t)len);
+    mf_hash_add_item(&mfp->mf_zhash, (mf_hashitem_T *)zp);
+
+    zp->zb_prev = NULL;
+    zp->zb_next = mfp->mf_zfirst;
+    if (mfp->mf_zfirst != NULL)
+	mfp->mf_zfirst->zb_prev = zp;
+    else
+	mfp->mf_zlast = zp;
+    mfp->mf_zfirst = zp;
+
+    ++mfp->mf_zcount;
+    mfp->mf_zsize += len;
+    mfp->mf_zorig += size;
+    total_zip_used += len;
+}
+
+/*
+ * Uncompress block "zp" into "hp" and drop it.
+ * Return FAIL when it can't be used, the block must be read from the file.
+ */
+    static int
+mf_zip_get(mfp, zp, hp)
+    memfile_T	*mfp;
+    mf_zblock_T	*zp;
+    bhdr_T	*hp;
+{
+    int		retval = FAIL;
+
+    if (zp->zb_page_count == hp->bh_page_count)
+	retval = mf_unzip(zp->zb_data, zp->zb_len, hp->bh_data,
+			     mfp->mf_page_size * (unsigned)hp->bh_page_count);
+    mf_zip_rem(mfp, zp);
+    return retval;
+}
+
+/*
+ * Remove compressed block "zp" from "mfp" and free it.
+ */
+    static void
+mf_zip_rem(mfp, zp)
+    memfile_T	*mfp;
+    mf_zblock_T	*zp;
+{
+    mf_hash_rem_item(&mfp->mf_zhash, (mf_hashitem_T *)zp);
+    if (zp->zb_prev == NULL)
+	mfp->mf_zfirst = zp->zb_next;
+    else
+	zp->zb_prev->zb_next = zp->zb_next;
+    if (zp->zb_next == NULL)
+	mfp->mf_zlast = zp->zb_prev;
+    else
+	zp->zb_next->zb_prev = zp->zb_prev;
+
+    --mfp->mf_zcount;
+    mfp->mf_zsize -= zp->zb_len;
+    mfp->mf_zorig -= mfp->mf_page_size * zp->zb_page_count;
+    total_zip_used -= zp->zb_len;
+    vim_free(zp);
+}
+
+/*
+ * Drop all compressed blocks of "mfp".
+ * Returns TRUE if there were any.
+ */
+    static int
+mf_zip_free_all(mfp)
+    memfile_T	*mfp;
+{
+    int		retval = (mfp->mf_zfirst != NULL);
+
+    while (mfp->mf_zfirst != NULL)
+	mf_zip_rem(mfp, mfp->mf_zfirst);
+    return retval;
+}
+
+/*
+ * Called when 'maxmemzip' was made smaller: drop compressed blocks until the
+ * total fits.
+ */
+    void
+mf_zip_limit()
+{
+    buf_T	*buf;
+    memfile_T	*mfp;
+
+    for (buf = firstbuf; buf != NULL
+			&& total_zip_used > ((long_u)p_mmz << 10);
+							    buf = buf->b_next)
+	if ((mfp = buf->b_ml.ml_mfp) != NULL)
+	    while (mfp->mf_zlast != NULL
+				   && total_zip_used > ((long_u)p_mmz << 10))
+		mf_zip_rem(mfp, mfp->mf_zlast);
+}
+
+/*
+ * ":memstats": list how many blocks of each buffer were found in memory,
+ * found compressed and read from the swap file, and how much memory is used.
+ */
+    void
+ex_memstats(eap)
+    exarg_T	*eap UNUSED;
+{
+    buf_T	*buf;
+    memfile_T	*mfp;
+    long	total;
+
+    MSG_PUTS_TITLE(_("\n buf   memory         hits    compressed         hits        reads  writes"));
+    for (buf = firstbuf; buf != NULL && !got_int; buf = buf->b_next)
+    {
+	mfp = buf->b_ml.ml_mfp;
+	if (mfp == NULL)
+	    continue;
+	total = mfp->mf_hits + mfp->mf_zhits + mfp->mf_reads;
+	if (total == 0)
+	    total = 1;
+	msg_putchar('\n');
+	vim_snprintf((char *)IObuff, IOSIZE,
+		"%4d %7ldK %7ld %3ld%% %7ldK %3ld%% %7ld %3ld%% %7ld %3ld%% %7ld",
+		buf->b_fnum,
+		(long)(((long_u)mfp->mf_used_count * mfp->mf_page_size) >> 10),
+		mfp->mf_hits, mfp->mf_hits * 100 / total,
+		(long)(mfp->mf_zsize >> 10),
+		mfp->mf_zorig == 0 ? 0L
+			: (long)(mfp->mf_zsize * 100 / mfp->mf_zorig),
+		mfp->mf_zhits, mfp->mf_zhits * 100 / total,
+		mfp->mf_reads, mfp->mf_reads * 100 / total,
+		mfp->mf_write_count);
+	msg_puts(IObuff);
+	out_flush();	    /* output one line at a time */
+	ui_breakcheck();
+    }
+    msg_putchar('\n');
+    vim_snprintf((char *)IObuff, IOSIZE,
+	    _("Total: %ldK in memory ('maxmemtot' %ldK), %ldK compressed ('maxmemzip' %ldK)"),
+	    (long)(total_mem_used >> 10), p_mmt,
+	    (long)(total_zip_used >> 10), p_mmz);
+    msg_puts(IObuff);
+    msg_putchar('\n');
+    vim_regcache_stats();
+}
+
 /*
  * Allocate a block header and a block of memory for it
  */
@@ -1039,6 +1798,8 @@ mf_read(mfp, hp)
     page_size = mfp->mf_page_size;
     offset = (off_t)page_size * hp->bh_bnum;
     size = page_size * hp->bh_page_count;
+    if (mfp->mf_ra_buf != NULL && size <= mfp->mf_ra_size)
+	return mf_read_ahead(mfp, offset, hp->bh_data, size);
     if (lseek(mfp->mf_fd, offset, SEEK_SET) != offset)
     {
 	PERROR(_("E294: Seek error in swap file read"));
@@ -1052,6 +1813,44 @@ mf_read(mfp, hp)
     return OK;
 }
 
+/*
+ * Read "size" bytes at "offset" from the file of "mfp" into "data", using
+ * the read-ahead buffer.  When the bytes are not in the buffer it is filled
+ * with the bytes starting at "offset".
+ *
+ * Return FAIL for failure, OK otherwise
+ */
+    static int
+mf_read_ahead(mfp, offset, data, size)
+    memfile_T	*mfp;
+    off_t	offset;
+    char_u	*data;
+    unsigned	size;
+{
+    long	len;
+
+    if (offset < mfp->mf_ra_off
+	    || offset + size > mfp->mf_ra_off + (off_t)mfp->mf_ra_len)
+    {
+	mfp->mf_ra_len = 0;
+	if (lseek(mfp->mf_fd, offset, SEEK_SET) != offset)
+	{
+	    PERROR(_("E294: Seek error in swap file read"));
+	    return FAIL;
+	}
+	len = vim_read(mfp->mf_fd, mfp->mf_ra_buf, mfp->mf_ra_size);
+	if (len < (long)size)
+	{
+	    PERROR(_("E295: Read error in swap file"));
+	    return FAIL;
+	}
+	mfp->mf_ra_off = offset;
+	mfp->mf_ra_len = (unsigned)len;
+    }
+    mch_memmove(data, mfp->mf_ra_buf + (offset - mfp->mf_ra_off), size);
+    return OK;
+}
+
 /*
  * write a block to disk
  *
@@ -1077,6 +1876,7 @@ mf_write(mfp, hp)
 	    return FAIL;
 
     page_size = mfp->mf_page_size;
+    mfp->mf_ra_len = 0;		/* read-ahead data may be outdated */
 
     /*
      * We don't want gaps in the file. Write the blocks in front of *hp
@@ -1121,8 +1921,13 @@ mf_write(mfp, hp)
 	    return FAIL;
 	}
 	did_swapwrite_msg = FALSE;
+	++mfp->mf_write_count;
+	mfp->mf_write_bytes += size;
 	if (hp2 != NULL)		    /* written a non-dummy block */
+	{
 	    hp2->bh_flags &= ~BH_DIRTY;
+	    ++mfp->mf_write_blocks;
+	}
 					    /* appended to the file */
 	if (nr + (blocknr_T)page_count > mfp->mf_infile_count)
 	    mfp->mf_infile_count = nr + page_count;
@@ -1144,7 +1949,6 @@ mf_trans_add(mfp, hp)
 {
     bhdr_T	*freep;
     blocknr_T	new_bnum;
-    int		hash;
     NR_TRANS	*np;
     int		page_count;
 
@@ -1192,12 +1996,8 @@ mf_trans_add(mfp, hp)
     hp->bh_bnum = new_bnum;
     mf_ins_hash(mfp, hp);		    /* insert in new hash list */
 
-    hash = MEMHASH(np->nt_old_bnum);	    /* insert in trans list */
-    np->nt_next = mfp->mf_trans[hash];
-    mfp->mf_trans[hash] = np;
-    if (np->nt_next != NULL)
-	np->nt_next->nt_prev = np;
-    np->nt_prev = NULL;
+    /* Insert "np" into the trans hashtable. */
+    mf_hash_add_item(&mfp->mf_trans, (mf_hashitem_T *)np);
 
     return OK;
 }
@@ -1212,25 +2012,20 @@ mf_trans_del(mfp, old_nr)
     memfile_T	*mfp;
     blocknr_T	old_nr;
 {
-    int		hash;
     NR_TRANS	*np;
     blocknr_T	new_bnum;
 
-    hash = MEMHASH(old_nr);
-    for (np = mfp->mf_trans[hash]; np != NULL; np = np->nt_next)
-	if (np->nt_old_bnum == old_nr)
-	    break;
+    np = (NR_TRANS *)mf_hash_find(&mfp->mf_trans, old_nr);
+
     if (np == NULL)		/* not found */
 	return old_nr;
 
     mfp->mf_neg_count--;
     new_bnum = np->nt_new_bnum;
-    if (np->nt_prev != NULL)		/* remove entry from the trans list */
-	np->nt_prev->nt_next = np->nt_next;
-    else
-	mfp->mf_trans[hash] = np->nt_next;
-    if (np->nt_next != NULL)
-	np->nt_next->nt_prev = np->nt_prev;
+
+    /* remove entry from the trans list */
+    mf_hash_rem_item(&mfp->mf_trans, (mf_hashitem_T *)np);
+
     vim_free(np);
 
     return new_bnum;
@@ -1354,3 +2149,206 @@ mf_do_open(mfp, fname, flags)
 	mch_hide(mfp->mf_fname);    /* try setting the 'hidden' flag */
     }
 }
+
+/*
+ * Implementation of mf_hashtab_T follows.
+ */
+
+/*
+ * The number of buckets in the hashtable is increased by a factor of
+ * MHT_GROWTH_FACTOR when the average number of items per bucket
+ * exceeds 2 ^ MHT_LOG_LOAD_FACTOR.
+ */
+#define MHT_LOG_LOAD_FACTOR 6
+#define MHT_GROWTH_FACTOR   2   /* must be a power of two */
+
+/*
+ * Initialize an empty hash table.
+ */
+    static void
+mf_hash_init(mht)
+    mf_hashtab_T *mht;
+{
+    vim_memset(mht, 0, sizeof(mf_hashtab_T));
+    mht->mht_buckets = mht->mht_small_buckets;
+    mht->mht_mask = MHT_INIT_SIZE - 1;
+}
+
+/*
+ * Free the array of a hash table.  Does not free the items it contains!
+ * The hash table must not be used again without another mf_hash_init() call.
+ */
+    static void
+mf_hash_free(mht)
+    mf_hashtab_T *mht;
+{
+    if (mht->mht_buckets != mht->mht_small_buckets)
+	vim_free(mht->mht_buckets);
+}
+
+/*
+ * Free the array of a hash table and all the items it contains.
+ */
+    static void
+mf_hash_free_all(mht)
+    mf_hashtab_T    *mht;
+{
+    long_u	    idx;
+    mf_hashitem_T   *mhi;
+    mf_hashitem_T   *next;
+
+    for (idx = 0; idx <= mht->mht_mask; idx++)
+	for (mhi = mht->mht_buckets[idx]; mhi != NULL; mhi = next)
+	{
+	    next = mhi->mhi_next;
+	    vim_free(mhi);
+	}
+
+    mf_hash_free(mht);
+}
+
+/*
+ * Find "key" in hashtable "mht".
+ * Returns a pointer to a mf_hashitem_T or NULL if the item was not found.
+ */
+    static mf_hashitem_T *
+mf_hash_find(mht, key)
+    mf_hashtab_T    *mht;
+    blocknr_T	    key;
+{
+    mf_hashitem_T   *mhi;
+
+    mhi = mht->mht_buckets[key & mht->mht_mask];
+    while (mhi != NULL && mhi->mhi_key != key)
+	mhi = mhi->mhi_next;
+
+    return mhi;
+}
+
+/*
+ * Add item "mhi" to hashtable "mht".
+ * "mhi" must not be NULL.
+ */
+    static void
+mf_hash_add_item(mht, mhi)
+    mf_hashtab_T    *mht;
+    mf_hashitem_T   *mhi;
+{
+    long_u	    idx;
+
+    idx = mhi->mhi_key & mht->mht_mask;
+    mhi->mhi_next = mht->mht_buckets[idx];
+    mhi->mhi_prev = NULL;
+    if (mhi->mhi_next != NULL)
+	mhi->mhi_next->mhi_prev = mhi;
+    mht->mht_buckets[idx] = mhi;
+
+    mht->mht_count++;
+
+    /*
+     * Grow hashtable when we have more than 2^MHT_LOG_LOAD_FACTOR
+     * items per bucket on average
+     */
+    if (mht->mht_fixed == 0
+	&& (mht->mht_count >> MHT_LOG_LOAD_FACTOR) > mht->mht_mask)
+    {
+	if (mf_hash_grow(mht) == FAIL)
+	{
+	    /* stop trying to grow after first failure to allocate memory */
+	    mht->mht_fixed = 1;
+	}
+    }
+}
+
+/*
+ * Remove item "mhi" from hashtable "mht".
+ * "mhi" must not be NULL and must have been inserted into "mht".
+ */
+    static void
+mf_hash_rem_item(mht, mhi)
+    mf_hashtab_T    *mht;
+    mf_hashitem_T   *mhi;
+{
+    if (mhi->mhi_prev == NULL)
+	mht->mht_buckets[mhi->mhi_key & mht->mht_mask] = mhi->mhi_next;
+    else
+	mhi->mhi_prev->mhi_next = mhi->mhi_next;
+
+    if (mhi->mhi_next != NULL)
+	mhi->mhi_next->mhi_prev = mhi->mhi_prev;
+
+    mht->mht_count--;
+
+    /* We could shrink the table here, but it typically takes little memory,
+     * so why bother?  */
+}
+
+/*
+ * Increase number of buckets in the hashtable by MHT_GROWTH_FACTOR and
+ * rehash items.
+ * Returns FAIL when out of memory.
+ */
+    static int
+mf_hash_grow(mht)
+    mf_hashtab_T    *mht;
+{
+    long_u	    i, j;
+    int		    shift;
+    mf_hashitem_T   *mhi;
+    mf_hashitem_T   *tails[MHT_GROWTH_FACTOR];
+    mf_hashitem_T   **buckets;
+    size_t	    size;
+
+    size = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR * sizeof(void *);
+    buckets = (mf_hashitem_T **)lalloc_clear(size, FALSE);
+    if (buckets == NULL)
+	return FAIL;
+
+    shift = 0;
+    while ((mht->mht_mask >> shift) != 0)
+	shift++;
+
+    for (i = 0; i <= mht->mht_mask; i++)
+    {
+	/*
+	 * Traverse the items in the i-th original bucket and move them into
+	 * MHT_GROWTH_FACTOR new buckets, preserving their relative order
+	 * within each new bucket.  Preserving the order keeps the most
+	 * recently inserted items at the front of each bucket.
+	 *
+	 * Here we strongly rely on the fact the hashes are computed modulo
+	 * a power of two.
+	 */
+
+	vim_memset(tails, 0, sizeof(tails));
+
+	for (mhi = mht->mht_buckets[i]; mhi != NULL; mhi = mhi->mhi_next)
+	{
+	    j = (mhi->mhi_key >> shift) & (MHT_GROWTH_FACTOR - 1);
+	    if (tails[j] == NULL)
+	    {
+		buckets[i + (j << shift)] = mhi;
+		tails[j] = mhi;
+		mhi->mhi_prev = NULL;
+	    }
+	    else
+	    {
+		tails[j]->mhi_next = mhi;
+		mhi->mhi_prev = tails[j];
+		tails[j] = mhi;
+	    }
+	}
+
+	for (j = 0; j < MHT_GROWTH_FACTOR; j++)
+	    if (tails[j] != NULL)
+		tails[j]->mhi_next = NULL;
+    }
+
+    if (mht->mht_buckets != mht->mht_small_buckets)
+	vim_free(mht->mht_buckets);
+
+    mht->mht_buckets = buckets;
+    mht->mht_mask = (mht->mht_mask + 1) * MHT_GROWTH_FACTOR - 1;
+
+    return OK;
+}
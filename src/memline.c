@@ -60,6 +60,10 @@
 # include <errno.h>
 #endif
 
+#ifdef FEAT_MMAP
+# include <sys/mman.h>
+#endif
+
 typedef struct block0		ZERO_BL;    /* contents of the first block */
 typedef struct pointer_block	PTR_BL;	    /* contents of a pointer block */
 typedef struct data_block	DATA_BL;    /* contents of a data block */
@@ -199,6 +203,44 @@ struct block0
 
 #define STACK_INCR	5	/* nr of entries added to ml_stack at a time */
 
+/* When recovering the swap file is read in chunks of this size. */
+#define RECOVER_READAHEAD  0x40000
+
+#ifdef FEAT_MMAP
+/*
+ * A file that is mapped into memory instead of being read into the memfile.
+ * The offset of every MLMAP_STEP'th line is kept in mm_index[], other lines
+ * are found by searching for the NL from there.  The line text is copied into
+ * mm_line[] when it is requested.
+ */
+# define MLMAP_STEP	256
+/* ml_map_load() appends lines in batches of about this many bytes. */
+# define MLMAP_LOAD_SIZE 0x10000
+
+struct mlmap_S
+{
+    char_u	*mm_data;	/* start of the mapped file */
+    size_t	mm_len;		/* length of the mapping */
+    off_t	mm_size;	/* size of the mapped file, less when it was
+				   truncated */
+    off_t	*mm_index;	/* offsets of lines 1, MLMAP_STEP + 1, etc. */
+    linenr_T	mm_last_lnum;	/* line last looked up, zero if none */
+    off_t	mm_last_off;	/* offset of line mm_last_lnum */
+    char_u	*mm_line;	/* copy of the line last returned */
+    colnr_T	mm_line_size;	/* allocated size of mm_line[] */
+    int		mm_noeol;	/* last line has no end-of-line */
+    int		mm_fd;		/* file descriptor of the file, for fstat() */
+    time_t	mm_mtime;	/* modification time when mapped */
+    dev_t	mm_dev;		/* device of the file */
+    ino_t	mm_ino;		/* inode number of the file */
+    int		mm_maptick;	/* maptick at the last check */
+    time_t	mm_checktime;	/* time of the last check */
+    int		mm_checkcount;	/* lines to get before the next check */
+    int		mm_changed;	/* another program changed the file, or
+				   reading it gave a SIGBUS */
+};
+#endif
+
 /*
  * The line number where the first mark may be is remembered.
  * If it is 0 there are no marks at all.
@@ -222,10 +264,27 @@ static void set_b0_dir_flag __ARGS((ZERO_BL *b0p, buf_T *buf));
 #ifdef FEAT_MBYTE
 static void add_b0_fenc __ARGS((ZERO_BL *b0p, buf_T *buf));
 #endif
+static int ml_read_b0 __ARGS((char_u *fname, struct stat *st, ZERO_BL *b0p));
+/* The caches for swap files use a hashtab, which is not always available. */
+#if defined(FEAT_EVAL) || defined(FEAT_SYN_HL)
+# define B0CACHE
+#endif
+#if defined(UNIX) && !defined(ARCHIE) && !defined(SHORT_FNAME) \
+	&& defined(B0CACHE)
+# define SWAPDIR_CACHE
+# if defined(EXITFREE)
+static void swapdir_clear __ARGS((void));
+# endif
+static int swapdir_longnames __ARGS((char_u *fname));
+static void swapdir_set_longnames __ARGS((char_u *fname));
+#endif
 static time_t swapfile_info __ARGS((char_u *));
 static int recov_file_names __ARGS((char_u **, char_u *, int prepend_dot));
 static int ml_append_int __ARGS((buf_T *, linenr_T, char_u *, colnr_T, int, int));
+static int ml_append_many __ARGS((buf_T *buf, linenr_T lnum, char_u *text, char_u **array, linenr_T count, int newfile));
+static linenr_T ml_append_fill __ARGS((buf_T *buf, linenr_T lnum, char_u **textp, char_u **array, linenr_T count, int newfile));
 static int ml_delete_int __ARGS((buf_T *, linenr_T, int));
+static long ml_delete_block __ARGS((buf_T *buf, linenr_T lnum, long count));
 static char_u *findswapname __ARGS((buf_T *, char_u **, char_u *));
 static void ml_flush_line __ARGS((buf_T *));
 static bhdr_T *ml_new_data __ARGS((memfile_T *, int, int));
@@ -244,6 +303,25 @@ static char_u *make_percent_swname __ARGS((char_u *dir, char_u *name));
 #endif
 #ifdef FEAT_BYTEOFF
 static void ml_updatechunk __ARGS((buf_T *buf, long line, long len, int updtype));
+static int ml_growchunks __ARGS((buf_T *buf));
+static void ml_chunk_add __ARGS((buf_T *buf, int curix, int lines, long size));
+static int ml_chunktree_build __ARGS((buf_T *buf));
+static int ml_chunktree_find __ARGS((buf_T *buf, linenr_T lnum, long offset, int ffdos, linenr_T *curlinep, long *sizep));
+static int ml_splitchunk __ARGS((buf_T *buf, int curix, linenr_T curline));
+static void ml_updatechunk_lines __ARGS((buf_T *buf, linenr_T line, linenr_T count, long len));
+#endif
+#ifdef FEAT_MMAP
+static linenr_T ml_map_scan __ARGS((char_u *data, size_t size, int flags, char_u *magic, garray_T *gap, int *noeolp));
+static int ml_map_scan_step __ARGS((char_u *data, size_t size, int flags, char_u *magic, char_u **pp, int *noeolp));
+static off_t ml_map_find __ARGS((mlmap_T *mm, linenr_T lnum));
+# ifdef FEAT_BYTEOFF
+static long ml_map_offset __ARGS((buf_T *buf, linenr_T lnum));
+static linenr_T ml_map_find_line __ARGS((buf_T *buf, long offset, long *startp));
+# endif
+static char_u *ml_map_get __ARGS((buf_T *buf, linenr_T lnum));
+static int ml_map_check __ARGS((buf_T *buf));
+static void ml_map_changed __ARGS((mlmap_T *mm, int buserr));
+static void ml_map_free __ARGS((buf_T *buf));
 #endif
 
 /*
@@ -271,6 +349,12 @@ ml_open(buf)
     buf->b_ml.ml_line_lnum = 0;	/* no cached line */
 #ifdef FEAT_BYTEOFF
     buf->b_ml.ml_chunksize = NULL;
+    buf->b_ml.ml_chunktree = NULL;
+    buf->b_ml.ml_treesize = 0;
+    buf->b_ml.ml_treeused = 0;
+#endif
+#ifdef FEAT_MMAP
+    buf->b_ml.ml_map = NULL;
 #endif
 
     /*
@@ -291,6 +375,7 @@ ml_open(buf)
     buf->b_ml.ml_mfp = mfp;
     buf->b_ml.ml_flags = ML_EMPTY;
     buf->b_ml.ml_line_count = 1;
+    ml_set_memlimit(buf);
 #ifdef FEAT_LINEBREAK
     curwin->w_nrwidth_line_count = 0;
 #endif
@@ -414,7 +499,7 @@ ml_setname(buf)
 #endif
 
     mfp = buf->b_ml.ml_mfp;
-    if (mfp->mf_fd < 0)		    /* there is no swap file yet */
+    if (mfp->mf_fd < 0 || mfp->mf_spill)    /* there is no swap file yet */
     {
 	/*
 	 * When 'updatecount' is 0 and 'noswapfile' there is no swap file.
@@ -531,6 +616,8 @@ ml_open_file(buf)
     char_u	*dirp;
 
     mfp = buf->b_ml.ml_mfp;
+    if (mfp != NULL && mfp->mf_spill && buf->b_p_swf)
+	mf_close_file(buf, TRUE);	/* replace temp file with swap file */
     if (mfp == NULL || mfp->mf_fd >= 0 || !buf->b_p_swf)
 	return;		/* nothing to do */
 
@@ -600,15 +687,36 @@ ml_open_file(buf)
     buf->b_may_swap = FALSE;
 }
 
+/*
+ * Set the limit for the memory used by buffer "buf" from 'memlimit'.  It only
+ * applies when there is no swap file.  Removes the temp file used for the
+ * limit when it no longer applies.
+ */
+    void
+ml_set_memlimit(buf)
+    buf_T	*buf;
+{
+    memfile_T	*mfp = buf->b_ml.ml_mfp;
+
+    if (mfp == NULL)
+	return;
+    if (mfp->mf_spill && (buf->b_p_mml == 0 || buf->b_p_swf))
+	mf_close_file(buf, TRUE);
+    mf_set_spill(mfp, buf->b_p_swf ? 0L : buf->b_p_mml);
+}
+
 /*
  * If still need to create a swap file, and starting to edit a not-readonly
  * file, or reading into an existing buffer, create a swap file now.
+ * With 'deferswap' set the swap file for a new file is created when the
+ * buffer is changed, see changed().
  */
     void
 check_need_swap(newfile)
     int	    newfile;		/* reading file into new buffer */
 {
-    if (curbuf->b_may_swap && (!curbuf->b_p_ro || !newfile))
+    if (curbuf->b_may_swap && (!curbuf->b_p_ro || !newfile)
+						       && !(newfile && p_dsw))
 	ml_open_file(curbuf);
 }
 
@@ -630,6 +738,13 @@ ml_close(buf, del_file)
 #ifdef FEAT_BYTEOFF
     vim_free(buf->b_ml.ml_chunksize);
     buf->b_ml.ml_chunksize = NULL;
+    vim_free(buf->b_ml.ml_chunktree);
+    buf->b_ml.ml_chunktree = NULL;
+    buf->b_ml.ml_treesize = 0;
+    buf->b_ml.ml_treeused = 0;
+#endif
+#ifdef FEAT_MMAP
+    ml_map_free(buf);
 #endif
     buf->b_ml.ml_mfp = NULL;
 
@@ -964,6 +1079,10 @@ ml_recover()
     vim_free(p);
     buf->b_ml.ml_mfp = mfp;
 
+    /* The blocks are mostly read in the order they are in the file, read
+     * large chunks instead of one block at a time. */
+    mf_set_readahead(mfp, RECOVER_READAHEAD);
+
     /*
      * The page size set in mf_open() might be different from the page size
      * used in the swap file, we must get it from block 0.  But to read block
@@ -1665,6 +1784,173 @@ make_percent_swname(dir, name)
 static int process_still_running;
 #endif
 
+#ifdef B0CACHE
+/*
+ * Block 0 of swap files that were read before, so that listing the swap
+ * files again, e.g., when recovering or for the ATTENTION message, doesn't
+ * need to open and read them again.  Found by the full name of the swap file,
+ * only used when the size, timestamp and inode number didn't change.
+ */
+typedef struct b0cache_S
+{
+    off_t	bc_size;	/* size of the swap file */
+    time_t	bc_mtime;	/* its modification time */
+#ifdef UNIX
+    ino_t	bc_ino;		/* its inode number */
+    dev_t	bc_dev;		/* device of bc_ino */
+#endif
+    int		bc_ok;		/* FALSE when block 0 couldn't be read */
+    ZERO_BL	bc_b0;		/* contents of block 0 */
+    char_u	bc_name[1];	/* full name of the swap file, actually longer */
+} b0cache_T;
+
+static hashtab_T b0cache_ht;
+static int	b0cache_ht_init = FALSE;
+
+/* Most swap files that are remembered.  When exceeded all are forgotten. */
+#define B0CACHE_MAX	1000
+
+static b0cache_T dumbc;
+#define HIKEY2BC(p)  ((b0cache_T *)(p - (dumbc.bc_name - (char_u *)&dumbc)))
+#define HI2BC(hi)     HIKEY2BC((hi)->hi_key)
+
+static void ml_b0cache_clear __ARGS((void));
+#endif
+
+/*
+ * Read block 0 of swap file "fname" into "b0p".  "st" is the result of
+ * mch_stat() for "fname".
+ * Returns OK when block 0 was read, NOTDONE when it could not be read and
+ * FAIL when the file could not be opened.
+ */
+    static int
+ml_read_b0(fname, st, b0p)
+    char_u	*fname;
+    struct stat	*st;
+    ZERO_BL	*b0p;
+{
+#ifdef B0CACHE
+    char_u	*ffname;
+    hashitem_T	*hi;
+    hash_T	hash;
+    b0cache_T	*bc;
+#endif
+    int		fd;
+    int		ok;
+
+#ifdef B0CACHE
+    if (!b0cache_ht_init)
+    {
+	hash_init(&b0cache_ht);
+	b0cache_ht_init = TRUE;
+    }
+
+    ffname = FullName_save(fname, TRUE);
+    if (ffname != NULL)
+    {
+	hash = hash_hash(ffname);
+	hi = hash_lookup(&b0cache_ht, ffname, hash);
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    bc = HI2BC(hi);
+	    if (bc->bc_size == st->st_size && bc->bc_mtime == st->st_mtime
+#ifdef UNIX
+		    && bc->bc_ino == st->st_ino && bc->bc_dev == st->st_dev
+#endif
+		    )
+	    {
+		vim_free(ffname);
+		if (!bc->bc_ok)
+		    return NOTDONE;
+		mch_memmove(b0p, &bc->bc_b0, sizeof(ZERO_BL));
+		return OK;
+	    }
+	    /* The file changed, forget about it. */
+	    hash_remove(&b0cache_ht, hi);
+	    vim_free(bc);
+	}
+    }
+#endif
+
+    fd = mch_open((char *)fname, O_RDONLY | O_EXTRA, 0);
+    if (fd < 0)
+    {
+#ifdef B0CACHE
+	vim_free(ffname);
+#endif
+	return FAIL;
+    }
+    ok = (read(fd, (char *)b0p, sizeof(ZERO_BL)) == sizeof(ZERO_BL));
+    close(fd);
+
+#ifdef B0CACHE
+    /* Only remember a file that wasn't changed in the last two seconds, a
+     * change within the same second would not be noticed. */
+    if (ffname != NULL && st->st_mtime < time(NULL) - 1)
+    {
+	if (b0cache_ht.ht_used >= B0CACHE_MAX)
+	    ml_b0cache_clear();
+	bc = (b0cache_T *)alloc((unsigned)(sizeof(b0cache_T) + STRLEN(ffname)));
+	if (bc != NULL)
+	{
+	    STRCPY(bc->bc_name, ffname);
+	    bc->bc_size = st->st_size;
+	    bc->bc_mtime = st->st_mtime;
+#ifdef UNIX
+	    bc->bc_ino = st->st_ino;
+	    bc->bc_dev = st->st_dev;
+#endif
+	    bc->bc_ok = ok;
+	    if (ok)
+		mch_memmove(&bc->bc_b0, b0p, sizeof(ZERO_BL));
+	    hi = hash_lookup(&b0cache_ht, bc->bc_name, hash);
+	    if (hash_add_item(&b0cache_ht, hi, bc->bc_name, hash) == FAIL)
+		vim_free(bc);
+	}
+    }
+    vim_free(ffname);
+#endif
+    return ok ? OK : NOTDONE;
+}
+
+#ifdef B0CACHE
+
+/*
+ * Forget about all remembered block 0 contents.
+ */
+    static void
+ml_b0cache_clear()
+{
+    hashitem_T	*hi;
+    int		todo;
+
+    if (!b0cache_ht_init)
+	return;
+    todo = (int)b0cache_ht.ht_used;
+    for (hi = b0cache_ht.ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    --todo;
+	    vim_free(HI2BC(hi));
+	}
+    hash_clear(&b0cache_ht);
+    hash_init(&b0cache_ht);
+}
+#endif
+
+#if defined(EXITFREE) || defined(PROTO)
+    void
+free_swap_caches()
+{
+# ifdef B0CACHE
+    ml_b0cache_clear();
+# endif
+# ifdef SWAPDIR_CACHE
+    swapdir_clear();
+# endif
+}
+#endif
+
 /*
  * Give information about an existing swap file.
  * Returns timestamp (0 when unknown).
@@ -1674,10 +1960,10 @@ swapfile_info(fname)
     char_u	*fname;
 {
     struct stat	    st;
-    int		    fd;
     struct block0   b0;
     time_t	    x = (time_t)0;
     char	    *p;
+    int		    r = FAIL;
 #ifdef UNIX
     char_u	    uname[B0_UNAME_SIZE];
 #endif
@@ -1685,6 +1971,8 @@ swapfile_info(fname)
     /* print the swap file date */
     if (mch_stat((char *)fname, &st) != -1)
     {
+	r = ml_read_b0(fname, &st, &b0);
+
 #ifdef UNIX
 	/* print name of owner of the file */
 	if (mch_get_uname(st.st_uid, uname, B0_UNAME_SIZE) == OK)
@@ -1707,10 +1995,9 @@ swapfile_info(fname)
     /*
      * print the original file name
      */
-    fd = mch_open((char *)fname, O_RDONLY | O_EXTRA, 0);
-    if (fd >= 0)
+    if (r != FAIL)
     {
-	if (read(fd, (char *)&b0, sizeof(b0)) == sizeof(b0))
+	if (r == OK)
 	{
 	    if (STRNCMP(b0.b0_version, "VIM 3.0", 7) == 0)
 	    {
@@ -1775,7 +2062,6 @@ swapfile_info(fname)
 	}
 	else
 	    MSG_PUTS(_("         [cannot be read]"));
-	close(fd);
     }
     else
 	MSG_PUTS(_("         [cannot be opened]"));
@@ -1912,8 +2198,9 @@ ml_sync_all(check_file, check_char)
 
     for (buf = firstbuf; buf != NULL; buf = buf->b_next)
     {
-	if (buf->b_ml.ml_mfp == NULL || buf->b_ml.ml_mfp->mf_fname == NULL)
-	    continue;			    /* no file */
+	if (buf->b_ml.ml_mfp == NULL || buf->b_ml.ml_mfp->mf_fname == NULL
+		|| buf->b_ml.ml_mfp->mf_spill)
+	    continue;			    /* no swap file */
 
 	ml_flush_line(buf);		    /* flush buffered line */
 					    /* flush locked block */
@@ -1965,7 +2252,7 @@ ml_preserve(buf, message)
     int		status;
     int		got_int_save = got_int;
 
-    if (mfp == NULL || mfp->mf_fname == NULL)
+    if (mfp == NULL || mfp->mf_fname == NULL || mfp->mf_spill)
     {
 	if (message)
 	    EMSG(_("E313: Cannot preserve, there is no swap file"));
@@ -2113,6 +2400,26 @@ errorret:
     if (buf->b_ml.ml_mfp == NULL)	/* there are no lines */
 	return (char_u *)"";
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_map != NULL)
+    {
+	/* A line of a mapped file can be read but not changed. */
+	if (!will_change)
+	{
+	    (void)ml_map_check(buf);
+	    if ((ptr = ml_map_get(buf, lnum)) != NULL)
+		return ptr;
+	    /* Another program truncated the file, the line is gone.  Keep the
+	     * number of lines, the caller may be looping over them.
+	     * ml_map_check_all() loads what is left later. */
+	    return (char_u *)"";
+	}
+	(void)ml_map_load(buf);
+	if (lnum > buf->b_ml.ml_line_count)
+	    goto errorret;
+    }
+#endif
+
 /*
  * See if it is the same line as requested last time.
  * Otherwise may need to flush last used line.
@@ -2214,6 +2521,193 @@ ml_append_buf(buf, lnum, line, len, newfile)
 }
 #endif
 
+/*
+ * Append "count" lines after "lnum" in the current buffer.  "text" contains
+ * the lines one after another, each terminated with a NUL.  This is a lot
+ * faster than calling ml_append() for every line, because as many lines as
+ * possible are put in a data block at once.  Used when reading a file.
+ * Check: The caller of this function should probably also call
+ * appended_lines().
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_append_lines(lnum, text, count, newfile)
+    linenr_T	lnum;		/* append after this line (can be 0) */
+    char_u	*text;		/* text of the new lines */
+    linenr_T	count;		/* number of lines in "text" */
+    int		newfile;	/* flag, see ml_append() */
+{
+    return ml_append_many(curbuf, lnum, text, NULL, count, newfile);
+}
+
+/*
+ * Like ml_append_lines(), but the text of the lines is in "array[count]".
+ */
+    int
+ml_append_array(lnum, array, count, newfile)
+    linenr_T	lnum;		/* append after this line (can be 0) */
+    char_u	**array;	/* text of the new lines */
+    linenr_T	count;		/* number of lines in "array" */
+    int		newfile;	/* flag, see ml_append() */
+{
+    return ml_append_many(curbuf, lnum, NULL, array, count, newfile);
+}
+
+/*
+ * Append "count" lines from "text" or "array" after "lnum" in buffer "buf".
+ */
+    static int
+ml_append_many(buf, lnum, text, array, count, newfile)
+    buf_T	*buf;
+    linenr_T	lnum;
+    char_u	*text;
+    char_u	**array;
+    linenr_T	count;
+    int		newfile;
+{
+    linenr_T	done;
+    char_u	*line;
+    colnr_T	len;
+
+    /* When starting up, we might still need to create the memfile */
+    if (buf->b_ml.ml_mfp == NULL
+		       && (buf != curbuf || open_buffer(FALSE, NULL) == FAIL))
+	return FAIL;
+
+    if (buf->b_ml.ml_line_lnum != 0)
+	ml_flush_line(buf);
+
+    while (count > 0)
+    {
+	/* The first line may need a new data block, let ml_append_int() take
+	 * care of that.  Following lines go into the same block. */
+	line = array != NULL ? *array++ : text;
+	len = (colnr_T)STRLEN(line) + 1;
+	if (ml_append_int(buf, lnum, line, len, newfile, FALSE) == FAIL)
+	    return FAIL;
+	if (array == NULL)
+	    text += len;
+	++lnum;
+	--count;
+
+	done = ml_append_fill(buf, lnum, &text, array, count, newfile);
+	if (array != NULL)
+	    array += done;
+	lnum += done;
+	count -= done;
+    }
+    return OK;
+}
+
+/*
+ * Put as many as possible of the "count" lines from "array", or from
+ * "*textp" when "array" is NULL, after line "lnum" in the data block that is
+ * locked, if it contains line "lnum".  Advances "*textp" to after the lines
+ * that were added.
+ * Returns the number of lines added.
+ */
+    static linenr_T
+ml_append_fill(buf, lnum, textp, array, count, newfile)
+    buf_T	*buf;
+    linenr_T	lnum;
+    char_u	**textp;
+    char_u	**array;
+    linenr_T	count;
+    int		newfile;
+{
+    bhdr_T	*hp = buf->b_ml.ml_locked;
+    DATA_BL	*dp;
+    char_u	*text = *textp;
+    char_u	*p;
+    int		db_idx;
+    int		line_count;
+    int		offset;
+    int		total = 0;
+    int		len;
+    int		i;
+    linenr_T	n;
+
+    if (hp == NULL || count == 0 || lnum < buf->b_ml.ml_locked_low
+					   || lnum > buf->b_ml.ml_locked_high)
+	return 0;
+    dp = (DATA_BL *)(hp->bh_data);
+    db_idx = lnum - buf->b_ml.ml_locked_low;
+    line_count = buf->b_ml.ml_locked_high - buf->b_ml.ml_locked_low + 1;
+
+    /* Find out how many lines fit in the free space. */
+    for (n = 0, p = text; n < count; ++n, p += len)
+    {
+	if (array != NULL)
+	    p = array[n];
+	len = (int)STRLEN(p) + 1;
+	if (total + len + (long)(n + 1) * INDEX_SIZE > dp->db_free)
+	    break;
+	total += len;
+    }
+    if (n == 0)
+	return 0;
+
+    /*
+     * Move the text of the lines that follow to the front and adjust their
+     * indexes, then copy the new lines in the gap.  The first new line goes
+     * just before the text of line "lnum".
+     */
+    offset = ((dp->db_index[db_idx]) & DB_INDEX_MASK);
+    if (line_count > db_idx + 1)
+    {
+	mch_memmove((char *)dp + dp->db_txt_start - total,
+					       (char *)dp + dp->db_txt_start,
+					 (size_t)(offset - dp->db_txt_start));
+	for (i = line_count - 1; i > db_idx; --i)
+	    dp->db_index[i + n] = dp->db_index[i] - total;
+    }
+    dp->db_txt_start -= total;
+    dp->db_free -= total + n * INDEX_SIZE;
+    dp->db_line_count += n;
+    for (i = 0, p = text; i < n; ++i, p += len)
+    {
+	if (array != NULL)
+	    p = array[i];
+	len = (int)STRLEN(p) + 1;
+	offset -= len;
+	mch_memmove((char *)dp + offset, p, (size_t)len);
+	dp->db_index[db_idx + i + 1] = offset;
+    }
+    if (array == NULL)
+	*textp = p;
+
+    buf->b_ml.ml_line_count += n;
+    buf->b_ml.ml_locked_high += n;
+    buf->b_ml.ml_locked_lineadd += n;
+    buf->b_ml.ml_flags |= ML_LOCKED_DIRTY;
+    if (!newfile)
+	buf->b_ml.ml_flags |= ML_LOCKED_POS;
+
+    if (lowest_marked && lowest_marked > lnum)
+	lowest_marked += n;
+
+#ifdef FEAT_BYTEOFF
+    /* All new lines are in the block now, update the chunks in one go. */
+    ml_updatechunk_lines(buf, lnum + 1, n, (long)total);
+#endif
+#ifdef FEAT_NETBEANS_INTG
+    if (usingNetbeans)
+	for (i = 0, p = text; i < n; ++i, p += len)
+	{
+	    if (array != NULL)
+		p = array[i];
+	    len = (int)STRLEN(p) + 1;
+	    if (len > 1)
+		netbeans_inserted(buf, lnum + i + 1, (colnr_T)0, p, len - 1);
+	    netbeans_inserted(buf, lnum + i + 1, (colnr_T)(len - 1),
+							   (char_u *)"\n", 1);
+	}
+#endif
+
+    return n;
+}
+
     static int
 ml_append_int(buf, lnum, line, len, newfile, mark)
     buf_T	*buf;
@@ -2241,6 +2735,12 @@ ml_append_int(buf, lnum, line, len, newfile, mark)
     if (lnum > buf->b_ml.ml_line_count || buf->b_ml.ml_mfp == NULL)
 	return FAIL;
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_map != NULL && (ml_map_load(buf) == FAIL
+					|| lnum > buf->b_ml.ml_line_count))
+	return FAIL;
+#endif
+
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked = lnum + 1;
 
@@ -2738,6 +3238,15 @@ ml_replace(lnum, line, copy)
 
     if (copy && (line = vim_strsave(line)) == NULL) /* allocate memory */
 	return FAIL;
+#ifdef FEAT_MMAP
+    /* Only after making the copy, "line" may be the text of a mapped line. */
+    if (curbuf->b_ml.ml_map != NULL && ml_map_load(curbuf) == FAIL)
+    {
+	if (copy)
+	    vim_free(line);
+	return FAIL;
+    }
+#endif
 #ifdef FEAT_NETBEANS_INTG
     if (usingNetbeans)
     {
@@ -2773,6 +3282,135 @@ ml_delete(lnum, message)
     return ml_delete_int(curbuf, lnum, message);
 }
 
+/*
+ * Delete "count" lines starting at "lnum" in the current buffer.  This is a
+ * lot faster than calling ml_delete() for every line, because the lines in
+ * one data block are removed at once.
+ *
+ * Check: The caller of this function should probably also call
+ * deleted_lines() after this.
+ *
+ * return FAIL for failure, OK otherwise
+ */
+    int
+ml_delete_lines(lnum, count, message)
+    linenr_T	lnum;
+    long	count;
+    int		message;
+{
+    ml_flush_line(curbuf);
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_map != NULL && ml_map_load(curbuf) == FAIL)
+	return FAIL;
+#endif
+    if (lnum < 1 || lnum > curbuf->b_ml.ml_line_count)
+	return FAIL;
+    if (count > curbuf->b_ml.ml_line_count - lnum + 1)
+	count = curbuf->b_ml.ml_line_count - lnum + 1;
+
+    while (count > 0)
+    {
+	count -= ml_delete_block(curbuf, lnum, count);
+	if (count > 0)
+	{
+	    /* Deleting the last line of a data block or finding the next
+	     * block is done by ml_delete_int(). */
+	    if (ml_delete_int(curbuf, lnum, message) == FAIL)
+		return FAIL;
+	    --count;
+	}
+    }
+    return OK;
+}
+
+/*
+ * Delete up to "count" lines starting at "lnum" from the data block that is
+ * locked, if it contains line "lnum".  At least one line is left in the
+ * block.
+ * Returns the number of lines deleted.
+ */
+    static long
+ml_delete_block(buf, lnum, count)
+    buf_T	*buf;
+    linenr_T	lnum;
+    long	count;
+{
+    bhdr_T	*hp = buf->b_ml.ml_locked;
+    DATA_BL	*dp;
+    int		line_count;
+    int		idx;
+    int		n;
+    int		i;
+    int		text_end;
+    int		line_start;
+    int		text_start;
+    long	size;
+
+    if (hp == NULL || lnum < buf->b_ml.ml_locked_low
+					   || lnum > buf->b_ml.ml_locked_high)
+	return 0;
+    dp = (DATA_BL *)(hp->bh_data);
+    line_count = buf->b_ml.ml_locked_high - buf->b_ml.ml_locked_low + 1;
+    idx = lnum - buf->b_ml.ml_locked_low;
+
+    n = buf->b_ml.ml_locked_high - lnum + 1;
+    if (n > count)
+	n = count;
+    if (n >= line_count)
+	n = line_count - 1;
+    if (n <= 0)
+	return 0;
+
+    /* The text of the lines goes from the start of the last one to the end
+     * of the first one. */
+    if (idx == 0)
+	text_end = dp->db_txt_end;
+    else
+	text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
+    line_start = ((dp->db_index[idx + n - 1]) & DB_INDEX_MASK);
+    size = text_end - line_start;
+
+#if defined(FEAT_BYTEOFF) || defined(FEAT_NETBEANS_INTG)
+    for (i = 0; i < n; ++i)
+    {
+	long	line_size = text_end - ((dp->db_index[idx + i]) & DB_INDEX_MASK);
+
+	text_end -= line_size;
+# ifdef FEAT_BYTEOFF
+	ml_updatechunk(buf, lnum, line_size, ML_CHNK_DELLINE);
+# endif
+# ifdef FEAT_NETBEANS_INTG
+	if (usingNetbeans)
+	    netbeans_removed(buf, lnum, 0, line_size);
+# endif
+    }
+#endif
+
+    /*
+     * Delete the text by moving the next lines forwards, delete the indexes
+     * by moving the next indexes backwards.
+     */
+    text_start = dp->db_txt_start;
+    mch_memmove((char *)dp + text_start + size, (char *)dp + text_start,
+					       (size_t)(line_start - text_start));
+    for (i = idx; i < line_count - n; ++i)
+	dp->db_index[i] = dp->db_index[i + n] + size;
+
+    dp->db_free += size + n * INDEX_SIZE;
+    dp->db_txt_start += size;
+    dp->db_line_count -= n;
+
+    buf->b_ml.ml_line_count -= n;
+    buf->b_ml.ml_locked_high -= n;
+    buf->b_ml.ml_locked_lineadd -= n;
+    buf->b_ml.ml_flags |= (ML_LOCKED_DIRTY | ML_LOCKED_POS);
+
+    if (lowest_marked && lowest_marked > lnum)
+	lowest_marked = lowest_marked - n > lnum ? lowest_marked - n : lnum;
+
+    return n;
+}
+
     static int
 ml_delete_int(buf, lnum, message)
     buf_T	*buf;
@@ -2795,6 +3433,12 @@ ml_delete_int(buf, lnum, message)
     if (lnum < 1 || lnum > buf->b_ml.ml_line_count)
 	return FAIL;
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_map != NULL && (ml_map_load(buf) == FAIL
+					|| lnum > buf->b_ml.ml_line_count))
+	return FAIL;
+#endif
+
     if (lowest_marked && lowest_marked > lnum)
 	lowest_marked--;
 
@@ -2946,6 +3590,12 @@ ml_setmarked(lnum)
 					       || curbuf->b_ml.ml_mfp == NULL)
 	return;			    /* give error message? */
 
+#ifdef FEAT_MMAP
+    /* The number of lines stays the same, also when loading fails. */
+    if (curbuf->b_ml.ml_map != NULL)
+	(void)ml_map_load(curbuf);
+#endif
+
     if (lowest_marked == 0 || lowest_marked > lnum)
 	lowest_marked = lnum;
 
@@ -2975,6 +3625,10 @@ ml_firstmarked()
 
     if (curbuf->b_ml.ml_mfp == NULL)
 	return (linenr_T) 0;
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_map != NULL)	/* marking lines loads the file */
+	return (linenr_T) 0;
+#endif
 
     /*
      * The search starts with lowest_marked line. This is the last line where
@@ -3039,8 +3693,15 @@ ml_clearmarked()
 
     if (curbuf->b_ml.ml_mfp == NULL)	    /* nothing to do */
 	return;
-
-    /*
+#ifdef FEAT_MMAP
+    if (curbuf->b_ml.ml_map != NULL)	    /* no lines can be marked */
+    {
+	lowest_marked = 0;
+	return;
+    }
+#endif
+
+    /*
      * The search starts with line lowest_marked.
      */
     for (lnum = lowest_marked; lnum <= curbuf->b_ml.ml_line_count; )
@@ -3802,6 +4463,139 @@ do_swapexists(buf, fname)
 }
 #endif
 
+#ifdef SWAPDIR_CACHE
+/*
+ * For every directory a swap file was looked for in, the result of the check
+ * for a file system that only supports 8.3 file names.  That check creates,
+ * stats and removes two files, which is only done once per directory then.
+ */
+typedef struct swapdir_S
+{
+    int		sd_longnames;	/* found the directory is not on a file
+				   system with 8.3 names */
+    char_u	sd_dir[1];	/* full directory name, actually longer */
+} swapdir_T;
+
+static hashtab_T swapdir_ht;
+static int	swapdir_ht_init = FALSE;
+
+static swapdir_T dumsd;
+#define HIKEY2SD(p)  ((swapdir_T *)(p - (dumsd.sd_dir - (char_u *)&dumsd)))
+#define HI2SD(hi)     HIKEY2SD((hi)->hi_key)
+
+static swapdir_T *swapdir_find __ARGS((char_u *fname, int create));
+
+/*
+ * Find the entry for the directory of swap file "fname".  When "create" is
+ * TRUE add one if it doesn't exist yet.
+ * Returns NULL when not found or out of memory.
+ */
+    static swapdir_T *
+swapdir_find(fname, create)
+    char_u	*fname;
+    int		create;
+{
+    char_u	dir[MAXPATHL];
+    char_u	*tail;
+    hashitem_T	*hi;
+    hash_T	hash;
+    swapdir_T	*sd = NULL;
+    int		len;
+
+    tail = gettail(fname);
+    len = 0;
+    if (!mch_isFullName(fname))
+    {
+	if (mch_dirname(dir, MAXPATHL) == FAIL)
+	    return NULL;
+	len = (int)STRLEN(dir);
+	if (len > 0 && !after_pathsep(dir, dir + len))
+	    dir[len++] = '/';
+    }
+    if (len + (tail - fname) >= MAXPATHL)
+	return NULL;
+    vim_strncpy(dir + len, fname, tail - fname);
+
+    if (!swapdir_ht_init)
+    {
+	hash_init(&swapdir_ht);
+	swapdir_ht_init = TRUE;
+    }
+    hash = hash_hash(dir);
+    hi = hash_lookup(&swapdir_ht, dir, hash);
+    if (!HASHITEM_EMPTY(hi))
+	sd = HI2SD(hi);
+    else if (create)
+    {
+	sd = (swapdir_T *)alloc((unsigned)(sizeof(swapdir_T) + STRLEN(dir)));
+	if (sd != NULL)
+	{
+	    STRCPY(sd->sd_dir, dir);
+	    sd->sd_longnames = FALSE;
+	    if (hash_add_item(&swapdir_ht, hi, sd->sd_dir, hash) == FAIL)
+	    {
+		vim_free(sd);
+		sd = NULL;
+	    }
+	}
+    }
+    return sd;
+}
+
+# if defined(EXITFREE)
+/*
+ * Forget about all directories.
+ */
+    static void
+swapdir_clear()
+{
+    hashitem_T	*hi;
+    int		todo;
+
+    if (!swapdir_ht_init)
+	return;
+    todo = (int)swapdir_ht.ht_used;
+    for (hi = swapdir_ht.ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    --todo;
+	    vim_free(HI2SD(hi));
+	}
+    hash_clear(&swapdir_ht);
+    hash_init(&swapdir_ht);
+}
+# endif
+
+/*
+ * Return TRUE when the directory of swap file "fname" was found not to be on
+ * a file system with 8.3 file names.
+ */
+    static int
+swapdir_longnames(fname)
+    char_u	*fname;
+{
+    swapdir_T	*sd;
+
+    sd = swapdir_find(fname, FALSE);
+    return sd != NULL && sd->sd_longnames;
+}
+
+/*
+ * Remember that the directory of swap file "fname" is not on a file system
+ * with 8.3 file names.
+ */
+    static void
+swapdir_set_longnames(fname)
+    char_u	*fname;
+{
+    swapdir_T	*sd;
+
+    sd = swapdir_find(fname, TRUE);
+    if (sd != NULL)
+	sd->sd_longnames = TRUE;
+}
+#endif
+
 /*
  * Find out what name to use for the swap file for buffer 'buf'.
  *
@@ -3878,7 +4672,11 @@ findswapname(buf, dirp, old_fname)
  * 8.3, detect if this is the case, set shortname and try again.
  */
 	if (fname[n - 2] == 'w' && fname[n - 1] == 'p'
-					&& !(buf->b_p_sn || buf->b_shortname))
+					&& !(buf->b_p_sn || buf->b_shortname)
+# ifdef SWAPDIR_CACHE
+					&& !swapdir_longnames(fname)
+# endif
+					)
 	{
 	    char_u	    *tail;
 	    char_u	    *fname2;
@@ -3948,6 +4746,10 @@ findswapname(buf, dirp, old_fname)
 				    && s1.st_dev == s2.st_dev
 				    && s1.st_ino == s2.st_ino)
 				same = TRUE;
+# ifdef SWAPDIR_CACHE
+			    else
+				swapdir_set_longnames(fname);
+# endif
 			    close(f2);
 			    if (created2)
 				mch_remove(fname2);
@@ -4047,7 +4849,8 @@ findswapname(buf, dirp, old_fname)
 	    if (!recoverymode && buf->b_fname != NULL
 				&& !buf->b_help && !(buf->b_flags & BF_DUMMY))
 	    {
-		int		fd;
+		int		r = FAIL;
+		struct stat	st;
 		struct block0	b0;
 		int		differ = FALSE;
 
@@ -4055,10 +4858,11 @@ findswapname(buf, dirp, old_fname)
 		 * Try to read block 0 from the swap file to get the original
 		 * file name (and inode number).
 		 */
-		fd = mch_open((char *)fname, O_RDONLY | O_EXTRA, 0);
-		if (fd >= 0)
+		if (mch_stat((char *)fname, &st) != -1)
+		    r = ml_read_b0(fname, &st, &b0);
+		if (r != FAIL)
 		{
-		    if (read(fd, (char *)&b0, sizeof(b0)) == sizeof(b0))
+		    if (r == OK)
 		    {
 			/*
 			 * If the swapfile has the same directory as the
@@ -4099,7 +4903,6 @@ findswapname(buf, dirp, old_fname)
 #endif
 			}
 		    }
-		    close(fd);
 		}
 #ifdef RISCOS
 		else
@@ -4465,6 +5268,270 @@ ml_setflags(buf)
 #define MLCS_MAXL 800	/* max no of lines in chunk */
 #define MLCS_MINL 400   /* should be half of MLCS_MAXL */
 
+/* Remember where the last added line went, for ml_updatechunk(). */
+static buf_T	*ml_upd_lastbuf = NULL;
+static linenr_T	ml_upd_lastline;
+static linenr_T	ml_upd_lastcurline;
+static int	ml_upd_lastcurix;
+
+/*
+ * Make sure there is room for one more chunk in "buf".
+ * Returns FAIL and stops keeping offsets for "buf" when out of memory.
+ */
+    static int
+ml_growchunks(buf)
+    buf_T	*buf;
+{
+    if (buf->b_ml.ml_usedchunks + 1 >= buf->b_ml.ml_numchunks)
+    {
+	buf->b_ml.ml_numchunks = buf->b_ml.ml_numchunks * 3 / 2;
+	buf->b_ml.ml_chunksize = (chunksize_T *)
+	    vim_realloc(buf->b_ml.ml_chunksize,
+			sizeof(chunksize_T) * buf->b_ml.ml_numchunks);
+	if (buf->b_ml.ml_chunksize == NULL)
+	{
+	    /* Hmmmm, Give up on offset for this buffer */
+	    buf->b_ml.ml_usedchunks = -1;
+	    return FAIL;
+	}
+    }
+    return OK;
+}
+
+/*
+ * Add "lines" and "size" to chunk "curix" of "buf".  Also updates the tree,
+ * unless it needs to be rebuilt anyway.
+ */
+    static void
+ml_chunk_add(buf, curix, lines, size)
+    buf_T	*buf;
+    int		curix;
+    int		lines;
+    long	size;
+{
+    int		i;
+
+    buf->b_ml.ml_chunksize[curix].mlcs_numlines += lines;
+    buf->b_ml.ml_chunksize[curix].mlcs_totalsize += size;
+    if (buf->b_ml.ml_treeused == buf->b_ml.ml_usedchunks)
+	for (i = curix + 1; i <= buf->b_ml.ml_treeused; i += i & -i)
+	{
+	    buf->b_ml.ml_chunktree[i].mlcs_numlines += lines;
+	    buf->b_ml.ml_chunktree[i].mlcs_totalsize += size;
+	}
+}
+
+/*
+ * Build the Fenwick tree for the chunks of "buf": entry "i" holds the sums
+ * of the chunks from "i - (i & -i)" to "i - 1".  Entry zero is not used.
+ * This is done when the tree is needed after chunks were split or joined.
+ * Returns FAIL and stops keeping offsets for "buf" when out of memory.
+ */
+    static int
+ml_chunktree_build(buf)
+    buf_T	*buf;
+{
+    chunksize_T	*tree;
+    int		n = buf->b_ml.ml_usedchunks;
+    int		i, j;
+
+    if (buf->b_ml.ml_treesize <= n)
+    {
+	vim_free(buf->b_ml.ml_chunktree);
+	buf->b_ml.ml_chunktree = (chunksize_T *)alloc((unsigned)
+			     sizeof(chunksize_T) * (buf->b_ml.ml_numchunks + 1));
+	if (buf->b_ml.ml_chunktree == NULL)
+	{
+	    buf->b_ml.ml_treesize = 0;
+	    buf->b_ml.ml_usedchunks = -1;
+	    return FAIL;
+	}
+	buf->b_ml.ml_treesize = buf->b_ml.ml_numchunks + 1;
+    }
+    tree = buf->b_ml.ml_chunktree;
+    mch_memmove(tree + 1, buf->b_ml.ml_chunksize, n * sizeof(chunksize_T));
+    for (i = 1; i <= n; ++i)
+    {
+	j = i + (i & -i);
+	if (j <= n)
+	{
+	    tree[j].mlcs_numlines += tree[i].mlcs_numlines;
+	    tree[j].mlcs_totalsize += tree[i].mlcs_totalsize;
+	}
+    }
+    buf->b_ml.ml_treeused = n;
+    return OK;
+}
+
+/*
+ * Find the chunk that contains line "lnum" (when not zero) or byte "offset"
+ * (when not zero), with "ffdos" set when a CR is counted for each line.
+ * The last chunk is used when the line or offset is beyond it.
+ * Sets "*curlinep" to the first line of the chunk and "*sizep" to the number
+ * of bytes before it.  Returns the chunk index, -1 when out of memory.
+ */
+    static int
+ml_chunktree_find(buf, lnum, offset, ffdos, curlinep, sizep)
+    buf_T	*buf;
+    linenr_T	lnum;
+    long	offset;
+    int		ffdos;
+    linenr_T	*curlinep;
+    long	*sizep;
+{
+    chunksize_T	*tp;
+    linenr_T	curline = 1;
+    long	size = 0;
+    long	len;
+    int		pos = 0;
+    int		step;
+    int		n;
+
+    if (buf->b_ml.ml_treeused != buf->b_ml.ml_usedchunks
+					    && ml_chunktree_build(buf) == FAIL)
+	return -1;
+
+    /* Binary search for the number of chunks before the one we want.  The
+     * last chunk is never skipped. */
+    n = buf->b_ml.ml_usedchunks - 1;
+    for (step = 1; step * 2 <= n; step *= 2)
+	;
+    for ( ; step > 0; step /= 2)
+    {
+	if (pos + step > n)
+	    continue;
+	tp = buf->b_ml.ml_chunktree + pos + step;
+	len = tp->mlcs_totalsize;
+	if (offset != 0 && ffdos)
+	    len += tp->mlcs_numlines;
+	if ((lnum != 0 && lnum >= curline + tp->mlcs_numlines)
+		|| (offset != 0 && offset > size + len))
+	{
+	    pos += step;
+	    curline += tp->mlcs_numlines;
+	    size += len;
+	}
+    }
+    *curlinep = curline;
+    *sizep = size;
+    return pos;
+}
+
+/*
+ * Split chunk "curix", which starts at line "curline", in two: the first
+ * MLCS_MINL lines and the rest.  The line counts of the chunk must match the
+ * text in the buffer.  There must be room for one more chunk.
+ * Returns FAIL and stops keeping offsets for "buf" when a block can't be
+ * found.
+ */
+    static int
+ml_splitchunk(buf, curix, curline)
+    buf_T	*buf;
+    int		curix;
+    linenr_T	curline;
+{
+    int		count;	    /* number of entries in block */
+    int		idx;
+    int		text_end;
+    int		linecnt;
+    int		rest;
+    long	size;
+    bhdr_T	*hp;
+    DATA_BL	*dp;
+
+    mch_memmove(buf->b_ml.ml_chunksize + curix + 1,
+		buf->b_ml.ml_chunksize + curix,
+		(buf->b_ml.ml_usedchunks - curix) *
+		sizeof(chunksize_T));
+    /* Compute length of first half of lines in the split chunk */
+    size = 0;
+    linecnt = 0;
+    while (curline < buf->b_ml.ml_line_count
+		&& linecnt < MLCS_MINL)
+    {
+	if ((hp = ml_find_line(buf, curline, ML_FIND)) == NULL)
+	{
+	    buf->b_ml.ml_usedchunks = -1;
+	    return FAIL;
+	}
+	dp = (DATA_BL *)(hp->bh_data);
+	count = (long)(buf->b_ml.ml_locked_high) -
+		(long)(buf->b_ml.ml_locked_low) + 1;
+	idx = curline - buf->b_ml.ml_locked_low;
+	curline = buf->b_ml.ml_locked_high + 1;
+	if (idx == 0)/* first line in block, text at the end */
+	    text_end = dp->db_txt_end;
+	else
+	    text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
+	/* Compute index of last line to use in this MEMLINE */
+	rest = count - idx;
+	if (linecnt + rest > MLCS_MINL)
+	{
+	    idx += MLCS_MINL - linecnt - 1;
+	    linecnt = MLCS_MINL;
+	}
+	else
+	{
+	    idx = count - 1;
+	    linecnt += rest;
+	}
+	size += text_end - ((dp->db_index[idx]) & DB_INDEX_MASK);
+    }
+    buf->b_ml.ml_chunksize[curix].mlcs_numlines = linecnt;
+    buf->b_ml.ml_chunksize[curix + 1].mlcs_numlines -= linecnt;
+    buf->b_ml.ml_chunksize[curix].mlcs_totalsize = size;
+    buf->b_ml.ml_chunksize[curix + 1].mlcs_totalsize -= size;
+    buf->b_ml.ml_usedchunks++;
+    buf->b_ml.ml_treeused = 0;
+    ml_upd_lastbuf = NULL;   /* Force recalc of curix & curline */
+    return OK;
+}
+
+/*
+ * Like ml_updatechunk() with ML_CHNK_ADDLINE for "count" lines starting at
+ * "line", with "len" bytes together.  All the lines must already be in the
+ * buffer, so that splitting the chunk finds the right text.
+ */
+    static void
+ml_updatechunk_lines(buf, line, count, len)
+    buf_T	*buf;
+    linenr_T	line;
+    linenr_T	count;
+    long	len;
+{
+    linenr_T	curline;
+    int		curix;
+    long	size;
+
+    if (count == 1 || buf->b_ml.ml_usedchunks == -1)
+    {
+	if (count == 1)
+	    ml_updatechunk(buf, line, len, ML_CHNK_ADDLINE);
+	return;
+    }
+    if (buf->b_ml.ml_chunksize == NULL)
+    {
+	/* Can't happen: the first line was added with ml_updatechunk(). */
+	buf->b_ml.ml_usedchunks = -1;
+	return;
+    }
+
+    curix = ml_chunktree_find(buf, line, 0L, FALSE, &curline, &size);
+    if (curix < 0)
+	return;
+    ml_chunk_add(buf, curix, (int)count, len);
+    ml_upd_lastbuf = NULL;
+
+    while (buf->b_ml.ml_chunksize[curix].mlcs_numlines >= MLCS_MAXL)
+    {
+	if (ml_growchunks(buf) == FAIL || ml_splitchunk(buf, curix, curline)
+								      == FAIL)
+	    return;
+	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
+	++curix;
+    }
+}
+
 /*
  * Keep information for finding byte offset of a line, updtytpe may be one of:
  * ML_CHNK_ADDLINE: Add len to parent chunk, possibly splitting it
@@ -4479,11 +5546,6 @@ ml_updatechunk(buf, line, len, updtype)
     long	len;
     int		updtype;
 {
-    static buf_T	*ml_upd_lastbuf = NULL;
-    static linenr_T	ml_upd_lastline;
-    static linenr_T	ml_upd_lastcurline;
-    static int		ml_upd_lastcurix;
-
     linenr_T		curline = ml_upd_lastcurline;
     int			curix = ml_upd_lastcurix;
     long		size;
@@ -4505,6 +5567,7 @@ ml_updatechunk(buf, line, len, updtype)
 	}
 	buf->b_ml.ml_numchunks = 100;
 	buf->b_ml.ml_usedchunks = 1;
+	buf->b_ml.ml_treeused = 0;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize = 1;
     }
@@ -4515,6 +5578,7 @@ ml_updatechunk(buf, line, len, updtype)
 	 * First line in empty buffer from ml_flush_line() -- reset
 	 */
 	buf->b_ml.ml_usedchunks = 1;
+	buf->b_ml.ml_treeused = 0;
 	buf->b_ml.ml_chunksize[0].mlcs_numlines = 1;
 	buf->b_ml.ml_chunksize[0].mlcs_totalsize =
 				  (long)STRLEN(buf->b_ml.ml_line_ptr) + 1;
@@ -4528,13 +5592,9 @@ ml_updatechunk(buf, line, len, updtype)
     if (buf != ml_upd_lastbuf || line != ml_upd_lastline + 1
 	    || updtype != ML_CHNK_ADDLINE)
     {
-	for (curline = 1, curix = 0;
-	     curix < buf->b_ml.ml_usedchunks - 1
-	     && line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	     curix++)
-	{
-	    curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	}
+	curix = ml_chunktree_find(buf, line, 0L, FALSE, &curline, &size);
+	if (curix < 0)
+	    return;
     }
     else if (line >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines
 		 && curix < buf->b_ml.ml_usedchunks - 1)
@@ -4543,81 +5603,20 @@ ml_updatechunk(buf, line, len, updtype)
 	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
 	curix++;
     }
-    curchnk = buf->b_ml.ml_chunksize + curix;
-
     if (updtype == ML_CHNK_DELLINE)
 	len = -len;
-    curchnk->mlcs_totalsize += len;
+    ml_chunk_add(buf, curix, updtype == ML_CHNK_ADDLINE ? 1
+				 : updtype == ML_CHNK_DELLINE ? -1 : 0, len);
+    curchnk = buf->b_ml.ml_chunksize + curix;
     if (updtype == ML_CHNK_ADDLINE)
     {
-	curchnk->mlcs_numlines++;
-
 	/* May resize here so we don't have to do it in both cases below */
-	if (buf->b_ml.ml_usedchunks + 1 >= buf->b_ml.ml_numchunks)
-	{
-	    buf->b_ml.ml_numchunks = buf->b_ml.ml_numchunks * 3 / 2;
-	    buf->b_ml.ml_chunksize = (chunksize_T *)
-		vim_realloc(buf->b_ml.ml_chunksize,
-			    sizeof(chunksize_T) * buf->b_ml.ml_numchunks);
-	    if (buf->b_ml.ml_chunksize == NULL)
-	    {
-		/* Hmmmm, Give up on offset for this buffer */
-		buf->b_ml.ml_usedchunks = -1;
-		return;
-	    }
-	}
+	if (ml_growchunks(buf) == FAIL)
+	    return;
 
 	if (buf->b_ml.ml_chunksize[curix].mlcs_numlines >= MLCS_MAXL)
 	{
-	    int	    count;	    /* number of entries in block */
-	    int	    idx;
-	    int	    text_end;
-	    int	    linecnt;
-
-	    mch_memmove(buf->b_ml.ml_chunksize + curix + 1,
-			buf->b_ml.ml_chunksize + curix,
-			(buf->b_ml.ml_usedchunks - curix) *
-			sizeof(chunksize_T));
-	    /* Compute length of first half of lines in the split chunk */
-	    size = 0;
-	    linecnt = 0;
-	    while (curline < buf->b_ml.ml_line_count
-			&& linecnt < MLCS_MINL)
-	    {
-		if ((hp = ml_find_line(buf, curline, ML_FIND)) == NULL)
-		{
-		    buf->b_ml.ml_usedchunks = -1;
-		    return;
-		}
-		dp = (DATA_BL *)(hp->bh_data);
-		count = (long)(buf->b_ml.ml_locked_high) -
-			(long)(buf->b_ml.ml_locked_low) + 1;
-		idx = curline - buf->b_ml.ml_locked_low;
-		curline = buf->b_ml.ml_locked_high + 1;
-		if (idx == 0)/* first line in block, text at the end */
-		    text_end = dp->db_txt_end;
-		else
-		    text_end = ((dp->db_index[idx - 1]) & DB_INDEX_MASK);
-		/* Compute index of last line to use in this MEMLINE */
-		rest = count - idx;
-		if (linecnt + rest > MLCS_MINL)
-		{
-		    idx += MLCS_MINL - linecnt - 1;
-		    linecnt = MLCS_MINL;
-		}
-		else
-		{
-		    idx = count - 1;
-		    linecnt += rest;
-		}
-		size += text_end - ((dp->db_index[idx]) & DB_INDEX_MASK);
-	    }
-	    buf->b_ml.ml_chunksize[curix].mlcs_numlines = linecnt;
-	    buf->b_ml.ml_chunksize[curix + 1].mlcs_numlines -= linecnt;
-	    buf->b_ml.ml_chunksize[curix].mlcs_totalsize = size;
-	    buf->b_ml.ml_chunksize[curix + 1].mlcs_totalsize -= size;
-	    buf->b_ml.ml_usedchunks++;
-	    ml_upd_lastbuf = NULL;   /* Force recalc of curix & curline */
+	    ml_splitchunk(buf, curix, curline);
 	    return;
 	}
 	else if (buf->b_ml.ml_chunksize[curix].mlcs_numlines >= MLCS_MINL
@@ -4630,6 +5629,7 @@ ml_updatechunk(buf, line, len, updtype)
 	     */
 	    curchnk = buf->b_ml.ml_chunksize + curix + 1;
 	    buf->b_ml.ml_usedchunks++;
+	    buf->b_ml.ml_treeused = 0;
 	    if (line == buf->b_ml.ml_line_count)
 	    {
 		curchnk->mlcs_numlines = 0;
@@ -4663,7 +5663,6 @@ ml_updatechunk(buf, line, len, updtype)
     }
     else if (updtype == ML_CHNK_DELLINE)
     {
-	curchnk->mlcs_numlines--;
 	ml_upd_lastbuf = NULL;   /* Force recalc of curix & curline */
 	if (curix < (buf->b_ml.ml_usedchunks - 1)
 		&& (curchnk->mlcs_numlines + curchnk[1].mlcs_numlines)
@@ -4675,6 +5674,7 @@ ml_updatechunk(buf, line, len, updtype)
 	else if (curix == 0 && curchnk->mlcs_numlines <= 0)
 	{
 	    buf->b_ml.ml_usedchunks--;
+	    buf->b_ml.ml_treeused = 0;
 	    mch_memmove(buf->b_ml.ml_chunksize, buf->b_ml.ml_chunksize + 1,
 			buf->b_ml.ml_usedchunks * sizeof(chunksize_T));
 	    return;
@@ -4690,6 +5690,7 @@ ml_updatechunk(buf, line, len, updtype)
 	curchnk[-1].mlcs_numlines += curchnk->mlcs_numlines;
 	curchnk[-1].mlcs_totalsize += curchnk->mlcs_totalsize;
 	buf->b_ml.ml_usedchunks--;
+	buf->b_ml.ml_treeused = 0;
 	if (curix < buf->b_ml.ml_usedchunks)
 	{
 	    mch_memmove(buf->b_ml.ml_chunksize + curix,
@@ -4718,7 +5719,6 @@ ml_find_line_or_offset(buf, lnum, offp)
     long	*offp;
 {
     linenr_T	curline;
-    int		curix;
     long	size;
     bhdr_T	*hp;
     DATA_BL	*dp;
@@ -4734,6 +5734,48 @@ ml_find_line_or_offset(buf, lnum, offp)
     /* take care of cached line first */
     ml_flush_line(curbuf);
 
+#ifdef FEAT_MMAP
+    if (buf->b_ml.ml_map != NULL && lnum >= 0)
+    {
+	(void)ml_map_check(buf);
+	/* The offsets in a mapped file are known, as long as no CR needs to
+	 * be inserted when looking for an offset. */
+	if (lnum == 0 && ffdos)
+	{
+	    if (ml_map_load(buf) == FAIL)
+		return -1;
+	}
+	else if (lnum == 0)
+	{
+	    offset = offp == NULL ? 0 : *offp;
+	    if (offset <= 0)
+		return 1;
+	    curline = ml_map_find_line(buf, offset, &size);
+	    if (curline == 0)
+		return -1;
+	    *offp = offset - size;
+	    return curline;
+	}
+	else
+	{
+	    if (lnum > buf->b_ml.ml_line_count + 1)
+		return -1;
+	    if (lnum > buf->b_ml.ml_line_count)
+		size = (long)buf->b_ml.ml_map->mm_size
+						  + buf->b_ml.ml_map->mm_noeol;
+	    else
+		size = ml_map_offset(buf, lnum);
+	    if (size < 0)
+		return -1;
+	    if (ffdos)
+		size += lnum - 1;
+	    if (buf->b_p_bin && !buf->b_p_eol)
+		size -= ffdos + 1;
+	    return size;
+	}
+    }
+#endif
+
     if (buf->b_ml.ml_usedchunks == -1
 	    || buf->b_ml.ml_chunksize == NULL
 	    || lnum < 0)
@@ -4746,24 +5788,11 @@ ml_find_line_or_offset(buf, lnum, offp)
     if (lnum == 0 && offset <= 0)
 	return 1;   /* Not a "find offset" and offset 0 _must_ be in line 1 */
     /*
-     * Find the last chunk before the one containing our line. Last chunk is
-     * special because it will never qualify
+     * Find the chunk containing our line or offset. Last chunk is special
+     * because it is used when nothing else qualifies.
      */
-    curline = 1;
-    curix = size = 0;
-    while (curix < buf->b_ml.ml_usedchunks - 1
-	    && ((lnum != 0
-	     && lnum >= curline + buf->b_ml.ml_chunksize[curix].mlcs_numlines)
-		|| (offset != 0
-	       && offset > size + buf->b_ml.ml_chunksize[curix].mlcs_totalsize
-		      + ffdos * buf->b_ml.ml_chunksize[curix].mlcs_numlines)))
-    {
-	curline += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	size += buf->b_ml.ml_chunksize[curix].mlcs_totalsize;
-	if (offset && ffdos)
-	    size += buf->b_ml.ml_chunksize[curix].mlcs_numlines;
-	curix++;
-    }
+    if (ml_chunktree_find(buf, lnum, offset, ffdos, &curline, &size) < 0)
+	return -1;
 
     while ((lnum != 0 && curline < lnum) || (offset != 0 && size < offset))
     {
@@ -4875,3 +5904,675 @@ goto_byte(cnt)
 # endif
 }
 #endif
+
+#if defined(FEAT_MMAP) || defined(PROTO)
+/*
+ * Map the file opened as "fd" into memory instead of reading it into the
+ * memfile of "buf", which must be empty.  Only done when the file is at least
+ * 'mmapsize' Kbyte.  The lines can then be obtained with ml_get_buf() without
+ * reading the whole file first.  As soon as a line is changed the whole file
+ * is loaded into the memfile, see ml_map_load().
+ * "flags" is a combination of MLMAP_ values.  "magic" is a string the file
+ * must not start with (an encrypted file) or NULL.
+ * The text must be usable as-is: no 'fileformat' other than "unix", no BOM,
+ * no conversion.  The caller must check most of that, except that with
+ * MLMAP_DETECT the 'fileformat' is detected like readfile() does it.
+ * Returns OK when the file was mapped, the size of the file is stored in
+ * "*sizep" and "*noeolp" is set when the last line has no end-of-line.
+ * Returns FAIL otherwise, the caller must read the file.
+ */
+    int
+ml_map_file(buf, fd, flags, magic, sizep, noeolp)
+    buf_T	*buf;
+    int		fd;
+    int		flags;
+    char_u	*magic;
+    long	*sizep;
+    int		*noeolp;
+{
+    struct stat	st;
+    mlmap_T	*mm;
+    garray_T	ga;
+    char_u	*data;
+    size_t	size;
+    linenr_T	lnum;
+    int		noeol = FALSE;
+
+    if (p_mms <= 0 || buf->b_ml.ml_mfp == NULL || buf->b_ml.ml_map != NULL
+	    || !(buf->b_ml.ml_flags & ML_EMPTY)
+	    || buf->b_ml.ml_line_count != 1)
+	return FAIL;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)
+	    || (st.st_size >> 10) < p_mms
+	    || (off_t)(size_t)st.st_size != st.st_size
+	    || (off_t)(long)st.st_size != st.st_size)
+	return FAIL;
+    size = (size_t)st.st_size;
+
+    data = (char_u *)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, (off_t)0);
+    if (data == (char_u *)MAP_FAILED)
+	return FAIL;
+
+#ifdef MADV_SEQUENTIAL
+    (void)madvise((void *)data, size, MADV_SEQUENTIAL);
+#endif
+
+    ga_init2(&ga, (int)sizeof(off_t), 1000);
+    lnum = ml_map_scan(data, size, flags, magic, &ga, &noeol);
+    if (lnum == 0)
+	goto fail;
+
+#ifdef MADV_NORMAL
+    (void)madvise((void *)data, size, MADV_NORMAL);
+#endif
+
+    mm = (mlmap_T *)alloc_clear((unsigned)sizeof(mlmap_T));
+    if (mm == NULL)
+	goto fail;
+    /* Keep the file open to find out when another program changes it. */
+    mm->mm_fd = dup(fd);
+    if (mm->mm_fd < 0)
+    {
+	vim_free(mm);
+	goto fail;
+    }
+# ifdef FD_CLOEXEC
+    (void)fcntl(mm->mm_fd, F_SETFD, FD_CLOEXEC);
+# endif
+    mm->mm_data = data;
+    mm->mm_len = size;
+    mm->mm_size = st.st_size;
+    mm->mm_index = (off_t *)ga.ga_data;
+    mm->mm_noeol = noeol;
+    mm->mm_mtime = st.st_mtime;
+    mm->mm_dev = st.st_dev;
+    mm->mm_ino = st.st_ino;
+    mm->mm_maptick = maptick;
+    mm->mm_checktime = time(NULL);
+    mm->mm_checkcount = MLMAP_STEP;
+
+    buf->b_ml.ml_map = mm;
+    buf->b_ml.ml_line_count = lnum;
+    buf->b_ml.ml_flags &= ~ML_EMPTY;
+    *sizep = (long)st.st_size;
+    *noeolp = noeol;
+    return OK;
+
+fail:
+    ga_clear(&ga);
+    munmap((void *)data, size);
+    return FAIL;
+}
+
+/*
+ * Check the text of the "size" bytes of mapped file "data" for ml_map_file()
+ * and find the start of every MLMAP_STEP'th line, their offsets are appended
+ * to "gap".  Sets "*noeolp" when the last line has no end-of-line.
+ * Returns the number of lines, zero when the file can't be mapped: it starts
+ * with "magic" or a BOM, has the wrong 'fileformat', a line is too long or
+ * invalid UTF-8, CTRL-C was typed or reading it gave a SIGBUS.
+ */
+    static linenr_T
+ml_map_scan(data, size, flags, magic, gap, noeolp)
+    char_u	*data;
+    size_t	size;
+    int		flags;
+    char_u	*magic;
+    garray_T	*gap;
+    int		*noeolp;
+{
+    char_u	*p = data;
+    linenr_T	lnum = 0;
+    int		n;
+
+    while (p < data + size)
+    {
+	/* Not while reading the file, a SIGBUS would jump out of it. */
+	if (ga_grow(gap, 1) == FAIL)
+	    return 0;
+	((off_t *)gap->ga_data)[gap->ga_len++] = (off_t)(p - data);
+	ui_breakcheck();
+	if (got_int)
+	    return 0;
+
+	n = ml_map_scan_step(data, size, flags, magic, &p, noeolp);
+	if (n < 0)
+	    return 0;
+	lnum += n;
+    }
+    return lnum;
+}
+
+/*
+ * Check up to MLMAP_STEP lines of mapped file "data" for ml_map_scan(),
+ * starting at "*pp".  At the start of the file also check for "magic", a BOM
+ * and the 'fileformat'.  "*pp" is advanced to the next line.
+ * Returns the number of lines, -1 when the file can't be mapped.
+ */
+    static int
+ml_map_scan_step(data, size, flags, magic, pp, noeolp)
+    char_u	*data;
+    size_t	size;
+    int		flags;
+    char_u	*magic;
+    char_u	**pp;
+    int		*noeolp;
+{
+    char_u	*end = data + size;
+    char_u	*p;
+    char_u	*e;
+#ifdef FEAT_MBYTE
+    char_u	*q;
+    int		l;
+#endif
+    size_t	len;
+    int		n;
+
+    /* Another program may truncate the file while it is being read. */
+    mch_startjmp_map();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	return -1;
+    }
+
+    if (*pp == data)
+    {
+	if (magic != NULL && size >= STRLEN(magic)
+				  && STRNCMP(data, magic, STRLEN(magic)) == 0)
+	    goto fail;
+	/* readfile() would remove a BOM */
+	if ((flags & MLMAP_UTF8) && size >= 3
+			 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf)
+	    goto fail;
+
+	if (flags & MLMAP_DETECT)
+	{
+	    /* Like readfile(): look at the first 64 Kbyte, a CR before the
+	     * first NL means "dos", a CR without a NL may mean "mac".  Only
+	     * "unix" is accepted, give up when in doubt. */
+	    len = size < 0x10000L ? size : 0x10000L;
+	    p = (char_u *)memchr(data, NL, len);
+	    if (p == NULL
+		    || ((flags & MLMAP_TRY_DOS) && p > data && p[-1] == CAR)
+		    || ((flags & MLMAP_TRY_MAC)
+					  && memchr(data, CAR, len) != NULL))
+		goto fail;
+	}
+    }
+
+    for (n = 0, p = *pp; n < MLMAP_STEP && p < end; ++n, p = e + 1)
+    {
+	e = (char_u *)memchr(p, NL, (size_t)(end - p));
+	if (e == NULL)
+	{
+	    e = end;
+	    *noeolp = TRUE;
+	}
+	if (e - p >= MAXCOL)
+	    goto fail;
+#ifdef FEAT_MBYTE
+	if (flags & MLMAP_UTF8)
+	{
+	    /* Illegal bytes are handled by readfile(). */
+	    for (q = p; q < e; )
+	    {
+		if (*q < 0x80)
+		    ++q;
+		else
+		{
+		    l = utf_ptr2len_len(q, (int)(e - q));
+		    if (l == 1 || l > e - q)
+			goto fail;
+		    q += l;
+		}
+	    }
+	}
+#endif
+    }
+    mch_endjmp();
+    *pp = p;
+    return n;
+
+fail:
+    mch_endjmp();
+    return -1;
+}
+
+/*
+ * Return the offset of line "lnum" in mapped file "mm".  Returns mm_size when
+ * the line is not in the file, it was truncated.
+ */
+    static off_t
+ml_map_find(mm, lnum)
+    mlmap_T	*mm;
+    linenr_T	lnum;
+{
+    linenr_T	l;
+    off_t	off;
+    char_u	*p;
+
+    /* Continue from the line last found when it's not too far back. */
+    l = (lnum - 1) / MLMAP_STEP * MLMAP_STEP + 1;
+    if (mm->mm_last_lnum >= l && mm->mm_last_lnum <= lnum)
+    {
+	l = mm->mm_last_lnum;
+	off = mm->mm_last_off;
+    }
+    else
+	off = mm->mm_index[(lnum - 1) / MLMAP_STEP];
+
+    for ( ; l < lnum; ++l)
+    {
+	if (off >= mm->mm_size)
+	    return mm->mm_size;
+	p = (char_u *)memchr(mm->mm_data + off, NL,
+						   (size_t)(mm->mm_size - off));
+	if (p == NULL)
+	    return mm->mm_size;
+	off = (off_t)(p - mm->mm_data) + 1;
+    }
+    mm->mm_last_lnum = l;
+    mm->mm_last_off = off;
+    return off;
+}
+
+# ifdef FEAT_BYTEOFF
+/*
+ * Return the offset of line "lnum" in the mapped file of "buf", like
+ * ml_map_find().  Returns -1 when reading the file gave a SIGBUS.
+ */
+    static long
+ml_map_offset(buf, lnum)
+    buf_T	*buf;
+    linenr_T	lnum;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+    long	off;
+
+    mch_startjmp_map();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	ml_map_changed(mm, TRUE);
+	return -1;
+    }
+    off = (long)ml_map_find(mm, lnum);
+    mch_endjmp();
+    return off;
+}
+
+/*
+ * Find the line in the mapped file of "buf" that contains byte "offset".
+ * Return the line number and store the offset of its first byte in "*startp".
+ * Return zero when "offset" is beyond the end of the file or reading the file
+ * gave a SIGBUS.
+ */
+    static linenr_T
+ml_map_find_line(buf, offset, startp)
+    buf_T	*buf;
+    long	offset;
+    long	*startp;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+    long	lo, hi, mid;
+    linenr_T	lnum;
+    off_t	off;
+    char_u	*p;
+
+    /* The last line always ends in a NL, possibly one that isn't there. */
+    if (offset < 0 || (off_t)offset >= mm->mm_size + mm->mm_noeol)
+	return 0;
+
+    mch_startjmp_map();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	ml_map_changed(mm, TRUE);
+	return 0;
+    }
+
+    /* Binary search for the last index entry at or before "offset". */
+    lo = 0;
+    hi = (buf->b_ml.ml_line_count - 1) / MLMAP_STEP;
+    while (lo < hi)
+    {
+	mid = (lo + hi + 1) / 2;
+	if (mm->mm_index[mid] <= (off_t)offset)
+	    lo = mid;
+	else
+	    hi = mid - 1;
+    }
+    lnum = lo * MLMAP_STEP + 1;
+    off = mm->mm_index[lo];
+
+    for (;;)
+    {
+	p = (char_u *)memchr(mm->mm_data + off, NL,
+						   (size_t)(mm->mm_size - off));
+	if (p == NULL || (off_t)offset <= (off_t)(p - mm->mm_data))
+	    break;
+	off = (off_t)(p - mm->mm_data) + 1;
+	++lnum;
+    }
+    mch_endjmp();
+    mm->mm_last_lnum = lnum;
+    mm->mm_last_off = off;
+    *startp = (long)off;
+    return lnum;
+}
+# endif
+
+/*
+ * Get line "lnum" from the mapped file of "buf".  The text is copied, because
+ * it needs a NUL at the end and NUL bytes must become NL.
+ * Returns NULL when out of memory or when the line is beyond the end of a
+ * truncated file.
+ * When another program truncated the file reading it gives a SIGBUS.  That is
+ * caught, "mm_changed" is set and NULL returned.  ml_map_check_all() then
+ * loads what is left of the file.
+ */
+    static char_u *
+ml_map_get(buf, lnum)
+    buf_T	*buf;
+    linenr_T	lnum;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+    off_t	off;
+    char_u	*start;
+    char_u	*end;
+    char_u	*p;
+    colnr_T	len;
+
+    mch_startjmp_map();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	ml_map_changed(mm, TRUE);
+	return NULL;
+    }
+
+    /* A line always starts before the end of the file. */
+    off = ml_map_find(mm, lnum);
+    if (off >= mm->mm_size)
+    {
+	mch_endjmp();
+	return NULL;
+    }
+    start = mm->mm_data + off;
+    end = (char_u *)memchr(start, NL,
+			 (size_t)(mm->mm_size - (off_t)(start - mm->mm_data)));
+    if (end == NULL)
+	end = mm->mm_data + mm->mm_size;
+    len = (colnr_T)(end - start);
+    mch_endjmp();
+
+    /* Not while reading the file, a SIGBUS would jump out of alloc(). */
+    if (len >= mm->mm_line_size)
+    {
+	vim_free(mm->mm_line);
+	mm->mm_line = alloc((unsigned)len + 1);
+	if (mm->mm_line == NULL)
+	{
+	    mm->mm_line_size = 0;
+	    return NULL;
+	}
+	mm->mm_line_size = len + 1;
+    }
+
+    mch_startjmp_map();
+    if (SETJMP(lc_jump_env) != 0)
+    {
+	mch_didjmp();
+	ml_map_changed(mm, TRUE);
+	return NULL;
+    }
+    mch_memmove(mm->mm_line, start, (size_t)len);
+    mch_endjmp();
+    mm->mm_line[len] = NUL;
+
+    /* A NUL in the file is a NL in memory. */
+    for (p = mm->mm_line; (p = (char_u *)memchr(p, NUL,
+			       (size_t)(mm->mm_line + len - p))) != NULL; ++p)
+	*p = NL;
+
+    return mm->mm_line;
+}
+
+/*
+ * Load all lines of the mapped file of "buf" into its memfile and unmap the
+ * file.  Called before the text is changed.  The lines are appended in
+ * batches, CTRL-C interrupts loading.
+ * The number of lines does not change, a command may be looping over them.
+ * Lines that are no longer in the file or could not be loaded are empty.
+ * Returns FAIL when not all lines could be loaded or the file was changed by
+ * another program.  The buffer is then made read-only, like after a read
+ * error.
+ */
+    int
+ml_map_load(buf)
+    buf_T	*buf;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+    garray_T	ga;
+    linenr_T	count;
+    linenr_T	lnum;
+    linenr_T	n;
+    char_u	*line;
+    int		len;
+    int		ok = TRUE;
+    int		changed;
+    char_u	empty[1000];
+
+    if (mm == NULL)
+	return OK;
+
+    /* Put back the empty memfile.  It still has the one empty line. */
+    count = buf->b_ml.ml_line_count;
+    buf->b_ml.ml_map = NULL;
+    buf->b_ml.ml_line_count = 1;
+    buf->b_ml.ml_flags |= ML_EMPTY;
+
+    ga_init2(&ga, 1, MLMAP_LOAD_SIZE);
+    for (lnum = 1; lnum <= count && ok; lnum += n)
+    {
+	/* Collect lines until there is about MLMAP_LOAD_SIZE bytes. */
+	ga.ga_len = 0;
+	for (n = 0; lnum + n <= count && ga.ga_len < MLMAP_LOAD_SIZE; ++n)
+	{
+	    buf->b_ml.ml_map = mm;
+	    line = ml_map_get(buf, lnum + n);
+	    buf->b_ml.ml_map = NULL;
+	    if (line == NULL)
+	    {
+		if (!mm->mm_changed)
+		{
+		    ok = FALSE;		/* out of memory */
+		    break;
+		}
+		line = (char_u *)"";	/* truncated by another program */
+	    }
+	    len = (int)STRLEN(line) + 1;
+	    if (ga_grow(&ga, len) == FAIL)
+	    {
+		ok = FALSE;
+		break;
+	    }
+	    mch_memmove((char_u *)ga.ga_data + ga.ga_len, line, (size_t)len);
+	    ga.ga_len += len;
+	}
+	if (n > 0 && ml_append_many(buf, lnum - 1, (char_u *)ga.ga_data,
+						   NULL, n, TRUE) == FAIL)
+	{
+	    n = 0;
+	    ok = FALSE;
+	}
+	ui_breakcheck();
+	if (got_int)
+	    ok = FALSE;
+    }
+    ga_clear(&ga);
+
+    /* Add empty lines for what could not be loaded. */
+    vim_memset(empty, NUL, sizeof(empty));
+    for (lnum = buf->b_ml.ml_line_count; lnum <= count; lnum += n)
+    {
+	n = count - lnum + 1;
+	if (n > (linenr_T)sizeof(empty))
+	    n = (linenr_T)sizeof(empty);
+	if (ml_append_many(buf, lnum - 1, empty, NULL, n, TRUE) == FAIL)
+	    break;
+    }
+
+    /* delete the empty line */
+    if (!(buf->b_ml.ml_flags & ML_EMPTY))
+	ml_delete_int(buf, buf->b_ml.ml_line_count, FALSE);
+
+    changed = mm->mm_changed;
+    buf->b_ml.ml_map = mm;
+    ml_map_free(buf);
+
+    if (!ok || changed)
+    {
+	win_T	    *wp;
+#ifdef FEAT_WINDOWS
+	tabpage_T   *tp;
+#endif
+
+	/* Lines are missing, a cursor may be beyond the last one. */
+	FOR_ALL_TAB_WINDOWS(tp, wp)
+	    if (wp->w_buffer == buf)
+	    {
+		if (wp->w_cursor.lnum > buf->b_ml.ml_line_count)
+		    wp->w_cursor.lnum = buf->b_ml.ml_line_count;
+		if (wp->w_topline > buf->b_ml.ml_line_count)
+		    wp->w_topline = buf->b_ml.ml_line_count;
+	    }
+
+	/* require "!" to overwrite the file, it wasn't loaded completely */
+	buf->b_flags |= BF_READERR;
+	buf->b_p_ro = TRUE;
+	if (changed)
+	    EMSG(_("E819: Mapped file was changed by another program, buffer made read-only"));
+	else
+	    EMSG(_("E818: Cannot load all lines of the mapped file, buffer made read-only"));
+	return FAIL;
+    }
+    return OK;
+}
+
+/*
+ * Check that the mapped file of "buf" was not changed by another program.
+ * Reading beyond the end of a truncated file gives a SIGBUS, and the text of
+ * a file that was rewritten would silently change.  fstat() is only used
+ * after a key was typed, once a second and every MLMAP_STEP lines.  A file
+ * truncated in between is noticed by catching the SIGBUS in ml_map_get().
+ * When the file was changed only what is still in it is read, the file is
+ * loaded later by ml_map_check_all().
+ * Returns OK when the mapped file was not changed.
+ */
+    static int
+ml_map_check(buf)
+    buf_T	*buf;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+    struct stat	st;
+    time_t	now;
+
+    if (mm->mm_changed)
+	return FAIL;
+    now = time(NULL);
+    if (mm->mm_maptick == maptick && mm->mm_checktime == now
+						   && --mm->mm_checkcount > 0)
+	return OK;
+    mm->mm_maptick = maptick;
+    mm->mm_checktime = now;
+    mm->mm_checkcount = MLMAP_STEP;
+    if (fstat(mm->mm_fd, &st) == 0 && st.st_size == mm->mm_size
+					       && st.st_mtime == mm->mm_mtime)
+	return OK;
+    ml_map_changed(mm, FALSE);
+    return FAIL;
+}
+
+/*
+ * Remember that another program changed mapped file "mm", only read what is
+ * still in it from now on.  "buserr" is TRUE when reading the file gave a
+ * SIGBUS, then nothing is read when the file did not get smaller.
+ */
+    static void
+ml_map_changed(mm, buserr)
+    mlmap_T	*mm;
+    int		buserr;
+{
+    struct stat	st;
+
+    mm->mm_changed = TRUE;
+    if (fstat(mm->mm_fd, &st) != 0 || (buserr && st.st_size >= mm->mm_size))
+	mm->mm_size = 0;
+    else if (st.st_size < mm->mm_size)
+	mm->mm_size = st.st_size;
+    mm->mm_last_lnum = 0;
+}
+
+/*
+ * Load the text of every buffer with a mapped file that another program
+ * changed, what is still in the file is kept.  Called from the main loop and
+ * not while executing a command, it may be looping over the lines.
+ */
+    void
+ml_map_check_all()
+{
+    buf_T	*buf;
+
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_map != NULL && ml_map_check(buf) == FAIL)
+	{
+	    (void)ml_map_load(buf);
+	    redraw_buf_later(buf, NOT_VALID);
+	}
+}
+
+/*
+ * Load the text of every buffer that has file "fname" mapped, it is about to
+ * be written.
+ * Returns FAIL when that failed, writing would lose lines of that buffer.
+ */
+    int
+ml_map_load_file(fname)
+    char_u	*fname;
+{
+    buf_T	*buf;
+    struct stat	st;
+    int		retval = OK;
+
+    if (mch_stat((char *)fname, &st) < 0)
+	return OK;
+    for (buf = firstbuf; buf != NULL; buf = buf->b_next)
+	if (buf->b_ml.ml_map != NULL
+		&& buf->b_ml.ml_map->mm_dev == st.st_dev
+		&& buf->b_ml.ml_map->mm_ino == st.st_ino
+		&& ml_map_load(buf) == FAIL)
+	    retval = FAIL;
+    return retval;
+}
+
+/*
+ * Unmap the mapped file of "buf", if any.
+ */
+    static void
+ml_map_free(buf)
+    buf_T	*buf;
+{
+    mlmap_T	*mm = buf->b_ml.ml_map;
+
+    if (mm == NULL)
+	return;
+    munmap((void *)mm->mm_data, mm->mm_len);
+    close(mm->mm_fd);
+    vim_free(mm->mm_index);
+    vim_free(mm->mm_line);
+    vim_free(mm);
+    buf->b_ml.ml_map = NULL;
+}
+#endif
@@ -442,7 +442,7 @@ get_number_indent(lnum)
 	    pos.coladd = 0;
 #endif
 	}
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
     }
 
     if (pos.lnum == 0 || *ml_get_pos(&pos) == NUL)
@@ -2356,17 +2356,15 @@ del_lines(nlines, undo)
     if (undo && u_savedel(first, nlines) == FAIL)
 	return;
 
-    for (n = 0; n < nlines; )
+    if (curbuf->b_ml.ml_flags & ML_EMPTY)	    /* nothing to delete */
+	n = 0;
+    else
     {
-	if (curbuf->b_ml.ml_flags & ML_EMPTY)	    /* nothing to delete */
-	    break;
-
-	ml_delete(first, TRUE);
-	++n;
-
 	/* If we delete the last line in the file, stop */
-	if (first > curbuf->b_ml.ml_line_count)
-	    break;
+	n = curbuf->b_ml.ml_line_count - first + 1;
+	if (n > nlines)
+	    n = nlines;
+	ml_delete_lines(first, n, TRUE);
     }
 
     /* Correct the cursor position before calling deleted_lines_mark(), it may
@@ -2814,6 +2812,11 @@ changed_common(lnum, col, lnume, xtra)
 	    if (wp->w_redr_type < VALID)
 		wp->w_redr_type = VALID;
 
+#ifdef FEAT_SEARCH_EXTRA
+	    /* Forget 'hlsearch' matches in the changed lines. */
+	    hlcache_changed(wp, lnum, lnume, xtra);
+#endif
+
 	    /* Check if a change in the buffer has invalidated the cached
 	     * values for the cursor. */
 #ifdef FEAT_FOLDING
@@ -8373,7 +8376,8 @@ preserve_exit()
 
     for (buf = firstbuf; buf != NULL; buf = buf->b_next)
     {
-	if (buf->b_ml.ml_mfp != NULL && buf->b_ml.ml_mfp->mf_fname != NULL)
+	if (buf->b_ml.ml_mfp != NULL && buf->b_ml.ml_mfp->mf_fname != NULL
+					       && !buf->b_ml.ml_mfp->mf_spill)
 	{
 	    OUT_STR(_("Vim: preserving files...\n"));
 	    screen_start();	    /* don't know where cursor is now */
@@ -8927,7 +8931,7 @@ dos_expandpath(
 # endif
 #endif
     vim_free(buf);
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
     vim_free(matchname);
 
     matches = gap->ga_len - start_len;
@@ -9160,7 +9164,7 @@ unix_expandpath(gap, path, wildoff, flags, didstar)
     }
 
     vim_free(buf);
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 
     matches = gap->ga_len - start_len;
     if (matches > 0)
@@ -3739,6 +3739,25 @@ do_put(regname, dir, count, flags)
 		    i = 1;
 		}
 
+		if (!(flags & PUT_FIXINDENT) && i < y_size)
+		{
+		    linenr_T	old_lcount = curbuf->b_ml.ml_line_count;
+		    long	n = y_size - i - (y_type == MCHAR ? 1 : 0);
+
+		    /* Append all lines at once, that is a lot faster.  For
+		     * MCHAR the last line was already inserted above. */
+		    if (n > 0 && ml_append_array(lnum, y_array + i,
+						  (linenr_T)n, FALSE) == FAIL)
+		    {
+			n = curbuf->b_ml.ml_line_count - old_lcount;
+			lnum += n;
+			nr_lines += n;
+			goto error;
+		    }
+		    lnum += y_size - i;
+		    nr_lines += y_size - i;
+		    i = y_size;
+		}
 		for (; i < y_size; ++i)
 		{
 		    if ((y_type != MCHAR || i < y_size - 1)
@@ -136,6 +136,7 @@
 #endif
 #define PV_MA		OPT_BUF(BV_MA)
 #define PV_ML		OPT_BUF(BV_ML)
+#define PV_MML		OPT_BUF(BV_MML)
 #define PV_MOD		OPT_BUF(BV_MOD)
 #define PV_MPS		OPT_BUF(BV_MPS)
 #define PV_NF		OPT_BUF(BV_NF)
@@ -320,6 +321,7 @@ static char_u	*p_key;
 #ifdef FEAT_LISP
 static int	p_lisp;
 #endif
+static long	p_mml;
 static int	p_ml;
 static int	p_ma;
 static int	p_mod;
@@ -896,6 +898,9 @@ static struct vimoption
     {"debug",	    NULL,   P_STRING|P_VI_DEF,
 			    (char_u *)&p_debug, PV_NONE,
 			    {(char_u *)"", (char_u *)0L} SCRIPTID_INIT},
+    {"deferswap",   "dsw",  P_BOOL|P_VI_DEF,
+			    (char_u *)&p_dsw, PV_NONE,
+			    {(char_u *)FALSE, (char_u *)0L} SCRIPTID_INIT},
     {"define",	    "def",  P_STRING|P_ALLOCED|P_VI_DEF,
 #ifdef FEAT_FIND_ID
 			    (char_u *)&p_def, PV_DEF,
@@ -1712,6 +1717,15 @@ static struct vimoption
 			    (char_u *)&p_mmt, PV_NONE,
 			    {(char_u *)DFLT_MAXMEMTOT, (char_u *)0L}
 			    SCRIPTID_INIT},
+    {"maxmemzip",   "mmz",  P_NUM|P_VI_DEF,
+			    (char_u *)&p_mmz, PV_NONE,
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
+    {"maxsteppattern","msp", P_NUM|P_VI_DEF,
+			    (char_u *)&p_msp, PV_NONE,
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
+    {"memlimit",    "mml",  P_NUM|P_VI_DEF,
+			    (char_u *)&p_mml, PV_MML,
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"menuitems",   "mis",  P_NUM|P_VI_DEF,
 #ifdef FEAT_MENU
 			    (char_u *)&p_mis, PV_NONE,
@@ -1731,6 +1745,13 @@ static struct vimoption
 			    {(char_u *)0L, (char_u *)0L}
 #endif
 			    SCRIPTID_INIT},
+    {"mmapsize",    "mms",  P_NUM|P_VI_DEF,
+#ifdef FEAT_MMAP
+			    (char_u *)&p_mms, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"modeline",    "ml",   P_BOOL|P_VIM,
 			    (char_u *)&p_ml, PV_ML,
 			    {(char_u *)FALSE, (char_u *)TRUE} SCRIPTID_INIT},
@@ -2015,6 +2036,9 @@ static struct vimoption
 			    (char_u *)NULL, PV_NONE,
 #endif
 			    {(char_u *)2000L, (char_u *)0L} SCRIPTID_INIT},
+    {"regexpengine", "re",  P_NUM|P_VI_DEF,
+			    (char_u *)&p_re, PV_NONE,
+			    {(char_u *)0L, (char_u *)0L} SCRIPTID_INIT},
     {"remap",	    NULL,   P_BOOL|P_VI_DEF,
 			    (char_u *)&p_remap, PV_NONE,
 			    {(char_u *)TRUE, (char_u *)0L} SCRIPTID_INIT},
@@ -2407,6 +2431,13 @@ static struct vimoption
 			    {(char_u *)0L, (char_u *)0L}
 #endif
 			    SCRIPTID_INIT},
+    {"syntaxidle",  "sxi",  P_NUM|P_VI_DEF,
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+			    (char_u *)&p_sxi, PV_NONE,
+#else
+			    (char_u *)NULL, PV_NONE,
+#endif
+			    {(char_u *)20L, (char_u *)0L} SCRIPTID_INIT},
     {"tabline",	    "tal",  P_STRING|P_VI_DEF|P_RALL,
 #ifdef FEAT_STL_OPT
 			    (char_u *)&p_tal, PV_NONE,
@@ -7076,11 +7107,11 @@ check_clipboard_option()
 	clip_autoselect = new_autoselect;
 	clip_autoselectml = new_autoselectml;
 	clip_html = new_html;
-	vim_free(clip_exclude_prog);
+	vim_regfree(clip_exclude_prog);
 	clip_exclude_prog = new_exclude_prog;
     }
     else
-	vim_free(new_exclude_prog);
+	vim_regfree(new_exclude_prog);
 
     return errmsg;
 }
@@ -7116,7 +7147,7 @@ compile_cap_prog(buf)
 	}
     }
 
-    vim_free(rp);
+    vim_regfree(rp);
     return NULL;
 }
 #endif
@@ -7264,6 +7295,7 @@ set_bool_option(opt_idx, varp, value, opt_flags)
 	    /* no need to reset curbuf->b_may_swap, ml_open_file() will check
 	     * buf->b_p_swf */
 	    mf_close_file(curbuf, TRUE);	/* remove the swap file */
+	ml_set_memlimit(curbuf);		/* 'memlimit' may apply now */
     }
 
     /* when 'terse' is set change 'shortmess' */
@@ -7985,6 +8017,55 @@ set_num_option(opt_idx, varp, value, errbuf, errbuflen, opt_flags)
 	if (p_uc && !old_value)
 	    ml_open_files();
     }
+
+    /* 'regexpengine' is 0, 1 or 2 */
+    else if (pp == &p_re)
+    {
+	if (p_re < 0 || p_re > 2)
+	{
+	    errmsg = e_invarg;
+	    p_re = old_value;
+	}
+    }
+
+    /* the number of blocks kept in memory depends on 'maxmem' */
+    else if (pp == &p_mm)
+    {
+	if (p_mm != old_value)
+	    mf_maxmem_changed();
+    }
+
+    /* drop compressed blocks over the new 'maxmemzip' */
+    else if (pp == &p_mmz)
+    {
+	if (p_mmz < 0)
+	{
+	    errmsg = e_positive;
+	    p_mmz = 0;
+	}
+	if (p_mmz < old_value)
+	    mf_zip_limit();
+    }
+
+    else if (pp == &p_msp)
+    {
+	if (p_msp < 0)
+	{
+	    errmsg = e_positive;
+	    p_msp = 0;
+	}
+    }
+
+    /* 'memlimit' is used for a buffer without a swap file */
+    else if (pp == &curbuf->b_p_mml)
+    {
+	if (curbuf->b_p_mml < 0)
+	{
+	    errmsg = e_positive;
+	    curbuf->b_p_mml = 0;
+	}
+	ml_set_memlimit(curbuf);
+    }
 #ifdef MZSCHEME_GUI_THREADS
     else if (pp == &p_mzq)
 	mzvim_reset_timer();
@@ -9289,6 +9370,7 @@ get_varp(p)
 	case PV_LISP:	return (char_u *)&(curbuf->b_p_lisp);
 #endif
 	case PV_ML:	return (char_u *)&(curbuf->b_p_ml);
+	case PV_MML:	return (char_u *)&(curbuf->b_p_mml);
 	case PV_MPS:	return (char_u *)&(curbuf->b_p_mps);
 	case PV_MA:	return (char_u *)&(curbuf->b_p_ma);
 	case PV_MOD:	return (char_u *)&(curbuf->b_changed);
@@ -9584,6 +9666,7 @@ buf_copy_options(buf, flags)
 	    buf->b_p_et = p_et;
 	    buf->b_p_et_nobin = p_et_nobin;
 	    buf->b_p_ml = p_ml;
+	    buf->b_p_mml = p_mml;
 	    buf->b_p_ml_nobin = p_ml_nobin;
 	    buf->b_p_inf = p_inf;
 	    buf->b_p_swf = p_swf;
@@ -396,6 +396,7 @@ EXTERN long	p_cspc;		/* 'cscopepathcomp' */
 EXTERN int	p_csverbose;	/* 'cscopeverbose' */
 #endif
 EXTERN char_u	*p_debug;	/* 'debug' */
+EXTERN int	p_dsw;		/* 'deferswap' */
 #ifdef FEAT_FIND_ID
 EXTERN char_u	*p_def;		/* 'define' */
 EXTERN char_u	*p_inc;
@@ -600,6 +601,11 @@ EXTERN long	p_mmd;		/* 'maxmapdepth' */
 EXTERN long	p_mm;		/* 'maxmem' */
 EXTERN long	p_mmp;		/* 'maxmempattern' */
 EXTERN long	p_mmt;		/* 'maxmemtot' */
+EXTERN long	p_mmz;		/* 'maxmemzip' */
+#ifdef FEAT_MMAP
+EXTERN long	p_mms;		/* 'mmapsize' */
+#endif
+EXTERN long	p_msp;		/* 'maxsteppattern' */
 #ifdef FEAT_MENU
 EXTERN long	p_mis;		/* 'menuitems' */
 #endif
@@ -636,6 +642,7 @@ EXTERN char_u	*p_cdpath;	/* 'cdpath' */
 #ifdef FEAT_RELTIME
 EXTERN long	p_rdt;		/* 'redrawtime' */
 #endif
+EXTERN long	p_re;		/* 'regexpengine' */
 EXTERN int	p_remap;	/* 'remap' */
 EXTERN long	p_report;	/* 'report' */
 #if defined(FEAT_WINDOWS) && defined(FEAT_QUICKFIX)
@@ -750,6 +757,9 @@ static char *(p_swb_values[]) = {"useopen", "usetab", "split", "newtab", NULL};
 #define SWB_USETAB		0x002
 #define SWB_SPLIT		0x004
 #define SWB_NEWTAB		0x008
+#if defined(FEAT_SYN_HL) && defined(FEAT_RELTIME)
+EXTERN long	p_sxi;		/* 'syntaxidle' */
+#endif
 EXTERN int	p_tbs;		/* 'tagbsearch' */
 EXTERN long	p_tl;		/* 'taglength' */
 EXTERN int	p_tr;		/* 'tagrelative' */
@@ -963,6 +973,7 @@ enum
 #endif
     , BV_MA
     , BV_ML
+    , BV_MML
     , BV_MOD
     , BV_MPS
     , BV_NF
@@ -879,7 +879,7 @@ sig_alarm SIGDEFARG(sigarg)
 
 #if (defined(HAVE_SETJMP_H) \
 	&& ((defined(FEAT_X11) && defined(FEAT_XCLIPBOARD)) \
-	    || defined(FEAT_LIBCALL))) \
+	    || defined(FEAT_LIBCALL) || defined(FEAT_MMAP))) \
     || defined(PROTO)
 /*
  * A simplistic version of setjmp() that only allows one level of using.
@@ -901,15 +901,39 @@ sig_alarm SIGDEFARG(sigarg)
  * Returns OK for normal return, FAIL when the protected code caused a
  * problem and LONGJMP() was used.
  */
+# if defined(FEAT_MMAP) && defined(SIGHASARG)
+/* TRUE when only a bus error jumps back, see mch_startjmp_map(). */
+static volatile int lc_map_only = FALSE;
+# endif
+
     void
 mch_startjmp()
 {
 #ifdef SIGHASARG
     lc_signal = 0;
 #endif
+# if defined(FEAT_MMAP) && defined(SIGHASARG)
+    lc_map_only = FALSE;
+# endif
     lc_active = TRUE;
 }
 
+# if defined(FEAT_MMAP) || defined(PROTO)
+/*
+ * Like mch_startjmp(), for reading a mapped file that another program may
+ * truncate.  Only SIGBUS and SIGSEGV jump back, other deadly signals are
+ * handled as usual by deathtrap().
+ */
+    void
+mch_startjmp_map()
+{
+    mch_startjmp();
+#  ifdef SIGHASARG
+    lc_map_only = TRUE;
+#  endif
+}
+# endif
+
     void
 mch_endjmp()
 {
@@ -948,7 +972,15 @@ deathtrap SIGDEFARG(sigarg)
      * Restores the environment saved in lc_jump_env, which looks like
      * SETJMP() returns 1.
      */
-    if (lc_active)
+    if (lc_active
+# if defined(FEAT_MMAP) && defined(SIGHASARG)
+	    && (!lc_map_only || sigarg == SIGSEGV
+#  ifdef SIGBUS
+		|| sigarg == SIGBUS
+#  endif
+	       )
+# endif
+       )
     {
 # if defined(SIGHASARG)
 	lc_signal = sigarg;
@@ -996,6 +1028,12 @@ deathtrap SIGDEFARG(sigarg)
 	SIGRETURN;
 #endif
 
+#if defined(HAVE_SETJMP_H)
+    /* Not going back to protected code, a crash while preserving files must
+     * not jump into it. */
+    lc_active = FALSE;
+#endif
+
     /* Remember how often we have been called. */
     ++entered;
 
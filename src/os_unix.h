@@ -524,7 +524,8 @@ int mch_rename __ARGS((const char *src, const char *dest));
 
 #if defined(HAVE_SETJMP_H)
 # include <setjmp.h>
-# ifdef HAVE_SIGSETJMP
+/* sigsetjmp() is a macro in glibc, configure doesn't find it then. */
+# if defined(HAVE_SIGSETJMP) || defined(sigsetjmp)
 #  define JMP_BUF sigjmp_buf
 #  define SETJMP(x) sigsetjmp((x), 1)
 #  define LONGJMP siglongjmp
@@ -7,6 +7,7 @@ long_u mch_total_mem __ARGS((int special));
 void mch_delay __ARGS((long msec, int ignoreinput));
 int mch_stackcheck __ARGS((char *p));
 void mch_startjmp __ARGS((void));
+void mch_startjmp_map __ARGS((void));
 void mch_endjmp __ARGS((void));
 void mch_didjmp __ARGS((void));
 void mch_suspend __ARGS((void));
@@ -1,13 +1,21 @@
 /* regexp.c */
 int re_multiline __ARGS((regprog_T *prog));
 int re_lookbehind __ARGS((regprog_T *prog));
+char_u *re_engine __ARGS((regprog_T *prog));
 char_u *skip_regexp __ARGS((char_u *startp, int dirc, int magic, char_u **newp));
 regprog_T *vim_regcomp __ARGS((char_u *expr, int re_flags));
+void vim_regfree __ARGS((regprog_T *prog));
+void vim_regcache_clear __ARGS((void));
+void vim_regcache_stats __ARGS((void));
+int vim_regfirst __ARGS((regprog_T *prog, int ic, char_u *tab));
 int vim_regcomp_had_eol __ARGS((void));
 void free_regexp_stuff __ARGS((void));
 int vim_regexec __ARGS((regmatch_T *rmp, char_u *line, colnr_T col));
 int vim_regexec_nl __ARGS((regmatch_T *rmp, char_u *line, colnr_T col));
 long vim_regexec_multi __ARGS((regmmatch_T *rmp, win_T *win, buf_T *buf, linenr_T lnum, colnr_T col, proftime_T *tm));
+linenr_T vim_regexec_nextline __ARGS((regmmatch_T *rmp, buf_T *buf, linenr_T lnum, linenr_T lnum2));
+void ex_regstats __ARGS((exarg_T *eap));
+void regstat_list __ARGS((list_T *l));
 reg_extmatch_T *ref_extmatch __ARGS((reg_extmatch_T *em));
 void unref_extmatch __ARGS((reg_extmatch_T *em));
 char_u *regtilde __ARGS((char_u *source, int magic));
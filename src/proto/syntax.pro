@@ -1,12 +1,16 @@
 /* syntax.c */
 void syntax_start __ARGS((win_T *wp, linenr_T lnum));
 void syn_stack_free_all __ARGS((buf_T *buf));
+void syn_stack_save __ARGS((buf_T *buf));
+void syn_stack_free_saved __ARGS((buf_T *buf));
 void syn_stack_apply_changes __ARGS((buf_T *buf));
 void syntax_end_parsing __ARGS((linenr_T lnum));
+int syntax_idle __ARGS((void));
 int syntax_check_changed __ARGS((linenr_T lnum));
 int get_syntax_attr __ARGS((colnr_T col, int *can_spell, int keep_state));
 void syntax_clear __ARGS((buf_T *buf));
 void ex_syntax __ARGS((exarg_T *eap));
+void ex_syntime __ARGS((exarg_T *eap));
 int syntax_present __ARGS((buf_T *buf));
 void reset_expand_highlight __ARGS((void));
 void set_context_in_echohl_cmd __ARGS((expand_T *xp, char_u *arg));
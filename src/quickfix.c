@@ -838,7 +838,7 @@ qf_init_ok:
     for (fmt_ptr = fmt_first; fmt_ptr != NULL; fmt_ptr = fmt_first)
     {
 	fmt_first = fmt_ptr->next;
-	vim_free(fmt_ptr->prog);
+	vim_regfree(fmt_ptr->prog);
 	vim_free(fmt_ptr);
     }
     qf_clean_dir_stack(&dir_stack);
@@ -2602,6 +2602,10 @@ qf_fill_buffer(qi)
 	(void)ml_delete(lnum + 1, FALSE);
     }
 
+    /* The text was replaced without calling changed(), still let everything
+     * that depends on b:changedtick know. */
+    ++curbuf->b_changedtick;
+
     /* correct cursor position */
     check_lnums(TRUE);
 
@@ -3332,7 +3336,7 @@ ex_vimgrep(eap)
 
 theend:
     vim_free(target_dir);
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 }
 
 /*
@@ -3896,7 +3900,7 @@ ex_helpgrep(eap)
 		FreeWild(fcount, fnames);
 	    }
 	}
-	vim_free(regmatch.regprog);
+	vim_regfree(regmatch.regprog);
 
 	qi->qf_lists[qi->qf_curlist].qf_nonevalid = FALSE;
 	qi->qf_lists[qi->qf_curlist].qf_ptr =
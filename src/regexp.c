@@ -404,6 +404,8 @@ static void	reg_equi_class __ARGS((int c));
 static int	get_coll_element __ARGS((char_u **pp));
 static char_u	*skip_anyof __ARGS((char_u *p));
 static void	init_class_tab __ARGS((void));
+static void	update_class_tab __ARGS((void));
+static int	reg_opt_class __ARGS((char_u *p, int mask));
 
 /*
  * Translate '\x' to its control character, except "\n", which is Magic.
@@ -497,6 +499,17 @@ static short	class_tab[256];
 #define	    RI_UPPER	0x80
 #define	    RI_WHITE	0x100
 
+/* These depend on options and are set by update_class_tab().  Only for bytes
+ * that are a character by themselves. */
+#define	    RI_IDENT	0x200	/* 'isident' */
+#define	    RI_KWORD	0x400	/* 'iskeyword' of curbuf */
+#define	    RI_FNAME	0x800	/* 'isfname' */
+#define	    RI_PRINT	0x1000	/* single-cell printable, 'isprint' */
+#define	    RI_OPTIONS	(RI_IDENT + RI_KWORD + RI_FNAME + RI_PRINT)
+
+static buf_T	*class_tab_buf = NULL;	/* curbuf used for RI_KWORD */
+static int	class_tab_tick = 0;	/* chartab_tick used for RI_OPTIONS */
+
     static void
 init_class_tab()
 {
@@ -505,6 +518,7 @@ init_class_tab()
 
     if (done)
 	return;
+    class_tab_buf = NULL;
 
     for (i = 0; i < 256; ++i)
     {
@@ -540,6 +554,64 @@ init_class_tab()
     done = TRUE;
 }
 
+/*
+ * Set the RI_OPTIONS flags in class_tab[] for the current options and
+ * buffer, when they changed since the last time.
+ */
+    static void
+update_class_tab()
+{
+    int		i;
+    int		flags;
+    char_u	buf[2];
+
+    if (class_tab_buf == curbuf && class_tab_tick == chartab_tick)
+	return;
+    class_tab_buf = curbuf;
+    class_tab_tick = chartab_tick;
+
+    buf[1] = NUL;
+    for (i = 1; i < 256; ++i)
+    {
+	flags = 0;
+#ifdef FEAT_MBYTE
+	/* A byte that may start a multi-byte character or is an illegal
+	 * byte is left to reg_opt_class(). */
+	if (!has_mbyte || i < 0x80)
+#endif
+	{
+	    buf[0] = i;
+	    if (vim_isIDc(i))
+		flags |= RI_IDENT;
+	    if (vim_iswordp(buf))
+		flags |= RI_KWORD;
+	    if (vim_isfilec(i))
+		flags |= RI_FNAME;
+	    if (ptr2cells(buf) == 1)
+		flags |= RI_PRINT;
+	}
+	class_tab[i] = (class_tab[i] & ~RI_OPTIONS) + flags;
+    }
+}
+
+/*
+ * Check if the character at "p" is in the class for RI_IDENT, RI_KWORD,
+ * RI_FNAME or RI_PRINT "mask", the slow way.
+ */
+    static int
+reg_opt_class(p, mask)
+    char_u	*p;
+    int		mask;
+{
+    switch (mask)
+    {
+	case RI_IDENT:	return vim_isIDc(*p);
+	case RI_KWORD:	return vim_iswordp(p);
+	case RI_FNAME:	return vim_isfilec(*p);
+    }
+    return ptr2cells(p) == 1;
+}
+
 #ifdef FEAT_MBYTE
 # define ri_digit(c)	(c < 0x100 && (class_tab[c] & RI_DIGIT))
 # define ri_hex(c)	(c < 0x100 && (class_tab[c] & RI_HEX))
@@ -568,6 +640,33 @@ init_class_tab()
 #define RF_HASNL    4	/* can match a NL */
 #define RF_ICOMBINE 8	/* ignore combining characters */
 #define RF_LOOKBH   16	/* uses "\@<=" or "\@<!" */
+#define RF_BACKTR   32	/* needs backtracking: "\1" or "\@" */
+#define RF_LOOP	    64	/* has a multi on something that isn't simple */
+#define RF_FIRST    128	/* "regfirst" can be used */
+#define RF_FIRST_IC 256	/* "regfirst_ic" can be used */
+#define RF_HASFIRST 512	/* "regfirst" is set */
+#define RF_HASFIRST_IC 1024 /* "regfirst_ic" is set */
+
+/*
+ * Maximum number of different bytes a match may start with to use
+ * "regfirst" for skipping.  With more of them it's not worth checking.
+ */
+#define REGFIRST_MAX	16
+
+/* Check if byte "c" is in "regfirst" or "regfirst_ic" table "tab". */
+#define REGFIRST_HAS(tab, c)	((tab)[(c) >> 3] & (1 << ((c) & 7)))
+#define REGFIRST_ADD(tab, c)	((tab)[(c) >> 3] |= (1 << ((c) & 7)))
+
+/* Values for 'regexpengine' and regprog_T->regengine. */
+#define REGENG_AUTO	0	/* choose the engine for each pattern */
+#define REGENG_BT	1	/* backtracking engine: regmatch() */
+#define REGENG_NFA	2	/* NFA engine: nfa_regmatch() */
+
+/*
+ * Largest count in "\{n,m}" for which the NFA engine is selected
+ * automatically.  It needs a thread for every count.
+ */
+#define NFA_MAXCOUNT	100
 
 /*
  * Global work variables for vim_regcomp().
@@ -576,6 +675,8 @@ init_class_tab()
 static char_u	*regparse;	/* Input-scan pointer. */
 static int	prevchr_len;	/* byte length of previous char */
 static int	num_complex_braces; /* Complex \{...} count */
+static long	max_brace_count; /* largest count in a simple "\{}" */
+static int	reg_used_prev_sub; /* "~" used the previous substitute string */
 static int	regnpar;	/* () count. */
 #ifdef FEAT_SYN_HL
 static int	regnzpar;	/* \z() count. */
@@ -651,6 +752,14 @@ static int	gethexchrs __ARGS((int maxinputlen));
 static int	getoctchrs __ARGS((void));
 static int	getdecchrs __ARGS((void));
 static int	coll_get_char __ARGS((void));
+static regprog_T *regcomp_prog __ARGS((char_u *expr, int re_flags));
+static int	reg_first_bytes __ARGS((char_u *scan, char_u *tab, char_u *tab_ic, int *icp, int depth));
+static int	reg_first_count __ARGS((char_u *tab));
+static void	reg_set_first __ARGS((regprog_T *prog));
+static int	reg_first_add_ic __ARGS((char_u *tab, int c));
+static int	regcache_state __ARGS((void));
+static regprog_T *regcache_find __ARGS((char_u *expr, int re_flags));
+static void	regcache_add __ARGS((char_u *expr, int re_flags, regprog_T *prog));
 static void	regcomp_start __ARGS((char_u *expr, int flags));
 static char_u	*reg __ARGS((int, int *));
 static char_u	*regbranch __ARGS((int *flagp));
@@ -697,6 +806,19 @@ re_lookbehind(prog)
     return (prog->regflags & RF_LOOKBH);
 }
 
+#if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Return the name of the engine that executes compiled regular expression
+ * "prog": "nfa" or "backtracking".
+ */
+    char_u *
+re_engine(prog)
+    regprog_T *prog;
+{
+    return (char_u *)(prog->regengine == REGENG_NFA ? "nfa" : "backtracking");
+}
+#endif
+
 /*
  * Check for an equivalence class name "[=a=]".  "pp" points to the '['.
  * Returns a character representing the class. Zero means that no item was
@@ -967,9 +1089,200 @@ skip_regexp(startp, dirc, magic, newp)
     return p;
 }
 
+/*
+ * Cache of compiled programs.  Many patterns are compiled again and again:
+ * for every "n" command, for every line of ":g", for every autocommand event.
+ * The cache is searched for the pattern text, the "re_flags" and the options
+ * that change the compiled program.  Whether case is ignored is decided when
+ * executing the program, thus 'ignorecase' doesn't matter.  When the cache is
+ * full the least recently used entry is dropped.
+ * A program may be used by the cache and any number of callers, "regrefcount"
+ * counts them.  vim_regfree() must be used to free the program.
+ */
+#define REGCACHE_SIZE	32
+
+typedef struct
+{
+    char_u	*rc_pat;	/* pattern, allocated */
+    int		rc_flags;	/* "re_flags" argument of vim_regcomp() */
+    int		rc_state;	/* regcache_state() when compiled */
+#if defined(FEAT_SYN_HL) || defined(PROTO)
+    int		rc_had_eol;	/* had_eol after compiling */
+#endif
+    regprog_T	*rc_prog;	/* the compiled program */
+} regcache_T;
+
+static regcache_T regcache[REGCACHE_SIZE];  /* most recently used first */
+static int	regcache_len = 0;	    /* nr of entries used in regcache[] */
+static long	regcache_hits = 0;	    /* nr of programs found in cache */
+static long	regcache_misses = 0;	    /* nr of programs compiled */
+
 /*
  * vim_regcomp() - compile a regular expression into internal code
  * Returns the program in allocated space.  Returns NULL for an error.
+ * The program may be shared with other users, the caller must free it with
+ * vim_regfree().
+ * "re_flags": RE_MAGIC and/or RE_STRING.
+ */
+    regprog_T *
+vim_regcomp(expr, re_flags)
+    char_u	*expr;
+    int		re_flags;
+{
+    regprog_T	*r;
+
+    if (expr == NULL)
+	EMSG_RET_NULL(_(e_null));
+
+    r = regcache_find(expr, re_flags);
+    if (r == NULL)
+    {
+	r = regcomp_prog(expr, re_flags);
+	if (r != NULL)
+	    regcache_add(expr, re_flags, r);
+    }
+    return r;
+}
+
+/*
+ * Free a program returned by vim_regcomp().  When it's still used elsewhere
+ * only the reference count goes down.
+ */
+    void
+vim_regfree(prog)
+    regprog_T	*prog;
+{
+    if (prog != NULL && --prog->regrefcount <= 0)
+	vim_free(prog);
+}
+
+/*
+ * Return the state of the options that change the program compiled for a
+ * pattern, other than the "re_flags".  'encoding' is not included,
+ * vim_regcache_clear() is called when it changes.
+ */
+    static int
+regcache_state()
+{
+    int		state = (int)p_re;
+
+    if (vim_strchr(p_cpo, CPO_LITERAL) != NULL)
+	state |= 0x10;
+    if (vim_strchr(p_cpo, CPO_BACKSL) != NULL)
+	state |= 0x20;
+#ifdef FEAT_SYN_HL
+    state |= reg_do_extmatch << 8;
+#endif
+    return state;
+}
+
+/*
+ * Find the program for "expr" in the cache.
+ * Returns the program with its reference count incremented, NULL when not
+ * found.
+ */
+    static regprog_T *
+regcache_find(expr, re_flags)
+    char_u	*expr;
+    int		re_flags;
+{
+    int		i;
+    int		state;
+    regcache_T	rc;
+
+    if (regcache_len == 0)
+	return NULL;
+    state = regcache_state();
+    for (i = 0; i < regcache_len; ++i)
+	if (regcache[i].rc_flags == re_flags
+		&& regcache[i].rc_state == state
+		&& STRCMP(regcache[i].rc_pat, expr) == 0)
+	{
+	    /* Move the entry to the front. */
+	    rc = regcache[i];
+	    mch_memmove(regcache + 1, regcache, i * sizeof(regcache_T));
+	    regcache[0] = rc;
+#if defined(FEAT_SYN_HL) || defined(PROTO)
+	    had_eol = rc.rc_had_eol;
+#endif
+	    /* The class table may not have been setup yet for this
+	     * encoding. */
+	    init_class_tab();
+	    ++regcache_hits;
+	    ++rc.rc_prog->regrefcount;
+	    return rc.rc_prog;
+	}
+    return NULL;
+}
+
+/*
+ * Add program "prog" just compiled for "expr" to the cache, dropping the least
+ * recently used entry when it's full.
+ */
+    static void
+regcache_add(expr, re_flags, prog)
+    char_u	*expr;
+    int		re_flags;
+    regprog_T	*prog;
+{
+    char_u	*pat;
+
+    ++regcache_misses;
+
+    /* "~" depends on the previous substitute string, can't cache that. */
+    if (reg_used_prev_sub)
+	return;
+    pat = vim_strsave(expr);
+    if (pat == NULL)
+	return;
+
+    if (regcache_len == REGCACHE_SIZE)
+    {
+	--regcache_len;
+	vim_free(regcache[regcache_len].rc_pat);
+	vim_regfree(regcache[regcache_len].rc_prog);
+    }
+    mch_memmove(regcache + 1, regcache, regcache_len * sizeof(regcache_T));
+    ++regcache_len;
+    regcache[0].rc_pat = pat;
+    regcache[0].rc_flags = re_flags;
+    regcache[0].rc_state = regcache_state();
+#if defined(FEAT_SYN_HL) || defined(PROTO)
+    regcache[0].rc_had_eol = had_eol;
+#endif
+    regcache[0].rc_prog = prog;
+    ++prog->regrefcount;
+}
+
+/*
+ * Drop all programs from the cache.  Programs still in use remain valid.
+ */
+    void
+vim_regcache_clear()
+{
+    while (regcache_len > 0)
+    {
+	--regcache_len;
+	vim_free(regcache[regcache_len].rc_pat);
+	vim_regfree(regcache[regcache_len].rc_prog);
+    }
+}
+
+/*
+ * List the cache statistics, used by ":memstats".
+ */
+    void
+vim_regcache_stats()
+{
+    vim_snprintf((char *)IObuff, IOSIZE,
+	    _("Regexp cache: %d patterns, %ld found, %ld compiled"),
+	    regcache_len, regcache_hits, regcache_misses);
+    msg_puts(IObuff);
+}
+
+/*
+ * regcomp_prog() - compile a regular expression into internal code
+ * Returns the program in allocated space.  Returns NULL for an error.
  *
  * We can't allocate space until we know how big the compiled form will be,
  * but we can't compile it (and thus know how big it is) until we've got a
@@ -987,8 +1300,8 @@ skip_regexp(startp, dirc, magic, newp)
  * of the structure of the compiled regexp.
  * "re_flags": RE_MAGIC and/or RE_STRING.
  */
-    regprog_T *
-vim_regcomp(expr, re_flags)
+    static regprog_T *
+regcomp_prog(expr, re_flags)
     char_u	*expr;
     int		re_flags;
 {
@@ -997,9 +1310,18 @@ vim_regcomp(expr, re_flags)
     char_u	*longest;
     int		len;
     int		flags;
-
-    if (expr == NULL)
-	EMSG_RET_NULL(_(e_null));
+    int		engine = (int)p_re;
+    char_u	*pat = expr;
+    long	progsize;
+
+    /* "\%#=1" at the start overrules 'regexpengine'. */
+    if (STRNCMP(expr, "\\%#=", 4) == 0
+			       && expr[4] >= '0' + REGENG_AUTO
+			       && expr[4] <= '0' + REGENG_NFA)
+    {
+	engine = expr[4] - '0';
+	expr += 5;
+    }
 
     init_class_tab();
 
@@ -1018,10 +1340,17 @@ vim_regcomp(expr, re_flags)
 	EMSG_RET_NULL(_("E339: Pattern too long"));
 #endif
 
-    /* Allocate space. */
-    r = (regprog_T *)lalloc(sizeof(regprog_T) + regsize, TRUE);
+    /* Allocate space, with room for the pattern after the program. */
+    progsize = regsize;
+    r = (regprog_T *)lalloc(sizeof(regprog_T) + progsize
+						    + (long)STRLEN(pat) + 1, TRUE);
     if (r == NULL)
 	return NULL;
+    r->regpat = r->program + progsize;
+    STRCPY(r->regpat, pat);
+#ifdef FEAT_PROFILE
+    r->regstat = NULL;
+#endif
 
     /*
      * Second pass: emit code.
@@ -1037,6 +1366,8 @@ vim_regcomp(expr, re_flags)
 	return NULL;
     }
 
+    r->regrefcount = 1;
+
     /* Dig out information for optimizations. */
     r->regstart = NUL;		/* Worst-case defaults. */
     r->reganch = 0;
@@ -1050,7 +1381,28 @@ vim_regcomp(expr, re_flags)
 #ifdef FEAT_SYN_HL
     /* Remember whether this pattern has any \z specials in it. */
     r->reghasz = re_has_z;
+    if (re_has_z)
+	r->regflags |= RF_BACKTR;
 #endif
+    if (num_complex_braces > 0)
+	r->regflags |= RF_BACKTR;
+    r->regsize = (long)(regcode - r->program);
+
+    /*
+     * Decide which engine executes the program.  The NFA engine can't do back
+     * references, look-around and complex braces.  For other patterns the
+     * backtracking engine is usually faster, unless it may have to try very
+     * many ways to match: for a repeated group.  But not with a large count
+     * in "\{n,m}", the NFA engine would need too many threads.
+     */
+    if (r->regflags & RF_BACKTR)
+	r->regengine = REGENG_BT;
+    else if (engine == REGENG_AUTO)
+	r->regengine = ((r->regflags & RF_LOOP)
+				      && max_brace_count <= NFA_MAXCOUNT)
+						     ? REGENG_NFA : REGENG_BT;
+    else
+	r->regengine = engine;
     scan = r->program + 1;	/* First BRANCH. */
     if (OP(regnext(scan)) == END)   /* Only one top-level choice. */
     {
@@ -1098,8 +1450,11 @@ vim_regcomp(expr, re_flags)
 	/*
 	 * When the r.e. starts with BOW, it is faster to look for a regmust
 	 * first. Used a lot for "#" and "*" commands. (Added by mool).
+	 * Also when the first character isn't known, then regtry() would be
+	 * called for every column.
 	 */
-	if ((flags & SPSTART || OP(scan) == BOW || OP(scan) == EOW)
+	if ((flags & SPSTART || OP(scan) == BOW || OP(scan) == EOW
+						       || r->regstart == NUL)
 							  && !(flags & HASNL))
 	{
 	    longest = NULL;
@@ -1114,12 +1469,264 @@ vim_regcomp(expr, re_flags)
 	    r->regmlen = len;
 	}
     }
+    if (r->regstart == NUL)
+	reg_set_first(r);
 #ifdef DEBUG
     regdump(expr, r);
 #endif
     return r;
 }
 
+/*
+ * Add the bytes a match for the program at "scan" may start with to table
+ * "tab", and to "tab_ic" for when ignoring case.  "*icp" is set to FALSE when
+ * the bytes for ignoring case are not known.
+ * Returns FAIL when a match may start with any byte.
+ */
+    static int
+reg_first_bytes(scan, tab, tab_ic, icp, depth)
+    char_u	*scan;
+    char_u	*tab;
+    char_u	*tab_ic;
+    int		*icp;
+    int		depth;
+{
+    char_u	*br;
+    char_u	*p;
+    int		mask;
+    int		i;
+
+    /* Don't go too deep for "\(\(\(\(...". */
+    if (++depth > 20)
+	return FAIL;
+
+    /* Skip over items that don't match a character. */
+    while (OP(scan) == BOL || OP(scan) == RE_BOF || OP(scan) == NOTHING
+	    || OP(scan) == BOW || OP(scan) == EOW
+	    || (OP(scan) >= MOPEN && OP(scan) <= MOPEN + 9)
+	    || (OP(scan) >= MCLOSE && OP(scan) <= MCLOSE + 9)
+	    || OP(scan) == NOPEN || OP(scan) == NCLOSE)
+	scan = regnext(scan);
+
+    switch (OP(scan))
+    {
+	case BRANCH:
+	    /* Every alternative must start with a known byte. */
+	    for (br = scan; br != NULL && OP(br) == BRANCH; br = regnext(br))
+		if (reg_first_bytes(OPERAND(br), tab, tab_ic, icp, depth)
+									== FAIL)
+		    return FAIL;
+	    return OK;
+
+	case PLUS:
+	    /* One or more times a simple item. */
+	    return reg_first_bytes(OPERAND(scan), tab, tab_ic, icp, depth);
+
+	case STAR:
+	    /* Zero or more times a simple item: the item or what follows. */
+	    if (reg_first_bytes(OPERAND(scan), tab, tab_ic, icp, depth) == FAIL)
+		return FAIL;
+	    return reg_first_bytes(regnext(scan), tab, tab_ic, icp, depth);
+
+	case BRACE_LIMITS:
+	    /* "\{n,m}" of a simple item, when "n" or "m" is zero also what
+	     * follows. */
+	    br = regnext(scan);
+	    if (br == NULL || OP(br) != BRACE_SIMPLE
+		    || reg_first_bytes(OPERAND(br), tab, tab_ic, icp, depth)
+									== FAIL)
+		return FAIL;
+	    if (OPERAND_MIN(scan) > 0 && OPERAND_MAX(scan) > 0)
+		return OK;
+	    return reg_first_bytes(regnext(br), tab, tab_ic, icp, depth);
+
+	case EXACTLY:
+	    p = OPERAND(scan);
+	    if (*p == NUL)
+		return FAIL;
+#ifdef FEAT_MBYTE
+	    /* A composing character may match after another character. */
+	    if (enc_utf8 && *p >= 0x80 && utf_iscomposing(utf_ptr2char(p)))
+		return FAIL;
+#endif
+	    REGFIRST_ADD(tab, *p);
+	    if (reg_first_add_ic(tab_ic, *p) == FAIL)
+		*icp = FALSE;
+	    return OK;
+
+	case ANYOF:
+	    for (p = OPERAND(scan); *p != NUL; ++p)
+	    {
+#ifdef FEAT_MBYTE
+		/* Give up for multi-byte characters, the operand may contain
+		 * bytes that are not valid by themselves. */
+		if (has_mbyte && *p >= 0x80)
+		    return FAIL;
+#endif
+		REGFIRST_ADD(tab, *p);
+		if (reg_first_add_ic(tab_ic, *p) == FAIL)
+		    *icp = FALSE;
+	    }
+	    return OK;
+
+	/* Character classes only match ASCII characters, ignoring case
+	 * doesn't matter. */
+	case DIGIT: mask = RI_DIGIT; break;
+	case HEX:   mask = RI_HEX; break;
+	case OCTAL: mask = RI_OCTAL; break;
+	case WORD:  mask = RI_WORD; break;
+	case HEAD:  mask = RI_HEAD; break;
+	case ALPHA: mask = RI_ALPHA; break;
+	case LOWER: mask = RI_LOWER; break;
+	case UPPER: mask = RI_UPPER; break;
+	case WHITE: mask = RI_WHITE; break;
+
+	default:
+	    return FAIL;
+    }
+
+    for (i = 1; i < 0x80; ++i)
+	if (class_tab[i] & mask)
+	{
+	    REGFIRST_ADD(tab, i);
+	    REGFIRST_ADD(tab_ic, i);
+	}
+    return OK;
+}
+
+/*
+ * Return the number of bytes in "regfirst" table "tab".
+ */
+    static int
+reg_first_count(tab)
+    char_u	*tab;
+{
+    int		count = 0;
+    int		c;
+
+    for (c = 0; c < 256; ++c)
+	if (REGFIRST_HAS(tab, c))
+	    ++count;
+    return count;
+}
+
+/*
+ * Set prog->regfirst and prog->regfirst_ic for a program that doesn't have a
+ * "regstart" character.  For "foo\|bar" they have the bits for "fb" and
+ * "fbFB" set, for "\s*\d" the bits for " \t0123456789".
+ * They are used for skipping to where a match may start when there are only
+ * a few bytes.
+ */
+    static void
+reg_set_first(prog)
+    regprog_T	*prog;
+{
+    int		ic_ok = TRUE;
+
+    vim_memset(prog->regfirst, 0, sizeof(prog->regfirst));
+    vim_memset(prog->regfirst_ic, 0, sizeof(prog->regfirst_ic));
+    if (reg_first_bytes(prog->program + 1, prog->regfirst, prog->regfirst_ic,
+							   &ic_ok, 0) == FAIL)
+	return;
+
+    prog->regflags |= RF_HASFIRST;
+    if (reg_first_count(prog->regfirst) <= REGFIRST_MAX)
+	prog->regflags |= RF_FIRST;
+    if (ic_ok)
+    {
+	prog->regflags |= RF_HASFIRST_IC;
+	if (reg_first_count(prog->regfirst_ic) <= 2 * REGFIRST_MAX)
+	    prog->regflags |= RF_FIRST_IC;
+    }
+}
+
+/*
+ * Add byte "c" to "regfirst_ic" table "tab", with the other case of an ASCII
+ * letter.  In UTF-8 the Kelvin sign and the capital I with dot fold to "k"
+ * and "i", add their lead byte as well.
+ * Returns FAIL for a byte that may be part of a multi-byte character or
+ * whose other case isn't ASCII, its other case can't be added.
+ */
+    static int
+reg_first_add_ic(tab, c)
+    char_u	*tab;
+    int		c;
+{
+    int		cc;
+
+    if (MB_ISUPPER(c))
+	cc = MB_TOLOWER(c);
+    else if (MB_ISLOWER(c))
+	cc = MB_TOUPPER(c);
+    else
+	cc = c;
+    if (c >= 0x80 || cc >= 0x80)
+	return FAIL;
+    REGFIRST_ADD(tab, c);
+    REGFIRST_ADD(tab, cc);
+#ifdef FEAT_MBYTE
+    if (enc_utf8)
+    {
+	if (c == 'k' || c == 'K')
+	    REGFIRST_ADD(tab, 0xe2);	/* U+212A */
+	else if (c == 'i' || c == 'I')
+	    REGFIRST_ADD(tab, 0xc4);	/* U+0130 */
+    }
+#endif
+    return OK;
+}
+
+#if defined(FEAT_SYN_HL) || defined(PROTO)
+/*
+ * Set the bits in "tab" (32 bytes) for the bytes a match for "prog" may start
+ * with, when matching with ignore-case "ic".  Used to skip a syntax pattern
+ * in a line where none of these bytes appear.
+ * Returns FAIL when this isn't known, a match may start with any byte.
+ */
+    int
+vim_regfirst(prog, ic, tab)
+    regprog_T	*prog;
+    int		ic;
+    char_u	*tab;
+{
+# ifdef FEAT_MBYTE
+    char_u	buf[MB_MAXBYTES + 1];
+# endif
+
+    /* Same as in vim_regexec_both(). */
+    if (prog == NULL || (prog->regflags & RF_ICOMBINE))
+	return FAIL;
+    if (prog->regflags & RF_ICASE)
+	ic = TRUE;
+    else if (prog->regflags & RF_NOICASE)
+	ic = FALSE;
+
+    if (prog->regstart == NUL)
+    {
+	if (!(prog->regflags & (ic ? RF_HASFIRST_IC : RF_HASFIRST)))
+	    return FAIL;
+	mch_memmove(tab, ic ? prog->regfirst_ic : prog->regfirst,
+						       sizeof(prog->regfirst));
+	return OK;
+    }
+
+    vim_memset(tab, 0, sizeof(prog->regfirst));
+    if (ic)
+	return reg_first_add_ic(tab, prog->regstart);
+# ifdef FEAT_MBYTE
+    if (has_mbyte)
+    {
+	/* Only the lead byte of the character. */
+	(*mb_char2bytes)(prog->regstart, buf);
+	REGFIRST_ADD(tab, buf[0]);
+	return OK;
+    }
+# endif
+    REGFIRST_ADD(tab, prog->regstart);
+    return OK;
+}
+#endif
+
 /*
  * Setup to parse the regexp.  Used once to get the length and once to do it.
  */
@@ -1137,6 +1744,8 @@ regcomp_start(expr, re_flags)
     reg_strict = (re_flags & RE_STRICT);
 
     num_complex_braces = 0;
+    max_brace_count = 0;
+    reg_used_prev_sub = FALSE;
     regnpar = 1;
     vim_memset(had_endbrace, 0, sizeof(had_endbrace));
 #ifdef FEAT_SYN_HL
@@ -1447,6 +2056,7 @@ regpiece(flagp)
 		reginsert(STAR, ret);
 	    else
 	    {
+		regflags |= RF_LOOP;
 		/* Emit x* as (x&|), where & means "self". */
 		reginsert(BRANCH, ret); /* Either x */
 		regoptail(ret, regnode(BACK));	/* and loop */
@@ -1461,6 +2071,7 @@ regpiece(flagp)
 		reginsert(PLUS, ret);
 	    else
 	    {
+		regflags |= RF_LOOP;
 		/* Emit x+ as x(&|), where & means "self". */
 		next = regnode(BRANCH); /* Either */
 		regtail(ret, next);
@@ -1489,6 +2100,7 @@ regpiece(flagp)
 		if (lop == END)
 		    EMSG_M_RET_NULL(_("E59: invalid character after %s@"),
 						      reg_magic == MAGIC_ALL);
+		regflags |= RF_BACKTR;
 		/* Look behind must match with behind_pos. */
 		if (lop == BEHIND || lop == NOBEHIND)
 		{
@@ -1515,6 +2127,10 @@ regpiece(flagp)
 		return NULL;
 	    if (flags & SIMPLE)
 	    {
+		if (minval != MAX_LIMIT && minval > max_brace_count)
+		    max_brace_count = minval;
+		if (maxval != MAX_LIMIT && maxval > max_brace_count)
+		    max_brace_count = maxval;
 		reginsert(BRACE_SIMPLE, ret);
 		reginsert_limits(BRACE_LIMITS, minval, maxval, ret);
 	    }
@@ -1723,6 +2339,7 @@ regatom(flagp)
 	/* NOTREACHED */
 
       case Magic('~'):		/* previous substitute pattern */
+	    reg_used_prev_sub = TRUE;
 	    if (reg_prev_sub != NULL)
 	    {
 		char_u	    *lp;
@@ -1775,6 +2392,7 @@ regatom(flagp)
 			EMSG_RET_NULL(_("E65: Illegal back reference"));
 		}
 		ret = regnode(BACKREF + refnum);
+		regflags |= RF_BACKTR;
 	    }
 	    break;
 
@@ -3016,32 +3634,133 @@ read_limits(minval, maxval)
  * Global work variables for vim_regexec().
  */
 
-/* The current match-position is remembered with these variables: */
-static linenr_T	reglnum;	/* line number, relative to first line */
-static char_u	*regline;	/* start of current line */
-static char_u	*reginput;	/* current input, points into "regline" */
-
-static int	need_clear_subexpr;	/* subexpressions still need to be
-					 * cleared */
-#ifdef FEAT_SYN_HL
-static int	need_clear_zsubexpr = FALSE;	/* extmatch subexpressions
-						 * still need to be cleared */
-#endif
-
 /*
- * Structure used to save the current input state, when it needs to be
- * restored after trying a match.  Used by reg_save() and reg_restore().
- * Also stores the length of "backpos".
- */
-typedef struct
-{
-    union
-    {
-	char_u	*ptr;	/* reginput pointer, for single-line regexp */
-	lpos_T	pos;	/* reginput pos, for multi-line regexp */
-    } rs_u;
-    int		rs_len;
-} regsave_T;
+ * The state of executing a program is kept in "rex".  It is set at each call
+ * to vim_regexec() and friends.  When called recursively, e.g. from an
+ * expression in the substitute string, the state of the outer call is saved
+ * and restored.
+ *
+ * Which fields are set depends on whether a single-line or multi-line match
+ * is done:
+ *			single-line		multi-line
+ * reg_match		&regmatch_T		NULL
+ * reg_mmatch		NULL			&regmmatch_T
+ * reg_startp		reg_match->startp	<invalid>
+ * reg_endp		reg_match->endp		<invalid>
+ * reg_startpos		<invalid>		reg_mmatch->startpos
+ * reg_endpos		<invalid>		reg_mmatch->endpos
+ * reg_win		NULL			window in which to search
+ * reg_buf		<invalid>		buffer in which to search
+ * reg_firstlnum	<invalid>		first line in which to search
+ * reg_maxline		0			last line nr
+ * reg_line_lbr		FALSE or TRUE		FALSE
+ */
+typedef struct
+{
+    /* The current match-position is remembered with these fields: */
+    linenr_T	lnum;		/* line number, relative to first line */
+    char_u	*line;		/* start of current line */
+    char_u	*input;		/* current input, points into "line" */
+
+    int		need_clear_subexpr;	/* subexpressions still need to be
+					 * cleared */
+#ifdef FEAT_SYN_HL
+    int		need_clear_zsubexpr;	/* extmatch subexpressions still need
+					 * to be cleared */
+#endif
+
+    /* Internal copy of 'ignorecase'.  Normally it gets the value of "rm_ic"
+     * or "rmm_ic", but when the pattern contains '\c' or '\C' the value is
+     * overruled. */
+    int		reg_ic;
+
+#ifdef FEAT_MBYTE
+    /* Similar to "reg_ic", but only for 'combining' characters.  Set with
+     * \Z flag in the regexp.  Defaults to false, always. */
+    int		reg_icombine;
+#endif
+
+    /* Copy of "rmm_maxcol": maximum column to search for a match.  Zero when
+     * there is no maximum. */
+    colnr_T	reg_maxcol;
+
+    regmatch_T	*reg_match;
+    regmmatch_T	*reg_mmatch;
+    char_u	**reg_startp;
+    char_u	**reg_endp;
+    lpos_T	*reg_startpos;
+    lpos_T	*reg_endpos;
+    win_T	*reg_win;
+    buf_T	*reg_buf;
+    linenr_T	reg_firstlnum;
+    linenr_T	reg_maxline;
+    int		reg_line_lbr;	    /* "\n" in string is line break */
+
+#ifdef FEAT_SYN_HL
+    char_u	*reg_startzp[NSUBEXP];	/* Workspace to mark beginning */
+    char_u	*reg_endzp[NSUBEXP];	/*   and end of \z(...\) matches */
+    lpos_T	reg_startzpos[NSUBEXP];	/* idem, beginning pos */
+    lpos_T	reg_endzpos[NSUBEXP];	/* idem, end pos */
+#endif
+
+    /* Counters for one call of vim_regexec_both(), for 'maxsteppattern' and
+     * ":regstats". */
+    long	reg_steps;	/* nr of program nodes visited */
+    long	reg_maxsteps;	/* abort when "reg_steps" gets above this */
+    long	reg_backtracks;	/* nr of times the input was restored */
+    regprog_T	*reg_prog;	/* program being executed, for E817 */
+} regexec_T;
+
+static regexec_T	rex;
+static int		rex_in_use = FALSE;
+
+#ifdef FEAT_PROFILE
+/*
+ * Statistics for executing a pattern, collected while ":regstats on" is
+ * active.  Stored in "regstat_ht" with the pattern as the key, programs
+ * compiled from the same pattern add to the same entry.
+ */
+typedef struct regstat_S
+{
+    long	rs_calls;	/* nr of times the pattern was executed */
+    long	rs_matches;	/* nr of times it matched */
+    long	rs_steps;	/* nr of program nodes visited */
+    long	rs_backtracks;	/* nr of times the input was restored */
+    long	rs_aborted;	/* nr of times 'maxsteppattern' was hit */
+    proftime_T	rs_total;	/* total time used */
+    proftime_T	rs_slowest;	/* time used by the slowest call */
+    char_u	rs_pattern[1];	/* the pattern, actually longer */
+} regstat_T;
+
+static regstat_T dumrs;			/* only used for offset of
+					   "rs_pattern" */
+#define HIKEY2RS(p)  ((regstat_T *)(p - (dumrs.rs_pattern - (char_u *)&dumrs)))
+#define HI2RS(hi)     HIKEY2RS((hi)->hi_key)
+
+static hashtab_T regstat_ht;		/* regstat_T items by pattern */
+static int	regstat_on = FALSE;	/* collecting statistics */
+static int	regstat_gen = 0;	/* incremented by ":regstats clear" */
+
+static regstat_T *regstat_find __ARGS((regprog_T *prog));
+static void	regstat_add __ARGS((regprog_T *prog, proftime_T *tm, int matched));
+static void	regstat_clear __ARGS((void));
+static regstat_T **regstat_sorted __ARGS((int *countp));
+#endif
+
+/*
+ * Structure used to save the current input state, when it needs to be
+ * restored after trying a match.  Used by reg_save() and reg_restore().
+ * Also stores the length of "backpos".
+ */
+typedef struct
+{
+    union
+    {
+	char_u	*ptr;	/* rex.input pointer, for single-line regexp */
+	lpos_T	pos;	/* rex.input pos, for multi-line regexp */
+    } rs_u;
+    int		rs_len;
+} regsave_T;
 
 /* struct to save start/end pointer/position in for \(\) */
 typedef struct
@@ -3064,8 +3783,13 @@ typedef struct regbehind_S
 } regbehind_T;
 
 static char_u	*reg_getline __ARGS((linenr_T lnum));
+static int	vim_regexec_string __ARGS((regmatch_T *rmp, char_u *line, colnr_T col, int line_lbr));
 static long	vim_regexec_both __ARGS((char_u *line, colnr_T col, proftime_T *tm));
+static char_u	*reg_find_must __ARGS((regprog_T *prog, char_u *s));
+static char_u	*reg_skip_start __ARGS((regprog_T *prog, char_u *s));
 static long	regtry __ARGS((regprog_T *prog, colnr_T col));
+static void	reg_toomanysteps __ARGS((void));
+static long	nfa_regmatch __ARGS((regprog_T *prog, colnr_T col, proftime_T *tm));
 static void	cleanup_subexpr __ARGS((void));
 #ifdef FEAT_SYN_HL
 static void	cleanup_zsubexpr __ARGS((void));
@@ -3092,33 +3816,13 @@ static void	save_se_one __ARGS((save_se_T *savep, char_u **pp));
 
 static int	re_num_cmp __ARGS((long_u val, char_u *scan));
 static int	regmatch __ARGS((char_u *prog));
+static int	regmatch_item __ARGS((char_u *scan));
 static int	regrepeat __ARGS((char_u *p, long maxcount));
 
 #ifdef DEBUG
 int		regnarrate = 0;
 #endif
 
-/*
- * Internal copy of 'ignorecase'.  It is set at each call to vim_regexec().
- * Normally it gets the value of "rm_ic" or "rmm_ic", but when the pattern
- * contains '\c' or '\C' the value is overruled.
- */
-static int	ireg_ic;
-
-#ifdef FEAT_MBYTE
-/*
- * Similar to ireg_ic, but only for 'combining' characters.  Set with \Z flag
- * in the regexp.  Defaults to false, always.
- */
-static int	ireg_icombine;
-#endif
-
-/*
- * Copy of "rmm_maxcol": maximum column to search for a match.  Zero when
- * there is no maximum.
- */
-static colnr_T	ireg_maxcol;
-
 /*
  * Sometimes need to save a copy of a line.  Since alloc()/free() is very
  * slow, we keep one allocated piece of memory and only re-allocate it when
@@ -3127,34 +3831,6 @@ static colnr_T	ireg_maxcol;
 static char_u	*reg_tofree = NULL;
 static unsigned	reg_tofreelen;
 
-/*
- * These variables are set when executing a regexp to speed up the execution.
- * Which ones are set depends on whether a single-line or multi-line match is
- * done:
- *			single-line		multi-line
- * reg_match		&regmatch_T		NULL
- * reg_mmatch		NULL			&regmmatch_T
- * reg_startp		reg_match->startp	<invalid>
- * reg_endp		reg_match->endp		<invalid>
- * reg_startpos		<invalid>		reg_mmatch->startpos
- * reg_endpos		<invalid>		reg_mmatch->endpos
- * reg_win		NULL			window in which to search
- * reg_buf		<invalid>		buffer in which to search
- * reg_firstlnum	<invalid>		first line in which to search
- * reg_maxline		0			last line nr
- * reg_line_lbr		FALSE or TRUE		FALSE
- */
-static regmatch_T	*reg_match;
-static regmmatch_T	*reg_mmatch;
-static char_u		**reg_startp = NULL;
-static char_u		**reg_endp = NULL;
-static lpos_T		*reg_startpos = NULL;
-static lpos_T		*reg_endpos = NULL;
-static win_T		*reg_win;
-static buf_T		*reg_buf;
-static linenr_T		reg_firstlnum;
-static linenr_T		reg_maxline;
-static int		reg_line_lbr;	    /* "\n" in string is line break */
 
 /* Values for rs_state in regitem_T. */
 typedef enum regstate_E
@@ -3191,7 +3867,7 @@ typedef struct regitem_S
     {
 	save_se_T  sesave;
 	regsave_T  regsave;
-    } rs_un;			/* room for saving reginput */
+    } rs_un;			/* room for saving rex.input */
     short	rs_no;		/* submatch nr or BEHIND/NOBEHIND */
 } regitem_T;
 
@@ -3240,19 +3916,67 @@ static garray_T	backpos = {0, 0, 0, 0, NULL};
 #define REGSTACK_INITIAL	2048
 #define BACKPOS_INITIAL		64
 
+/* A thread of the NFA engine, see nfa_regmatch(). */
+typedef struct
+{
+    char_u	*nt_scan;		/* node to match, NULL for a match */
+    long	nt_count;		/* count for STAR, PLUS, BRACE_SIMPLE */
+    lpos_T	nt_pos;			/* position in the text */
+    lpos_T	nt_startpos[NSUBEXP];	/* start of \( \) submatches */
+    lpos_T	nt_endpos[NSUBEXP];	/* end of \( \) submatches */
+} nfa_thread_T;
+
+/* Node and count of a STAR, PLUS or BRACE_SIMPLE thread. */
+typedef struct
+{
+    char_u	*nc_scan;
+    long	nc_count;
+    int		nc_back;
+    int		nc_step;		/* step in which it was added */
+} nfa_count_T;
+
+/*
+ * "nfa_list" holds the threads for the current and the next step.  Like
+ * "regstack" they are kept over calls and freed when they have grown.
+ * "nfa_seen" has the step number in which a thread was added for each byte in
+ * the program, twice: before and after passing a BACK node.  For threads with
+ * a count "nfa_seen_count" is used, a hash table with "nfa_seen_count_size"
+ * entries, a power of two.  Entries with another step number are unused.
+ */
+#define NFA_LIST_INITIAL	64
+#define NFA_COUNT_INITIAL	64
+
+static garray_T	nfa_list[2] = {{0, 0, 0, 0, NULL}, {0, 0, 0, 0, NULL}};
+static garray_T	nfa_seen = {0, 0, 0, 0, NULL};
+static nfa_count_T *nfa_seen_count = NULL;
+static int	nfa_seen_count_size = 0;
+static int	nfa_seen_count_used = 0;  /* entries used in this step */
+static int	nfa_step = 0;		/* current step number */
+static int	nfa_toobig;		/* threads exceeded 'maxmempattern' */
+
 #if defined(EXITFREE) || defined(PROTO)
     void
 free_regexp_stuff()
 {
     ga_clear(&regstack);
     ga_clear(&backpos);
+    ga_clear(&nfa_list[0]);
+    ga_clear(&nfa_list[1]);
+    ga_clear(&nfa_seen);
+    vim_free(nfa_seen_count);
+    nfa_seen_count = NULL;
+    nfa_seen_count_size = 0;
+    vim_regcache_clear();
+# ifdef FEAT_PROFILE
+    regstat_clear();
+# endif
     vim_free(reg_tofree);
     vim_free(reg_prev_sub);
 }
 #endif
 
 /*
- * Get pointer to the line "lnum", which is relative to "reg_firstlnum".
+ * Get pointer to the line "lnum", which is relative to "rex.reg_firstlnum".
  */
     static char_u *
 reg_getline(lnum)
@@ -3260,25 +3984,18 @@ reg_getline(lnum)
 {
     /* when looking behind for a match/no-match lnum is negative.  But we
      * can't go before line 1 */
-    if (reg_firstlnum + lnum < 1)
+    if (rex.reg_firstlnum + lnum < 1)
 	return NULL;
-    if (lnum > reg_maxline)
+    if (lnum > rex.reg_maxline)
 	/* Must have matched the "\n" in the last line. */
 	return (char_u *)"";
-    return ml_get_buf(reg_buf, reg_firstlnum + lnum, FALSE);
+    return ml_get_buf(rex.reg_buf, rex.reg_firstlnum + lnum, FALSE);
 }
 
 static regsave_T behind_pos;
 
-#ifdef FEAT_SYN_HL
-static char_u	*reg_startzp[NSUBEXP];	/* Workspace to mark beginning */
-static char_u	*reg_endzp[NSUBEXP];	/*   and end of \z(...\) matches */
-static lpos_T	reg_startzpos[NSUBEXP];	/* idem, beginning pos */
-static lpos_T	reg_endzpos[NSUBEXP];	/* idem, end pos */
-#endif
-
 /* TRUE if using multi-line regexp. */
-#define REG_MULTI	(reg_match == NULL)
+#define REG_MULTI	(rex.reg_match == NULL)
 
 /*
  * Match a regexp against a string.
@@ -3293,17 +4010,7 @@ vim_regexec(rmp, line, col)
     char_u	*line;	/* string to match against */
     colnr_T	col;	/* column to start looking for match */
 {
-    reg_match = rmp;
-    reg_mmatch = NULL;
-    reg_maxline = 0;
-    reg_line_lbr = FALSE;
-    reg_win = NULL;
-    ireg_ic = rmp->rm_ic;
-#ifdef FEAT_MBYTE
-    ireg_icombine = FALSE;
-#endif
-    ireg_maxcol = 0;
-    return (vim_regexec_both(line, col, NULL) != 0);
+    return vim_regexec_string(rmp, line, col, FALSE);
 }
 
 #if defined(FEAT_MODIFY_FNAME) || defined(FEAT_EVAL) \
@@ -3317,19 +4024,47 @@ vim_regexec_nl(rmp, line, col)
     char_u	*line;	/* string to match against */
     colnr_T	col;	/* column to start looking for match */
 {
-    reg_match = rmp;
-    reg_mmatch = NULL;
-    reg_maxline = 0;
-    reg_line_lbr = TRUE;
-    reg_win = NULL;
-    ireg_ic = rmp->rm_ic;
+    return vim_regexec_string(rmp, line, col, TRUE);
+}
+#endif
+
+/*
+ * Common code for vim_regexec() and vim_regexec_nl().
+ * "line_lbr" is TRUE when a "\n" in "line" is a line break.
+ */
+    static int
+vim_regexec_string(rmp, line, col, line_lbr)
+    regmatch_T	*rmp;
+    char_u	*line;
+    colnr_T	col;
+    int		line_lbr;
+{
+    int		r;
+    regexec_T	rex_save;
+    int		rex_in_use_save = rex_in_use;
+
+    if (rex_in_use)
+	/* Being called recursively, save the state. */
+	rex_save = rex;
+    rex_in_use = TRUE;
+
+    rex.reg_match = rmp;
+    rex.reg_mmatch = NULL;
+    rex.reg_maxline = 0;
+    rex.reg_line_lbr = line_lbr;
+    rex.reg_win = NULL;
+    rex.reg_ic = rmp->rm_ic;
 #ifdef FEAT_MBYTE
-    ireg_icombine = FALSE;
+    rex.reg_icombine = FALSE;
 #endif
-    ireg_maxcol = 0;
-    return (vim_regexec_both(line, col, NULL) != 0);
+    rex.reg_maxcol = 0;
+    r = (vim_regexec_both(line, col, NULL) != 0);
+
+    rex_in_use = rex_in_use_save;
+    if (rex_in_use)
+	rex = rex_save;
+    return r;
 }
-#endif
 
 /*
  * Match a regexp against multiple lines.
@@ -3350,28 +4085,81 @@ vim_regexec_multi(rmp, win, buf, lnum, col, tm)
 {
     long	r;
     buf_T	*save_curbuf = curbuf;
-
-    reg_match = NULL;
-    reg_mmatch = rmp;
-    reg_buf = buf;
-    reg_win = win;
-    reg_firstlnum = lnum;
-    reg_maxline = reg_buf->b_ml.ml_line_count - lnum;
-    reg_line_lbr = FALSE;
-    ireg_ic = rmp->rmm_ic;
+    regexec_T	rex_save;
+    int		rex_in_use_save = rex_in_use;
+
+    if (rex_in_use)
+	/* Being called recursively, save the state. */
+	rex_save = rex;
+    rex_in_use = TRUE;
+
+    rex.reg_match = NULL;
+    rex.reg_mmatch = rmp;
+    rex.reg_buf = buf;
+    rex.reg_win = win;
+    rex.reg_firstlnum = lnum;
+    rex.reg_maxline = rex.reg_buf->b_ml.ml_line_count - lnum;
+    rex.reg_line_lbr = FALSE;
+    rex.reg_ic = rmp->rmm_ic;
 #ifdef FEAT_MBYTE
-    ireg_icombine = FALSE;
+    rex.reg_icombine = FALSE;
 #endif
-    ireg_maxcol = rmp->rmm_maxcol;
+    rex.reg_maxcol = rmp->rmm_maxcol;
 
     /* Need to switch to buffer "buf" to make vim_iswordc() work. */
     curbuf = buf;
     r = vim_regexec_both(NULL, col, tm);
     curbuf = save_curbuf;
 
+    rex_in_use = rex_in_use_save;
+    if (rex_in_use)
+	rex = rex_save;
     return r;
 }
 
+/*
+ * Find the first line from "lnum" to "lnum2" in "buf" where
+ * vim_regexec_multi() with column zero may find a match.  Only looks for the
+ * text that the pattern requires, which is much faster than trying to match.
+ * Used to quickly skip over lines for ":global" and ":substitute".
+ * Returns "lnum2" + 1 when none of the lines can match.
+ */
+    linenr_T
+vim_regexec_nextline(rmp, buf, lnum, lnum2)
+    regmmatch_T	*rmp;
+    buf_T	*buf;
+    linenr_T	lnum;
+    linenr_T	lnum2;
+{
+    regprog_T	*prog = rmp->regprog;
+    char_u	*line;
+    int		save_reg_ic = rex.reg_ic;
+
+    if (prog == NULL || (prog->regmust == NULL && prog->regstart == NUL
+					     && !(prog->regflags & RF_FIRST)))
+	return lnum;
+
+    /* Same as in vim_regexec_both(). */
+    rex.reg_ic = rmp->rmm_ic;
+    if (prog->regflags & RF_ICASE)
+	rex.reg_ic = TRUE;
+    else if (prog->regflags & RF_NOICASE)
+	rex.reg_ic = FALSE;
+
+    for ( ; lnum <= lnum2; ++lnum)
+    {
+	line = ml_get_buf(buf, lnum, FALSE);
+	if ((prog->regmust == NULL || reg_find_must(prog, line) != NULL)
+		&& reg_skip_start(prog, line) != NULL)
+	    break;
+	line_breakcheck();
+	if (got_int)
+	    break;
+    }
+    rex.reg_ic = save_reg_ic;
+    return lnum;
+}
+
 /*
  * Match a regexp against a string ("line" points to the string) or multiple
  * lines ("line" is NULL, use reg_getline()).
@@ -3382,9 +4170,20 @@ vim_regexec_both(line, col, tm)
     colnr_T	col;		/* column to start looking for match */
     proftime_T	*tm UNUSED;	/* timeout limit or NULL */
 {
-    regprog_T	*prog;
+    regprog_T	*prog = NULL;
     char_u	*s;
     long	retval = 0L;
+#ifdef FEAT_PROFILE
+    proftime_T	start_tm;
+
+    if (regstat_on)
+	profile_start(&start_tm);
+#endif
+
+    rex.reg_steps = 0;
+    rex.reg_maxsteps = p_msp > 0 ? p_msp : MAXLNUM;
+    rex.reg_backtracks = 0;
+    rex.reg_prog = NULL;
 
     /* Create "regstack" and "backpos" if they are not allocated yet.
      * We allocate *_INITIAL amount of bytes first and then set the grow size
@@ -3408,16 +4207,16 @@ vim_regexec_both(line, col, tm)
 
     if (REG_MULTI)
     {
-	prog = reg_mmatch->regprog;
+	prog = rex.reg_mmatch->regprog;
 	line = reg_getline((linenr_T)0);
-	reg_startpos = reg_mmatch->startpos;
-	reg_endpos = reg_mmatch->endpos;
+	rex.reg_startpos = rex.reg_mmatch->startpos;
+	rex.reg_endpos = rex.reg_mmatch->endpos;
     }
     else
     {
-	prog = reg_match->regprog;
-	reg_startp = reg_match->startp;
-	reg_endp = reg_match->endp;
+	prog = rex.reg_match->regprog;
+	rex.reg_startp = rex.reg_match->startp;
+	rex.reg_endp = rex.reg_match->endp;
     }
 
     /* Be paranoid... */
@@ -3430,73 +4229,44 @@ vim_regexec_both(line, col, tm)
     /* Check validity of program. */
     if (prog_magic_wrong())
 	goto theend;
+    rex.reg_prog = prog;
 
     /* If the start column is past the maximum column: no need to try. */
-    if (ireg_maxcol > 0 && col >= ireg_maxcol)
+    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
 	goto theend;
 
-    /* If pattern contains "\c" or "\C": overrule value of ireg_ic */
+    /* If pattern contains "\c" or "\C": overrule value of rex.reg_ic */
     if (prog->regflags & RF_ICASE)
-	ireg_ic = TRUE;
+	rex.reg_ic = TRUE;
     else if (prog->regflags & RF_NOICASE)
-	ireg_ic = FALSE;
+	rex.reg_ic = FALSE;
 
 #ifdef FEAT_MBYTE
-    /* If pattern contains "\Z" overrule value of ireg_icombine */
+    /* If pattern contains "\Z" overrule value of rex.reg_icombine */
     if (prog->regflags & RF_ICOMBINE)
-	ireg_icombine = TRUE;
+	rex.reg_icombine = TRUE;
 #endif
 
     /* If there is a "must appear" string, look for it. */
-    if (prog->regmust != NULL)
-    {
-	int c;
+    if (prog->regmust != NULL && reg_find_must(prog, line + col) == NULL)
+	goto theend;
 
-#ifdef FEAT_MBYTE
-	if (has_mbyte)
-	    c = (*mb_ptr2char)(prog->regmust);
-	else
-#endif
-	    c = *prog->regmust;
-	s = line + col;
+    rex.line = line;
+    rex.lnum = 0;
 
-	/*
-	 * This is used very often, esp. for ":global".  Use three versions of
-	 * the loop to avoid overhead of conditions.
-	 */
-	if (!ireg_ic
-#ifdef FEAT_MBYTE
-		&& !has_mbyte
-#endif
-		)
-	    while ((s = vim_strbyte(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		++s;
-	    }
-#ifdef FEAT_MBYTE
-	else if (!ireg_ic || (!enc_utf8 && mb_char2len(c) > 1))
-	    while ((s = vim_strchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-#endif
-	else
-	    while ((s = cstrchr(s, c)) != NULL)
-	    {
-		if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
-		    break;		/* Found it. */
-		mb_ptr_adv(s);
-	    }
-	if (s == NULL)		/* Not present. */
+    if (prog->regengine == REGENG_NFA)
+    {
+	retval = nfa_regmatch(prog, col, tm);
+	if (!nfa_toobig)
 	    goto theend;
-    }
 
-    regline = line;
-    reglnum = 0;
+	/* The NFA engine needs too much memory for its threads, use the
+	 * backtracking engine instead. */
+	if (REG_MULTI)
+	    line = reg_getline((linenr_T)0);
+	rex.line = line;
+	rex.lnum = 0;
+    }
 
     /* Simplest case: Anchored match need be tried only once. */
     if (prog->reganch)
@@ -3505,13 +4275,13 @@ vim_regexec_both(line, col, tm)
 
 #ifdef FEAT_MBYTE
 	if (has_mbyte)
-	    c = (*mb_ptr2char)(regline + col);
+	    c = (*mb_ptr2char)(rex.line + col);
 	else
 #endif
-	    c = regline[col];
+	    c = rex.line[col];
 	if (prog->regstart == NUL
 		|| prog->regstart == c
-		|| (ireg_ic && ((
+		|| (rex.reg_ic && ((
 #ifdef FEAT_MBYTE
 			(enc_utf8 && utf_fold(prog->regstart) == utf_fold(c)))
 			|| (c < 255 && prog->regstart < 255 &&
@@ -3529,28 +4299,16 @@ vim_regexec_both(line, col, tm)
 	/* Messy cases:  unanchored match. */
 	while (!got_int)
 	{
-	    if (prog->regstart != NUL)
+	    s = reg_skip_start(prog, rex.line + col);
+	    if (s == NULL)
 	    {
-		/* Skip until the char we know it must start with.
-		 * Used often, do some work to avoid call overhead. */
-		if (!ireg_ic
-#ifdef FEAT_MBYTE
-			    && !has_mbyte
-#endif
-			    )
-		    s = vim_strbyte(regline + col, prog->regstart);
-		else
-		    s = cstrchr(regline + col, prog->regstart);
-		if (s == NULL)
-		{
-		    retval = 0;
-		    break;
-		}
-		col = (int)(s - regline);
+		retval = 0;
+		break;
 	    }
+	    col = (int)(s - rex.line);
 
 	    /* Check for maximum column to try. */
-	    if (ireg_maxcol > 0 && col >= ireg_maxcol)
+	    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
 	    {
 		retval = 0;
 		break;
@@ -3561,16 +4319,16 @@ vim_regexec_both(line, col, tm)
 		break;
 
 	    /* if not currently on the first line, get it again */
-	    if (reglnum != 0)
+	    if (rex.lnum != 0)
 	    {
-		reglnum = 0;
-		regline = reg_getline((linenr_T)0);
+		rex.lnum = 0;
+		rex.line = reg_getline((linenr_T)0);
 	    }
-	    if (regline[col] == NUL)
+	    if (rex.line[col] == NUL)
 		break;
 #ifdef FEAT_MBYTE
 	    if (has_mbyte)
-		col += (*mb_ptr2len)(regline + col);
+		col += (*mb_ptr2len)(rex.line + col);
 	    else
 #endif
 		++col;
@@ -3598,10 +4356,284 @@ theend:
 	ga_clear(&regstack);
     if (backpos.ga_maxlen > BACKPOS_INITIAL)
 	ga_clear(&backpos);
+    if (nfa_list[0].ga_maxlen > NFA_LIST_INITIAL)
+	ga_clear(&nfa_list[0]);
+    if (nfa_list[1].ga_maxlen > NFA_LIST_INITIAL)
+	ga_clear(&nfa_list[1]);
+    if (nfa_seen_count_size > NFA_COUNT_INITIAL)
+    {
+	vim_free(nfa_seen_count);
+	nfa_seen_count = NULL;
+	nfa_seen_count_size = 0;
+    }
+
+#ifdef FEAT_EVAL
+    /* reg_toomanysteps() gave the error message.  Inside ":try" the
+     * interrupt would replace the error exception, only keep the error. */
+    if (rex.reg_steps > rex.reg_maxsteps && trylevel > 0)
+	got_int = FALSE;
+#endif
+#ifdef FEAT_PROFILE
+    if (prog != NULL && regstat_on)
+    {
+	profile_end(&start_tm);
+	regstat_add(prog, &start_tm, retval > 0);
+    }
+#endif
 
     return retval;
 }
 
+#if defined(FEAT_PROFILE) || defined(PROTO)
+/*
+ * Find or add the statistics entry for "prog".  Returns NULL when out of
+ * memory.
+ */
+    static regstat_T *
+regstat_find(prog)
+    regprog_T	*prog;
+{
+    hashitem_T	*hi;
+    regstat_T	*rs;
+
+    if (prog->regstat != NULL && prog->regstat_gen == regstat_gen)
+	return prog->regstat;
+
+    hi = hash_find(&regstat_ht, prog->regpat);
+    if (HASHITEM_EMPTY(hi))
+    {
+	rs = (regstat_T *)alloc_clear((unsigned)(sizeof(regstat_T)
+						     + STRLEN(prog->regpat)));
+	if (rs == NULL)
+	    return NULL;
+	STRCPY(rs->rs_pattern, prog->regpat);
+	if (hash_add(&regstat_ht, rs->rs_pattern) == FAIL)
+	{
+	    vim_free(rs);
+	    return NULL;
+	}
+    }
+    else
+	rs = HI2RS(hi);
+    prog->regstat = rs;
+    prog->regstat_gen = regstat_gen;
+    return rs;
+}
+
+/*
+ * Add the counters of the last execution of "prog" to its statistics.
+ * "tm" is the time it took.
+ */
+    static void
+regstat_add(prog, tm, matched)
+    regprog_T	*prog;
+    proftime_T	*tm;
+    int		matched;
+{
+    regstat_T	*rs = regstat_find(prog);
+
+    if (rs == NULL)
+	return;
+    ++rs->rs_calls;
+    if (matched)
+	++rs->rs_matches;
+    rs->rs_steps += rex.reg_steps;
+    rs->rs_backtracks += rex.reg_backtracks;
+    if (rex.reg_steps > rex.reg_maxsteps)
+	++rs->rs_aborted;
+    profile_add(&rs->rs_total, tm);
+    if (profile_cmp(&rs->rs_slowest, tm) > 0)
+	rs->rs_slowest = *tm;
+}
+
+/*
+ * Free all the statistics.  Programs still pointing to an entry notice from
+ * "regstat_gen" that it was freed.
+ */
+    static void
+regstat_clear()
+{
+    hashitem_T	*hi;
+    int		todo;
+
+    if (regstat_ht.ht_array == NULL)
+	return;
+    todo = (int)regstat_ht.ht_used;
+    for (hi = regstat_ht.ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    --todo;
+	    vim_free(HI2RS(hi));
+	}
+    hash_clear(&regstat_ht);
+    hash_init(&regstat_ht);
+    ++regstat_gen;
+}
+
+static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+regstat_compare __ARGS((const void *s1, const void *s2));
+
+/*
+ * Compare two statistics entries for qsort(), the one that used the most
+ * time comes first.
+ */
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+regstat_compare(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    regstat_T	*rs1 = *(regstat_T **)s1;
+    regstat_T	*rs2 = *(regstat_T **)s2;
+
+    return profile_cmp(&rs1->rs_total, &rs2->rs_total);
+}
+
+/*
+ * Return an allocated array with pointers to the statistics entries, sorted
+ * on the time used.  "*countp" is set to the number of entries.
+ * Returns NULL when there are none or out of memory.
+ */
+    static regstat_T **
+regstat_sorted(countp)
+    int		*countp;
+{
+    regstat_T	**list;
+    hashitem_T	*hi;
+    int		todo;
+    int		count = 0;
+
+    *countp = 0;
+    if (regstat_ht.ht_array == NULL || regstat_ht.ht_used == 0)
+	return NULL;
+    list = (regstat_T **)alloc((unsigned)(regstat_ht.ht_used
+						       * sizeof(regstat_T *)));
+    if (list == NULL)
+	return NULL;
+    todo = (int)regstat_ht.ht_used;
+    for (hi = regstat_ht.ht_array; todo > 0; ++hi)
+	if (!HASHITEM_EMPTY(hi))
+	{
+	    --todo;
+	    list[count++] = HI2RS(hi);
+	}
+    qsort((void *)list, (size_t)count, sizeof(regstat_T *), regstat_compare);
+    *countp = count;
+    return list;
+}
+
+/*
+ * ":regstats on": start collecting statistics for executing patterns.
+ * ":regstats off": stop collecting.
+ * ":regstats clear": drop the collected statistics.
+ * ":regstats": list the statistics, the pattern that used the most time
+ * first.
+ */
+    void
+ex_regstats(eap)
+    exarg_T	*eap;
+{
+    char_u	*arg = eap->arg;
+    regstat_T	**list;
+    regstat_T	*rs;
+    int		count;
+    int		i;
+
+    if (STRCMP(arg, "on") == 0)
+    {
+	if (regstat_ht.ht_array == NULL)
+	    hash_init(&regstat_ht);
+	regstat_on = TRUE;
+    }
+    else if (STRCMP(arg, "off") == 0)
+	regstat_on = FALSE;
+    else if (STRCMP(arg, "clear") == 0)
+	regstat_clear();
+    else if (*arg != NUL)
+	EMSG2(_(e_invarg2), arg);
+    else
+    {
+	list = regstat_sorted(&count);
+	if (list == NULL)
+	{
+	    MSG(_("No regexp statistics"));
+	    return;
+	}
+
+	MSG_PUTS_TITLE(_("\n     TOTAL   COUNT   MATCH    SLOWEST      STEPS BACKTRACKS ABORTED  PATTERN"));
+	for (i = 0; i < count && !got_int; ++i)
+	{
+	    rs = list[i];
+	    msg_putchar('\n');
+	    msg_puts((char_u *)profile_msg(&rs->rs_total));
+	    vim_snprintf((char *)IObuff, IOSIZE, " %7ld %7ld ",
+					       rs->rs_calls, rs->rs_matches);
+	    msg_puts(IObuff);
+	    msg_puts((char_u *)profile_msg(&rs->rs_slowest));
+	    vim_snprintf((char *)IObuff, IOSIZE, " %10ld %10ld %7ld  ",
+			   rs->rs_steps, rs->rs_backtracks, rs->rs_aborted);
+	    msg_puts(IObuff);
+	    msg_outtrans(rs->rs_pattern);
+	    out_flush();
+	    ui_breakcheck();
+	}
+	vim_free(list);
+    }
+}
+
+# if defined(FEAT_EVAL) || defined(PROTO)
+/*
+ * Add a Dictionary with the statistics of each pattern to "l", the one that
+ * used the most time first.  Used for regstats().
+ */
+    void
+regstat_list(l)
+    list_T	*l;
+{
+    regstat_T	**list;
+    regstat_T	*rs;
+    dict_T	*dict;
+    int		count;
+    int		i;
+
+    list = regstat_sorted(&count);
+    if (list == NULL)
+	return;
+    for (i = 0; i < count; ++i)
+    {
+	rs = list[i];
+	dict = dict_alloc();
+	if (dict == NULL)
+	    break;
+	dict_add_nr_str(dict, "pattern", 0L, rs->rs_pattern);
+	dict_add_nr_str(dict, "count", rs->rs_calls, NULL);
+	dict_add_nr_str(dict, "match", rs->rs_matches, NULL);
+	dict_add_nr_str(dict, "steps", rs->rs_steps, NULL);
+	dict_add_nr_str(dict, "backtracks", rs->rs_backtracks, NULL);
+	dict_add_nr_str(dict, "aborted", rs->rs_aborted, NULL);
+#  ifdef FEAT_FLOAT
+	dict_add_float(dict, "total",
+			       (float_T)profile_usec(&rs->rs_total) / 1000000.0);
+	dict_add_float(dict, "slowest",
+			     (float_T)profile_usec(&rs->rs_slowest) / 1000000.0);
+#  else
+	dict_add_nr_str(dict, "total", 0L,
+				     (char_u *)profile_msg(&rs->rs_total));
+	dict_add_nr_str(dict, "slowest", 0L,
+				   (char_u *)profile_msg(&rs->rs_slowest));
+#  endif
+	list_append_dict(l, dict);
+    }
+    vim_free(list);
+}
+# endif
+#endif
+
 #ifdef FEAT_SYN_HL
 static reg_extmatch_T *make_extmatch __ARGS((void));
 
@@ -3651,20 +4683,127 @@ unref_extmatch(em)
 #endif
 
 /*
- * regtry - try match of "prog" with at regline["col"].
- * Returns 0 for failure, number of lines contained in the match otherwise.
+ * Find the "regmust" string of "prog" in "s".
+ * Returns a pointer to where it was found, NULL if not present.
  */
-    static long
-regtry(prog, col)
+    static char_u *
+reg_find_must(prog, s)
     regprog_T	*prog;
-    colnr_T	col;
+    char_u	*s;
 {
-    reginput = regline + col;
-    need_clear_subexpr = TRUE;
-#ifdef FEAT_SYN_HL
-    /* Clear the external match subpointers if necessary. */
+    int		c;
+
+#ifdef FEAT_MBYTE
+    if (has_mbyte)
+	c = (*mb_ptr2char)(prog->regmust);
+    else
+#endif
+	c = *prog->regmust;
+
+    /*
+     * This is used very often, esp. for ":global".  Use three versions of
+     * the loop to avoid overhead of conditions.  When case matters a
+     * plain byte search works, except for a double-byte encoding, where a
+     * trail byte may look like another character.  The C library usually
+     * has a very fast strstr().
+     */
+    if (!rex.reg_ic
+#ifdef FEAT_MBYTE
+	    && (!has_mbyte || enc_utf8)
+#endif
+	    )
+	s = (char_u *)strstr((char *)s, (char *)prog->regmust);
+#ifdef FEAT_MBYTE
+    else if (!rex.reg_ic || (!enc_utf8 && mb_char2len(c) > 1))
+	while ((s = vim_strchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
+		break;		/* Found it. */
+	    mb_ptr_adv(s);
+	}
+#endif
+    else
+	while ((s = cstrchr(s, c)) != NULL)
+	{
+	    if (cstrncmp(s, prog->regmust, &prog->regmlen) == 0)
+		break;		/* Found it. */
+	    mb_ptr_adv(s);
+	}
+    return s;
+}
+
+/*
+ * Skip to where a match for "prog" may start in "s": the character it must
+ * start with or one of the bytes it may start with.
+ * Returns NULL when there is no such position in "s".
+ */
+    static char_u *
+reg_skip_start(prog, s)
+    regprog_T	*prog;
+    char_u	*s;
+{
+    char_u	*first;
+
+    if (prog->regstart != NUL)
+    {
+	/* Used often, do some work to avoid call overhead.  An ASCII
+	 * character is never part of a UTF-8 multi-byte character. */
+	if (!rex.reg_ic
+#ifdef FEAT_MBYTE
+		    && (!has_mbyte || (enc_utf8 && prog->regstart < 0x80))
+#endif
+		    )
+	    return vim_strbyte(s, prog->regstart);
+	return cstrchr(s, prog->regstart);
+    }
+
+    if (!(prog->regflags & (rex.reg_ic ? RF_FIRST_IC : RF_FIRST)))
+	return s;
+    first = rex.reg_ic ? prog->regfirst_ic : prog->regfirst;
+#ifdef FEAT_MBYTE
+    if (has_mbyte && !enc_utf8)
+    {
+	/* A trail byte may look like one of the bytes, go by character. */
+	for ( ; *s != NUL; mb_ptr_adv(s))
+	    if (REGFIRST_HAS(first, *s))
+		return s;
+	return NULL;
+    }
+#endif
+    /* In UTF-8 a lead byte is never part of another character, can check
+     * all bytes. */
+    for ( ; *s != NUL; ++s)
+	if (REGFIRST_HAS(first, *s))
+	    return s;
+    return NULL;
+}
+
+/*
+ * Give the error for taking more than 'maxsteppattern' steps.  Must be done
+ * before "got_int" is set, the message would be dropped otherwise.
+ */
+    static void
+reg_toomanysteps()
+{
+    EMSG2(_("E817: Pattern exceeded 'maxsteppattern': %s"),
+							   rex.reg_prog->regpat);
+}
+
+/*
+ * regtry - try match of "prog" with at rex.line["col"].
+ * Returns 0 for failure, number of lines contained in the match otherwise.
+ */
+    static long
+regtry(prog, col)
+    regprog_T	*prog;
+    colnr_T	col;
+{
+    rex.input = rex.line + col;
+    rex.need_clear_subexpr = TRUE;
+#ifdef FEAT_SYN_HL
+    /* Clear the external match subpointers if necessary. */
     if (prog->reghasz == REX_SET)
-	need_clear_zsubexpr = TRUE;
+	rex.need_clear_zsubexpr = TRUE;
 #endif
 
     if (regmatch(prog->program + 1) == 0)
@@ -3673,26 +4812,26 @@ regtry(prog, col)
     cleanup_subexpr();
     if (REG_MULTI)
     {
-	if (reg_startpos[0].lnum < 0)
+	if (rex.reg_startpos[0].lnum < 0)
 	{
-	    reg_startpos[0].lnum = 0;
-	    reg_startpos[0].col = col;
+	    rex.reg_startpos[0].lnum = 0;
+	    rex.reg_startpos[0].col = col;
 	}
-	if (reg_endpos[0].lnum < 0)
+	if (rex.reg_endpos[0].lnum < 0)
 	{
-	    reg_endpos[0].lnum = reglnum;
-	    reg_endpos[0].col = (int)(reginput - regline);
+	    rex.reg_endpos[0].lnum = rex.lnum;
+	    rex.reg_endpos[0].col = (int)(rex.input - rex.line);
 	}
 	else
 	    /* Use line number of "\ze". */
-	    reglnum = reg_endpos[0].lnum;
+	    rex.lnum = rex.reg_endpos[0].lnum;
     }
     else
     {
-	if (reg_startp[0] == NULL)
-	    reg_startp[0] = regline + col;
-	if (reg_endp[0] == NULL)
-	    reg_endp[0] = reginput;
+	if (rex.reg_startp[0] == NULL)
+	    rex.reg_startp[0] = rex.line + col;
+	if (rex.reg_endp[0] == NULL)
+	    rex.reg_endp[0] = rex.input;
     }
 #ifdef FEAT_SYN_HL
     /* Package any found \z(...\) matches for export. Default is none. */
@@ -3710,24 +4849,24 @@ regtry(prog, col)
 	    if (REG_MULTI)
 	    {
 		/* Only accept single line matches. */
-		if (reg_startzpos[i].lnum >= 0
-			&& reg_endzpos[i].lnum == reg_startzpos[i].lnum)
+		if (rex.reg_startzpos[i].lnum >= 0
+			&& rex.reg_endzpos[i].lnum == rex.reg_startzpos[i].lnum)
 		    re_extmatch_out->matches[i] =
-			vim_strnsave(reg_getline(reg_startzpos[i].lnum)
-						       + reg_startzpos[i].col,
-				   reg_endzpos[i].col - reg_startzpos[i].col);
+			vim_strnsave(reg_getline(rex.reg_startzpos[i].lnum)
+						       + rex.reg_startzpos[i].col,
+				   rex.reg_endzpos[i].col - rex.reg_startzpos[i].col);
 	    }
 	    else
 	    {
-		if (reg_startzp[i] != NULL && reg_endzp[i] != NULL)
+		if (rex.reg_startzp[i] != NULL && rex.reg_endzp[i] != NULL)
 		    re_extmatch_out->matches[i] =
-			    vim_strnsave(reg_startzp[i],
-					(int)(reg_endzp[i] - reg_startzp[i]));
+			    vim_strnsave(rex.reg_startzp[i],
+					(int)(rex.reg_endzp[i] - rex.reg_startzp[i]));
 	    }
 	}
     }
 #endif
-    return 1 + reglnum;
+    return 1 + rex.lnum;
 }
 
 #ifdef FEAT_MBYTE
@@ -3739,14 +4878,14 @@ static int reg_prev_class __ARGS((void));
     static int
 reg_prev_class()
 {
-    if (reginput > regline)
-	return mb_get_class(reginput - 1
-				     - (*mb_head_off)(regline, reginput - 1));
+    if (rex.input > rex.line)
+	return mb_get_class(rex.input - 1
+				     - (*mb_head_off)(rex.line, rex.input - 1));
     return -1;
 }
 
 #endif
-#define ADVANCE_REGINPUT() mb_ptr_adv(reginput)
+#define ADVANCE_REGINPUT() mb_ptr_adv(rex.input)
 
 /*
  * The arguments from BRACE_LIMITS are stored here.  They are actually local
@@ -3766,9 +4905,9 @@ static long	bl_maxval;
  * (that don't need to know whether the rest of the match failed) by a nested
  * loop.
  *
- * Returns TRUE when there is a match.  Leaves reginput and reglnum just after
+ * Returns TRUE when there is a match.  Leaves rex.input and rex.lnum just after
  * the last matched character.
- * Returns FALSE when there is no match.  Leaves reginput and reglnum in an
+ * Returns FALSE when there is no match.  Leaves rex.input and rex.lnum in an
  * undefined state!
  */
     static int
@@ -3777,7 +4916,6 @@ regmatch(scan)
 {
   char_u	*next;		/* Next node. */
   int		op;
-  int		c;
   regitem_T	*rp;
   int		no;
   int		status;		/* one of the RA_ values: */
@@ -3820,6 +4958,13 @@ regmatch(scan)
 	    status = RA_FAIL;
 	    break;
 	}
+	/* Abort when taking too many steps. */
+	if (++rex.reg_steps > rex.reg_maxsteps)
+	{
+	    reg_toomanysteps();
+	    status = RA_FAIL;
+	    break;
+	}
 	status = RA_CONT;
 
 #ifdef DEBUG
@@ -3846,1498 +4991,1529 @@ regmatch(scan)
 #endif
 	next = regnext(scan);
 
-	op = OP(scan);
-	/* Check for character class with NL added. */
-	if (!reg_line_lbr && WITH_NL(op) && REG_MULTI
-				&& *reginput == NUL && reglnum <= reg_maxline)
-	{
-	    reg_nextline();
-	}
-	else if (reg_line_lbr && WITH_NL(op) && *reginput == '\n')
-	{
-	    ADVANCE_REGINPUT();
-	}
-	else
+	status = regmatch_item(scan);
+	if (status == 0)
 	{
-	  if (WITH_NL(op))
-	      op -= ADD_NL;
-#ifdef FEAT_MBYTE
-	  if (has_mbyte)
-	      c = (*mb_ptr2char)(reginput);
-	  else
-#endif
-	      c = *reginput;
+	  status = RA_CONT;
+	  op = OP(scan);
 	  switch (op)
 	  {
-	  case BOL:
-	    if (reginput != regline)
-		status = RA_NOMATCH;
+	  case NOTHING:
 	    break;
 
-	  case EOL:
-	    if (c != NUL)
-		status = RA_NOMATCH;
+	  case BACK:
+	    {
+		int		i;
+		backpos_T	*bp;
+
+		/*
+		 * When we run into BACK we need to check if we don't keep
+		 * looping without matching any input.  The second and later
+		 * times a BACK is encountered it fails if the input is still
+		 * at the same position as the previous time.
+		 * The positions are stored in "backpos" and found by the
+		 * current value of "scan", the position in the RE program.
+		 */
+		bp = (backpos_T *)backpos.ga_data;
+		for (i = 0; i < backpos.ga_len; ++i)
+		    if (bp[i].bp_scan == scan)
+			break;
+		if (i == backpos.ga_len)
+		{
+		    /* First time at this BACK, make room to store the pos. */
+		    if (ga_grow(&backpos, 1) == FAIL)
+			status = RA_FAIL;
+		    else
+		    {
+			/* get "ga_data" again, it may have changed */
+			bp = (backpos_T *)backpos.ga_data;
+			bp[i].bp_scan = scan;
+			++backpos.ga_len;
+		    }
+		}
+		else if (reg_save_equal(&bp[i].bp_pos))
+		    /* Still at same position as last time, fail. */
+		    status = RA_NOMATCH;
+
+		if (status != RA_FAIL && status != RA_NOMATCH)
+		    reg_save(&bp[i].bp_pos, &backpos);
+	    }
 	    break;
 
-	  case RE_BOF:
-	    /* We're not at the beginning of the file when below the first
-	     * line where we started, not at the start of the line or we
-	     * didn't start at the first line of the buffer. */
-	    if (reglnum != 0 || reginput != regline
-					  || (REG_MULTI && reg_firstlnum > 1))
-		status = RA_NOMATCH;
+	  case MOPEN + 0:   /* Match start: \zs */
+	  case MOPEN + 1:   /* \( */
+	  case MOPEN + 2:
+	  case MOPEN + 3:
+	  case MOPEN + 4:
+	  case MOPEN + 5:
+	  case MOPEN + 6:
+	  case MOPEN + 7:
+	  case MOPEN + 8:
+	  case MOPEN + 9:
+	    {
+		no = op - MOPEN;
+		cleanup_subexpr();
+		rp = regstack_push(RS_MOPEN, scan);
+		if (rp == NULL)
+		    status = RA_FAIL;
+		else
+		{
+		    rp->rs_no = no;
+		    save_se(&rp->rs_un.sesave, &rex.reg_startpos[no],
+							     &rex.reg_startp[no]);
+		    /* We simply continue and handle the result when done. */
+		}
+	    }
 	    break;
 
-	  case RE_EOF:
-	    if (reglnum != reg_maxline || c != NUL)
-		status = RA_NOMATCH;
+	  case NOPEN:	    /* \%( */
+	  case NCLOSE:	    /* \) after \%( */
+		if (regstack_push(RS_NOPEN, scan) == NULL)
+		    status = RA_FAIL;
+		/* We simply continue and handle the result when done. */
+		break;
+
+#ifdef FEAT_SYN_HL
+	  case ZOPEN + 1:
+	  case ZOPEN + 2:
+	  case ZOPEN + 3:
+	  case ZOPEN + 4:
+	  case ZOPEN + 5:
+	  case ZOPEN + 6:
+	  case ZOPEN + 7:
+	  case ZOPEN + 8:
+	  case ZOPEN + 9:
+	    {
+		no = op - ZOPEN;
+		cleanup_zsubexpr();
+		rp = regstack_push(RS_ZOPEN, scan);
+		if (rp == NULL)
+		    status = RA_FAIL;
+		else
+		{
+		    rp->rs_no = no;
+		    save_se(&rp->rs_un.sesave, &rex.reg_startzpos[no],
+							     &rex.reg_startzp[no]);
+		    /* We simply continue and handle the result when done. */
+		}
+	    }
 	    break;
+#endif
 
-	  case CURSOR:
-	    /* Check if the buffer is in a window and compare the
-	     * reg_win->w_cursor position to the match position. */
-	    if (reg_win == NULL
-		    || (reglnum + reg_firstlnum != reg_win->w_cursor.lnum)
-		    || ((colnr_T)(reginput - regline) != reg_win->w_cursor.col))
-		status = RA_NOMATCH;
+	  case MCLOSE + 0:  /* Match end: \ze */
+	  case MCLOSE + 1:  /* \) */
+	  case MCLOSE + 2:
+	  case MCLOSE + 3:
+	  case MCLOSE + 4:
+	  case MCLOSE + 5:
+	  case MCLOSE + 6:
+	  case MCLOSE + 7:
+	  case MCLOSE + 8:
+	  case MCLOSE + 9:
+	    {
+		no = op - MCLOSE;
+		cleanup_subexpr();
+		rp = regstack_push(RS_MCLOSE, scan);
+		if (rp == NULL)
+		    status = RA_FAIL;
+		else
+		{
+		    rp->rs_no = no;
+		    save_se(&rp->rs_un.sesave, &rex.reg_endpos[no], &rex.reg_endp[no]);
+		    /* We simply continue and handle the result when done. */
+		}
+	    }
 	    break;
 
-	  case RE_MARK:
-	    /* Compare the mark position to the match position.  NOTE: Always
-	     * uses the current buffer. */
+#ifdef FEAT_SYN_HL
+	  case ZCLOSE + 1:  /* \) after \z( */
+	  case ZCLOSE + 2:
+	  case ZCLOSE + 3:
+	  case ZCLOSE + 4:
+	  case ZCLOSE + 5:
+	  case ZCLOSE + 6:
+	  case ZCLOSE + 7:
+	  case ZCLOSE + 8:
+	  case ZCLOSE + 9:
 	    {
-		int	mark = OPERAND(scan)[0];
-		int	cmp = OPERAND(scan)[1];
-		pos_T	*pos;
-
-		pos = getmark(mark, FALSE);
-		if (pos == NULL		     /* mark doesn't exist */
-			|| pos->lnum <= 0    /* mark isn't set (in curbuf) */
-			|| (pos->lnum == reglnum + reg_firstlnum
-				? (pos->col == (colnr_T)(reginput - regline)
-				    ? (cmp == '<' || cmp == '>')
-				    : (pos->col < (colnr_T)(reginput - regline)
-					? cmp != '>'
-					: cmp != '<'))
-				: (pos->lnum < reglnum + reg_firstlnum
-				    ? cmp != '>'
-				    : cmp != '<')))
-		    status = RA_NOMATCH;
+		no = op - ZCLOSE;
+		cleanup_zsubexpr();
+		rp = regstack_push(RS_ZCLOSE, scan);
+		if (rp == NULL)
+		    status = RA_FAIL;
+		else
+		{
+		    rp->rs_no = no;
+		    save_se(&rp->rs_un.sesave, &rex.reg_endzpos[no],
+							      &rex.reg_endzp[no]);
+		    /* We simply continue and handle the result when done. */
+		}
 	    }
 	    break;
+#endif
 
-	  case RE_VISUAL:
-#ifdef FEAT_VISUAL
-	    /* Check if the buffer is the current buffer. and whether the
-	     * position is inside the Visual area. */
-	    if (reg_buf != curbuf || VIsual.lnum == 0)
-		status = RA_NOMATCH;
-	    else
+	  case BACKREF + 1:
+	  case BACKREF + 2:
+	  case BACKREF + 3:
+	  case BACKREF + 4:
+	  case BACKREF + 5:
+	  case BACKREF + 6:
+	  case BACKREF + 7:
+	  case BACKREF + 8:
+	  case BACKREF + 9:
 	    {
-		pos_T	    top, bot;
-		linenr_T    lnum;
-		colnr_T	    col;
-		win_T	    *wp = reg_win == NULL ? curwin : reg_win;
-		int	    mode;
+		int		len;
+		linenr_T	clnum;
+		colnr_T		ccol;
+		char_u		*p;
 
-		if (VIsual_active)
+		no = op - BACKREF;
+		cleanup_subexpr();
+		if (!REG_MULTI)		/* Single-line regexp */
 		{
-		    if (lt(VIsual, wp->w_cursor))
+		    if (rex.reg_startp[no] == NULL || rex.reg_endp[no] == NULL)
 		    {
-			top = VIsual;
-			bot = wp->w_cursor;
+			/* Backref was not set: Match an empty string. */
+			len = 0;
 		    }
 		    else
 		    {
-			top = wp->w_cursor;
-			bot = VIsual;
+			/* Compare current input with back-ref in the same
+			 * line. */
+			len = (int)(rex.reg_endp[no] - rex.reg_startp[no]);
+			if (cstrncmp(rex.reg_startp[no], rex.input, &len) != 0)
+			    status = RA_NOMATCH;
 		    }
-		    mode = VIsual_mode;
 		}
-		else
+		else				/* Multi-line regexp */
 		{
-		    if (lt(curbuf->b_visual.vi_start, curbuf->b_visual.vi_end))
+		    if (rex.reg_startpos[no].lnum < 0 || rex.reg_endpos[no].lnum < 0)
 		    {
-			top = curbuf->b_visual.vi_start;
-			bot = curbuf->b_visual.vi_end;
+			/* Backref was not set: Match an empty string. */
+			len = 0;
 		    }
 		    else
 		    {
-			top = curbuf->b_visual.vi_end;
-			bot = curbuf->b_visual.vi_start;
-		    }
-		    mode = curbuf->b_visual.vi_mode;
-		}
-		lnum = reglnum + reg_firstlnum;
-		col = (colnr_T)(reginput - regline);
-		if (lnum < top.lnum || lnum > bot.lnum)
-		    status = RA_NOMATCH;
-		else if (mode == 'v')
-		{
-		    if ((lnum == top.lnum && col < top.col)
-			    || (lnum == bot.lnum
-					 && col >= bot.col + (*p_sel != 'e')))
-			status = RA_NOMATCH;
-		}
-		else if (mode == Ctrl_V)
-		{
-		    colnr_T	    start, end;
-		    colnr_T	    start2, end2;
-		    colnr_T	    cols;
-
-		    getvvcol(wp, &top, &start, NULL, &end);
-		    getvvcol(wp, &bot, &start2, NULL, &end2);
-		    if (start2 < start)
-			start = start2;
-		    if (end2 > end)
-			end = end2;
-		    if (top.col == MAXCOL || bot.col == MAXCOL)
-			end = MAXCOL;
-		    cols = win_linetabsize(wp,
-				      regline, (colnr_T)(reginput - regline));
-		    if (cols < start || cols > end - (*p_sel == 'e'))
-			status = RA_NOMATCH;
-		}
-	    }
-#else
-	    status = RA_NOMATCH;
-#endif
-	    break;
-
-	  case RE_LNUM:
-	    if (!REG_MULTI || !re_num_cmp((long_u)(reglnum + reg_firstlnum),
-									scan))
-		status = RA_NOMATCH;
-	    break;
+			if (rex.reg_startpos[no].lnum == rex.lnum
+				&& rex.reg_endpos[no].lnum == rex.lnum)
+			{
+			    /* Compare back-ref within the current line. */
+			    len = rex.reg_endpos[no].col - rex.reg_startpos[no].col;
+			    if (cstrncmp(rex.line + rex.reg_startpos[no].col,
+							  rex.input, &len) != 0)
+				status = RA_NOMATCH;
+			}
+			else
+			{
+			    /* Messy situation: Need to compare between two
+			     * lines. */
+			    ccol = rex.reg_startpos[no].col;
+			    clnum = rex.reg_startpos[no].lnum;
+			    for (;;)
+			    {
+				/* Since getting one line may invalidate
+				 * the other, need to make copy.  Slow! */
+				if (rex.line != reg_tofree)
+				{
+				    len = (int)STRLEN(rex.line);
+				    if (reg_tofree == NULL
+						 || len >= (int)reg_tofreelen)
+				    {
+					len += 50;	/* get some extra */
+					vim_free(reg_tofree);
+					reg_tofree = alloc(len);
+					if (reg_tofree == NULL)
+					{
+					    status = RA_FAIL; /* outof memory!*/
+					    break;
+					}
+					reg_tofreelen = len;
+				    }
+				    STRCPY(reg_tofree, rex.line);
+				    rex.input = reg_tofree
+						       + (rex.input - rex.line);
+				    rex.line = reg_tofree;
+				}
 
-	  case RE_COL:
-	    if (!re_num_cmp((long_u)(reginput - regline) + 1, scan))
-		status = RA_NOMATCH;
-	    break;
+				/* Get the line to compare with. */
+				p = reg_getline(clnum);
+				if (clnum == rex.reg_endpos[no].lnum)
+				    len = rex.reg_endpos[no].col - ccol;
+				else
+				    len = (int)STRLEN(p + ccol);
 
-	  case RE_VCOL:
-	    if (!re_num_cmp((long_u)win_linetabsize(
-			    reg_win == NULL ? curwin : reg_win,
-			    regline, (colnr_T)(reginput - regline)) + 1, scan))
-		status = RA_NOMATCH;
-	    break;
+				if (cstrncmp(p + ccol, rex.input, &len) != 0)
+				{
+				    status = RA_NOMATCH;  /* doesn't match */
+				    break;
+				}
+				if (clnum == rex.reg_endpos[no].lnum)
+				    break;		/* match and at end! */
+				if (rex.lnum >= rex.reg_maxline)
+				{
+				    status = RA_NOMATCH;  /* text too short */
+				    break;
+				}
 
-	  case BOW:	/* \<word; reginput points to w */
-	    if (c == NUL)	/* Can't match at end of line */
-		status = RA_NOMATCH;
-#ifdef FEAT_MBYTE
-	    else if (has_mbyte)
-	    {
-		int this_class;
-
-		/* Get class of current and previous char (if it exists). */
-		this_class = mb_get_class(reginput);
-		if (this_class <= 1)
-		    status = RA_NOMATCH;  /* not on a word at all */
-		else if (reg_prev_class() == this_class)
-		    status = RA_NOMATCH;  /* previous char is in same word */
-	    }
-#endif
-	    else
-	    {
-		if (!vim_iswordc(c)
-			|| (reginput > regline && vim_iswordc(reginput[-1])))
-		    status = RA_NOMATCH;
+				/* Advance to next line. */
+				reg_nextline();
+				++clnum;
+				ccol = 0;
+				if (got_int)
+				{
+				    status = RA_FAIL;
+				    break;
+				}
+			    }
+
+			    /* found a match!  Note that rex.line may now point
+			     * to a copy of the line, that should not matter. */
+			}
+		    }
+		}
+
+		/* Matched the backref, skip over it. */
+		rex.input += len;
 	    }
 	    break;
 
-	  case EOW:	/* word\>; reginput points after d */
-	    if (reginput == regline)    /* Can't match at start of line */
-		status = RA_NOMATCH;
-#ifdef FEAT_MBYTE
-	    else if (has_mbyte)
+#ifdef FEAT_SYN_HL
+	  case ZREF + 1:
+	  case ZREF + 2:
+	  case ZREF + 3:
+	  case ZREF + 4:
+	  case ZREF + 5:
+	  case ZREF + 6:
+	  case ZREF + 7:
+	  case ZREF + 8:
+	  case ZREF + 9:
 	    {
-		int this_class, prev_class;
+		int	len;
 
-		/* Get class of current and previous char (if it exists). */
-		this_class = mb_get_class(reginput);
-		prev_class = reg_prev_class();
-		if (this_class == prev_class
-			|| prev_class == 0 || prev_class == 1)
-		    status = RA_NOMATCH;
+		cleanup_zsubexpr();
+		no = op - ZREF;
+		if (re_extmatch_in != NULL
+			&& re_extmatch_in->matches[no] != NULL)
+		{
+		    len = (int)STRLEN(re_extmatch_in->matches[no]);
+		    if (cstrncmp(re_extmatch_in->matches[no],
+							  rex.input, &len) != 0)
+			status = RA_NOMATCH;
+		    else
+			rex.input += len;
+		}
+		else
+		{
+		    /* Backref was not set: Match an empty string. */
+		}
 	    }
+	    break;
 #endif
-	    else
+
+	  case BRANCH:
 	    {
-		if (!vim_iswordc(reginput[-1])
-			|| (reginput[0] != NUL && vim_iswordc(c)))
-		    status = RA_NOMATCH;
+		if (OP(next) != BRANCH) /* No choice. */
+		    next = OPERAND(scan);	/* Avoid recursion. */
+		else
+		{
+		    rp = regstack_push(RS_BRANCH, scan);
+		    if (rp == NULL)
+			status = RA_FAIL;
+		    else
+			status = RA_BREAK;	/* rest is below */
+		}
 	    }
-	    break; /* Matched with EOW */
-
-	  case ANY:
-	    if (c == NUL)
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case IDENT:
-	    if (!vim_isIDc(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case SIDENT:
-	    if (VIM_ISDIGIT(*reginput) || !vim_isIDc(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case KWORD:
-	    if (!vim_iswordp(reginput))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case SKWORD:
-	    if (VIM_ISDIGIT(*reginput) || !vim_iswordp(reginput))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case FNAME:
-	    if (!vim_isfilec(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
 	    break;
 
-	  case SFNAME:
-	    if (VIM_ISDIGIT(*reginput) || !vim_isfilec(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
-
-	  case PRINT:
-	    if (ptr2cells(reginput) != 1)
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  case BRACE_LIMITS:
+	    {
+		if (OP(next) == BRACE_SIMPLE)
+		{
+		    bl_minval = OPERAND_MIN(scan);
+		    bl_maxval = OPERAND_MAX(scan);
+		}
+		else if (OP(next) >= BRACE_COMPLEX
+			&& OP(next) < BRACE_COMPLEX + 10)
+		{
+		    no = OP(next) - BRACE_COMPLEX;
+		    brace_min[no] = OPERAND_MIN(scan);
+		    brace_max[no] = OPERAND_MAX(scan);
+		    brace_count[no] = 0;
+		}
+		else
+		{
+		    EMSG(_(e_internal));	    /* Shouldn't happen */
+		    status = RA_FAIL;
+		}
+	    }
 	    break;
 
-	  case SPRINT:
-	    if (VIM_ISDIGIT(*reginput) || ptr2cells(reginput) != 1)
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
+	  case BRACE_COMPLEX + 0:
+	  case BRACE_COMPLEX + 1:
+	  case BRACE_COMPLEX + 2:
+	  case BRACE_COMPLEX + 3:
+	  case BRACE_COMPLEX + 4:
+	  case BRACE_COMPLEX + 5:
+	  case BRACE_COMPLEX + 6:
+	  case BRACE_COMPLEX + 7:
+	  case BRACE_COMPLEX + 8:
+	  case BRACE_COMPLEX + 9:
+	    {
+		no = op - BRACE_COMPLEX;
+		++brace_count[no];
 
-	  case WHITE:
-	    if (!vim_iswhite(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
+		/* If not matched enough times yet, try one more */
+		if (brace_count[no] <= (brace_min[no] <= brace_max[no]
+					     ? brace_min[no] : brace_max[no]))
+		{
+		    rp = regstack_push(RS_BRCPLX_MORE, scan);
+		    if (rp == NULL)
+			status = RA_FAIL;
+		    else
+		    {
+			rp->rs_no = no;
+			reg_save(&rp->rs_un.regsave, &backpos);
+			next = OPERAND(scan);
+			/* We continue and handle the result when done. */
+		    }
+		    break;
+		}
 
-	  case NWHITE:
-	    if (c == NUL || vim_iswhite(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+		/* If matched enough times, may try matching some more */
+		if (brace_min[no] <= brace_max[no])
+		{
+		    /* Range is the normal way around, use longest match */
+		    if (brace_count[no] <= brace_max[no])
+		    {
+			rp = regstack_push(RS_BRCPLX_LONG, scan);
+			if (rp == NULL)
+			    status = RA_FAIL;
+			else
+			{
+			    rp->rs_no = no;
+			    reg_save(&rp->rs_un.regsave, &backpos);
+			    next = OPERAND(scan);
+			    /* We continue and handle the result when done. */
+			}
+		    }
+		}
+		else
+		{
+		    /* Range is backwards, use shortest match first */
+		    if (brace_count[no] <= brace_min[no])
+		    {
+			rp = regstack_push(RS_BRCPLX_SHORT, scan);
+			if (rp == NULL)
+			    status = RA_FAIL;
+			else
+			{
+			    reg_save(&rp->rs_un.regsave, &backpos);
+			    /* We continue and handle the result when done. */
+			}
+		    }
+		}
+	    }
 	    break;
 
-	  case DIGIT:
-	    if (!ri_digit(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
+	  case BRACE_SIMPLE:
+	  case STAR:
+	  case PLUS:
+	    {
+		regstar_T	rst;
 
-	  case NDIGIT:
-	    if (c == NUL || ri_digit(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
+		/*
+		 * Lookahead to avoid useless match attempts when we know
+		 * what character comes next.
+		 */
+		if (OP(next) == EXACTLY)
+		{
+		    rst.nextb = *OPERAND(next);
+		    if (rex.reg_ic)
+		    {
+			if (MB_ISUPPER(rst.nextb))
+			    rst.nextb_ic = MB_TOLOWER(rst.nextb);
+			else
+			    rst.nextb_ic = MB_TOUPPER(rst.nextb);
+		    }
+		    else
+			rst.nextb_ic = rst.nextb;
+		}
+		else
+		{
+		    rst.nextb = NUL;
+		    rst.nextb_ic = NUL;
+		}
+		if (op != BRACE_SIMPLE)
+		{
+		    rst.minval = (op == STAR) ? 0 : 1;
+		    rst.maxval = MAX_LIMIT;
+		}
+		else
+		{
+		    rst.minval = bl_minval;
+		    rst.maxval = bl_maxval;
+		}
 
-	  case HEX:
-	    if (!ri_hex(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
-	    break;
+		/*
+		 * When maxval > minval, try matching as much as possible, up
+		 * to maxval.  When maxval < minval, try matching at least the
+		 * minimal number (since the range is backwards, that's also
+		 * maxval!).
+		 */
+		rst.count = regrepeat(OPERAND(scan), rst.maxval);
+		if (got_int)
+		{
+		    status = RA_FAIL;
+		    break;
+		}
+		if (rst.minval <= rst.maxval
+			  ? rst.count >= rst.minval : rst.count >= rst.maxval)
+		{
+		    /* It could match.  Prepare for trying to match what
+		     * follows.  The code is below.  Parameters are stored in
+		     * a regstar_T on the regstack. */
+		    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
+		    {
+			EMSG(_(e_maxmempat));
+			status = RA_FAIL;
+		    }
+		    else if (ga_grow(&regstack, sizeof(regstar_T)) == FAIL)
+			status = RA_FAIL;
+		    else
+		    {
+			regstack.ga_len += sizeof(regstar_T);
+			rp = regstack_push(rst.minval <= rst.maxval
+					? RS_STAR_LONG : RS_STAR_SHORT, scan);
+			if (rp == NULL)
+			    status = RA_FAIL;
+			else
+			{
+			    *(((regstar_T *)rp) - 1) = rst;
+			    status = RA_BREAK;	    /* skip the restore bits */
+			}
+		    }
+		}
+		else
+		    status = RA_NOMATCH;
 
-	  case NHEX:
-	    if (c == NUL || ri_hex(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	    }
 	    break;
 
-	  case OCTAL:
-	    if (!ri_octal(c))
-		status = RA_NOMATCH;
+	  case NOMATCH:
+	  case MATCH:
+	  case SUBPAT:
+	    rp = regstack_push(RS_NOMATCH, scan);
+	    if (rp == NULL)
+		status = RA_FAIL;
 	    else
-		ADVANCE_REGINPUT();
+	    {
+		rp->rs_no = op;
+		reg_save(&rp->rs_un.regsave, &backpos);
+		next = OPERAND(scan);
+		/* We continue and handle the result when done. */
+	    }
 	    break;
 
-	  case NOCTAL:
-	    if (c == NUL || ri_octal(c))
-		status = RA_NOMATCH;
+	  case BEHIND:
+	  case NOBEHIND:
+	    /* Need a bit of room to store extra positions. */
+	    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
+	    {
+		EMSG(_(e_maxmempat));
+		status = RA_FAIL;
+	    }
+	    else if (ga_grow(&regstack, sizeof(regbehind_T)) == FAIL)
+		status = RA_FAIL;
 	    else
-		ADVANCE_REGINPUT();
-	    break;
+	    {
+		regstack.ga_len += sizeof(regbehind_T);
+		rp = regstack_push(RS_BEHIND1, scan);
+		if (rp == NULL)
+		    status = RA_FAIL;
+		else
+		{
+		    /* Need to save the subexpr to be able to restore them
+		     * when there is a match but we don't use it. */
+		    save_subexpr(((regbehind_T *)rp) - 1);
 
-	  case WORD:
-	    if (!ri_word(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+		    rp->rs_no = op;
+		    reg_save(&rp->rs_un.regsave, &backpos);
+		    /* First try if what follows matches.  If it does then we
+		     * check the behind match by looping. */
+		}
+	    }
 	    break;
 
-	  case NWORD:
-	    if (c == NUL || ri_word(c))
+	  case BHPOS:
+	    if (REG_MULTI)
+	    {
+		if (behind_pos.rs_u.pos.col != (colnr_T)(rex.input - rex.line)
+			|| behind_pos.rs_u.pos.lnum != rex.lnum)
+		    status = RA_NOMATCH;
+	    }
+	    else if (behind_pos.rs_u.ptr != rex.input)
 		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
 	    break;
 
-	  case HEAD:
-	    if (!ri_head(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  case END:
+	    status = RA_MATCH;	/* Success! */
 	    break;
 
-	  case NHEAD:
-	    if (c == NUL || ri_head(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  default:
+	    EMSG(_(e_re_corr));
+#ifdef DEBUG
+	    printf("Illegal op code %d\n", op);
+#endif
+	    status = RA_FAIL;
 	    break;
+	  }
+	}
 
-	  case ALPHA:
-	    if (!ri_alpha(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	/* If we can't continue sequentially, break the inner loop. */
+	if (status != RA_CONT)
 	    break;
 
-	  case NALPHA:
-	    if (c == NUL || ri_alpha(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	/* Continue in inner loop, advance to next item. */
+	scan = next;
+
+    } /* end of inner loop */
+
+    /*
+     * If there is something on the regstack execute the code for the state.
+     * If the state is popped then loop and use the older state.
+     */
+    while (regstack.ga_len > 0 && status != RA_FAIL)
+    {
+	rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
+	switch (rp->rs_state)
+	{
+	  case RS_NOPEN:
+	    /* Result is passed on as-is, simply pop the state. */
+	    regstack_pop(&scan);
 	    break;
 
-	  case LOWER:
-	    if (!ri_lower(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  case RS_MOPEN:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+		restore_se(&rp->rs_un.sesave, &rex.reg_startpos[rp->rs_no],
+						  &rex.reg_startp[rp->rs_no]);
+	    regstack_pop(&scan);
 	    break;
 
-	  case NLOWER:
-	    if (c == NUL || ri_lower(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+#ifdef FEAT_SYN_HL
+	  case RS_ZOPEN:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+		restore_se(&rp->rs_un.sesave, &rex.reg_startzpos[rp->rs_no],
+						 &rex.reg_startzp[rp->rs_no]);
+	    regstack_pop(&scan);
 	    break;
+#endif
 
-	  case UPPER:
-	    if (!ri_upper(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  case RS_MCLOSE:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+		restore_se(&rp->rs_un.sesave, &rex.reg_endpos[rp->rs_no],
+						    &rex.reg_endp[rp->rs_no]);
+	    regstack_pop(&scan);
 	    break;
 
-	  case NUPPER:
-	    if (c == NUL || ri_upper(c))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+#ifdef FEAT_SYN_HL
+	  case RS_ZCLOSE:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+		restore_se(&rp->rs_un.sesave, &rex.reg_endzpos[rp->rs_no],
+						   &rex.reg_endzp[rp->rs_no]);
+	    regstack_pop(&scan);
 	    break;
+#endif
 
-	  case EXACTLY:
+	  case RS_BRANCH:
+	    if (status == RA_MATCH)
+		/* this branch matched, use it */
+		regstack_pop(&scan);
+	    else
 	    {
-		int	len;
-		char_u	*opnd;
-
-		opnd = OPERAND(scan);
-		/* Inline the first byte, for speed. */
-		if (*opnd != *reginput
-			&& (!ireg_ic || (
-#ifdef FEAT_MBYTE
-			    !enc_utf8 &&
-#endif
-			    MB_TOLOWER(*opnd) != MB_TOLOWER(*reginput))))
-		    status = RA_NOMATCH;
-		else if (*opnd == NUL)
+		if (status != RA_BREAK)
+		{
+		    /* After a non-matching branch: try next one. */
+		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    scan = rp->rs_scan;
+		}
+		if (scan == NULL || OP(scan) != BRANCH)
 		{
-		    /* match empty string always works; happens when "~" is
-		     * empty. */
+		    /* no more branches, didn't find a match */
+		    status = RA_NOMATCH;
+		    regstack_pop(&scan);
 		}
-		else if (opnd[1] == NUL
-#ifdef FEAT_MBYTE
-			    && !(enc_utf8 && ireg_ic)
-#endif
-			)
-		    ++reginput;		/* matched a single char */
 		else
 		{
-		    len = (int)STRLEN(opnd);
-		    /* Need to match first byte again for multi-byte. */
-		    if (cstrncmp(opnd, reginput, &len) != 0)
-			status = RA_NOMATCH;
-#ifdef FEAT_MBYTE
-		    /* Check for following composing character. */
-		    else if (enc_utf8
-			       && UTF_COMPOSINGLIKE(reginput, reginput + len))
-		    {
-			/* raaron: This code makes a composing character get
-			 * ignored, which is the correct behavior (sometimes)
-			 * for voweled Hebrew texts. */
-			if (!ireg_icombine)
-			    status = RA_NOMATCH;
-		    }
-#endif
-		    else
-			reginput += len;
+		    /* Prepare to try a branch. */
+		    rp->rs_scan = regnext(scan);
+		    reg_save(&rp->rs_un.regsave, &backpos);
+		    scan = OPERAND(scan);
 		}
 	    }
 	    break;
 
-	  case ANYOF:
-	  case ANYBUT:
-	    if (c == NUL)
-		status = RA_NOMATCH;
-	    else if ((cstrchr(OPERAND(scan), c) == NULL) == (op == ANYOF))
-		status = RA_NOMATCH;
-	    else
-		ADVANCE_REGINPUT();
+	  case RS_BRCPLX_MORE:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+	    {
+		reg_restore(&rp->rs_un.regsave, &backpos);
+		--brace_count[rp->rs_no];	/* decrement match count */
+	    }
+	    regstack_pop(&scan);
 	    break;
 
-#ifdef FEAT_MBYTE
-	  case MULTIBYTECODE:
-	    if (has_mbyte)
+	  case RS_BRCPLX_LONG:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
 	    {
-		int	i, len;
-		char_u	*opnd;
-		int	opndc = 0, inpc;
-
-		opnd = OPERAND(scan);
-		/* Safety check (just in case 'encoding' was changed since
-		 * compiling the program). */
-		if ((len = (*mb_ptr2len)(opnd)) < 2)
-		{
-		    status = RA_NOMATCH;
-		    break;
-		}
-		if (enc_utf8)
-		    opndc = mb_ptr2char(opnd);
-		if (enc_utf8 && utf_iscomposing(opndc))
-		{
-		    /* When only a composing char is given match at any
-		     * position where that composing char appears. */
-		    status = RA_NOMATCH;
-		    for (i = 0; reginput[i] != NUL; i += utf_char2len(inpc))
-		    {
-			inpc = mb_ptr2char(reginput + i);
-			if (!utf_iscomposing(inpc))
-			{
-			    if (i > 0)
-				break;
-			}
-			else if (opndc == inpc)
-			{
-			    /* Include all following composing chars. */
-			    len = i + mb_ptr2len(reginput + i);
-			    status = RA_MATCH;
-			    break;
-			}
-		    }
-		}
-		else
-		    for (i = 0; i < len; ++i)
-			if (opnd[i] != reginput[i])
-			{
-			    status = RA_NOMATCH;
-			    break;
-			}
-		reginput += len;
+		/* There was no match, but we did find enough matches. */
+		reg_restore(&rp->rs_un.regsave, &backpos);
+		--brace_count[rp->rs_no];
+		/* continue with the items after "\{}" */
+		status = RA_CONT;
 	    }
-	    else
-		status = RA_NOMATCH;
-	    break;
-#endif
-
-	  case NOTHING:
+	    regstack_pop(&scan);
+	    if (status == RA_CONT)
+		scan = regnext(scan);
 	    break;
 
-	  case BACK:
+	  case RS_BRCPLX_SHORT:
+	    /* Pop the state.  Restore pointers when there is no match. */
+	    if (status == RA_NOMATCH)
+		/* There was no match, try to match one more item. */
+		reg_restore(&rp->rs_un.regsave, &backpos);
+	    regstack_pop(&scan);
+	    if (status == RA_NOMATCH)
 	    {
-		int		i;
-		backpos_T	*bp;
-
-		/*
-		 * When we run into BACK we need to check if we don't keep
-		 * looping without matching any input.  The second and later
-		 * times a BACK is encountered it fails if the input is still
-		 * at the same position as the previous time.
-		 * The positions are stored in "backpos" and found by the
-		 * current value of "scan", the position in the RE program.
-		 */
-		bp = (backpos_T *)backpos.ga_data;
-		for (i = 0; i < backpos.ga_len; ++i)
-		    if (bp[i].bp_scan == scan)
-			break;
-		if (i == backpos.ga_len)
-		{
-		    /* First time at this BACK, make room to store the pos. */
-		    if (ga_grow(&backpos, 1) == FAIL)
-			status = RA_FAIL;
-		    else
-		    {
-			/* get "ga_data" again, it may have changed */
-			bp = (backpos_T *)backpos.ga_data;
-			bp[i].bp_scan = scan;
-			++backpos.ga_len;
-		    }
-		}
-		else if (reg_save_equal(&bp[i].bp_pos))
-		    /* Still at same position as last time, fail. */
-		    status = RA_NOMATCH;
-
-		if (status != RA_FAIL && status != RA_NOMATCH)
-		    reg_save(&bp[i].bp_pos, &backpos);
+		scan = OPERAND(scan);
+		status = RA_CONT;
 	    }
 	    break;
 
-	  case MOPEN + 0:   /* Match start: \zs */
-	  case MOPEN + 1:   /* \( */
-	  case MOPEN + 2:
-	  case MOPEN + 3:
-	  case MOPEN + 4:
-	  case MOPEN + 5:
-	  case MOPEN + 6:
-	  case MOPEN + 7:
-	  case MOPEN + 8:
-	  case MOPEN + 9:
+	  case RS_NOMATCH:
+	    /* Pop the state.  If the operand matches for NOMATCH or
+	     * doesn't match for MATCH/SUBPAT, we fail.  Otherwise backup,
+	     * except for SUBPAT, and continue with the next item. */
+	    if (status == (rp->rs_no == NOMATCH ? RA_MATCH : RA_NOMATCH))
+		status = RA_NOMATCH;
+	    else
 	    {
-		no = op - MOPEN;
-		cleanup_subexpr();
-		rp = regstack_push(RS_MOPEN, scan);
-		if (rp == NULL)
-		    status = RA_FAIL;
-		else
-		{
-		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_startpos[no],
-							     &reg_startp[no]);
-		    /* We simply continue and handle the result when done. */
-		}
+		status = RA_CONT;
+		if (rp->rs_no != SUBPAT)	/* zero-width */
+		    reg_restore(&rp->rs_un.regsave, &backpos);
 	    }
+	    regstack_pop(&scan);
+	    if (status == RA_CONT)
+		scan = regnext(scan);
 	    break;
 
-	  case NOPEN:	    /* \%( */
-	  case NCLOSE:	    /* \) after \%( */
-		if (regstack_push(RS_NOPEN, scan) == NULL)
-		    status = RA_FAIL;
-		/* We simply continue and handle the result when done. */
-		break;
-
-#ifdef FEAT_SYN_HL
-	  case ZOPEN + 1:
-	  case ZOPEN + 2:
-	  case ZOPEN + 3:
-	  case ZOPEN + 4:
-	  case ZOPEN + 5:
-	  case ZOPEN + 6:
-	  case ZOPEN + 7:
-	  case ZOPEN + 8:
-	  case ZOPEN + 9:
+	  case RS_BEHIND1:
+	    if (status == RA_NOMATCH)
 	    {
-		no = op - ZOPEN;
-		cleanup_zsubexpr();
-		rp = regstack_push(RS_ZOPEN, scan);
-		if (rp == NULL)
-		    status = RA_FAIL;
-		else
-		{
-		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_startzpos[no],
-							     &reg_startzp[no]);
-		    /* We simply continue and handle the result when done. */
-		}
+		regstack_pop(&scan);
+		regstack.ga_len -= sizeof(regbehind_T);
 	    }
-	    break;
-#endif
-
-	  case MCLOSE + 0:  /* Match end: \ze */
-	  case MCLOSE + 1:  /* \) */
-	  case MCLOSE + 2:
-	  case MCLOSE + 3:
-	  case MCLOSE + 4:
-	  case MCLOSE + 5:
-	  case MCLOSE + 6:
-	  case MCLOSE + 7:
-	  case MCLOSE + 8:
-	  case MCLOSE + 9:
+	    else
 	    {
-		no = op - MCLOSE;
-		cleanup_subexpr();
-		rp = regstack_push(RS_MCLOSE, scan);
-		if (rp == NULL)
-		    status = RA_FAIL;
-		else
-		{
-		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_endpos[no], &reg_endp[no]);
-		    /* We simply continue and handle the result when done. */
-		}
+		/* The stuff after BEHIND/NOBEHIND matches.  Now try if
+		 * the behind part does (not) match before the current
+		 * position in the input.  This must be done at every
+		 * position in the input and checking if the match ends at
+		 * the current position. */
+
+		/* save the position after the found match for next */
+		reg_save(&(((regbehind_T *)rp) - 1)->save_after, &backpos);
+
+		/* start looking for a match with operand at the current
+		 * position.  Go back one character until we find the
+		 * result, hitting the start of the line or the previous
+		 * line (for multi-line matching).
+		 * Set behind_pos to where the match should end, BHPOS
+		 * will match it.  Save the current value. */
+		(((regbehind_T *)rp) - 1)->save_behind = behind_pos;
+		behind_pos = rp->rs_un.regsave;
+
+		rp->rs_state = RS_BEHIND2;
+
+		reg_restore(&rp->rs_un.regsave, &backpos);
+		scan = OPERAND(rp->rs_scan);
 	    }
 	    break;
 
-#ifdef FEAT_SYN_HL
-	  case ZCLOSE + 1:  /* \) after \z( */
-	  case ZCLOSE + 2:
-	  case ZCLOSE + 3:
-	  case ZCLOSE + 4:
-	  case ZCLOSE + 5:
-	  case ZCLOSE + 6:
-	  case ZCLOSE + 7:
-	  case ZCLOSE + 8:
-	  case ZCLOSE + 9:
+	  case RS_BEHIND2:
+	    /*
+	     * Looping for BEHIND / NOBEHIND match.
+	     */
+	    if (status == RA_MATCH && reg_save_equal(&behind_pos))
 	    {
-		no = op - ZCLOSE;
-		cleanup_zsubexpr();
-		rp = regstack_push(RS_ZCLOSE, scan);
-		if (rp == NULL)
-		    status = RA_FAIL;
+		/* found a match that ends where "next" started */
+		behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+		if (rp->rs_no == BEHIND)
+		    reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
+								    &backpos);
 		else
 		{
-		    rp->rs_no = no;
-		    save_se(&rp->rs_un.sesave, &reg_endzpos[no],
-							      &reg_endzp[no]);
-		    /* We simply continue and handle the result when done. */
+		    /* But we didn't want a match.  Need to restore the
+		     * subexpr, because what follows matched, so they have
+		     * been set. */
+		    status = RA_NOMATCH;
+		    restore_subexpr(((regbehind_T *)rp) - 1);
 		}
+		regstack_pop(&scan);
+		regstack.ga_len -= sizeof(regbehind_T);
 	    }
-	    break;
-#endif
-
-	  case BACKREF + 1:
-	  case BACKREF + 2:
-	  case BACKREF + 3:
-	  case BACKREF + 4:
-	  case BACKREF + 5:
-	  case BACKREF + 6:
-	  case BACKREF + 7:
-	  case BACKREF + 8:
-	  case BACKREF + 9:
+	    else
 	    {
-		int		len;
-		linenr_T	clnum;
-		colnr_T		ccol;
-		char_u		*p;
-
-		no = op - BACKREF;
-		cleanup_subexpr();
-		if (!REG_MULTI)		/* Single-line regexp */
+		/* No match or a match that doesn't end where we want it: Go
+		 * back one character.  May go to previous line once. */
+		no = OK;
+		if (REG_MULTI)
 		{
-		    if (reg_startp[no] == NULL || reg_endp[no] == NULL)
+		    if (rp->rs_un.regsave.rs_u.pos.col == 0)
 		    {
-			/* Backref was not set: Match an empty string. */
-			len = 0;
+			if (rp->rs_un.regsave.rs_u.pos.lnum
+					< behind_pos.rs_u.pos.lnum
+				|| reg_getline(
+					--rp->rs_un.regsave.rs_u.pos.lnum)
+								  == NULL)
+			    no = FAIL;
+			else
+			{
+			    reg_restore(&rp->rs_un.regsave, &backpos);
+			    rp->rs_un.regsave.rs_u.pos.col =
+						 (colnr_T)STRLEN(rex.line);
+			}
 		    }
 		    else
+			--rp->rs_un.regsave.rs_u.pos.col;
+		}
+		else
+		{
+		    if (rp->rs_un.regsave.rs_u.ptr == rex.line)
+			no = FAIL;
+		    else
+			--rp->rs_un.regsave.rs_u.ptr;
+		}
+		if (no == OK)
+		{
+		    /* Advanced, prepare for finding match again. */
+		    reg_restore(&rp->rs_un.regsave, &backpos);
+		    scan = OPERAND(rp->rs_scan);
+		    if (status == RA_MATCH)
 		    {
-			/* Compare current input with back-ref in the same
-			 * line. */
-			len = (int)(reg_endp[no] - reg_startp[no]);
-			if (cstrncmp(reg_startp[no], reginput, &len) != 0)
-			    status = RA_NOMATCH;
+			/* We did match, so subexpr may have been changed,
+			 * need to restore them for the next try. */
+			status = RA_NOMATCH;
+			restore_subexpr(((regbehind_T *)rp) - 1);
 		    }
 		}
-		else				/* Multi-line regexp */
+		else
 		{
-		    if (reg_startpos[no].lnum < 0 || reg_endpos[no].lnum < 0)
+		    /* Can't advance.  For NOBEHIND that's a match. */
+		    behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
+		    if (rp->rs_no == NOBEHIND)
 		    {
-			/* Backref was not set: Match an empty string. */
-			len = 0;
+			reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
+								    &backpos);
+			status = RA_MATCH;
 		    }
 		    else
 		    {
-			if (reg_startpos[no].lnum == reglnum
-				&& reg_endpos[no].lnum == reglnum)
-			{
-			    /* Compare back-ref within the current line. */
-			    len = reg_endpos[no].col - reg_startpos[no].col;
-			    if (cstrncmp(regline + reg_startpos[no].col,
-							  reginput, &len) != 0)
-				status = RA_NOMATCH;
-			}
-			else
+			/* We do want a proper match.  Need to restore the
+			 * subexpr if we had a match, because they may have
+			 * been set. */
+			if (status == RA_MATCH)
 			{
-			    /* Messy situation: Need to compare between two
-			     * lines. */
-			    ccol = reg_startpos[no].col;
-			    clnum = reg_startpos[no].lnum;
-			    for (;;)
-			    {
-				/* Since getting one line may invalidate
-				 * the other, need to make copy.  Slow! */
-				if (regline != reg_tofree)
-				{
-				    len = (int)STRLEN(regline);
-				    if (reg_tofree == NULL
-						 || len >= (int)reg_tofreelen)
-				    {
-					len += 50;	/* get some extra */
-					vim_free(reg_tofree);
-					reg_tofree = alloc(len);
-					if (reg_tofree == NULL)
-					{
-					    status = RA_FAIL; /* outof memory!*/
-					    break;
-					}
-					reg_tofreelen = len;
-				    }
-				    STRCPY(reg_tofree, regline);
-				    reginput = reg_tofree
-						       + (reginput - regline);
-				    regline = reg_tofree;
-				}
-
-				/* Get the line to compare with. */
-				p = reg_getline(clnum);
-				if (clnum == reg_endpos[no].lnum)
-				    len = reg_endpos[no].col - ccol;
-				else
-				    len = (int)STRLEN(p + ccol);
-
-				if (cstrncmp(p + ccol, reginput, &len) != 0)
-				{
-				    status = RA_NOMATCH;  /* doesn't match */
-				    break;
-				}
-				if (clnum == reg_endpos[no].lnum)
-				    break;		/* match and at end! */
-				if (reglnum >= reg_maxline)
-				{
-				    status = RA_NOMATCH;  /* text too short */
-				    break;
-				}
-
-				/* Advance to next line. */
-				reg_nextline();
-				++clnum;
-				ccol = 0;
-				if (got_int)
-				{
-				    status = RA_FAIL;
-				    break;
-				}
-			    }
-
-			    /* found a match!  Note that regline may now point
-			     * to a copy of the line, that should not matter. */
+			    status = RA_NOMATCH;
+			    restore_subexpr(((regbehind_T *)rp) - 1);
 			}
 		    }
+		    regstack_pop(&scan);
+		    regstack.ga_len -= sizeof(regbehind_T);
 		}
-
-		/* Matched the backref, skip over it. */
-		reginput += len;
 	    }
 	    break;
 
-#ifdef FEAT_SYN_HL
-	  case ZREF + 1:
-	  case ZREF + 2:
-	  case ZREF + 3:
-	  case ZREF + 4:
-	  case ZREF + 5:
-	  case ZREF + 6:
-	  case ZREF + 7:
-	  case ZREF + 8:
-	  case ZREF + 9:
+	  case RS_STAR_LONG:
+	  case RS_STAR_SHORT:
 	    {
-		int	len;
+		regstar_T	    *rst = ((regstar_T *)rp) - 1;
 
-		cleanup_zsubexpr();
-		no = op - ZREF;
-		if (re_extmatch_in != NULL
-			&& re_extmatch_in->matches[no] != NULL)
-		{
-		    len = (int)STRLEN(re_extmatch_in->matches[no]);
-		    if (cstrncmp(re_extmatch_in->matches[no],
-							  reginput, &len) != 0)
-			status = RA_NOMATCH;
-		    else
-			reginput += len;
-		}
-		else
+		if (status == RA_MATCH)
 		{
-		    /* Backref was not set: Match an empty string. */
+		    regstack_pop(&scan);
+		    regstack.ga_len -= sizeof(regstar_T);
+		    break;
 		}
-	    }
-	    break;
-#endif
 
-	  case BRANCH:
-	    {
-		if (OP(next) != BRANCH) /* No choice. */
-		    next = OPERAND(scan);	/* Avoid recursion. */
-		else
+		/* Tried once already, restore input pointers. */
+		if (status != RA_BREAK)
+		    reg_restore(&rp->rs_un.regsave, &backpos);
+
+		/* Repeat until we found a position where it could match. */
+		for (;;)
 		{
-		    rp = regstack_push(RS_BRANCH, scan);
-		    if (rp == NULL)
-			status = RA_FAIL;
+		    if (status != RA_BREAK)
+		    {
+			/* Tried first position already, advance. */
+			++rex.reg_backtracks;
+			if (rp->rs_state == RS_STAR_LONG)
+			{
+			    /* Trying for longest match, but couldn't or
+			     * didn't match -- back up one char. */
+			    if (--rst->count < rst->minval)
+				break;
+			    if (rex.input == rex.line)
+			    {
+				/* backup to last char of previous line */
+				--rex.lnum;
+				rex.line = reg_getline(rex.lnum);
+				/* Just in case regrepeat() didn't count
+				 * right. */
+				if (rex.line == NULL)
+				    break;
+				rex.input = rex.line + STRLEN(rex.line);
+				fast_breakcheck();
+			    }
+			    else
+				mb_ptr_back(rex.line, rex.input);
+			}
+			else
+			{
+			    /* Range is backwards, use shortest match first.
+			     * Careful: maxval and minval are exchanged!
+			     * Couldn't or didn't match: try advancing one
+			     * char. */
+			    if (rst->count == rst->minval
+				  || regrepeat(OPERAND(rp->rs_scan), 1L) == 0)
+				break;
+			    ++rst->count;
+			}
+			if (got_int)
+			    break;
+		    }
 		    else
-			status = RA_BREAK;	/* rest is below */
-		}
-	    }
-	    break;
+			status = RA_NOMATCH;
 
-	  case BRACE_LIMITS:
-	    {
-		if (OP(next) == BRACE_SIMPLE)
-		{
-		    bl_minval = OPERAND_MIN(scan);
-		    bl_maxval = OPERAND_MAX(scan);
-		}
-		else if (OP(next) >= BRACE_COMPLEX
-			&& OP(next) < BRACE_COMPLEX + 10)
-		{
-		    no = OP(next) - BRACE_COMPLEX;
-		    brace_min[no] = OPERAND_MIN(scan);
-		    brace_max[no] = OPERAND_MAX(scan);
-		    brace_count[no] = 0;
+		    /* If it could match, try it. */
+		    if (rst->nextb == NUL || *rex.input == rst->nextb
+					     || *rex.input == rst->nextb_ic)
+		    {
+			reg_save(&rp->rs_un.regsave, &backpos);
+			scan = regnext(rp->rs_scan);
+			status = RA_CONT;
+			break;
+		    }
 		}
-		else
+		if (status != RA_CONT)
 		{
-		    EMSG(_(e_internal));	    /* Shouldn't happen */
-		    status = RA_FAIL;
+		    /* Failed. */
+		    regstack_pop(&scan);
+		    regstack.ga_len -= sizeof(regstar_T);
+		    status = RA_NOMATCH;
 		}
 	    }
 	    break;
+	}
 
-	  case BRACE_COMPLEX + 0:
-	  case BRACE_COMPLEX + 1:
-	  case BRACE_COMPLEX + 2:
-	  case BRACE_COMPLEX + 3:
-	  case BRACE_COMPLEX + 4:
-	  case BRACE_COMPLEX + 5:
-	  case BRACE_COMPLEX + 6:
-	  case BRACE_COMPLEX + 7:
-	  case BRACE_COMPLEX + 8:
-	  case BRACE_COMPLEX + 9:
-	    {
-		no = op - BRACE_COMPLEX;
-		++brace_count[no];
-
-		/* If not matched enough times yet, try one more */
-		if (brace_count[no] <= (brace_min[no] <= brace_max[no]
-					     ? brace_min[no] : brace_max[no]))
-		{
-		    rp = regstack_push(RS_BRCPLX_MORE, scan);
-		    if (rp == NULL)
-			status = RA_FAIL;
-		    else
-		    {
-			rp->rs_no = no;
-			reg_save(&rp->rs_un.regsave, &backpos);
-			next = OPERAND(scan);
-			/* We continue and handle the result when done. */
-		    }
-		    break;
-		}
+	/* If we want to continue the inner loop or didn't pop a state
+	 * continue matching loop */
+	if (status == RA_CONT || rp == (regitem_T *)
+			     ((char *)regstack.ga_data + regstack.ga_len) - 1)
+	    break;
+    }
 
-		/* If matched enough times, may try matching some more */
-		if (brace_min[no] <= brace_max[no])
-		{
-		    /* Range is the normal way around, use longest match */
-		    if (brace_count[no] <= brace_max[no])
-		    {
-			rp = regstack_push(RS_BRCPLX_LONG, scan);
-			if (rp == NULL)
-			    status = RA_FAIL;
-			else
-			{
-			    rp->rs_no = no;
-			    reg_save(&rp->rs_un.regsave, &backpos);
-			    next = OPERAND(scan);
-			    /* We continue and handle the result when done. */
-			}
-		    }
-		}
-		else
-		{
-		    /* Range is backwards, use shortest match first */
-		    if (brace_count[no] <= brace_min[no])
-		    {
-			rp = regstack_push(RS_BRCPLX_SHORT, scan);
-			if (rp == NULL)
-			    status = RA_FAIL;
-			else
-			{
-			    reg_save(&rp->rs_un.regsave, &backpos);
-			    /* We continue and handle the result when done. */
-			}
-		    }
-		}
-	    }
-	    break;
+    /* May need to continue with the inner loop, starting at "scan". */
+    if (status == RA_CONT)
+	continue;
 
-	  case BRACE_SIMPLE:
-	  case STAR:
-	  case PLUS:
-	    {
-		regstar_T	rst;
+    /*
+     * If the regstack is empty or something failed we are done.
+     */
+    if (regstack.ga_len == 0 || status == RA_FAIL)
+    {
+	if (scan == NULL)
+	{
+	    /*
+	     * We get here only if there's trouble -- normally "case END" is
+	     * the terminating point.
+	     */
+	    EMSG(_(e_re_corr));
+#ifdef DEBUG
+	    printf("Premature EOL\n");
+#endif
+	}
+	if (status == RA_FAIL)
+	    got_int = TRUE;
+	return (status == RA_MATCH);
+    }
 
-		/*
-		 * Lookahead to avoid useless match attempts when we know
-		 * what character comes next.
-		 */
-		if (OP(next) == EXACTLY)
+  } /* End of loop until the regstack is empty. */
+
+  /* NOTREACHED */
+}
+
+/*
+ * Match the single item "scan" at rex.input: a zero-width check or something
+ * that matches one character (or line break).  Used for the items that don't
+ * need the regstack.  Advances rex.input (and rex.lnum) past the match.
+ * Returns RA_CONT when it matches, RA_NOMATCH when it doesn't and zero when
+ * "scan" is not such an item.
+ */
+    static int
+regmatch_item(scan)
+    char_u	*scan;
+{
+    int		op;
+    int		c;
+    int		status = RA_CONT;
+
+    op = OP(scan);
+    /* Check for character class with NL added. */
+    if (!rex.reg_line_lbr && WITH_NL(op) && REG_MULTI
+				&& *rex.input == NUL && rex.lnum <= rex.reg_maxline)
+    {
+	reg_nextline();
+	return RA_CONT;
+    }
+    if (rex.reg_line_lbr && WITH_NL(op) && *rex.input == '\n')
+    {
+	ADVANCE_REGINPUT();
+	return RA_CONT;
+    }
+
+    if (WITH_NL(op))
+	op -= ADD_NL;
+#ifdef FEAT_MBYTE
+    if (has_mbyte)
+	c = (*mb_ptr2char)(rex.input);
+    else
+#endif
+	c = *rex.input;
+    switch (op)
+    {
+      case BOL:
+	if (rex.input != rex.line)
+	    status = RA_NOMATCH;
+	break;
+
+      case EOL:
+	if (c != NUL)
+	    status = RA_NOMATCH;
+	break;
+
+      case RE_BOF:
+	/* We're not at the beginning of the file when below the first
+	 * line where we started, not at the start of the line or we
+	 * didn't start at the first line of the buffer. */
+	if (rex.lnum != 0 || rex.input != rex.line
+				      || (REG_MULTI && rex.reg_firstlnum > 1))
+	    status = RA_NOMATCH;
+	break;
+
+      case RE_EOF:
+	if (rex.lnum != rex.reg_maxline || c != NUL)
+	    status = RA_NOMATCH;
+	break;
+
+      case CURSOR:
+	/* Check if the buffer is in a window and compare the
+	 * rex.reg_win->w_cursor position to the match position. */
+	if (rex.reg_win == NULL
+		|| (rex.lnum + rex.reg_firstlnum != rex.reg_win->w_cursor.lnum)
+		|| ((colnr_T)(rex.input - rex.line) != rex.reg_win->w_cursor.col))
+	    status = RA_NOMATCH;
+	break;
+
+      case RE_MARK:
+	/* Compare the mark position to the match position.  NOTE: Always
+	 * uses the current buffer. */
+	{
+	    int     mark = OPERAND(scan)[0];
+	    int     cmp = OPERAND(scan)[1];
+	    pos_T   *pos;
+
+	    pos = getmark(mark, FALSE);
+	    if (pos == NULL              /* mark doesn't exist */
+		    || pos->lnum <= 0    /* mark isn't set (in curbuf) */
+		    || (pos->lnum == rex.lnum + rex.reg_firstlnum
+			    ? (pos->col == (colnr_T)(rex.input - rex.line)
+				? (cmp == '<' || cmp == '>')
+				: (pos->col < (colnr_T)(rex.input - rex.line)
+				    ? cmp != '>'
+				    : cmp != '<'))
+			    : (pos->lnum < rex.lnum + rex.reg_firstlnum
+				? cmp != '>'
+				: cmp != '<')))
+		status = RA_NOMATCH;
+	}
+	break;
+
+      case RE_VISUAL:
+#ifdef FEAT_VISUAL
+	/* Check if the buffer is the current buffer. and whether the
+	 * position is inside the Visual area. */
+	if (rex.reg_buf != curbuf || VIsual.lnum == 0)
+	    status = RA_NOMATCH;
+	else
+	{
+	    pos_T       top, bot;
+	    linenr_T    lnum;
+	    colnr_T     col;
+	    win_T       *wp = rex.reg_win == NULL ? curwin : rex.reg_win;
+	    int         mode;
+
+	    if (VIsual_active)
+	    {
+		if (lt(VIsual, wp->w_cursor))
 		{
-		    rst.nextb = *OPERAND(next);
-		    if (ireg_ic)
-		    {
-			if (MB_ISUPPER(rst.nextb))
-			    rst.nextb_ic = MB_TOLOWER(rst.nextb);
-			else
-			    rst.nextb_ic = MB_TOUPPER(rst.nextb);
-		    }
-		    else
-			rst.nextb_ic = rst.nextb;
+		    top = VIsual;
+		    bot = wp->w_cursor;
 		}
 		else
 		{
-		    rst.nextb = NUL;
-		    rst.nextb_ic = NUL;
+		    top = wp->w_cursor;
+		    bot = VIsual;
 		}
-		if (op != BRACE_SIMPLE)
+		mode = VIsual_mode;
+	    }
+	    else
+	    {
+		if (lt(curbuf->b_visual.vi_start, curbuf->b_visual.vi_end))
 		{
-		    rst.minval = (op == STAR) ? 0 : 1;
-		    rst.maxval = MAX_LIMIT;
+		    top = curbuf->b_visual.vi_start;
+		    bot = curbuf->b_visual.vi_end;
 		}
 		else
 		{
-		    rst.minval = bl_minval;
-		    rst.maxval = bl_maxval;
-		}
-
-		/*
-		 * When maxval > minval, try matching as much as possible, up
-		 * to maxval.  When maxval < minval, try matching at least the
-		 * minimal number (since the range is backwards, that's also
-		 * maxval!).
-		 */
-		rst.count = regrepeat(OPERAND(scan), rst.maxval);
-		if (got_int)
-		{
-		    status = RA_FAIL;
-		    break;
-		}
-		if (rst.minval <= rst.maxval
-			  ? rst.count >= rst.minval : rst.count >= rst.maxval)
-		{
-		    /* It could match.  Prepare for trying to match what
-		     * follows.  The code is below.  Parameters are stored in
-		     * a regstar_T on the regstack. */
-		    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
-		    {
-			EMSG(_(e_maxmempat));
-			status = RA_FAIL;
-		    }
-		    else if (ga_grow(&regstack, sizeof(regstar_T)) == FAIL)
-			status = RA_FAIL;
-		    else
-		    {
-			regstack.ga_len += sizeof(regstar_T);
-			rp = regstack_push(rst.minval <= rst.maxval
-					? RS_STAR_LONG : RS_STAR_SHORT, scan);
-			if (rp == NULL)
-			    status = RA_FAIL;
-			else
-			{
-			    *(((regstar_T *)rp) - 1) = rst;
-			    status = RA_BREAK;	    /* skip the restore bits */
-			}
-		    }
+		    top = curbuf->b_visual.vi_end;
+		    bot = curbuf->b_visual.vi_start;
 		}
-		else
-		    status = RA_NOMATCH;
-
-	    }
-	    break;
-
-	  case NOMATCH:
-	  case MATCH:
-	  case SUBPAT:
-	    rp = regstack_push(RS_NOMATCH, scan);
-	    if (rp == NULL)
-		status = RA_FAIL;
-	    else
-	    {
-		rp->rs_no = op;
-		reg_save(&rp->rs_un.regsave, &backpos);
-		next = OPERAND(scan);
-		/* We continue and handle the result when done. */
-	    }
-	    break;
-
-	  case BEHIND:
-	  case NOBEHIND:
-	    /* Need a bit of room to store extra positions. */
-	    if ((long)((unsigned)regstack.ga_len >> 10) >= p_mmp)
-	    {
-		EMSG(_(e_maxmempat));
-		status = RA_FAIL;
+		mode = curbuf->b_visual.vi_mode;
 	    }
-	    else if (ga_grow(&regstack, sizeof(regbehind_T)) == FAIL)
-		status = RA_FAIL;
-	    else
+	    lnum = rex.lnum + rex.reg_firstlnum;
+	    col = (colnr_T)(rex.input - rex.line);
+	    if (lnum < top.lnum || lnum > bot.lnum)
+		status = RA_NOMATCH;
+	    else if (mode == 'v')
 	    {
-		regstack.ga_len += sizeof(regbehind_T);
-		rp = regstack_push(RS_BEHIND1, scan);
-		if (rp == NULL)
-		    status = RA_FAIL;
-		else
-		{
-		    /* Need to save the subexpr to be able to restore them
-		     * when there is a match but we don't use it. */
-		    save_subexpr(((regbehind_T *)rp) - 1);
-
-		    rp->rs_no = op;
-		    reg_save(&rp->rs_un.regsave, &backpos);
-		    /* First try if what follows matches.  If it does then we
-		     * check the behind match by looping. */
-		}
+		if ((lnum == top.lnum && col < top.col)
+			|| (lnum == bot.lnum
+				     && col >= bot.col + (*p_sel != 'e')))
+		    status = RA_NOMATCH;
 	    }
-	    break;
-
-	  case BHPOS:
-	    if (REG_MULTI)
+	    else if (mode == Ctrl_V)
 	    {
-		if (behind_pos.rs_u.pos.col != (colnr_T)(reginput - regline)
-			|| behind_pos.rs_u.pos.lnum != reglnum)
+		colnr_T         start, end;
+		colnr_T         start2, end2;
+		colnr_T         cols;
+
+		getvvcol(wp, &top, &start, NULL, &end);
+		getvvcol(wp, &bot, &start2, NULL, &end2);
+		if (start2 < start)
+		    start = start2;
+		if (end2 > end)
+		    end = end2;
+		if (top.col == MAXCOL || bot.col == MAXCOL)
+		    end = MAXCOL;
+		cols = win_linetabsize(wp,
+				  rex.line, (colnr_T)(rex.input - rex.line));
+		if (cols < start || cols > end - (*p_sel == 'e'))
 		    status = RA_NOMATCH;
 	    }
-	    else if (behind_pos.rs_u.ptr != reginput)
-		status = RA_NOMATCH;
-	    break;
-
-	  case NEWL:
-	    if ((c != NUL || !REG_MULTI || reglnum > reg_maxline
-			     || reg_line_lbr) && (c != '\n' || !reg_line_lbr))
-		status = RA_NOMATCH;
-	    else if (reg_line_lbr)
-		ADVANCE_REGINPUT();
-	    else
-		reg_nextline();
-	    break;
+	}
+#else
+	status = RA_NOMATCH;
+#endif
+	break;
 
-	  case END:
-	    status = RA_MATCH;	/* Success! */
-	    break;
+      case RE_LNUM:
+	if (!REG_MULTI || !re_num_cmp((long_u)(rex.lnum + rex.reg_firstlnum),
+								    scan))
+	    status = RA_NOMATCH;
+	break;
 
-	  default:
-	    EMSG(_(e_re_corr));
-#ifdef DEBUG
-	    printf("Illegal op code %d\n", op);
+      case RE_COL:
+	if (!re_num_cmp((long_u)(rex.input - rex.line) + 1, scan))
+	    status = RA_NOMATCH;
+	break;
+
+      case RE_VCOL:
+	if (!re_num_cmp((long_u)win_linetabsize(
+			rex.reg_win == NULL ? curwin : rex.reg_win,
+			rex.line, (colnr_T)(rex.input - rex.line)) + 1, scan))
+	    status = RA_NOMATCH;
+	break;
+
+      case BOW:     /* \<word; rex.input points to w */
+	if (c == NUL)       /* Can't match at end of line */
+	    status = RA_NOMATCH;
+#ifdef FEAT_MBYTE
+	else if (has_mbyte)
+	{
+	    int this_class;
+
+	    /* Get class of current and previous char (if it exists). */
+	    this_class = mb_get_class(rex.input);
+	    if (this_class <= 1)
+		status = RA_NOMATCH;  /* not on a word at all */
+	    else if (reg_prev_class() == this_class)
+		status = RA_NOMATCH;  /* previous char is in same word */
+	}
 #endif
-	    status = RA_FAIL;
-	    break;
-	  }
+	else
+	{
+	    if (!vim_iswordc(c)
+		    || (rex.input > rex.line && vim_iswordc(rex.input[-1])))
+		status = RA_NOMATCH;
 	}
+	break;
 
-	/* If we can't continue sequentially, break the inner loop. */
-	if (status != RA_CONT)
-	    break;
+      case EOW:     /* word\>; rex.input points after d */
+	if (rex.input == rex.line)    /* Can't match at start of line */
+	    status = RA_NOMATCH;
+#ifdef FEAT_MBYTE
+	else if (has_mbyte)
+	{
+	    int this_class, prev_class;
 
-	/* Continue in inner loop, advance to next item. */
-	scan = next;
+	    /* Get class of current and previous char (if it exists). */
+	    this_class = mb_get_class(rex.input);
+	    prev_class = reg_prev_class();
+	    if (this_class == prev_class
+		    || prev_class == 0 || prev_class == 1)
+		status = RA_NOMATCH;
+	}
+#endif
+	else
+	{
+	    if (!vim_iswordc(rex.input[-1])
+		    || (rex.input[0] != NUL && vim_iswordc(c)))
+		status = RA_NOMATCH;
+	}
+	break; /* Matched with EOW */
 
-    } /* end of inner loop */
+      case ANY:
+	if (c == NUL)
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-    /*
-     * If there is something on the regstack execute the code for the state.
-     * If the state is popped then loop and use the older state.
-     */
-    while (regstack.ga_len > 0 && status != RA_FAIL)
-    {
-	rp = (regitem_T *)((char *)regstack.ga_data + regstack.ga_len) - 1;
-	switch (rp->rs_state)
-	{
-	  case RS_NOPEN:
-	    /* Result is passed on as-is, simply pop the state. */
-	    regstack_pop(&scan);
-	    break;
+      case IDENT:
+	if (!vim_isIDc(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_MOPEN:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_startpos[rp->rs_no],
-						  &reg_startp[rp->rs_no]);
-	    regstack_pop(&scan);
-	    break;
+      case SIDENT:
+	if (VIM_ISDIGIT(*rex.input) || !vim_isIDc(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-#ifdef FEAT_SYN_HL
-	  case RS_ZOPEN:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_startzpos[rp->rs_no],
-						 &reg_startzp[rp->rs_no]);
-	    regstack_pop(&scan);
-	    break;
-#endif
+      case KWORD:
+	if (!vim_iswordp(rex.input))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_MCLOSE:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_endpos[rp->rs_no],
-						    &reg_endp[rp->rs_no]);
-	    regstack_pop(&scan);
-	    break;
+      case SKWORD:
+	if (VIM_ISDIGIT(*rex.input) || !vim_iswordp(rex.input))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-#ifdef FEAT_SYN_HL
-	  case RS_ZCLOSE:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-		restore_se(&rp->rs_un.sesave, &reg_endzpos[rp->rs_no],
-						   &reg_endzp[rp->rs_no]);
-	    regstack_pop(&scan);
-	    break;
-#endif
+      case FNAME:
+	if (!vim_isfilec(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BRANCH:
-	    if (status == RA_MATCH)
-		/* this branch matched, use it */
-		regstack_pop(&scan);
-	    else
-	    {
-		if (status != RA_BREAK)
-		{
-		    /* After a non-matching branch: try next one. */
-		    reg_restore(&rp->rs_un.regsave, &backpos);
-		    scan = rp->rs_scan;
-		}
-		if (scan == NULL || OP(scan) != BRANCH)
-		{
-		    /* no more branches, didn't find a match */
-		    status = RA_NOMATCH;
-		    regstack_pop(&scan);
-		}
-		else
-		{
-		    /* Prepare to try a branch. */
-		    rp->rs_scan = regnext(scan);
-		    reg_save(&rp->rs_un.regsave, &backpos);
-		    scan = OPERAND(scan);
-		}
-	    }
-	    break;
+      case SFNAME:
+	if (VIM_ISDIGIT(*rex.input) || !vim_isfilec(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BRCPLX_MORE:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-	    {
-		reg_restore(&rp->rs_un.regsave, &backpos);
-		--brace_count[rp->rs_no];	/* decrement match count */
-	    }
-	    regstack_pop(&scan);
-	    break;
+      case PRINT:
+	if (ptr2cells(rex.input) != 1)
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BRCPLX_LONG:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-	    {
-		/* There was no match, but we did find enough matches. */
-		reg_restore(&rp->rs_un.regsave, &backpos);
-		--brace_count[rp->rs_no];
-		/* continue with the items after "\{}" */
-		status = RA_CONT;
-	    }
-	    regstack_pop(&scan);
-	    if (status == RA_CONT)
-		scan = regnext(scan);
-	    break;
+      case SPRINT:
+	if (VIM_ISDIGIT(*rex.input) || ptr2cells(rex.input) != 1)
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BRCPLX_SHORT:
-	    /* Pop the state.  Restore pointers when there is no match. */
-	    if (status == RA_NOMATCH)
-		/* There was no match, try to match one more item. */
-		reg_restore(&rp->rs_un.regsave, &backpos);
-	    regstack_pop(&scan);
-	    if (status == RA_NOMATCH)
-	    {
-		scan = OPERAND(scan);
-		status = RA_CONT;
-	    }
-	    break;
+      case WHITE:
+	if (!vim_iswhite(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_NOMATCH:
-	    /* Pop the state.  If the operand matches for NOMATCH or
-	     * doesn't match for MATCH/SUBPAT, we fail.  Otherwise backup,
-	     * except for SUBPAT, and continue with the next item. */
-	    if (status == (rp->rs_no == NOMATCH ? RA_MATCH : RA_NOMATCH))
-		status = RA_NOMATCH;
-	    else
-	    {
-		status = RA_CONT;
-		if (rp->rs_no != SUBPAT)	/* zero-width */
-		    reg_restore(&rp->rs_un.regsave, &backpos);
-	    }
-	    regstack_pop(&scan);
-	    if (status == RA_CONT)
-		scan = regnext(scan);
-	    break;
+      case NWHITE:
+	if (c == NUL || vim_iswhite(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BEHIND1:
-	    if (status == RA_NOMATCH)
-	    {
-		regstack_pop(&scan);
-		regstack.ga_len -= sizeof(regbehind_T);
-	    }
-	    else
-	    {
-		/* The stuff after BEHIND/NOBEHIND matches.  Now try if
-		 * the behind part does (not) match before the current
-		 * position in the input.  This must be done at every
-		 * position in the input and checking if the match ends at
-		 * the current position. */
+      case DIGIT:
+	if (!ri_digit(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-		/* save the position after the found match for next */
-		reg_save(&(((regbehind_T *)rp) - 1)->save_after, &backpos);
+      case NDIGIT:
+	if (c == NUL || ri_digit(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-		/* start looking for a match with operand at the current
-		 * position.  Go back one character until we find the
-		 * result, hitting the start of the line or the previous
-		 * line (for multi-line matching).
-		 * Set behind_pos to where the match should end, BHPOS
-		 * will match it.  Save the current value. */
-		(((regbehind_T *)rp) - 1)->save_behind = behind_pos;
-		behind_pos = rp->rs_un.regsave;
+      case HEX:
+	if (!ri_hex(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-		rp->rs_state = RS_BEHIND2;
+      case NHEX:
+	if (c == NUL || ri_hex(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-		reg_restore(&rp->rs_un.regsave, &backpos);
-		scan = OPERAND(rp->rs_scan);
-	    }
-	    break;
+      case OCTAL:
+	if (!ri_octal(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-	  case RS_BEHIND2:
-	    /*
-	     * Looping for BEHIND / NOBEHIND match.
-	     */
-	    if (status == RA_MATCH && reg_save_equal(&behind_pos))
-	    {
-		/* found a match that ends where "next" started */
-		behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
-		if (rp->rs_no == BEHIND)
-		    reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-								    &backpos);
-		else
-		{
-		    /* But we didn't want a match.  Need to restore the
-		     * subexpr, because what follows matched, so they have
-		     * been set. */
-		    status = RA_NOMATCH;
-		    restore_subexpr(((regbehind_T *)rp) - 1);
-		}
-		regstack_pop(&scan);
-		regstack.ga_len -= sizeof(regbehind_T);
+      case NOCTAL:
+	if (c == NUL || ri_octal(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case WORD:
+	if (!ri_word(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case NWORD:
+	if (c == NUL || ri_word(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case HEAD:
+	if (!ri_head(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case NHEAD:
+	if (c == NUL || ri_head(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case ALPHA:
+	if (!ri_alpha(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case NALPHA:
+	if (c == NUL || ri_alpha(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case LOWER:
+	if (!ri_lower(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case NLOWER:
+	if (c == NUL || ri_lower(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case UPPER:
+	if (!ri_upper(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case NUPPER:
+	if (c == NUL || ri_upper(c))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
+
+      case EXACTLY:
+	{
+	    int     len;
+	    char_u  *opnd;
+
+	    opnd = OPERAND(scan);
+	    /* Inline the first byte, for speed. */
+	    if (*opnd != *rex.input
+		    && (!rex.reg_ic || (
+#ifdef FEAT_MBYTE
+			!enc_utf8 &&
+#endif
+			MB_TOLOWER(*opnd) != MB_TOLOWER(*rex.input))))
+		status = RA_NOMATCH;
+	    else if (*opnd == NUL)
+	    {
+		/* match empty string always works; happens when "~" is
+		 * empty. */
 	    }
+	    else if (opnd[1] == NUL
+#ifdef FEAT_MBYTE
+			&& !(enc_utf8 && rex.reg_ic)
+#endif
+		    )
+		++rex.input;         /* matched a single char */
 	    else
 	    {
-		/* No match or a match that doesn't end where we want it: Go
-		 * back one character.  May go to previous line once. */
-		no = OK;
-		if (REG_MULTI)
-		{
-		    if (rp->rs_un.regsave.rs_u.pos.col == 0)
-		    {
-			if (rp->rs_un.regsave.rs_u.pos.lnum
-					< behind_pos.rs_u.pos.lnum
-				|| reg_getline(
-					--rp->rs_un.regsave.rs_u.pos.lnum)
-								  == NULL)
-			    no = FAIL;
-			else
-			{
-			    reg_restore(&rp->rs_un.regsave, &backpos);
-			    rp->rs_un.regsave.rs_u.pos.col =
-						 (colnr_T)STRLEN(regline);
-			}
-		    }
-		    else
-			--rp->rs_un.regsave.rs_u.pos.col;
-		}
-		else
-		{
-		    if (rp->rs_un.regsave.rs_u.ptr == regline)
-			no = FAIL;
-		    else
-			--rp->rs_un.regsave.rs_u.ptr;
-		}
-		if (no == OK)
+		len = (int)STRLEN(opnd);
+		/* Need to match first byte again for multi-byte. */
+		if (cstrncmp(opnd, rex.input, &len) != 0)
+		    status = RA_NOMATCH;
+#ifdef FEAT_MBYTE
+		/* Check for following composing character. */
+		else if (enc_utf8
+			   && UTF_COMPOSINGLIKE(rex.input, rex.input + len))
 		{
-		    /* Advanced, prepare for finding match again. */
-		    reg_restore(&rp->rs_un.regsave, &backpos);
-		    scan = OPERAND(rp->rs_scan);
-		    if (status == RA_MATCH)
-		    {
-			/* We did match, so subexpr may have been changed,
-			 * need to restore them for the next try. */
+		    /* raaron: This code makes a composing character get
+		     * ignored, which is the correct behavior (sometimes)
+		     * for voweled Hebrew texts. */
+		    if (!rex.reg_icombine)
 			status = RA_NOMATCH;
-			restore_subexpr(((regbehind_T *)rp) - 1);
-		    }
 		}
+#endif
 		else
-		{
-		    /* Can't advance.  For NOBEHIND that's a match. */
-		    behind_pos = (((regbehind_T *)rp) - 1)->save_behind;
-		    if (rp->rs_no == NOBEHIND)
-		    {
-			reg_restore(&(((regbehind_T *)rp) - 1)->save_after,
-								    &backpos);
-			status = RA_MATCH;
-		    }
-		    else
-		    {
-			/* We do want a proper match.  Need to restore the
-			 * subexpr if we had a match, because they may have
-			 * been set. */
-			if (status == RA_MATCH)
-			{
-			    status = RA_NOMATCH;
-			    restore_subexpr(((regbehind_T *)rp) - 1);
-			}
-		    }
-		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regbehind_T);
-		}
+		    rex.input += len;
 	    }
-	    break;
-
-	  case RS_STAR_LONG:
-	  case RS_STAR_SHORT:
-	    {
-		regstar_T	    *rst = ((regstar_T *)rp) - 1;
+	}
+	break;
 
-		if (status == RA_MATCH)
-		{
-		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regstar_T);
-		    break;
-		}
+      case ANYOF:
+      case ANYBUT:
+	if (c == NUL)
+	    status = RA_NOMATCH;
+	else if ((cstrchr(OPERAND(scan), c) == NULL) == (op == ANYOF))
+	    status = RA_NOMATCH;
+	else
+	    ADVANCE_REGINPUT();
+	break;
 
-		/* Tried once already, restore input pointers. */
-		if (status != RA_BREAK)
-		    reg_restore(&rp->rs_un.regsave, &backpos);
+#ifdef FEAT_MBYTE
+      case MULTIBYTECODE:
+	if (has_mbyte)
+	{
+	    int     i, len;
+	    char_u  *opnd;
+	    int     opndc = 0, inpc;
 
-		/* Repeat until we found a position where it could match. */
-		for (;;)
+	    opnd = OPERAND(scan);
+	    /* Safety check (just in case 'encoding' was changed since
+	     * compiling the program). */
+	    if ((len = (*mb_ptr2len)(opnd)) < 2)
+	    {
+		status = RA_NOMATCH;
+		break;
+	    }
+	    if (enc_utf8)
+		opndc = mb_ptr2char(opnd);
+	    if (enc_utf8 && utf_iscomposing(opndc))
+	    {
+		/* When only a composing char is given match at any
+		 * position where that composing char appears. */
+		status = RA_NOMATCH;
+		for (i = 0; rex.input[i] != NUL; i += utf_char2len(inpc))
 		{
-		    if (status != RA_BREAK)
+		    inpc = mb_ptr2char(rex.input + i);
+		    if (!utf_iscomposing(inpc))
 		    {
-			/* Tried first position already, advance. */
-			if (rp->rs_state == RS_STAR_LONG)
-			{
-			    /* Trying for longest match, but couldn't or
-			     * didn't match -- back up one char. */
-			    if (--rst->count < rst->minval)
-				break;
-			    if (reginput == regline)
-			    {
-				/* backup to last char of previous line */
-				--reglnum;
-				regline = reg_getline(reglnum);
-				/* Just in case regrepeat() didn't count
-				 * right. */
-				if (regline == NULL)
-				    break;
-				reginput = regline + STRLEN(regline);
-				fast_breakcheck();
-			    }
-			    else
-				mb_ptr_back(regline, reginput);
-			}
-			else
-			{
-			    /* Range is backwards, use shortest match first.
-			     * Careful: maxval and minval are exchanged!
-			     * Couldn't or didn't match: try advancing one
-			     * char. */
-			    if (rst->count == rst->minval
-				  || regrepeat(OPERAND(rp->rs_scan), 1L) == 0)
-				break;
-			    ++rst->count;
-			}
-			if (got_int)
+			if (i > 0)
 			    break;
 		    }
-		    else
-			status = RA_NOMATCH;
-
-		    /* If it could match, try it. */
-		    if (rst->nextb == NUL || *reginput == rst->nextb
-					     || *reginput == rst->nextb_ic)
+		    else if (opndc == inpc)
 		    {
-			reg_save(&rp->rs_un.regsave, &backpos);
-			scan = regnext(rp->rs_scan);
-			status = RA_CONT;
+			/* Include all following composing chars. */
+			len = i + mb_ptr2len(rex.input + i);
+			status = RA_MATCH;
 			break;
 		    }
 		}
-		if (status != RA_CONT)
-		{
-		    /* Failed. */
-		    regstack_pop(&scan);
-		    regstack.ga_len -= sizeof(regstar_T);
-		    status = RA_NOMATCH;
-		}
 	    }
-	    break;
+	    else
+		for (i = 0; i < len; ++i)
+		    if (opnd[i] != rex.input[i])
+		    {
+			status = RA_NOMATCH;
+			break;
+		    }
+	    rex.input += len;
 	}
-
-	/* If we want to continue the inner loop or didn't pop a state
-	 * continue matching loop */
-	if (status == RA_CONT || rp == (regitem_T *)
-			     ((char *)regstack.ga_data + regstack.ga_len) - 1)
-	    break;
-    }
-
-    /* May need to continue with the inner loop, starting at "scan". */
-    if (status == RA_CONT)
-	continue;
-
-    /*
-     * If the regstack is empty or something failed we are done.
-     */
-    if (regstack.ga_len == 0 || status == RA_FAIL)
-    {
-	if (scan == NULL)
-	{
-	    /*
-	     * We get here only if there's trouble -- normally "case END" is
-	     * the terminating point.
-	     */
-	    EMSG(_(e_re_corr));
-#ifdef DEBUG
-	    printf("Premature EOL\n");
+	else
+	    status = RA_NOMATCH;
+	break;
 #endif
-	}
-	if (status == RA_FAIL)
-	    got_int = TRUE;
-	return (status == RA_MATCH);
-    }
 
-  } /* End of loop until the regstack is empty. */
+      case NEWL:
+	if ((c != NUL || !REG_MULTI || rex.lnum > rex.reg_maxline
+			 || rex.reg_line_lbr) && (c != '\n' || !rex.reg_line_lbr))
+	    status = RA_NOMATCH;
+	else if (rex.reg_line_lbr)
+	    ADVANCE_REGINPUT();
+	else
+	    reg_nextline();
+	break;
 
-  /* NOTREACHED */
+      default:
+	status = 0;
+	break;
+    }
+    return status;
 }
 
 /*
@@ -5384,7 +6560,7 @@ regstack_pop(scan)
 
 /*
  * regrepeat - repeatedly match something simple, return how many.
- * Advances reginput (and reglnum) to just after the matched chars.
+ * Advances rex.input (and rex.lnum) to just after the matched chars.
  */
     static int
 regrepeat(p, maxcount)
@@ -5397,149 +6573,107 @@ regrepeat(p, maxcount)
     int		mask;
     int		testval = 0;
 
-    scan = reginput;	    /* Make local copy of reginput for speed. */
+    scan = rex.input;	    /* Make local copy of rex.input for speed. */
     opnd = OPERAND(p);
     switch (OP(p))
     {
       case ANY:
-      case ANY + ADD_NL:
-	while (count < maxcount)
-	{
-	    /* Matching anything means we continue until end-of-line (or
-	     * end-of-file for ANY + ADD_NL), only limited by maxcount. */
-	    while (*scan != NUL && count < maxcount)
-	    {
-		++count;
-		mb_ptr_adv(scan);
-	    }
-	    if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-					 || reg_line_lbr || count == maxcount)
-		break;
-	    ++count;		/* count the line-break */
-	    reg_nextline();
-	    scan = reginput;
-	    if (got_int)
-		break;
-	}
-	break;
-
-      case IDENT:
-      case IDENT + ADD_NL:
-	testval = TRUE;
-	/*FALLTHROUGH*/
-      case SIDENT:
-      case SIDENT + ADD_NL:
-	while (count < maxcount)
-	{
-	    if (vim_isIDc(*scan) && (testval || !VIM_ISDIGIT(*scan)))
-	    {
-		mb_ptr_adv(scan);
-	    }
-	    else if (*scan == NUL)
-	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
-		    break;
-		reg_nextline();
-		scan = reginput;
-		if (got_int)
-		    break;
-	    }
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
-		++scan;
-	    else
-		break;
-	    ++count;
-	}
-	break;
-
-      case KWORD:
-      case KWORD + ADD_NL:
-	testval = TRUE;
-	/*FALLTHROUGH*/
-      case SKWORD:
-      case SKWORD + ADD_NL:
+      case ANY + ADD_NL:
 	while (count < maxcount)
 	{
-	    if (vim_iswordp(scan) && (testval || !VIM_ISDIGIT(*scan)))
+	    /* Matching anything means we continue until end-of-line (or
+	     * end-of-file for ANY + ADD_NL), only limited by maxcount. */
+	    while (*scan != NUL && count < maxcount)
 	    {
+		++count;
 		mb_ptr_adv(scan);
 	    }
-	    else if (*scan == NUL)
-	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
-		    break;
-		reg_nextline();
-		scan = reginput;
-		if (got_int)
-		    break;
-	    }
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
-		++scan;
-	    else
+	    if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
+					 || rex.reg_line_lbr || count == maxcount)
+		break;
+	    ++count;		/* count the line-break */
+	    reg_nextline();
+	    scan = rex.input;
+	    if (got_int)
 		break;
-	    ++count;
 	}
 	break;
 
+      case IDENT:
+      case IDENT + ADD_NL:
+	mask = RI_IDENT;
+	goto do_opt_class;
+      case SIDENT:
+      case SIDENT + ADD_NL:
+	mask = RI_IDENT;
+	goto do_opt_sclass;
+      case KWORD:
+      case KWORD + ADD_NL:
+	mask = RI_KWORD;
+	goto do_opt_class;
+      case SKWORD:
+      case SKWORD + ADD_NL:
+	mask = RI_KWORD;
+	goto do_opt_sclass;
       case FNAME:
       case FNAME + ADD_NL:
-	testval = TRUE;
-	/*FALLTHROUGH*/
+	mask = RI_FNAME;
+	goto do_opt_class;
       case SFNAME:
       case SFNAME + ADD_NL:
-	while (count < maxcount)
-	{
-	    if (vim_isfilec(*scan) && (testval || !VIM_ISDIGIT(*scan)))
-	    {
-		mb_ptr_adv(scan);
-	    }
-	    else if (*scan == NUL)
-	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
-		    break;
-		reg_nextline();
-		scan = reginput;
-		if (got_int)
-		    break;
-	    }
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
-		++scan;
-	    else
-		break;
-	    ++count;
-	}
-	break;
-
+	mask = RI_FNAME;
+	goto do_opt_sclass;
       case PRINT:
       case PRINT + ADD_NL:
-	testval = TRUE;
-	/*FALLTHROUGH*/
+	mask = RI_PRINT;
+	goto do_opt_class;
       case SPRINT:
       case SPRINT + ADD_NL:
-	while (count < maxcount)
+	mask = RI_PRINT;
+do_opt_sclass:
+	/* Same as below, but a digit doesn't match. */
+	testval = RI_DIGIT;
+do_opt_class:
 	{
-	    if (*scan == NUL)
+	    int	    optmask = mask;
+
+	    update_class_tab();
+
+	    /* Check the bits for the class and the digit bit for the "S"
+	     * classes: RI_DIGIT must be off for them. */
+	    mask |= testval;
+	    testval = optmask;
+	    while (count < maxcount)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
-		    break;
-		reg_nextline();
-		scan = reginput;
-		if (got_int)
+		/* Most characters are found in class_tab[].  In UTF-8 the
+		 * next byte must not start a composing character. */
+		if ((class_tab[*scan] & mask) == testval
+#ifdef FEAT_MBYTE
+			&& (!enc_utf8 || scan[1] < 0x80)
+#endif
+			)
+		    ++scan;
+		else if (*scan == NUL)
+		{
+		    if (!REG_MULTI || !WITH_NL(OP(p))
+			    || rex.lnum > rex.reg_maxline || rex.reg_line_lbr)
+			break;
+		    reg_nextline();
+		    scan = rex.input;
+		    if (got_int)
+			break;
+		}
+		else if (reg_opt_class(scan, optmask)
+			&& ((mask & RI_DIGIT) == 0 || !VIM_ISDIGIT(*scan)))
+		{
+		    mb_ptr_adv(scan);
+		}
+		else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+		    ++scan;
+		else
 		    break;
+		++count;
 	    }
-	    else if (ptr2cells(scan) == 1 && (testval || !VIM_ISDIGIT(*scan)))
-	    {
-		mb_ptr_adv(scan);
-	    }
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
-		++scan;
-	    else
-		break;
-	    ++count;
 	}
 	break;
 
@@ -5554,11 +6688,11 @@ do_class:
 #endif
 	    if (*scan == NUL)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
+		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
+							      || rex.reg_line_lbr)
 		    break;
 		reg_nextline();
-		scan = reginput;
+		scan = rex.input;
 		if (got_int)
 		    break;
 	    }
@@ -5572,7 +6706,7 @@ do_class:
 #endif
 	    else if ((class_tab[*scan] & mask) == testval)
 		++scan;
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
 		++scan;
 	    else
 		break;
@@ -5649,131 +6783,740 @@ do_class:
 	mask = RI_UPPER;
 	goto do_class;
 
-      case EXACTLY:
+      case EXACTLY:
+	{
+	    int	    cu, cl;
+
+	    /* This doesn't do a multi-byte character, because a MULTIBYTECODE
+	     * would have been used for it.  It does handle single-byte
+	     * characters, such as latin1. */
+	    if (rex.reg_ic)
+	    {
+		cu = MB_TOUPPER(*opnd);
+		cl = MB_TOLOWER(*opnd);
+		while (count < maxcount && (*scan == cu || *scan == cl))
+		{
+		    count++;
+		    scan++;
+		}
+	    }
+	    else
+	    {
+		cu = *opnd;
+		while (count < maxcount && *scan == cu)
+		{
+		    count++;
+		    scan++;
+		}
+	    }
+	    break;
+	}
+
+#ifdef FEAT_MBYTE
+      case MULTIBYTECODE:
+	{
+	    int		i, len, cf = 0;
+
+	    /* Safety check (just in case 'encoding' was changed since
+	     * compiling the program). */
+	    if ((len = (*mb_ptr2len)(opnd)) > 1)
+	    {
+		if (rex.reg_ic && enc_utf8)
+		    cf = utf_fold(utf_ptr2char(opnd));
+		while (count < maxcount)
+		{
+		    for (i = 0; i < len; ++i)
+			if (opnd[i] != scan[i])
+			    break;
+		    if (i < len && (!rex.reg_ic || !enc_utf8
+					|| utf_fold(utf_ptr2char(scan)) != cf))
+			break;
+		    scan += len;
+		    ++count;
+		}
+	    }
+	}
+	break;
+#endif
+
+      case ANYOF:
+      case ANYOF + ADD_NL:
+	testval = TRUE;
+	/*FALLTHROUGH*/
+
+      case ANYBUT:
+      case ANYBUT + ADD_NL:
+	while (count < maxcount)
+	{
+#ifdef FEAT_MBYTE
+	    int len;
+#endif
+	    if (*scan == NUL)
+	    {
+		if (!REG_MULTI || !WITH_NL(OP(p)) || rex.lnum > rex.reg_maxline
+							      || rex.reg_line_lbr)
+		    break;
+		reg_nextline();
+		scan = rex.input;
+		if (got_int)
+		    break;
+	    }
+	    else if (rex.reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
+		++scan;
+#ifdef FEAT_MBYTE
+	    else if (has_mbyte && (len = (*mb_ptr2len)(scan)) > 1)
+	    {
+		if ((cstrchr(opnd, (*mb_ptr2char)(scan)) == NULL) == testval)
+		    break;
+		scan += len;
+	    }
+#endif
+	    else
+	    {
+		if ((cstrchr(opnd, *scan) == NULL) == testval)
+		    break;
+		++scan;
+	    }
+	    ++count;
+	}
+	break;
+
+      case NEWL:
+	while (count < maxcount
+		&& ((*scan == NUL && rex.lnum <= rex.reg_maxline && !rex.reg_line_lbr
+			    && REG_MULTI) || (*scan == '\n' && rex.reg_line_lbr)))
+	{
+	    count++;
+	    if (rex.reg_line_lbr)
+		ADVANCE_REGINPUT();
+	    else
+		reg_nextline();
+	    scan = rex.input;
+	    if (got_int)
+		break;
+	}
+	break;
+
+      default:			/* Oh dear.  Called inappropriately. */
+	EMSG(_(e_re_corr));
+#ifdef DEBUG
+	printf("Called regrepeat with op code %d\n", OP(p));
+#endif
+	break;
+    }
+
+    rex.input = scan;
+
+    return (int)count;
+}
+
+/*
+ * The NFA engine.
+ *
+ * This executes the same program as regmatch(), but instead of trying one
+ * alternative and backtracking when it fails, all alternatives are followed
+ * at the same time.  Each alternative is a thread: a node in the program, the
+ * position in the text where it is to be matched and the submatches found so
+ * far.  The threads are kept in the order of priority, the order in which
+ * regmatch() would try them, thus the match found is the one regmatch() would
+ * find.  When two threads arrive at the same node at the same position only
+ * the one with the highest priority is kept.  Thus the text is gone over only
+ * once and the time used is linear in the length of the text.
+ *
+ * Back references, look-around and complex braces need backtracking, these
+ * are not supported.  vim_regcomp() selects regmatch() for such a pattern.
+ */
+
+static regprog_T    *nfa_prog;		/* program being executed */
+static garray_T	    *nfa_next;		/* list to add threads to */
+static nfa_thread_T nfa_cur;		/* thread being added */
+static nfa_thread_T nfa_match;		/* match with highest priority */
+static int	    nfa_matched;	/* "nfa_match" is valid */
+static int	    nfa_cut;		/* found a match, skip the rest */
+static int	    nfa_fail;		/* out of memory or other error */
+
+static void nfa_setpos __ARGS((lpos_T *pos));
+static nfa_count_T *nfa_count_find __ARGS((nfa_count_T *table, int size, char_u *scan, long count, int back));
+static int nfa_count_grow __ARGS((void));
+static int nfa_seen_before __ARGS((char_u *scan, long count, int back));
+static void nfa_push __ARGS((nfa_thread_T *t));
+static void nfa_add __ARGS((char_u *scan, long count));
+static void nfa_repeat __ARGS((char_u *scan, long count, long minval, long maxval));
+static void nfa_found __ARGS((void));
+static void nfa_addstate __ARGS((char_u *scan, long count, int back));
+static colnr_T nfa_startcol __ARGS((regprog_T *prog, colnr_T col));
+
+/*
+ * Set "rex.lnum", "rex.line" and "rex.input" for position "pos".
+ */
+    static void
+nfa_setpos(pos)
+    lpos_T	*pos;
+{
+    if (REG_MULTI && rex.lnum != pos->lnum)
+    {
+	rex.lnum = pos->lnum;
+	rex.line = reg_getline(rex.lnum);
+    }
+    rex.input = rex.line + pos->col;
+}
+
+/*
+ * Find the entry for node "scan" with "count" and "back" in hash table
+ * "table" with "size" entries.  Returns the unused entry where it is to be
+ * added when it's not there.
+ */
+    static nfa_count_T *
+nfa_count_find(table, size, scan, count, back)
+    nfa_count_T	*table;
+    int		size;
+    char_u	*scan;
+    long	count;
+    int		back;
+{
+    long_u	hash;
+    nfa_count_T	*nc;
+
+    hash = ((long_u)(scan - nfa_prog->program) * 31 + (long_u)count) * 2
+									+ back;
+    for (;;)
+    {
+	nc = &table[hash & (size - 1)];
+	if (nc->nc_step != nfa_step || (nc->nc_scan == scan
+			       && nc->nc_count == count && nc->nc_back == back))
+	    return nc;
+	++hash;
+    }
+}
+
+/*
+ * Make "nfa_seen_count" twice as big, keeping the entries of this step.
+ * Returns FAIL when out of memory.
+ */
+    static int
+nfa_count_grow()
+{
+    int		size;
+    nfa_count_T	*table;
+    nfa_count_T	*nc;
+    int		i;
+
+    size = nfa_seen_count_size == 0 ? NFA_COUNT_INITIAL
+						    : nfa_seen_count_size * 2;
+    table = (nfa_count_T *)alloc_clear((unsigned)(size * sizeof(nfa_count_T)));
+    if (table == NULL)
+	return FAIL;
+    for (i = 0; i < nfa_seen_count_size; ++i)
+    {
+	nc = &nfa_seen_count[i];
+	if (nc->nc_step == nfa_step)
+	    *nfa_count_find(table, size, nc->nc_scan, nc->nc_count,
+							   nc->nc_back) = *nc;
+    }
+    vim_free(nfa_seen_count);
+    nfa_seen_count = table;
+    nfa_seen_count_size = size;
+    return OK;
+}
+
+/*
+ * Return TRUE if a thread for node "scan" with "count" was already added in
+ * this step.  "back" is TRUE after passing a BACK node.  Otherwise remember
+ * it and return FALSE.
+ */
+    static int
+nfa_seen_before(scan, count, back)
+    char_u	*scan;
+    long	count;
+    int		back;
+{
+    int		*seen;
+    nfa_count_T	*nc;
+
+    if (count == 0)
+    {
+	seen = (int *)nfa_seen.ga_data + (scan - nfa_prog->program);
+	if (back)
+	    seen += nfa_prog->regsize;
+	if (*seen == nfa_step)
+	    return TRUE;
+	*seen = nfa_step;
+	return FALSE;
+    }
+
+    /* Keep the table at most half full. */
+    if (nfa_seen_count_used * 2 >= nfa_seen_count_size
+					       && nfa_count_grow() == FAIL)
+    {
+	nfa_fail = TRUE;
+	return TRUE;
+    }
+    nc = nfa_count_find(nfa_seen_count, nfa_seen_count_size,
+							  scan, count, back);
+    if (nc->nc_step == nfa_step)
+	return TRUE;
+    nc->nc_scan = scan;
+    nc->nc_count = count;
+    nc->nc_back = back;
+    nc->nc_step = nfa_step;
+    ++nfa_seen_count_used;
+    return FALSE;
+}
+
+/*
+ * Append thread "t" to "nfa_next".
+ */
+    static void
+nfa_push(t)
+    nfa_thread_T *t;
+{
+    if ((long)((unsigned)(nfa_next->ga_len * sizeof(nfa_thread_T)) >> 10)
+								     >= p_mmp)
+    {
+	/* vim_regexec_both() tries the backtracking engine instead. */
+	nfa_toobig = TRUE;
+	nfa_fail = TRUE;
+    }
+    else if (ga_grow(nfa_next, 1) == FAIL)
+	nfa_fail = TRUE;
+    else
+	((nfa_thread_T *)nfa_next->ga_data)[nfa_next->ga_len++] = *t;
+}
+
+/*
+ * Add a thread for "nfa_cur" to "nfa_next": node "scan" is to be matched at
+ * the current input position.
+ */
+    static void
+nfa_add(scan, count)
+    char_u	*scan;
+    long	count;
+{
+    lpos_T	pos;
+
+    pos = nfa_cur.nt_pos;
+    nfa_cur.nt_scan = scan;
+    nfa_cur.nt_count = count;
+    nfa_cur.nt_pos.lnum = rex.lnum;
+    nfa_cur.nt_pos.col = (colnr_T)(rex.input - rex.line);
+    nfa_push(&nfa_cur);
+    nfa_cur.nt_pos = pos;
+}
+
+/*
+ * Try matching the operand of STAR, PLUS or BRACE_SIMPLE node "scan" once
+ * more.  "count" is the number of times it matched so far, "minval" and
+ * "maxval" the limits.
+ */
+    static void
+nfa_repeat(scan, count, minval, maxval)
+    char_u	*scan;
+    long	count;
+    long	minval;
+    long	maxval;
+{
+    if (nfa_cut || nfa_fail || count >= maxval)
+	return;
+    nfa_setpos(&nfa_cur.nt_pos);
+    if (regrepeat(OPERAND(scan), 1L) == 1)
+    {
+	/* Without a maximum all counts above the minimum are equal. */
+	if (++count > minval && maxval == MAX_LIMIT)
+	    count = minval;
+	nfa_add(scan, count);
+    }
+}
+
+/*
+ * "nfa_cur" arrived at the end of the program: remember the match and skip
+ * all threads with a lower priority.
+ */
+    static void
+nfa_found()
+{
+    nfa_match = nfa_cur;
+    nfa_matched = TRUE;
+    nfa_cut = TRUE;
+}
+
+/*
+ * Add the thread in "nfa_cur" at node "scan".  Nodes that don't match text
+ * are followed right away, until a node that matches text.  The thread for
+ * what comes after that is added to "nfa_next".
+ * "back" is TRUE when a BACK node was passed at this position.
+ * "rex.input" is not used, the position is "nfa_cur.nt_pos".
+ */
+    static void
+nfa_addstate(scan, count, back)
+    char_u	*scan;
+    long	count;
+    int		back;
+{
+    char_u	*next;
+    int		op;
+    int		no;
+    int		status;
+    lpos_T	save;
+    long	minval;
+    long	maxval;
+
+    for (;;)
+    {
+	if (nfa_cut || nfa_fail || scan == NULL)
+	    return;
+	++rex.reg_steps;
+	next = regnext(scan);
+	op = OP(scan);
+
+	/* Like in regmatch() a BACK fails when it was passed before at the
+	 * same position.  Nodes after it may be tried again, an empty match
+	 * of the loop may set submatches. */
+	if (nfa_seen_before(scan, count, op == BACK ? FALSE : back))
+	    return;
+	if (op == BACK)
+	    back = TRUE;
+
+	switch (op)
 	{
-	    int	    cu, cl;
+	  case NOTHING:
+	  case BACK:
+	  case NOPEN:
+	  case NCLOSE:
+	  case BRACE_LIMITS:
+	    break;
 
-	    /* This doesn't do a multi-byte character, because a MULTIBYTECODE
-	     * would have been used for it.  It does handle single-byte
-	     * characters, such as latin1. */
-	    if (ireg_ic)
+	  case BRANCH:
+	    if (OP(next) != BRANCH) /* No choice. */
 	    {
-		cu = MB_TOUPPER(*opnd);
-		cl = MB_TOLOWER(*opnd);
-		while (count < maxcount && (*scan == cu || *scan == cl))
-		{
-		    count++;
-		    scan++;
-		}
+		next = OPERAND(scan);
+		break;
+	    }
+	    /* Add the alternatives in order of priority. */
+	    for ( ; scan != NULL && OP(scan) == BRANCH; scan = regnext(scan))
+		nfa_addstate(OPERAND(scan), 0L, back);
+	    return;
+
+	  case MOPEN + 0:
+	  case MOPEN + 1:
+	  case MOPEN + 2:
+	  case MOPEN + 3:
+	  case MOPEN + 4:
+	  case MOPEN + 5:
+	  case MOPEN + 6:
+	  case MOPEN + 7:
+	  case MOPEN + 8:
+	  case MOPEN + 9:
+	    no = op - MOPEN;
+	    save = nfa_cur.nt_startpos[no];
+	    nfa_cur.nt_startpos[no] = nfa_cur.nt_pos;
+	    nfa_addstate(next, 0L, back);
+	    nfa_cur.nt_startpos[no] = save;
+	    return;
+
+	  case MCLOSE + 0:
+	  case MCLOSE + 1:
+	  case MCLOSE + 2:
+	  case MCLOSE + 3:
+	  case MCLOSE + 4:
+	  case MCLOSE + 5:
+	  case MCLOSE + 6:
+	  case MCLOSE + 7:
+	  case MCLOSE + 8:
+	  case MCLOSE + 9:
+	    no = op - MCLOSE;
+	    save = nfa_cur.nt_endpos[no];
+	    nfa_cur.nt_endpos[no] = nfa_cur.nt_pos;
+	    nfa_addstate(next, 0L, back);
+	    nfa_cur.nt_endpos[no] = save;
+	    return;
+
+	  case BRACE_SIMPLE:
+	  case STAR:
+	  case PLUS:
+	    if (op == BRACE_SIMPLE)
+	    {
+		/* The BRACE_LIMITS node comes just before. */
+		minval = OPERAND_MIN(scan - 11);
+		maxval = OPERAND_MAX(scan - 11);
 	    }
 	    else
 	    {
-		cu = *opnd;
-		while (count < maxcount && *scan == cu)
-		{
-		    count++;
-		    scan++;
-		}
+		minval = (op == STAR) ? 0 : 1;
+		maxval = MAX_LIMIT;
+	    }
+	    if (minval <= maxval)
+	    {
+		/* Longest match first: one more has priority. */
+		nfa_repeat(scan, count, minval, maxval);
+		if (count < minval)
+		    return;
+	    }
+	    else
+	    {
+		/* Range is backwards, use shortest match first.  Careful:
+		 * maxval and minval are exchanged! */
+		if (count >= maxval)
+		    nfa_addstate(next, 0L, back);
+		nfa_repeat(scan, count, maxval, minval);
+		return;
 	    }
 	    break;
-	}
 
-#ifdef FEAT_MBYTE
-      case MULTIBYTECODE:
-	{
-	    int		i, len, cf = 0;
+	  case END:
+	    nfa_found();
+	    return;
 
-	    /* Safety check (just in case 'encoding' was changed since
-	     * compiling the program). */
-	    if ((len = (*mb_ptr2len)(opnd)) > 1)
+	  default:
+	    nfa_setpos(&nfa_cur.nt_pos);
+	    status = regmatch_item(scan);
+	    if (status == 0)
 	    {
-		if (ireg_ic && enc_utf8)
-		    cf = utf_fold(utf_ptr2char(opnd));
-		while (count < maxcount)
-		{
-		    for (i = 0; i < len; ++i)
-			if (opnd[i] != scan[i])
-			    break;
-		    if (i < len && (!ireg_ic || !enc_utf8
-					|| utf_fold(utf_ptr2char(scan)) != cf))
-			break;
-		    scan += len;
-		    ++count;
-		}
+		EMSG(_(e_re_corr));
+		nfa_fail = TRUE;
+		return;
 	    }
+	    if (status == RA_NOMATCH)
+		return;
+	    if (status == RA_MATCH)
+	    {
+		/* Matched a composing character, done. */
+		nfa_add(NULL, 0L);
+		return;
+	    }
+	    if (rex.lnum != nfa_cur.nt_pos.lnum
+		    || (colnr_T)(rex.input - rex.line) != nfa_cur.nt_pos.col)
+	    {
+		/* Matched some text, continue in the next step. */
+		nfa_add(next, 0L);
+		return;
+	    }
+	    break;
 	}
-	break;
+
+	/* Zero-width match, continue with the next node. */
+	scan = next;
+	count = 0;
+    }
+}
+
+/*
+ * Return the first column in line 0 at or after "col" where a match could
+ * start.  Return MAXCOL if there is none.
+ */
+    static colnr_T
+nfa_startcol(prog, col)
+    regprog_T	*prog;
+    colnr_T	col;
+{
+    lpos_T	pos;
+    char_u	*s;
+
+    pos.lnum = 0;
+    pos.col = col;
+    nfa_setpos(&pos);
+    s = reg_skip_start(prog, rex.input);
+    if (s == NULL)
+	return MAXCOL;
+    col = (colnr_T)(s - rex.line);
+
+    /* Check for maximum column to try. */
+    if (rex.reg_maxcol > 0 && col >= rex.reg_maxcol)
+	return MAXCOL;
+    return col;
+}
+
+/*
+ * nfa_regmatch - match "prog" at rex.line["col"] or after it with the NFA
+ * engine.  Only tries at "col" for an anchored pattern.
+ * Returns 0 for failure, number of lines contained in the match otherwise.
+ */
+    static long
+nfa_regmatch(prog, col, tm)
+    regprog_T	*prog;
+    colnr_T	col;
+    proftime_T	*tm UNUSED;	/* timeout limit or NULL */
+{
+    garray_T	*clist;
+    nfa_thread_T *t;
+    lpos_T	cur;
+    colnr_T	startcol;	/* where to start a thread, MAXCOL for none */
+    int		i;
+#ifdef FEAT_RELTIME
+    int		tm_count = 0;
 #endif
 
-      case ANYOF:
-      case ANYOF + ADD_NL:
-	testval = TRUE;
-	/*FALLTHROUGH*/
+    for (i = 0; i < 2; ++i)
+	if (nfa_list[i].ga_data == NULL)
+	    ga_init2(&nfa_list[i], sizeof(nfa_thread_T), NFA_LIST_INITIAL);
+    if (nfa_seen.ga_maxlen < prog->regsize * 2)
+    {
+	/* New memory is cleared, thus lower than any step number. */
+	ga_clear(&nfa_seen);
+	ga_init2(&nfa_seen, sizeof(int), 1);
+	if (ga_grow(&nfa_seen, (int)prog->regsize * 2) == FAIL)
+	    return 0;
+    }
 
-      case ANYBUT:
-      case ANYBUT + ADD_NL:
-	while (count < maxcount)
+    nfa_prog = prog;
+    nfa_matched = FALSE;
+    nfa_fail = FALSE;
+    nfa_toobig = FALSE;
+    clist = &nfa_list[0];
+    clist->ga_len = 0;
+    cur.lnum = 0;
+    cur.col = col;
+    if (prog->reganch)
+	startcol = col;
+    else
+	startcol = nfa_startcol(prog, col);
+    if (startcol == MAXCOL)
+	return 0;
+    cur.col = startcol;
+
+    for (;;)
+    {
+	/* Allow breaking off, just like in regmatch(). */
+	fast_breakcheck();
+	if (got_int)
+	    break;
+	if (rex.reg_steps > rex.reg_maxsteps)
 	{
-#ifdef FEAT_MBYTE
-	    int len;
+	    reg_toomanysteps();
+	    got_int = TRUE;
+	    break;
+	}
+#ifdef FEAT_RELTIME
+	/* Check for timeout once in a twenty times to avoid overhead. */
+	if (tm != NULL && ++tm_count == 20)
+	{
+	    tm_count = 0;
+	    if (profile_passed_limit(tm))
+		break;
+	}
 #endif
-	    if (*scan == NUL)
+
+	/* Start a new step: no thread was added yet. */
+	if (nfa_step >= 0x7ffffff0)
+	{
+	    vim_memset(nfa_seen.ga_data, 0,
+				    (size_t)nfa_seen.ga_maxlen * sizeof(int));
+	    if (nfa_seen_count != NULL)
+		vim_memset(nfa_seen_count, 0,
+			   (size_t)nfa_seen_count_size * sizeof(nfa_count_T));
+	    nfa_step = 0;
+	}
+	++nfa_step;
+	nfa_seen_count_used = 0;
+	nfa_cut = FALSE;
+	nfa_next = (clist == &nfa_list[0]) ? &nfa_list[1] : &nfa_list[0];
+	nfa_next->ga_len = 0;
+
+	/* Handle the threads waiting for this position, in order of
+	 * priority, and pass on the others. */
+	t = (nfa_thread_T *)clist->ga_data;
+	for (i = 0; i < clist->ga_len && !nfa_cut && !nfa_fail; ++i)
+	{
+	    if (t[i].nt_pos.lnum == cur.lnum && t[i].nt_pos.col == cur.col)
 	    {
-		if (!REG_MULTI || !WITH_NL(OP(p)) || reglnum > reg_maxline
-							      || reg_line_lbr)
-		    break;
-		reg_nextline();
-		scan = reginput;
-		if (got_int)
-		    break;
+		nfa_cur = t[i];
+		if (nfa_cur.nt_scan == NULL)
+		    nfa_found();
+		else
+		    nfa_addstate(nfa_cur.nt_scan, nfa_cur.nt_count, FALSE);
 	    }
-	    else if (reg_line_lbr && *scan == '\n' && WITH_NL(OP(p)))
-		++scan;
-#ifdef FEAT_MBYTE
-	    else if (has_mbyte && (len = (*mb_ptr2len)(scan)) > 1)
+	    else
+		nfa_push(&t[i]);
+	}
+
+	/* A thread starting here has the lowest priority. */
+	if (!nfa_cut && !nfa_fail && !nfa_matched
+			&& startcol != MAXCOL && cur.lnum == 0
+			&& cur.col == startcol)
+	{
+	    for (i = 0; i < NSUBEXP; ++i)
 	    {
-		if ((cstrchr(opnd, (*mb_ptr2char)(scan)) == NULL) == testval)
-		    break;
-		scan += len;
+		nfa_cur.nt_startpos[i].lnum = -1;
+		nfa_cur.nt_startpos[i].col = 0;
+		nfa_cur.nt_endpos[i].lnum = -1;
+		nfa_cur.nt_endpos[i].col = 0;
 	    }
-#endif
+	    nfa_cur.nt_pos = cur;
+	    nfa_cur.nt_startpos[0] = cur;
+	    nfa_addstate(prog->program + 1, 0L, FALSE);
+
+	    nfa_setpos(&cur);
+	    if (prog->reganch || *rex.input == NUL)
+		startcol = MAXCOL;
 	    else
 	    {
-		if ((cstrchr(opnd, *scan) == NULL) == testval)
-		    break;
-		++scan;
+#ifdef FEAT_MBYTE
+		if (has_mbyte)
+		    startcol += (*mb_ptr2len)(rex.input);
+		else
+#endif
+		    ++startcol;
+		startcol = nfa_startcol(prog, startcol);
 	    }
-	    ++count;
 	}
-	break;
+	if (nfa_fail)
+	    break;
 
-      case NEWL:
-	while (count < maxcount
-		&& ((*scan == NUL && reglnum <= reg_maxline && !reg_line_lbr
-			    && REG_MULTI) || (*scan == '\n' && reg_line_lbr)))
+	clist = nfa_next;
+	if (nfa_matched)
+	    startcol = MAXCOL;
+	if (clist->ga_len == 0 && startcol == MAXCOL)
+	    break;
+
+	/* Continue at the first position a thread is waiting for, or where
+	 * the next thread starts. */
+	if (startcol != MAXCOL)
 	{
-	    count++;
-	    if (reg_line_lbr)
-		ADVANCE_REGINPUT();
-	    else
-		reg_nextline();
-	    scan = reginput;
-	    if (got_int)
-		break;
+	    cur.lnum = 0;
+	    cur.col = startcol;
 	}
-	break;
-
-      default:			/* Oh dear.  Called inappropriately. */
-	EMSG(_(e_re_corr));
-#ifdef DEBUG
-	printf("Called regrepeat with op code %d\n", OP(p));
-#endif
-	break;
+	else
+	    cur = ((nfa_thread_T *)clist->ga_data)[0].nt_pos;
+	t = (nfa_thread_T *)clist->ga_data;
+	for (i = 0; i < clist->ga_len; ++i)
+	    if (t[i].nt_pos.lnum < cur.lnum || (t[i].nt_pos.lnum == cur.lnum
+						&& t[i].nt_pos.col < cur.col))
+		cur = t[i].nt_pos;
     }
 
-    reginput = scan;
+    if (!nfa_matched || nfa_fail || got_int)
+	return 0;
 
-    return (int)count;
+    if (REG_MULTI)
+    {
+	for (i = 0; i < NSUBEXP; ++i)
+	{
+	    rex.reg_startpos[i] = nfa_match.nt_startpos[i];
+	    rex.reg_endpos[i] = nfa_match.nt_endpos[i];
+	}
+	if (rex.reg_endpos[0].lnum < 0)
+	    rex.reg_endpos[0] = nfa_match.nt_pos;
+	/* Use line number of "\ze". */
+	rex.lnum = rex.reg_endpos[0].lnum;
+    }
+    else
+    {
+	for (i = 0; i < NSUBEXP; ++i)
+	{
+	    rex.reg_startp[i] = nfa_match.nt_startpos[i].lnum < 0 ? NULL
+				     : rex.line + nfa_match.nt_startpos[i].col;
+	    rex.reg_endp[i] = nfa_match.nt_endpos[i].lnum < 0 ? NULL
+				       : rex.line + nfa_match.nt_endpos[i].col;
+	}
+	if (rex.reg_endp[0] == NULL)
+	    rex.reg_endp[0] = rex.line + nfa_match.nt_pos.col;
+	rex.lnum = 0;
+    }
+#ifdef FEAT_SYN_HL
+    /* No \z(...\) matches to export. */
+    unref_extmatch(re_extmatch_out);
+    re_extmatch_out = NULL;
+#endif
+    return 1 + rex.lnum;
 }
 
 /*
@@ -5808,8 +7551,8 @@ regnext(p)
 prog_magic_wrong()
 {
     if (UCHARAT(REG_MULTI
-		? reg_mmatch->regprog->program
-		: reg_match->regprog->program) != REGMAGIC)
+		? rex.reg_mmatch->regprog->program
+		: rex.reg_match->regprog->program) != REGMAGIC)
     {
 	EMSG(_(e_re_corr));
 	return TRUE;
@@ -5825,20 +7568,20 @@ prog_magic_wrong()
     static void
 cleanup_subexpr()
 {
-    if (need_clear_subexpr)
+    if (rex.need_clear_subexpr)
     {
 	if (REG_MULTI)
 	{
 	    /* Use 0xff to set lnum to -1 */
-	    vim_memset(reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-	    vim_memset(reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex.reg_startpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex.reg_endpos, 0xff, sizeof(lpos_T) * NSUBEXP);
 	}
 	else
 	{
-	    vim_memset(reg_startp, 0, sizeof(char_u *) * NSUBEXP);
-	    vim_memset(reg_endp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex.reg_startp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex.reg_endp, 0, sizeof(char_u *) * NSUBEXP);
 	}
-	need_clear_subexpr = FALSE;
+	rex.need_clear_subexpr = FALSE;
     }
 }
 
@@ -5846,20 +7589,20 @@ cleanup_subexpr()
     static void
 cleanup_zsubexpr()
 {
-    if (need_clear_zsubexpr)
+    if (rex.need_clear_zsubexpr)
     {
 	if (REG_MULTI)
 	{
 	    /* Use 0xff to set lnum to -1 */
-	    vim_memset(reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
-	    vim_memset(reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex.reg_startzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
+	    vim_memset(rex.reg_endzpos, 0xff, sizeof(lpos_T) * NSUBEXP);
 	}
 	else
 	{
-	    vim_memset(reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
-	    vim_memset(reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex.reg_startzp, 0, sizeof(char_u *) * NSUBEXP);
+	    vim_memset(rex.reg_endzp, 0, sizeof(char_u *) * NSUBEXP);
 	}
-	need_clear_zsubexpr = FALSE;
+	rex.need_clear_zsubexpr = FALSE;
     }
 }
 #endif
@@ -5874,22 +7617,22 @@ save_subexpr(bp)
 {
     int i;
 
-    /* When "need_clear_subexpr" is set we don't need to save the values, only
+    /* When "rex.need_clear_subexpr" is set we don't need to save the values, only
      * remember that this flag needs to be set again when restoring. */
-    bp->save_need_clear_subexpr = need_clear_subexpr;
-    if (!need_clear_subexpr)
+    bp->save_need_clear_subexpr = rex.need_clear_subexpr;
+    if (!rex.need_clear_subexpr)
     {
 	for (i = 0; i < NSUBEXP; ++i)
 	{
 	    if (REG_MULTI)
 	    {
-		bp->save_start[i].se_u.pos = reg_startpos[i];
-		bp->save_end[i].se_u.pos = reg_endpos[i];
+		bp->save_start[i].se_u.pos = rex.reg_startpos[i];
+		bp->save_end[i].se_u.pos = rex.reg_endpos[i];
 	    }
 	    else
 	    {
-		bp->save_start[i].se_u.ptr = reg_startp[i];
-		bp->save_end[i].se_u.ptr = reg_endp[i];
+		bp->save_start[i].se_u.ptr = rex.reg_startp[i];
+		bp->save_end[i].se_u.ptr = rex.reg_endp[i];
 	    }
 	}
     }
@@ -5905,33 +7648,33 @@ restore_subexpr(bp)
     int i;
 
     /* Only need to restore saved values when they are not to be cleared. */
-    need_clear_subexpr = bp->save_need_clear_subexpr;
-    if (!need_clear_subexpr)
+    rex.need_clear_subexpr = bp->save_need_clear_subexpr;
+    if (!rex.need_clear_subexpr)
     {
 	for (i = 0; i < NSUBEXP; ++i)
 	{
 	    if (REG_MULTI)
 	    {
-		reg_startpos[i] = bp->save_start[i].se_u.pos;
-		reg_endpos[i] = bp->save_end[i].se_u.pos;
+		rex.reg_startpos[i] = bp->save_start[i].se_u.pos;
+		rex.reg_endpos[i] = bp->save_end[i].se_u.pos;
 	    }
 	    else
 	    {
-		reg_startp[i] = bp->save_start[i].se_u.ptr;
-		reg_endp[i] = bp->save_end[i].se_u.ptr;
+		rex.reg_startp[i] = bp->save_start[i].se_u.ptr;
+		rex.reg_endp[i] = bp->save_end[i].se_u.ptr;
 	    }
 	}
     }
 }
 
 /*
- * Advance reglnum, regline and reginput to the next line.
+ * Advance rex.lnum, rex.line and rex.input to the next line.
  */
     static void
 reg_nextline()
 {
-    regline = reg_getline(++reglnum);
-    reginput = regline;
+    rex.line = reg_getline(++rex.lnum);
+    rex.input = rex.line;
     fast_breakcheck();
 }
 
@@ -5945,35 +7688,37 @@ reg_save(save, gap)
 {
     if (REG_MULTI)
     {
-	save->rs_u.pos.col = (colnr_T)(reginput - regline);
-	save->rs_u.pos.lnum = reglnum;
+	save->rs_u.pos.col = (colnr_T)(rex.input - rex.line);
+	save->rs_u.pos.lnum = rex.lnum;
     }
     else
-	save->rs_u.ptr = reginput;
+	save->rs_u.ptr = rex.input;
     save->rs_len = gap->ga_len;
 }
 
 /*
- * Restore the input line and position from a regsave_T.
+ * Restore the input line and position from a regsave_T.  This is a
+ * backtrack, counted for ":regstats".
  */
     static void
 reg_restore(save, gap)
     regsave_T	*save;
     garray_T	*gap;
 {
+    ++rex.reg_backtracks;
     if (REG_MULTI)
     {
-	if (reglnum != save->rs_u.pos.lnum)
+	if (rex.lnum != save->rs_u.pos.lnum)
 	{
 	    /* only call reg_getline() when the line number changed to save
 	     * a bit of time */
-	    reglnum = save->rs_u.pos.lnum;
-	    regline = reg_getline(reglnum);
+	    rex.lnum = save->rs_u.pos.lnum;
+	    rex.line = reg_getline(rex.lnum);
 	}
-	reginput = regline + save->rs_u.pos.col;
+	rex.input = rex.line + save->rs_u.pos.col;
     }
     else
-	reginput = save->rs_u.ptr;
+	rex.input = save->rs_u.ptr;
     gap->ga_len = save->rs_len;
 }
 
@@ -5985,9 +7730,9 @@ reg_save_equal(save)
     regsave_T	*save;
 {
     if (REG_MULTI)
-	return reglnum == save->rs_u.pos.lnum
-				  && reginput == regline + save->rs_u.pos.col;
-    return reginput == save->rs_u.ptr;
+	return rex.lnum == save->rs_u.pos.lnum
+				  && rex.input == rex.line + save->rs_u.pos.col;
+    return rex.input == save->rs_u.ptr;
 }
 
 /*
@@ -6003,8 +7748,8 @@ save_se_multi(savep, posp)
     lpos_T	*posp;
 {
     savep->se_u.pos = *posp;
-    posp->lnum = reglnum;
-    posp->col = (colnr_T)(reginput - regline);
+    posp->lnum = rex.lnum;
+    posp->col = (colnr_T)(rex.input - rex.line);
 }
 
     static void
@@ -6013,7 +7758,7 @@ save_se_one(savep, pp)
     char_u	**pp;
 {
     savep->se_u.ptr = *pp;
-    *pp = reginput;
+    *pp = rex.input;
 }
 
 /*
@@ -6566,7 +8311,7 @@ mb_decompose(c, c1, c2, c3)
 #endif
 
 /*
- * Compare two strings, ignore case if ireg_ic set.
+ * Compare two strings, ignore case if rex.reg_ic set.
  * Return 0 if strings match, non-zero otherwise.
  * Correct the length "*n" when composing characters are ignored.
  */
@@ -6577,14 +8322,14 @@ cstrncmp(s1, s2, n)
 {
     int		result;
 
-    if (!ireg_ic)
+    if (!rex.reg_ic)
 	result = STRNCMP(s1, s2, *n);
     else
 	result = MB_STRNICMP(s1, s2, *n);
 
 #ifdef FEAT_MBYTE
     /* if it failed and it's utf8 and we want to combineignore: */
-    if (result != 0 && enc_utf8 && ireg_icombine)
+    if (result != 0 && enc_utf8 && rex.reg_icombine)
     {
 	char_u	*str1, *str2;
 	int	c1, c2, c11, c12;
@@ -6603,14 +8348,14 @@ cstrncmp(s1, s2, n)
 	    /* decompose the character if necessary, into 'base' characters
 	     * because I don't care about Arabic, I will hard-code the Hebrew
 	     * which I *do* care about!  So sue me... */
-	    if (c1 != c2 && (!ireg_ic || utf_fold(c1) != utf_fold(c2)))
+	    if (c1 != c2 && (!rex.reg_ic || utf_fold(c1) != utf_fold(c2)))
 	    {
 		/* decomposition necessary? */
 		mb_decompose(c1, &c11, &junk, &junk);
 		mb_decompose(c2, &c12, &junk, &junk);
 		c1 = c11;
 		c2 = c12;
-		if (c11 != c12 && (!ireg_ic || utf_fold(c11) != utf_fold(c12)))
+		if (c11 != c12 && (!rex.reg_ic || utf_fold(c11) != utf_fold(c12)))
 		    break;
 	    }
 	}
@@ -6634,7 +8379,7 @@ cstrchr(s, c)
     char_u	*p;
     int		cc;
 
-    if (!ireg_ic
+    if (!rex.reg_ic
 #ifdef FEAT_MBYTE
 	    || (!enc_utf8 && mb_char2len(c) > 1)
 #endif
@@ -6822,14 +8567,6 @@ regtilde(source, magic)
 
 #ifdef FEAT_EVAL
 static int can_f_submatch = FALSE;	/* TRUE when submatch() can be used */
-
-/* These pointers are used instead of reg_match and reg_mmatch for
- * reg_submatch().  Needed for when the substitution string is an expression
- * that contains a call to substitute() and submatch(). */
-static regmatch_T	*submatch_match;
-static regmmatch_T	*submatch_mmatch;
-static linenr_T		submatch_firstlnum;
-static linenr_T		submatch_maxline;
 #endif
 
 #if defined(FEAT_MODIFY_FNAME) || defined(FEAT_EVAL) || defined(PROTO)
@@ -6860,10 +8597,24 @@ vim_regsub(rmp, source, dest, copy, magic, backslash)
     int		magic;
     int		backslash;
 {
-    reg_match = rmp;
-    reg_mmatch = NULL;
-    reg_maxline = 0;
-    return vim_regsub_both(source, dest, copy, magic, backslash);
+    int		result;
+    regexec_T	rex_save;
+    int		rex_in_use_save = rex_in_use;
+
+    if (rex_in_use)
+	/* Being called recursively, save the state. */
+	rex_save = rex;
+    rex_in_use = TRUE;
+
+    rex.reg_match = rmp;
+    rex.reg_mmatch = NULL;
+    rex.reg_maxline = 0;
+    result = vim_regsub_both(source, dest, copy, magic, backslash);
+
+    rex_in_use = rex_in_use_save;
+    if (rex_in_use)
+	rex = rex_save;
+    return result;
 }
 #endif
 
@@ -6877,12 +8628,26 @@ vim_regsub_multi(rmp, lnum, source, dest, copy, magic, backslash)
     int		magic;
     int		backslash;
 {
-    reg_match = NULL;
-    reg_mmatch = rmp;
-    reg_buf = curbuf;		/* always works on the current buffer! */
-    reg_firstlnum = lnum;
-    reg_maxline = curbuf->b_ml.ml_line_count - lnum;
-    return vim_regsub_both(source, dest, copy, magic, backslash);
+    int		result;
+    regexec_T	rex_save;
+    int		rex_in_use_save = rex_in_use;
+
+    if (rex_in_use)
+	/* Being called recursively, save the state. */
+	rex_save = rex;
+    rex_in_use = TRUE;
+
+    rex.reg_match = NULL;
+    rex.reg_mmatch = rmp;
+    rex.reg_buf = curbuf;		/* always works on the current buffer! */
+    rex.reg_firstlnum = lnum;
+    rex.reg_maxline = curbuf->b_ml.ml_line_count - lnum;
+    result = vim_regsub_both(source, dest, copy, magic, backslash);
+
+    rex_in_use = rex_in_use_save;
+    if (rex_in_use)
+	rex = rex_save;
+    return result;
 }
 
     static int
@@ -6943,21 +8708,11 @@ vim_regsub_both(source, dest, copy, magic, backslash)
 	}
 	else
 	{
-	    win_T	*save_reg_win;
-	    int		save_ireg_ic;
-
 	    vim_free(eval_result);
 
 	    /* The expression may contain substitute(), which calls us
-	     * recursively.  Make sure submatch() gets the text from the first
-	     * level.  Don't need to save "reg_buf", because
-	     * vim_regexec_multi() can't be called recursively. */
-	    submatch_match = reg_match;
-	    submatch_mmatch = reg_mmatch;
-	    submatch_firstlnum = reg_firstlnum;
-	    submatch_maxline = reg_maxline;
-	    save_reg_win = reg_win;
-	    save_ireg_ic = ireg_ic;
+	     * recursively.  That saves and restores "rex", thus submatch()
+	     * gets the text from this level. */
 	    can_f_submatch = TRUE;
 
 	    eval_result = eval_to_string(source + 2, NULL, TRUE);
@@ -6976,12 +8731,6 @@ vim_regsub_both(source, dest, copy, magic, backslash)
 		dst += STRLEN(eval_result);
 	    }
 
-	    reg_match = submatch_match;
-	    reg_mmatch = submatch_mmatch;
-	    reg_firstlnum = submatch_firstlnum;
-	    reg_maxline = submatch_maxline;
-	    reg_win = save_reg_win;
-	    ireg_ic = save_ireg_ic;
 	    can_f_submatch = FALSE;
 	}
 #endif
@@ -7092,26 +8841,26 @@ vim_regsub_both(source, dest, copy, magic, backslash)
 	{
 	    if (REG_MULTI)
 	    {
-		clnum = reg_mmatch->startpos[no].lnum;
-		if (clnum < 0 || reg_mmatch->endpos[no].lnum < 0)
+		clnum = rex.reg_mmatch->startpos[no].lnum;
+		if (clnum < 0 || rex.reg_mmatch->endpos[no].lnum < 0)
 		    s = NULL;
 		else
 		{
-		    s = reg_getline(clnum) + reg_mmatch->startpos[no].col;
-		    if (reg_mmatch->endpos[no].lnum == clnum)
-			len = reg_mmatch->endpos[no].col
-					       - reg_mmatch->startpos[no].col;
+		    s = reg_getline(clnum) + rex.reg_mmatch->startpos[no].col;
+		    if (rex.reg_mmatch->endpos[no].lnum == clnum)
+			len = rex.reg_mmatch->endpos[no].col
+					       - rex.reg_mmatch->startpos[no].col;
 		    else
 			len = (int)STRLEN(s);
 		}
 	    }
 	    else
 	    {
-		s = reg_match->startp[no];
-		if (reg_match->endp[no] == NULL)
+		s = rex.reg_match->startp[no];
+		if (rex.reg_match->endp[no] == NULL)
 		    s = NULL;
 		else
-		    len = (int)(reg_match->endp[no] - s);
+		    len = (int)(rex.reg_match->endp[no] - s);
 	    }
 	    if (s != NULL)
 	    {
@@ -7121,14 +8870,14 @@ vim_regsub_both(source, dest, copy, magic, backslash)
 		    {
 			if (REG_MULTI)
 			{
-			    if (reg_mmatch->endpos[no].lnum == clnum)
+			    if (rex.reg_mmatch->endpos[no].lnum == clnum)
 				break;
 			    if (copy)
 				*dst = CAR;
 			    ++dst;
 			    s = reg_getline(++clnum);
-			    if (reg_mmatch->endpos[no].lnum == clnum)
-				len = reg_mmatch->endpos[no].col;
+			    if (rex.reg_mmatch->endpos[no].lnum == clnum)
+				len = rex.reg_mmatch->endpos[no].col;
 			    else
 				len = (int)STRLEN(s);
 			}
@@ -7214,31 +8963,6 @@ exit:
 }
 
 #ifdef FEAT_EVAL
-static char_u *reg_getline_submatch __ARGS((linenr_T lnum));
-
-/*
- * Call reg_getline() with the line numbers from the submatch.  If a
- * substitute() was used the reg_maxline and other values have been
- * overwritten.
- */
-    static char_u *
-reg_getline_submatch(lnum)
-    linenr_T	lnum;
-{
-    char_u *s;
-    linenr_T save_first = reg_firstlnum;
-    linenr_T save_max = reg_maxline;
-
-    reg_firstlnum = submatch_firstlnum;
-    reg_maxline = submatch_maxline;
-
-    s = reg_getline(lnum);
-
-    reg_firstlnum = save_first;
-    reg_maxline = save_max;
-    return s;
-}
-
 /*
  * Used for the submatch() function: get the string from the n'th submatch in
  * allocated memory.
@@ -7257,7 +8981,7 @@ reg_submatch(no)
     if (!can_f_submatch || no < 0)
 	return NULL;
 
-    if (submatch_match == NULL)
+    if (rex.reg_match == NULL)
     {
 	/*
 	 * First round: compute the length and allocate memory.
@@ -7265,18 +8989,18 @@ reg_submatch(no)
 	 */
 	for (round = 1; round <= 2; ++round)
 	{
-	    lnum = submatch_mmatch->startpos[no].lnum;
-	    if (lnum < 0 || submatch_mmatch->endpos[no].lnum < 0)
+	    lnum = rex.reg_mmatch->startpos[no].lnum;
+	    if (lnum < 0 || rex.reg_mmatch->endpos[no].lnum < 0)
 		return NULL;
 
-	    s = reg_getline_submatch(lnum) + submatch_mmatch->startpos[no].col;
+	    s = reg_getline(lnum) + rex.reg_mmatch->startpos[no].col;
 	    if (s == NULL)  /* anti-crash check, cannot happen? */
 		break;
-	    if (submatch_mmatch->endpos[no].lnum == lnum)
+	    if (rex.reg_mmatch->endpos[no].lnum == lnum)
 	    {
 		/* Within one line: take form start to end col. */
-		len = submatch_mmatch->endpos[no].col
-					  - submatch_mmatch->startpos[no].col;
+		len = rex.reg_mmatch->endpos[no].col
+					  - rex.reg_mmatch->startpos[no].col;
 		if (round == 2)
 		    vim_strncpy(retval, s, len);
 		++len;
@@ -7293,9 +9017,9 @@ reg_submatch(no)
 		}
 		++len;
 		++lnum;
-		while (lnum < submatch_mmatch->endpos[no].lnum)
+		while (lnum < rex.reg_mmatch->endpos[no].lnum)
 		{
-		    s = reg_getline_submatch(lnum++);
+		    s = reg_getline(lnum++);
 		    if (round == 2)
 			STRCPY(retval + len, s);
 		    len += (int)STRLEN(s);
@@ -7304,9 +9028,9 @@ reg_submatch(no)
 		    ++len;
 		}
 		if (round == 2)
-		    STRNCPY(retval + len, reg_getline_submatch(lnum),
-					     submatch_mmatch->endpos[no].col);
-		len += submatch_mmatch->endpos[no].col;
+		    STRNCPY(retval + len, reg_getline(lnum),
+					     rex.reg_mmatch->endpos[no].col);
+		len += rex.reg_mmatch->endpos[no].col;
 		if (round == 2)
 		    retval[len] = NUL;
 		++len;
@@ -7322,11 +9046,11 @@ reg_submatch(no)
     }
     else
     {
-	s = submatch_match->startp[no];
-	if (s == NULL || submatch_match->endp[no] == NULL)
+	s = rex.reg_match->startp[no];
+	if (s == NULL || rex.reg_match->endp[no] == NULL)
 	    retval = NULL;
 	else
-	    retval = vim_strnsave(s, (int)(submatch_match->endp[no] - s));
+	    retval = vim_strnsave(s, (int)(rex.reg_match->endp[no] - s));
     }
 
     return retval;
@@ -32,8 +32,19 @@ typedef struct
     char_u		reganch;
     char_u		*regmust;
     int			regmlen;
+    char_u		regfirst[32];	/* bit for each byte a match may
+					   start with */
+    char_u		regfirst_ic[32]; /* idem, for when ignoring case */
     unsigned		regflags;
     char_u		reghasz;
+    char_u		regengine;	/* engine used to execute "program" */
+    long		regsize;	/* size of "program" */
+    int			regrefcount;	/* nr of users, see vim_regfree() */
+    char_u		*regpat;	/* pattern, stored after "program" */
+#ifdef FEAT_PROFILE
+    struct regstat_S	*regstat;	/* statistics for ":regstats" */
+    int			regstat_gen;	/* regstat_gen when "regstat" set */
+#endif
     char_u		program[1];		/* actually longer.. */
 } regprog_T;
 
@@ -101,6 +101,8 @@ static int	screen_cur_row, screen_cur_col;	/* last known cursor position */
 
 #ifdef FEAT_SEARCH_EXTRA
 static match_T search_hl;	/* used for 'hlsearch' highlight matching */
+static hlcache_T *search_hl_cache = NULL; /* cache for the window being
+					     drawn, NULL if not used */
 #endif
 
 #ifdef FEAT_FOLDING
@@ -140,6 +142,11 @@ static void start_search_hl __ARGS((void));
 static void end_search_hl __ARGS((void));
 static void prepare_search_hl __ARGS((win_T *wp, linenr_T lnum));
 static void next_search_hl __ARGS((win_T *win, match_T *shl, linenr_T lnum, colnr_T mincol));
+static hlcache_T *hlcache_check __ARGS((win_T *wp));
+static void hlcache_clear __ARGS((hlcache_T *hc));
+static void hlcache_clear_lines __ARGS((hlcache_T *hc));
+static hlentry_T *hlcache_find __ARGS((hlcache_T *hc, linenr_T lnum, colnr_T prevstart, colnr_T prevend, colnr_T mincol));
+static void hlcache_add __ARGS((hlcache_T *hc, linenr_T lnum, hlentry_T *hep));
 #endif
 static void screen_start_highlight __ARGS((int attr));
 static void screen_char __ARGS((unsigned off, int row, int col));
@@ -866,6 +873,11 @@ win_update(wp)
     search_hl.buf = buf;
     search_hl.lnum = 0;
     search_hl.first_lnum = 0;
+    /* Redrawing everything may be because of a change that wasn't passed to
+     * hlcache_changed(), don't use the cached results then. */
+    if (type >= NOT_VALID)
+	hlcache_clear(&wp->w_hlcache);
+    search_hl_cache = hlcache_check(wp);
     /* time limit is set at the toplevel, for all windows */
 #endif
 
@@ -6614,9 +6626,10 @@ end_search_hl()
 {
     if (search_hl.rm.regprog != NULL)
     {
-	vim_free(search_hl.rm.regprog);
+	vim_regfree(search_hl.rm.regprog);
 	search_hl.rm.regprog = NULL;
     }
+    search_hl_cache = NULL;
 }
 
 /*
@@ -6706,6 +6719,9 @@ next_search_hl(win, shl, lnum, mincol)
     linenr_T	l;
     colnr_T	matchcol;
     long	nmatched;
+    hlcache_T	*hc = NULL;
+    hlentry_T	he;
+    hlentry_T	*hep;
 
     if (shl->lnum != 0)
     {
@@ -6721,6 +6737,42 @@ next_search_hl(win, shl, lnum, mincol)
 	    return;
     }
 
+    /*
+     * For 'hlsearch' use the result of searching this line before, if
+     * there is one.  A previous match is always in this line here, the
+     * pattern doesn't match a line break.
+     */
+    if (shl == &search_hl && search_hl_cache != NULL)
+    {
+	hc = search_hl_cache;
+	if (shl->lnum == 0)
+	{
+	    he.he_prevstart = MAXCOL;
+	    he.he_prevend = MAXCOL;
+	}
+	else
+	{
+	    he.he_prevstart = shl->rm.startpos[0].col;
+	    he.he_prevend = shl->rm.endpos[0].col;
+	}
+	he.he_mincol = mincol;
+	hep = hlcache_find(hc, lnum, he.he_prevstart, he.he_prevend, mincol);
+	if (hep != NULL)
+	{
+	    if (hep->he_start == MAXCOL)
+		shl->lnum = 0;
+	    else
+	    {
+		shl->lnum = lnum;
+		shl->rm.startpos[0].lnum = 0;
+		shl->rm.startpos[0].col = hep->he_start;
+		shl->rm.endpos[0].lnum = 0;
+		shl->rm.endpos[0].col = hep->he_end;
+	    }
+	    return;
+	}
+    }
+
     /*
      * Repeat searching for a match until one is found that includes "mincol"
      * or none is found in this line.
@@ -6733,6 +6785,7 @@ next_search_hl(win, shl, lnum, mincol)
 	if (profile_passed_limit(&(shl->tm)))
 	{
 	    shl->lnum = 0;		/* no match found in time */
+	    hc = NULL;
 	    break;
 	}
 #endif
@@ -6782,12 +6835,13 @@ next_search_hl(win, shl, lnum, mincol)
 	    if (shl == &search_hl)
 	    {
 		/* don't free regprog in the match list, it's a copy */
-		vim_free(shl->rm.regprog);
+		vim_regfree(shl->rm.regprog);
 		no_hlsearch = TRUE;
 	    }
 	    shl->rm.regprog = NULL;
 	    shl->lnum = 0;
 	    got_int = FALSE;  /* avoid the "Type :quit to exit Vim" message */
+	    hc = NULL;
 	    break;
 	}
 	if (nmatched == 0)
@@ -6804,6 +6858,264 @@ next_search_hl(win, shl, lnum, mincol)
 	    break;			/* useful match found */
 	}
     }
+
+    /* Remember the result, unless searching was interrupted or timed out or
+     * the match isn't inside this line. */
+    if (hc != NULL && !got_int
+#ifdef FEAT_RELTIME
+	    && !profile_passed_limit(&(shl->tm))
+#endif
+	    )
+    {
+	if (shl->lnum == 0)
+	{
+	    he.he_start = MAXCOL;
+	    he.he_end = MAXCOL;
+	    hlcache_add(hc, lnum, &he);
+	}
+	else if (shl->lnum == lnum && shl->rm.startpos[0].lnum == 0
+						&& shl->rm.endpos[0].lnum == 0)
+	{
+	    he.he_start = shl->rm.startpos[0].col;
+	    he.he_end = shl->rm.endpos[0].col;
+	    hlcache_add(hc, lnum, &he);
+	}
+    }
+}
+
+/* Maximum number of lines in the 'hlsearch' cache of a window. */
+#define HLCACHE_MAXLINES 10000
+
+/*
+ * Check if the 'hlsearch' cache of window "wp" can be used for the current
+ * search pattern.  Empties the cache when it was for another pattern or the
+ * buffer changed in a way that wasn't passed to hlcache_changed().
+ * Returns NULL when the pattern can't be cached.
+ */
+    static hlcache_T *
+hlcache_check(wp)
+    win_T	*wp;
+{
+    hlcache_T	*hc = &wp->w_hlcache;
+    buf_T	*buf = wp->w_buffer;
+    char_u	*pat = last_search_pat();
+    int		cpo_search = (vim_strchr(p_cpo, CPO_SEARCH) != NULL);
+
+    /* The result must only depend on the text in the line: no line breaks,
+     * no cursor, Visual area, mark, line or column items ("\%") and no
+     * previous substitute string ("~"). */
+    if (search_hl.rm.regprog == NULL || pat == NULL
+	    || re_multiline(search_hl.rm.regprog)
+	    || vim_strchr(pat, '%') != NULL
+	    || vim_strchr(pat, '~') != NULL)
+    {
+	hlcache_clear(hc);
+	return NULL;
+    }
+
+    if (hc->hc_pat == NULL
+	    || STRCMP(hc->hc_pat, pat) != 0
+	    || hc->hc_magic != last_search_magic()
+	    || hc->hc_ic != search_hl.rm.rmm_ic
+	    || hc->hc_cpo_search != cpo_search
+	    || hc->hc_fnum != buf->b_fnum
+	    || hc->hc_changedtick != buf->b_changedtick
+	    || hc->hc_chartab_tick != chartab_tick)
+    {
+	hlcache_clear(hc);
+	hc->hc_pat = vim_strsave(pat);
+	if (hc->hc_pat == NULL)
+	    return NULL;
+	hc->hc_magic = last_search_magic();
+	hc->hc_ic = search_hl.rm.rmm_ic;
+	hc->hc_cpo_search = cpo_search;
+	hc->hc_fnum = buf->b_fnum;
+	hc->hc_changedtick = buf->b_changedtick;
+	hc->hc_chartab_tick = chartab_tick;
+	hc->hc_first = 1;
+	ga_init2(&hc->hc_lines, (int)sizeof(garray_T), 100);
+    }
+    return hc;
+}
+
+/*
+ * Empty the 'hlsearch' cache "hc".
+ */
+    static void
+hlcache_clear(hc)
+    hlcache_T	*hc;
+{
+    if (hc->hc_pat != NULL)
+    {
+	hlcache_clear_lines(hc);
+	vim_free(hc->hc_pat);
+	hc->hc_pat = NULL;
+    }
+}
+
+/*
+ * Forget the results for all lines in the 'hlsearch' cache "hc".
+ */
+    static void
+hlcache_clear_lines(hc)
+    hlcache_T	*hc;
+{
+    int		i;
+
+    for (i = 0; i < hc->hc_lines.ga_len; ++i)
+	ga_clear((garray_T *)hc->hc_lines.ga_data + i);
+    ga_clear(&hc->hc_lines);
+}
+
+/*
+ * Find the result of next_search_hl() for line "lnum" with the previous
+ * match "prevstart" - "prevend" and "mincol".
+ * Returns NULL when the line wasn't searched that way yet.
+ */
+    static hlentry_T *
+hlcache_find(hc, lnum, prevstart, prevend, mincol)
+    hlcache_T	*hc;
+    linenr_T	lnum;
+    colnr_T	prevstart;
+    colnr_T	prevend;
+    colnr_T	mincol;
+{
+    garray_T	*gap;
+    hlentry_T	*hep;
+    int		i;
+
+    if (lnum < hc->hc_first || lnum >= hc->hc_first + hc->hc_lines.ga_len)
+	return NULL;
+    gap = (garray_T *)hc->hc_lines.ga_data + (lnum - hc->hc_first);
+    hep = (hlentry_T *)gap->ga_data;
+    for (i = 0; i < gap->ga_len; ++i, ++hep)
+	if (hep->he_prevstart == prevstart && hep->he_prevend == prevend
+						  && hep->he_mincol == mincol)
+	    return hep;
+    return NULL;
+}
+
+/*
+ * Add result "hep" of next_search_hl() for line "lnum" to the 'hlsearch'
+ * cache "hc".
+ */
+    static void
+hlcache_add(hc, lnum, hep)
+    hlcache_T	*hc;
+    linenr_T	lnum;
+    hlentry_T	*hep;
+{
+    garray_T	*gap;
+    int		n;
+
+    if (lnum < hc->hc_first || lnum >= hc->hc_first + HLCACHE_MAXLINES)
+    {
+	/* Too far away from the cached lines, start again around "lnum". */
+	hlcache_clear_lines(hc);
+	hc->hc_first = lnum > HLCACHE_MAXLINES / 2
+					       ? lnum - HLCACHE_MAXLINES / 2 : 1;
+    }
+    n = lnum - hc->hc_first + 1 - hc->hc_lines.ga_len;
+    if (n > 0)
+    {
+	if (ga_grow(&hc->hc_lines, n) == FAIL)
+	    return;
+	for ( ; n > 0; --n)
+	    ga_init2((garray_T *)hc->hc_lines.ga_data + hc->hc_lines.ga_len++,
+						   (int)sizeof(hlentry_T), 4);
+    }
+    gap = (garray_T *)hc->hc_lines.ga_data + (lnum - hc->hc_first);
+    if (ga_grow(gap, 1) == OK)
+	((hlentry_T *)gap->ga_data)[gap->ga_len++] = *hep;
+}
+#endif
+
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Called by changed_common() for window "wp" showing the changed buffer:
+ * lines "lnum" to "lnume" (exclusive) changed and "xtra" lines were
+ * inserted (negative for deleted lines).  Forget the 'hlsearch' results for
+ * the changed lines and adjust the line numbers of the lines below them.
+ */
+    void
+hlcache_changed(wp, lnum, lnume, xtra)
+    win_T	*wp;
+    linenr_T	lnum;
+    linenr_T	lnume;
+    long	xtra;
+{
+    hlcache_T	*hc = &wp->w_hlcache;
+    garray_T	*lines;
+    long	top;
+    long	bot;
+    long	i;
+
+    if (hc->hc_pat == NULL)
+	return;
+
+    /* changed() incremented b_changedtick just before.  If it changed more
+     * often some change wasn't passed here, throw away the cache. */
+    if (hc->hc_changedtick + 1 != wp->w_buffer->b_changedtick)
+    {
+	hlcache_clear(hc);
+	return;
+    }
+    hc->hc_changedtick = wp->w_buffer->b_changedtick;
+
+    top = lnum - hc->hc_first;
+    bot = lnume - hc->hc_first;
+    if (bot <= 0)
+    {
+	/* change is above the cached lines */
+	hc->hc_first += xtra;
+	return;
+    }
+    if (top < 0)
+	top = 0;
+    if (top >= hc->hc_lines.ga_len)
+	return;			/* change is below the cached lines */
+
+    lines = (garray_T *)hc->hc_lines.ga_data;
+    for (i = top; i < bot && i < hc->hc_lines.ga_len; ++i)
+	ga_clear(&lines[i]);
+    if (xtra == 0 || bot >= hc->hc_lines.ga_len)
+	return;
+    if (bot + xtra < top)
+    {
+	/* doesn't happen, deleted lines are inside the change */
+	hlcache_clear_lines(hc);
+	return;
+    }
+
+    /* Move the results for the lines below the change. */
+    if (xtra > 0)
+    {
+	if (hc->hc_lines.ga_len + xtra > HLCACHE_MAXLINES
+			       || ga_grow(&hc->hc_lines, (int)xtra) == FAIL)
+	{
+	    hlcache_clear_lines(hc);
+	    return;
+	}
+	lines = (garray_T *)hc->hc_lines.ga_data;
+	mch_memmove(lines + bot + xtra, lines + bot,
+			 (size_t)(hc->hc_lines.ga_len - bot) * sizeof(garray_T));
+	for (i = bot; i < bot + xtra; ++i)
+	    ga_init2(&lines[i], (int)sizeof(hlentry_T), 4);
+    }
+    else
+	mch_memmove(lines + bot + xtra, lines + bot,
+			 (size_t)(hc->hc_lines.ga_len - bot) * sizeof(garray_T));
+    hc->hc_lines.ga_len += xtra;
+}
+
+/*
+ * Free the 'hlsearch' cache of window "wp".
+ */
+    void
+hlcache_free(wp)
+    win_T	*wp;
+{
+    hlcache_clear(&wp->w_hlcache);
 }
 #endif
 
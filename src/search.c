@@ -423,6 +423,17 @@ last_search_pat()
     return spats[last_idx].pat;
 }
 
+#if defined(FEAT_SEARCH_EXTRA) || defined(PROTO)
+/*
+ * Get the 'magic' value that the last used search pattern was defined with.
+ */
+    int
+last_search_magic()
+{
+    return spats[last_idx].magic;
+}
+#endif
+
 /*
  * Reset search direction to forward.  For "gd" and "gD" commands.
  */
@@ -630,6 +641,20 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
 		    break;
 #endif
 
+		/* Quickly skip over lines where the pattern can't match. */
+		if (dir == FORWARD && !at_first_line)
+		{
+		    linenr_T	last = buf->b_ml.ml_line_count;
+
+		    if (stop_lnum != 0 && stop_lnum < last)
+			last = stop_lnum;
+		    if (loop && start_pos.lnum < last)
+			last = start_pos.lnum;
+		    lnum = vim_regexec_nextline(&regmatch, buf, lnum, last);
+		    if (lnum > last)
+			break;
+		}
+
 		/*
 		 * Look for a match somewhere in line "lnum".
 		 */
@@ -967,7 +992,7 @@ searchit(win, buf, pos, dir, pat, count, options, pat_use, stop_lnum, tm)
     }
     while (--count > 0 && found);   /* stop after count matches or no match */
 
-    vim_free(regmatch.regprog);
+    vim_regfree(regmatch.regprog);
 
     called_emsg |= save_called_emsg;
 
@@ -5217,9 +5242,9 @@ exit_matched:
 
 fpip_end:
     vim_free(file_line);
-    vim_free(regmatch.regprog);
-    vim_free(incl_regmatch.regprog);
-    vim_free(def_regmatch.regprog);
+    vim_regfree(regmatch.regprog);
+    vim_regfree(incl_regmatch.regprog);
+    vim_regfree(def_regmatch.regprog);
 
 #ifdef RISCOS
    /* Restore previous file munging state. */
@@ -359,6 +359,35 @@ typedef struct block_hdr    bhdr_T;
 typedef struct memfile	    memfile_T;
 typedef long		    blocknr_T;
 
+/*
+ * mf_hashtab_T is a chained hashtable with blocknr_T key and arbitrary
+ * structures as items.  This is an intrusive data structure: we require
+ * that items begin with mf_hashitem_T which contains the key and linked
+ * list pointers.  List of items in each bucket is doubly-linked.
+ */
+
+typedef struct mf_hashitem_S mf_hashitem_T;
+
+struct mf_hashitem_S
+{
+    mf_hashitem_T   *mhi_next;
+    mf_hashitem_T   *mhi_prev;
+    blocknr_T	    mhi_key;
+};
+
+#define MHT_INIT_SIZE   64
+
+typedef struct mf_hashtab_S
+{
+    long_u	    mht_mask;	    /* mask used for hash value (nr of items
+				     * in array is "mht_mask" + 1) */
+    long_u	    mht_count;	    /* nr of items inserted into hashtable */
+    mf_hashitem_T   **mht_buckets;  /* points to mht_small_buckets or
+				     * dynamically allocated array */
+    mf_hashitem_T   *mht_small_buckets[MHT_INIT_SIZE];   /* initial buckets */
+    char	    mht_fixed;	    /* non-zero value forbids growth */
+} mf_hashtab_T;
+
 /*
  * for each (previously) used block in the memfile there is one block header.
  *
@@ -374,13 +403,32 @@ typedef long		    blocknr_T;
  *	the contents of the block in the file (if any) is irrelevant.
  */
 
+/*
+ * A block that was released from memory and is kept in compressed form, so
+ * that it doesn't need to be read from the swap file when needed again.
+ * Only clean blocks are kept, they are also in the file.
+ */
+typedef struct mf_zblock_S mf_zblock_T;
+
+struct mf_zblock_S
+{
+    mf_hashitem_T zb_hashitem;	    /* header for hash table and key */
+#define zb_bnum zb_hashitem.mhi_key /* block number, part of zb_hashitem */
+
+    mf_zblock_T	*zb_next;	    /* next older compressed block */
+    mf_zblock_T	*zb_prev;	    /* next newer compressed block */
+    int		zb_page_count;	    /* number of pages in the block */
+    unsigned	zb_len;		    /* number of bytes in zb_data */
+    char_u	zb_data[1];	    /* compressed data, actually longer */
+};
+
 struct block_hdr
 {
+    mf_hashitem_T bh_hashitem;      /* header for hash table and key */
+#define bh_bnum bh_hashitem.mhi_key /* block number, part of bh_hashitem */
+
     bhdr_T	*bh_next;	    /* next block_hdr in free or used list */
     bhdr_T	*bh_prev;	    /* previous block_hdr in used list */
-    bhdr_T	*bh_hash_next;	    /* next block_hdr in hash list */
-    bhdr_T	*bh_hash_prev;	    /* previous block_hdr in hash list */
-    blocknr_T	bh_bnum;		/* block number */
     char_u	*bh_data;	    /* pointer to memory (for used block) */
     int		bh_page_count;	    /* number of pages in this block */
 
@@ -399,9 +447,9 @@ typedef struct nr_trans NR_TRANS;
 
 struct nr_trans
 {
-    NR_TRANS	*nt_next;		/* next nr_trans in hash list */
-    NR_TRANS	*nt_prev;		/* previous nr_trans in hash list */
-    blocknr_T	nt_old_bnum;		/* old, negative, number */
+    mf_hashitem_T nt_hashitem;		/* header for hash table and key */
+#define nt_old_bnum nt_hashitem.mhi_key	/* old, negative, number */
+
     blocknr_T	nt_new_bnum;		/* new, positive, number */
 };
 
@@ -479,13 +527,6 @@ typedef struct
 # endif
 } cmdmod_T;
 
-/*
- * Simplistic hashing scheme to quickly locate the blocks in the used list.
- * 64 blocks are found directly (64 * 4K = 256K, most files are smaller).
- */
-#define MEMHASHSIZE	64
-#define MEMHASH(nr)	((nr) & (MEMHASHSIZE - 1))
-
 struct memfile
 {
     char_u	*mf_fname;		/* name of the file */
@@ -496,14 +537,40 @@ struct memfile
     bhdr_T	*mf_used_last;		/* lru block_hdr in used list */
     unsigned	mf_used_count;		/* number of pages in used list */
     unsigned	mf_used_count_max;	/* maximum number of pages in memory */
-    bhdr_T	*mf_hash[MEMHASHSIZE];	/* array of hash lists */
-    NR_TRANS	*mf_trans[MEMHASHSIZE];	/* array of trans lists */
+    unsigned	mf_used_count_limit;	/* upper limit for mf_used_count_max,
+					   computed from 'maxmem' */
+    mf_hashtab_T mf_hash;		/* hash lists */
+    mf_hashtab_T mf_trans;		/* trans lists */
     blocknr_T	mf_blocknr_max;		/* highest positive block number + 1*/
     blocknr_T	mf_blocknr_min;		/* lowest negative block number - 1 */
     blocknr_T	mf_neg_count;		/* number of negative blocks numbers */
     blocknr_T	mf_infile_count;	/* number of pages in the file */
     unsigned	mf_page_size;		/* number of bytes in a page */
     int		mf_dirty;		/* TRUE if there are dirty blocks */
+    long	mf_sync_count;		/* nr of mf_sync() calls with a file,
+					   also when nothing was written */
+    long	mf_write_count;		/* nr of write() calls */
+    long	mf_write_blocks;	/* nr of blocks written */
+    long_u	mf_write_bytes;		/* nr of bytes written */
+    long	mf_sync_usec;		/* microseconds spent in mf_sync() */
+    long	mf_sync_max_usec;	/* longest mf_sync() in microseconds */
+    unsigned	mf_spill_count;		/* when not zero and there is no swap
+					   file: max nr of pages in memory,
+					   others go to a temp file */
+    int		mf_spill;		/* TRUE when mf_fd is that temp file */
+    mf_hashtab_T mf_zhash;		/* compressed blocks */
+    mf_zblock_T	*mf_zfirst;		/* most recently compressed block */
+    mf_zblock_T	*mf_zlast;		/* least recently compressed block */
+    long	mf_zcount;		/* number of compressed blocks */
+    long_u	mf_zsize;		/* bytes used for compressed blocks */
+    long_u	mf_zorig;		/* size of them when not compressed */
+    long	mf_hits;		/* nr of blocks found in memory */
+    long	mf_zhits;		/* nr of blocks found compressed */
+    long	mf_reads;		/* nr of blocks read from the file */
+    char_u	*mf_ra_buf;		/* read-ahead buffer or NULL */
+    unsigned	mf_ra_size;		/* allocated size of mf_ra_buf */
+    off_t	mf_ra_off;		/* file offset of mf_ra_buf[0] */
+    unsigned	mf_ra_len;		/* nr of valid bytes in mf_ra_buf */
 };
 
 /*
@@ -539,6 +606,12 @@ typedef struct ml_chunksize
 /*
  * the memline structure holds all the information about a memline
  */
+#ifdef FEAT_MMAP
+/* File mapped into memory, used for the text until the buffer is changed.
+ * Defined in memline.c. */
+typedef struct mlmap_S mlmap_T;
+#endif
+
 typedef struct memline
 {
     linenr_T	ml_line_count;	/* number of lines in the buffer */
@@ -562,10 +635,17 @@ typedef struct memline
     linenr_T	ml_locked_low;	/* first line in ml_locked */
     linenr_T	ml_locked_high;	/* last line in ml_locked */
     int		ml_locked_lineadd;  /* number of lines inserted in ml_locked */
+#ifdef FEAT_MMAP
+    mlmap_T	*ml_map;	/* file with the text when not NULL */
+#endif
 #ifdef FEAT_BYTEOFF
     chunksize_T *ml_chunksize;
     int		ml_numchunks;
     int		ml_usedchunks;
+    chunksize_T *ml_chunktree;	/* Fenwick tree with sums of ml_chunksize */
+    int		ml_treesize;	/* number of entries in ml_chunktree */
+    int		ml_treeused;	/* number of chunks in ml_chunktree, zero when
+				   it needs to be rebuilt */
 #endif
 } memline_T;
 
@@ -802,6 +882,28 @@ struct syn_state
     linenr_T	sst_change_lnum;/* when non-zero, change in this line
 				 * may have made the state invalid */
 };
+
+/*
+ * The states of b_sst_array[] kept while the text of a buffer is unloaded,
+ * see syn_stack_save().
+ */
+typedef struct
+{
+    synstate_T	*ss_array;	/* used entries of b_sst_array[], in order */
+    int		ss_len;		/* number of entries in ss_array[] */
+    linenr_T	ss_line_count;	/* number of lines in the buffer */
+    long	ss_mtime;	/* b_mtime, the text is that of the file */
+    size_t	ss_size;	/* b_orig_size */
+    int		ss_ff;		/* fileformat the text was read with */
+    int		ss_bin;		/* value of 'binary' */
+# ifdef FEAT_MBYTE
+    char_u	*ss_fenc;	/* value of 'fileencoding', allocated */
+# endif
+    long_u	ss_syn_hash;	/* hash of the syntax items */
+# ifdef FEAT_RELTIME
+    linenr_T	ss_idle_lnum;	/* value of b_sst_idle_lnum */
+# endif
+} synsave_T;
 #endif /* FEAT_SYN_HL */
 
 /*
@@ -1402,6 +1504,7 @@ struct file_buffer
     int		b_p_ml;		/* 'modeline' */
     int		b_p_ml_nobin;	/* b_p_ml saved for binary mode */
     int		b_p_ma;		/* 'modifiable' */
+    long	b_p_mml;	/* 'memlimit' */
     char_u	*b_p_nf;	/* 'nrformats' */
 #ifdef FEAT_OSFILETYPE
     char_u	*b_p_oft;	/* 'osfiletype' */
@@ -1564,6 +1667,15 @@ struct file_buffer
  * b_sst_freecount	number of free entries in b_sst_array[]
  * b_sst_check_lnum	entries after this lnum need to be checked for
  *			validity (MAXLNUM means no check needed)
+ * b_sst_idle_lnum	entries up to this lnum were stored while parsing
+ *			from the start of the buffer, see syntax_idle()
+ * b_sst_fallback	first line drawn with a shortened sync because
+ *			b_sst_idle_lnum was far above it, zero if none
+ * b_sst_near_top	when syncing is cheap syntax_idle() parses the lines
+ * b_sst_near_bot	around the cursor instead, lines b_sst_near_top to
+ *			b_sst_near_bot were done; zero when not started
+ * b_sst_near_up	line where checking the states below a region above
+ *			b_sst_near_top continues, zero if none
  */
     synstate_T	*b_sst_array;
     int		b_sst_len;
@@ -1572,6 +1684,14 @@ struct file_buffer
     int		b_sst_freecount;
     linenr_T	b_sst_check_lnum;
     short_u	b_sst_lasttick;	/* last display tick */
+# ifdef FEAT_RELTIME
+    linenr_T	b_sst_idle_lnum;
+    linenr_T	b_sst_fallback;
+    linenr_T	b_sst_near_top;
+    linenr_T	b_sst_near_bot;
+    linenr_T	b_sst_near_up;
+# endif
+    synsave_T	*b_sst_saved;	/* states kept when unloading or NULL */
 #endif /* FEAT_SYN_HL */
 
 #ifdef FEAT_SPELL
@@ -1755,6 +1875,38 @@ struct matchitem
     match_T	hl;	    /* struct for doing the actual highlighting */
 };
 
+/*
+ * Result of one call to next_search_hl() for 'hlsearch', remembered in
+ * hlcache_T.  Columns are MAXCOL when there is no match.
+ */
+typedef struct
+{
+    colnr_T	he_prevstart;	/* start of previous match in the line */
+    colnr_T	he_prevend;	/* end of previous match in the line */
+    colnr_T	he_mincol;	/* minimal column for the match */
+    colnr_T	he_start;	/* start of the match found */
+    colnr_T	he_end;		/* end of the match found */
+} hlentry_T;
+
+/*
+ * Cache of the 'hlsearch' matches in the lines of a window, so that
+ * scrolling doesn't need to search the lines that were drawn before.
+ * Only used for a pattern that doesn't depend on anything but the text of
+ * the line.  Lines are invalidated by changed_common().
+ */
+typedef struct
+{
+    char_u	*hc_pat;	/* pattern; NULL when the cache is empty */
+    int		hc_magic;	/* 'magic' used for "hc_pat" */
+    int		hc_ic;		/* ignore case used for "hc_pat" */
+    int		hc_cpo_search;	/* 'cpoptions' contains 'c' */
+    int		hc_chartab_tick; /* chartab_tick, for 'iskeyword' etc. */
+    int		hc_fnum;	/* number of the buffer */
+    long	hc_changedtick;	/* b_changedtick the cache is valid for */
+    linenr_T	hc_first;	/* line number of the first item in hc_lines */
+    garray_T	hc_lines;	/* list of growarrays with hlentry_T items */
+} hlcache_T;
+
 /*
  * Structure which contains all information that belongs to a window
  *
@@ -2003,6 +2155,7 @@ struct window_S
 #ifdef FEAT_SEARCH_EXTRA
     matchitem_T	*w_match_head;		/* head of match list */
     int		w_next_match_id;	/* next match ID */
+    hlcache_T	w_hlcache;		/* cached 'hlsearch' matches */
 #endif
 
     /*
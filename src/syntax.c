@@ -136,6 +136,19 @@ static char *(spo_name_tab[SPO_COUNT]) =
  * A character offset can be given for the matched text (_m_start and _m_end)
  * and for the actually highlighted text (_h_start and _h_end).
  */
+#ifdef FEAT_PROFILE
+/*
+ * Time used for trying one pattern, collected while ":syntime on" is active.
+ */
+typedef struct syn_time_S
+{
+    proftime_T	st_total;	/* total time used */
+    proftime_T	st_slowest;	/* time used by the slowest try */
+    long	st_count;	/* nr of times the pattern was tried */
+    long	st_match;	/* nr of times it matched */
+} syn_time_T;
+#endif
+
 typedef struct syn_pattern
 {
     char	 sp_type;		/* see SPTYPE_ defines below */
@@ -153,6 +166,12 @@ typedef struct syn_pattern
     int		 sp_sync_idx;		/* sync item index (syncing only) */
     int		 sp_line_id;		/* ID of last line where tried */
     int		 sp_startcol;		/* next match in sp_line_id line */
+    int		 sp_has_first;		/* "sp_first" is valid */
+    char_u	 sp_first[32];		/* bit for each byte a match may
+					   start with */
+#ifdef FEAT_PROFILE
+    syn_time_T	 sp_time;		/* for ":syntime" */
+#endif
 } synpat_T;
 
 /* The sp_off_flags are computed like this:
@@ -253,6 +272,16 @@ static char_u **syn_cmdlinep;
 static int current_syn_inc_tag = 0;
 static int running_syn_inc_tag = 0;
 
+static char *(msg_no_items) = N_("No Syntax items defined for this buffer");
+
+#ifdef FEAT_PROFILE
+static int syn_time_on = FALSE;	/* collecting time for ":syntime" */
+
+static void syn_clear_time __ARGS((syn_time_T *st));
+static void syntime_clear __ARGS((void));
+static void syntime_report __ARGS((void));
+#endif
+
 /*
  * In a hashtable item "hi_key" points to "keyword" in a keyentry.
  * This avoids adding a pointer to the hashtable item.
@@ -362,6 +391,17 @@ static short	*current_next_list = NULL; /* when non-zero, nextgroup list */
 static int	current_next_flags = 0; /* flags for current_next_list */
 static int	current_line_id = 0;	/* unique number for current line */
 
+/*
+ * For skipping patterns that can't match in a line: a bit for every byte that
+ * appears in line "syn_first_lnum" of "syn_first_buf" and the column after
+ * where it appears last.  Computed once for "current_line_id".
+ */
+static char_u	syn_first_bytes[32];
+static colnr_T	syn_first_col[256];
+static int	syn_first_line_id = 0;
+static linenr_T	syn_first_lnum = 0;
+static buf_T	*syn_first_buf = NULL;
+
 #define CUR_STATE(idx)	((stateitem_T *)(current_state.ga_data))[idx]
 
 static void syn_sync __ARGS((win_T *wp, linenr_T lnum, synstate_T *last_valid));
@@ -369,6 +409,17 @@ static int syn_match_linecont __ARGS((linenr_T lnum));
 static void syn_start_line __ARGS((void));
 static void syn_update_ends __ARGS((int startofline));
 static void syn_stack_alloc __ARGS((void));
+static void syn_stack_restore __ARGS((void));
+static int syn_stack_same_text __ARGS((buf_T *buf, synsave_T *ssp));
+static long_u syn_hash_add __ARGS((long_u hash, long_u n));
+static long_u syn_items_hash __ARGS((buf_T *buf));
+static long_u syn_hash_list __ARGS((long_u hash, short *list, int min_tag));
+#ifdef FEAT_RELTIME
+static int syn_idle_fallback __ARGS((win_T *wp, linenr_T from, linenr_T lnum));
+static int syn_idle_parse __ARGS((win_T *wp, proftime_T *tm, int *redrawp));
+static int syn_idle_can_sync __ARGS((buf_T *buf));
+static int syn_idle_near __ARGS((win_T *wp, proftime_T *tm));
+#endif
 static int syn_stack_cleanup __ARGS((void));
 static void syn_stack_free_entry __ARGS((buf_T *buf, synstate_T *p));
 static synstate_T *syn_stack_find_entry __ARGS((linenr_T lnum));
@@ -399,7 +450,9 @@ static void limit_pos_zero __ARGS((lpos_T *pos, lpos_T *limit));
 static void syn_add_end_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpat_T *spp, int idx, int extra));
 static void syn_add_start_off __ARGS((lpos_T *result, regmmatch_T *regmatch, synpat_T *spp, int idx, int extra));
 static char_u *syn_getcurline __ARGS((void));
-static int syn_regexec __ARGS((regmmatch_T *rmp, linenr_T lnum, colnr_T col));
+static int syn_regexec __ARGS((regmmatch_T *rmp, linenr_T lnum, colnr_T col, synpat_T *spp));
+static int syn_may_match __ARGS((synpat_T *spp, linenr_T lnum, colnr_T col));
+static void syn_set_first __ARGS((synpat_T *spp));
 static int check_keyword_id __ARGS((char_u *line, int startcol, int *endcol, long *flags, short **next_list, stateitem_T *cur_si));
 static void syn_cmd_case __ARGS((exarg_T *eap, int syncing));
 static void syn_cmd_spell __ARGS((exarg_T *eap, int syncing));
@@ -469,6 +522,9 @@ syntax_start(wp, lnum)
     linenr_T	first_stored;
     int		dist;
     static int	changedtick = 0;	/* remember the last change ID */
+#ifdef FEAT_RELTIME
+    long	minlines;
+#endif
 
     /*
      * After switching buffers, invalidate current_state.
@@ -534,7 +590,11 @@ syntax_start(wp, lnum)
 		    last_min_valid = p;
 	    }
 	}
-	if (last_min_valid != NULL)
+	if (last_min_valid != NULL
+#ifdef FEAT_RELTIME
+		&& !syn_idle_fallback(wp, last_min_valid->sst_lnum, lnum)
+#endif
+		)
 	    load_current_state(last_min_valid);
     }
 
@@ -544,8 +604,18 @@ syntax_start(wp, lnum)
      */
     if (INVALID_STATE(&current_state))
     {
+#ifdef FEAT_RELTIME
+	/* When syntax_idle() is still far behind, sync with fewer lines
+	 * instead of making the user wait. */
+	minlines = syn_buf->b_syn_sync_minlines;
+	if (syn_idle_fallback(wp, lnum - minlines, lnum))
+	    syn_buf->b_syn_sync_minlines = SST_IDLE_MINLINES;
+#endif
 	syn_sync(wp, lnum, last_valid);
 	first_stored = current_lnum + syn_buf->b_syn_sync_minlines;
+#ifdef FEAT_RELTIME
+	syn_buf->b_syn_sync_minlines = minlines;
+#endif
     }
     else
 	first_stored = current_lnum;
@@ -620,6 +690,35 @@ syntax_start(wp, lnum)
     syn_start_line();
 }
 
+#ifdef FEAT_RELTIME
+/*
+ * Return TRUE when drawing line "lnum" in window "wp" would require parsing
+ * from line "from", which is far away, and syntax_idle() did not get near
+ * "lnum" yet.  The caller then uses a shortened sync, which may be wrong.
+ * syntax_idle() redraws the window when it gets there.
+ */
+    static int
+syn_idle_fallback(wp, from, lnum)
+    win_T	*wp;
+    linenr_T	from;
+    linenr_T	lnum;
+{
+    if (p_sxi <= 0
+	    || !updating_screen
+	    || lnum - from <= SST_IDLE_MAXPARSE
+	    || syn_buf->b_sst_idle_lnum + SST_IDLE_MAXPARSE >= lnum)
+	return FALSE;
+# ifdef FEAT_FOLDING
+    /* Fold levels are remembered, they must be right. */
+    if (foldmethodIsSyntax(wp))
+	return FALSE;
+# endif
+    if (syn_buf->b_sst_fallback == 0 || syn_buf->b_sst_fallback > lnum)
+	syn_buf->b_sst_fallback = lnum;
+    return TRUE;
+}
+#endif
+
 /*
  * We cannot simply discard growarrays full of state_items or buf_states; we
  * have to manually release their extmatch pointers first.
@@ -956,7 +1055,7 @@ syn_match_linecont(lnum)
     {
 	regmatch.rmm_ic = syn_buf->b_syn_linecont_ic;
 	regmatch.regprog = syn_buf->b_syn_linecont_prog;
-	return syn_regexec(&regmatch, lnum, (colnr_T)0);
+	return syn_regexec(&regmatch, lnum, (colnr_T)0, NULL);
     }
     return FALSE;
 }
@@ -1107,6 +1206,13 @@ syn_stack_free_all(buf)
 	buf->b_sst_array = NULL;
 	buf->b_sst_len = 0;
     }
+#ifdef FEAT_RELTIME
+    buf->b_sst_idle_lnum = 0;
+    buf->b_sst_fallback = 0;
+    buf->b_sst_near_top = 0;
+    buf->b_sst_near_bot = 0;
+    buf->b_sst_near_up = 0;
+#endif
 #ifdef FEAT_FOLDING
     /* When using "syntax" fold method, must update all folds. */
     FOR_ALL_WINDOWS(wp)
@@ -1117,6 +1223,310 @@ syn_stack_free_all(buf)
 #endif
 }
 
+/*
+ * Called before the text of buffer "buf" is freed.  Keep the valid states in
+ * b_sst_array[] together with the timestamp of the file and a hash of the
+ * syntax items, so that syn_stack_restore() can use them again when the same
+ * file is loaded with the same syntax, e.g., for ":edit".  Only done when the
+ * buffer was not changed, then the text is that of the file.
+ */
+    void
+syn_stack_save(buf)
+    buf_T	*buf;
+{
+    synstate_T	*p, *np;
+    synstate_T	*to;
+    synsave_T	*ssp;
+    buf_T	*bp;
+    long	mem = 0;
+    int		len = 0;
+
+    syn_stack_free_saved(buf);
+    if (buf->b_sst_array == NULL || buf->b_mod_set || buf->b_syn_error
+	    || buf->b_changed || buf->b_ffname == NULL || buf->b_mtime == 0
+						       || !syntax_present(buf))
+	return;
+
+    /* States that depend on a change can't be trusted.  A "nextgroup" list
+     * belongs to the syntax items, which are going to be freed. */
+    for (p = buf->b_sst_first; p != NULL; p = p->sst_next)
+	if (p->sst_change_lnum == 0 && p->sst_next_list == NULL)
+	    ++len;
+    if (len == 0 || len * (long)sizeof(synstate_T) > SST_SAVE_MEM)
+	return;
+
+    /* Stay within SST_SAVE_MEM for all buffers, drop the states kept for
+     * other buffers when needed. */
+    for (bp = firstbuf; bp != NULL; bp = bp->b_next)
+	if (bp->b_sst_saved != NULL)
+	    mem += bp->b_sst_saved->ss_len * (long)sizeof(synstate_T);
+    for (bp = firstbuf; bp != NULL
+		 && mem + len * (long)sizeof(synstate_T) > SST_SAVE_MEM;
+							       bp = bp->b_next)
+	if (bp->b_sst_saved != NULL)
+	{
+	    mem -= bp->b_sst_saved->ss_len * (long)sizeof(synstate_T);
+	    syn_stack_free_saved(bp);
+	}
+
+    ssp = (synsave_T *)alloc((unsigned)sizeof(synsave_T));
+    if (ssp == NULL)
+	return;
+    ssp->ss_array = (synstate_T *)alloc((unsigned)(len * sizeof(synstate_T)));
+    if (ssp->ss_array == NULL)
+    {
+	vim_free(ssp);
+	return;
+    }
+    ssp->ss_len = len;
+    ssp->ss_line_count = buf->b_ml.ml_line_count;
+    ssp->ss_mtime = buf->b_mtime;
+    ssp->ss_size = buf->b_orig_size;
+    ssp->ss_ff = get_fileformat(buf);
+    ssp->ss_bin = buf->b_p_bin;
+# ifdef FEAT_MBYTE
+    ssp->ss_fenc = vim_strsave(buf->b_p_fenc);
+# endif
+    ssp->ss_syn_hash = syn_items_hash(buf);
+# ifdef FEAT_RELTIME
+    ssp->ss_idle_lnum = buf->b_sst_idle_lnum;
+# endif
+
+    /* Move the states to the new array, free the others. */
+    to = ssp->ss_array;
+    for (p = buf->b_sst_first; p != NULL; p = np)
+    {
+	np = p->sst_next;
+	if (p->sst_change_lnum == 0 && p->sst_next_list == NULL)
+	{
+	    *to = *p;
+	    to->sst_next = to + 1;
+	    ++to;
+	}
+	else
+	    clear_syn_state(p);
+    }
+    (to - 1)->sst_next = NULL;
+    vim_free(buf->b_sst_array);
+    buf->b_sst_array = NULL;
+    buf->b_sst_len = 0;
+    buf->b_sst_saved = ssp;
+}
+
+/*
+ * Free the states kept by syn_stack_save() for buffer "buf".
+ */
+    void
+syn_stack_free_saved(buf)
+    buf_T	*buf;
+{
+    synsave_T	*ssp = buf->b_sst_saved;
+    int		i;
+
+    if (ssp == NULL)
+	return;
+    if (ssp->ss_array != NULL)
+    {
+	for (i = 0; i < ssp->ss_len; ++i)
+	    clear_syn_state(&ssp->ss_array[i]);
+	vim_free(ssp->ss_array);
+    }
+# ifdef FEAT_MBYTE
+    vim_free(ssp->ss_fenc);
+# endif
+    vim_free(ssp);
+    buf->b_sst_saved = NULL;
+}
+
+/*
+ * Use the states kept by syn_stack_save() for syn_buf when the file and the
+ * syntax items are still the same.  Free them otherwise.
+ */
+    static void
+syn_stack_restore()
+{
+    synsave_T	*ssp = syn_buf->b_sst_saved;
+
+    if (syn_stack_same_text(syn_buf, ssp)
+	    && ssp->ss_syn_hash == syn_items_hash(syn_buf))
+    {
+	syn_buf->b_sst_array = ssp->ss_array;
+	syn_buf->b_sst_len = ssp->ss_len;
+	syn_buf->b_sst_first = ssp->ss_array;
+	syn_buf->b_sst_firstfree = NULL;
+	syn_buf->b_sst_freecount = 0;
+# ifdef FEAT_RELTIME
+	syn_buf->b_sst_idle_lnum = ssp->ss_idle_lnum;
+# endif
+	ssp->ss_array = NULL;
+    }
+    syn_stack_free_saved(syn_buf);
+}
+
+/*
+ * Return TRUE when the text of "buf" is the text the states in "ssp" were
+ * kept for: it was read from the same file, with the same timestamp and
+ * size, and read the same way.
+ */
+    static int
+syn_stack_same_text(buf, ssp)
+    buf_T	*buf;
+    synsave_T	*ssp;
+{
+    return !buf->b_changed
+	    && buf->b_mtime != 0
+	    && buf->b_mtime == ssp->ss_mtime
+	    && buf->b_orig_size == ssp->ss_size
+	    && buf->b_ml.ml_line_count == ssp->ss_line_count
+	    && get_fileformat(buf) == ssp->ss_ff
+	    && buf->b_p_bin == ssp->ss_bin
+# ifdef FEAT_MBYTE
+	    && ssp->ss_fenc != NULL
+	    && STRCMP(buf->b_p_fenc, ssp->ss_fenc) == 0
+# endif
+	    ;
+}
+
+/*
+ * Add number "n" to hash "hash".  Multiply and fold the high bits back in,
+ * so that every bit of "n" influences all bits of the result.
+ */
+    static long_u
+syn_hash_add(hash, n)
+    long_u	hash;
+    long_u	n;
+{
+    hash = (hash ^ n) * (long_u)0x5bd1e995L;
+    return hash ^ (hash >> 15);
+}
+
+/* Add a number to a hash, and a ":syn include" tag counted from "min_tag". */
+#define SYN_HASH_NUM(h, n) syn_hash_add((h), (long_u)(n))
+#define SYN_HASH_TAG(h, t) SYN_HASH_NUM(h, (t) == 0 ? 0 : (t) - min_tag + 1)
+
+/*
+ * Compute a hash of everything that influences the syntax states of buffer
+ * "buf".  The ":syn include" tags are counted from the lowest one, they are
+ * different each time a syntax file is loaded.
+ */
+    static long_u
+syn_items_hash(buf)
+    buf_T	*buf;
+{
+    long_u	hash = 0;
+    long_u	kwhash;
+    int		min_tag = 0;
+    int		i;
+    int		todo;
+    synpat_T	*spp;
+    keyentry_T	*kp;
+    hashitem_T	*hi;
+    hashtab_T	*ht;
+    char_u	*p;
+
+    for (i = 0; i < buf->b_syn_patterns.ga_len; ++i)
+    {
+	spp = &SYN_ITEMS(buf)[i];
+	if (spp->sp_syn.inc_tag != 0
+			      && (min_tag == 0 || spp->sp_syn.inc_tag < min_tag))
+	    min_tag = spp->sp_syn.inc_tag;
+    }
+
+    for (i = 0; i < buf->b_syn_patterns.ga_len; ++i)
+    {
+	spp = &SYN_ITEMS(buf)[i];
+	hash = SYN_HASH_NUM(hash, spp->sp_type);
+	hash = SYN_HASH_NUM(hash, spp->sp_syncing);
+	hash = SYN_HASH_NUM(hash, spp->sp_flags);
+	hash = SYN_HASH_TAG(hash, spp->sp_syn.inc_tag);
+	hash = SYN_HASH_NUM(hash, spp->sp_syn.id);
+	hash = syn_hash_list(hash, spp->sp_syn.cont_in_list, min_tag);
+	hash = SYN_HASH_NUM(hash, spp->sp_syn_match_id);
+	for (p = spp->sp_pattern; p != NULL && *p != NUL; ++p)
+	    hash = SYN_HASH_NUM(hash, *p);
+	hash = SYN_HASH_NUM(hash, spp->sp_ic);
+	hash = SYN_HASH_NUM(hash, spp->sp_off_flags);
+	for (todo = 0; todo < SPO_COUNT; ++todo)
+	    hash = SYN_HASH_NUM(hash, spp->sp_offsets[todo]);
+	hash = syn_hash_list(hash, spp->sp_cont_list, min_tag);
+	hash = syn_hash_list(hash, spp->sp_next_list, min_tag);
+	hash = SYN_HASH_NUM(hash, spp->sp_sync_idx);
+    }
+
+    for (i = 0; i < buf->b_syn_clusters.ga_len; ++i)
+	hash = syn_hash_list(hash,
+		     ((syn_cluster_T *)buf->b_syn_clusters.ga_data)[i].scl_list,
+								     min_tag);
+
+    /* The order of keywords in the hashtable may differ, add them up. */
+    for (ht = &buf->b_keywtab; ht != NULL;
+			   ht = (ht == &buf->b_keywtab ? &buf->b_keywtab_ic : NULL))
+    {
+	kwhash = 0;
+	todo = (int)ht->ht_used;
+	for (hi = ht->ht_array; todo > 0; ++hi)
+	    if (!HASHITEM_EMPTY(hi))
+	    {
+		--todo;
+		for (kp = HI2KE(hi); kp != NULL; kp = kp->ke_next)
+		{
+		    long_u	h = 0;
+
+		    for (p = kp->keyword; *p != NUL; ++p)
+			h = SYN_HASH_NUM(h, *p);
+		    h = SYN_HASH_TAG(h, kp->k_syn.inc_tag);
+		    h = SYN_HASH_NUM(h, kp->k_syn.id);
+		    h = syn_hash_list(h, kp->k_syn.cont_in_list, min_tag);
+		    h = syn_hash_list(h, kp->next_list, min_tag);
+		    h = SYN_HASH_NUM(h, kp->flags);
+		    kwhash += h;
+		}
+	    }
+	hash = SYN_HASH_NUM(hash, kwhash);
+    }
+
+    hash = SYN_HASH_NUM(hash, buf->b_syn_ic);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_containedin);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_sync_flags);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_sync_id);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_sync_minlines);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_sync_maxlines);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_sync_linebreaks);
+    for (p = buf->b_syn_linecont_pat; p != NULL && *p != NUL; ++p)
+	hash = SYN_HASH_NUM(hash, *p);
+    hash = SYN_HASH_NUM(hash, buf->b_syn_linecont_ic);
+    hash = SYN_HASH_NUM(hash, buf->b_p_smc);
+    for (i = 0; i < 32; ++i)	/* 'iskeyword' */
+	hash = SYN_HASH_NUM(hash, buf->b_chartab[i]);
+    return hash;
+}
+
+/*
+ * Add the group IDs in "list" to "hash".  The ":syn include" tag in the
+ * ALLBUT, TOP and CONTAINED IDs is counted from "min_tag".
+ */
+    static long_u
+syn_hash_list(hash, list, min_tag)
+    long_u	hash;
+    short	*list;
+    int		min_tag;
+{
+    short	*p;
+    int		base;
+
+    if (list == NULL)
+	return SYN_HASH_NUM(hash, 1);
+    for (p = list; *p != 0; ++p)
+	if (*p >= SYNID_ALLBUT && *p < SYNID_CLUSTER)
+	{
+	    base = SYNID_ALLBUT + (*p - SYNID_ALLBUT) / 5000 * 5000;
+	    hash = SYN_HASH_TAG(SYN_HASH_NUM(hash, base), *p - base);
+	}
+	else
+	    hash = SYN_HASH_NUM(hash, *p);
+    return SYN_HASH_NUM(hash, 0);
+}
+
 /*
  * Allocate the syntax state stack for syn_buf when needed.
  * If the number of entries in b_sst_array[] is much too big or a bit too
@@ -1130,6 +1540,9 @@ syn_stack_alloc()
     synstate_T	*to, *from;
     synstate_T	*sstp;
 
+    if (syn_buf->b_sst_array == NULL && syn_buf->b_sst_saved != NULL)
+	syn_stack_restore();
+
     len = syn_buf->b_ml.ml_line_count / SST_DIST + Rows * 2;
     if (len < SST_MIN_ENTRIES)
 	len = SST_MIN_ENTRIES;
@@ -1212,6 +1625,22 @@ syn_stack_apply_changes(buf)
     if (buf->b_sst_array == NULL)	/* nothing to do */
 	return;
 
+#ifdef FEAT_RELTIME
+    /* States from syntax_idle() below the change need to be checked. */
+    n = buf->b_mod_top - buf->b_syn_sync_linebreaks;
+    if (buf->b_sst_idle_lnum > n)
+	buf->b_sst_idle_lnum = n > 0 ? n : 0;
+    if (buf->b_sst_near_bot > n)
+    {
+	if (n > buf->b_sst_near_top)
+	    buf->b_sst_near_bot = n;
+	else
+	    buf->b_sst_near_top = buf->b_sst_near_bot = 0;
+    }
+    if (buf->b_sst_near_up > n)
+	buf->b_sst_near_up = 0;
+#endif
+
     prev = NULL;
     for (p = buf->b_sst_first; p != NULL; )
     {
@@ -1605,6 +2034,341 @@ syntax_end_parsing(lnum)
 	sp->sst_change_lnum = lnum;
 }
 
+#if defined(FEAT_RELTIME) || defined(PROTO)
+/*
+ * Called when waiting for the user to type a character: parse the syntax of
+ * the buffers in the windows from the start, storing states in
+ * b_sst_array[], so that a redraw always finds a saved state nearby.  Works
+ * in slices of 'syntaxidle' msec until a character is available.
+ * Returns TRUE when a window was drawn with a shortened sync and has now
+ * been marked for redrawing.
+ */
+    int
+syntax_idle()
+{
+    proftime_T	tm;
+    win_T	*wp;
+    int		busy;
+    int		redraw = FALSE;
+
+    if (p_sxi <= 0)
+	return FALSE;
+    do
+    {
+	profile_setlimit(p_sxi, &tm);
+	/* Start with the current window, then do the others. */
+	busy = syn_idle_parse(curwin, &tm, &redraw);
+	FOR_ALL_WINDOWS(wp)
+	    if (!busy && wp != curwin)
+		busy = syn_idle_parse(wp, &tm, &redraw);
+    } while (busy && !ui_char_avail());
+    return redraw;
+}
+
+/*
+ * Parse the syntax for the buffer of window "wp" from b_sst_idle_lnum
+ * onwards, until the time limit "tm" has passed.  Windows that were drawn
+ * with a shortened sync are redrawn when parsing gets past their last line,
+ * "*redrawp" is set then.
+ * Returns TRUE when the end of the buffer was not reached yet.
+ */
+    static int
+syn_idle_parse(wp, tm, redrawp)
+    win_T	*wp;
+    proftime_T	*tm;
+    int		*redrawp;
+{
+    buf_T	*buf = wp->w_buffer;
+    synstate_T	*p;
+    synstate_T	*sp;		/* last saved state before current_lnum */
+    synstate_T	*prev = NULL;	/* last state stored or checked */
+    linenr_T	old_lnum;
+    int		dist;
+    int		save_got_int = got_int;
+    win_T	*twp;
+
+    if (!syntax_present(buf) || buf->b_syn_error || buf->b_mod_set)
+	return FALSE;
+    if (syn_idle_can_sync(buf))
+	return syn_idle_near(wp, tm);
+    if (buf->b_sst_idle_lnum >= buf->b_ml.ml_line_count)
+	return FALSE;
+
+    old_lnum = buf->b_sst_idle_lnum;
+    invalidate_current_state();
+    syn_buf = buf;
+    syn_win = wp;
+    syn_stack_alloc();
+    if (buf->b_sst_array == NULL)
+	return FALSE;		/* out of memory */
+
+    /* Continue at the last valid state stored at or before b_sst_idle_lnum,
+     * these were all found by parsing from the first line.  Start at the
+     * first line without any state when there is none. */
+    for (p = buf->b_sst_first; p != NULL
+			    && p->sst_lnum <= buf->b_sst_idle_lnum; p = p->sst_next)
+	if (p->sst_change_lnum == 0)
+	    prev = p;
+    if (prev != NULL)
+	load_current_state(prev);
+    else
+    {
+	current_lnum = 1;
+	validate_current_state();
+    }
+    sp = syn_stack_find_entry(current_lnum);
+
+    if (buf->b_sst_len <= Rows)
+	dist = 999999;
+    else
+	dist = buf->b_ml.ml_line_count / (buf->b_sst_len - Rows) + 1;
+    got_int = FALSE;
+    ++emsg_off;
+    while (current_lnum < buf->b_ml.ml_line_count)
+    {
+	syn_start_line();
+	(void)syn_finish_line(FALSE);
+	++current_lnum;
+
+	/* A state saved for this line that is different was found with a
+	 * shortened sync or depends on a change: replace it.  Otherwise store
+	 * a state every "dist" lines. */
+	p = sp == NULL ? buf->b_sst_first : sp->sst_next;
+	if (p != NULL && p->sst_lnum == current_lnum && syn_stack_equal(p))
+	{
+	    p->sst_change_lnum = 0;
+	    prev = sp = p;
+	}
+	else if ((p != NULL && p->sst_lnum == current_lnum)
+		|| prev == NULL
+		|| current_lnum >= prev->sst_lnum + dist)
+	{
+	    p = store_current_state();
+	    if (p != NULL)
+		prev = p;
+	    /* Storing may have removed entries, find our place again. */
+	    sp = syn_stack_find_entry(current_lnum);
+	}
+
+	/* Don't stop before a state was stored past where we started, the
+	 * last one may be removed again when b_sst_array[] is full. */
+	if (got_int || (profile_passed_limit(tm)
+			       && prev != NULL && prev->sst_lnum > old_lnum))
+	    break;
+    }
+
+    /* Remember where to continue.  After an error or interrupt the states
+     * can't be trusted, stop parsing this buffer. */
+    if (got_int)
+	buf->b_sst_idle_lnum = buf->b_ml.ml_line_count;
+    else
+    {
+	(void)store_current_state();
+	buf->b_sst_idle_lnum = current_lnum;
+    }
+    --emsg_off;
+    got_int = save_got_int;
+
+    /* syntax_start() must not continue from this state. */
+    invalidate_current_state();
+
+    if (buf->b_sst_fallback != 0)
+    {
+	FOR_ALL_WINDOWS(twp)
+	    if (twp->w_buffer == buf
+		    && buf->b_sst_fallback < twp->w_botline
+		    && old_lnum < twp->w_botline
+		    && (buf->b_sst_idle_lnum >= twp->w_botline
+			|| buf->b_sst_idle_lnum >= buf->b_ml.ml_line_count))
+	    {
+		redraw_win_later(twp, NOT_VALID);
+		*redrawp = TRUE;
+	    }
+	if (buf->b_sst_idle_lnum >= buf->b_ml.ml_line_count)
+	    buf->b_sst_fallback = 0;
+    }
+    return buf->b_sst_idle_lnum < buf->b_ml.ml_line_count;
+}
+
+/*
+ * Return TRUE when syncing "buf" at any line only looks at a limited number
+ * of lines above it.  A "ccomment" search only compares characters, that is
+ * cheap even without "maxlines".
+ */
+    static int
+syn_idle_can_sync(buf)
+    buf_T	*buf;
+{
+    return buf->b_syn_sync_minlines <= SST_IDLE_MAXPARSE
+	    && (!(buf->b_syn_sync_flags & SF_MATCH)
+		|| (buf->b_syn_sync_maxlines > 0
+			&& buf->b_syn_sync_maxlines <= SST_IDLE_MAXPARSE));
+}
+
+/*
+ * Parse the syntax for the buffer of window "wp" around the cursor, for a
+ * buffer where syncing is cheap.  Every step parses a region of lines above
+ * or below the lines done so far, whichever is closer to the cursor, until
+ * the time limit "tm" has passed.  A region below continues from the state
+ * stored at its start, a region above is synced with syntax_start().  The
+ * states found that way are compared with the ones stored for the lines
+ * below it, until they are equal, thus they don't depend on where parsing
+ * started.  When the time runs out while doing that, b_sst_near_up is set
+ * to the line where the next call continues.
+ * Returns TRUE when not all lines were done yet.
+ */
+    static int
+syn_idle_near(wp, tm)
+    win_T	*wp;
+    proftime_T	*tm;
+{
+    buf_T	*buf = wp->w_buffer;
+    linenr_T	lnum = wp->w_cursor.lnum;
+    linenr_T	count = buf->b_ml.ml_line_count;
+    linenr_T	size = SST_IDLE_REGION + buf->b_syn_sync_minlines;
+    linenr_T	from;
+    linenr_T	to;
+    linenr_T	stop;
+    synstate_T	*p;
+    synstate_T	*sp;		/* last saved state before current_lnum */
+    synstate_T	*prev;		/* last state stored or checked */
+    linenr_T	start;
+    int		down;
+    int		equal;
+    int		timeout;
+    int		dist;
+    int		save_got_int = got_int;
+
+    /* Start at the cursor when it moved away from the lines done. */
+    if (buf->b_sst_near_bot == 0 || lnum + size < buf->b_sst_near_top
+					  || lnum > buf->b_sst_near_bot + size)
+    {
+	buf->b_sst_near_top = buf->b_sst_near_bot = lnum;
+	buf->b_sst_near_up = 0;
+    }
+    if (buf->b_sst_near_bot > count)
+	buf->b_sst_near_bot = count;
+    if (buf->b_sst_near_top > buf->b_sst_near_bot)
+	buf->b_sst_near_top = buf->b_sst_near_bot;
+
+    got_int = FALSE;
+    ++emsg_off;
+    while (buf->b_sst_near_top > 1 || buf->b_sst_near_bot < count)
+    {
+	/* Continuing a region above requires the state stored where it
+	 * stopped, otherwise the region is done again. */
+	if (buf->b_sst_near_up != 0
+		&& ((p = syn_stack_find_entry(buf->b_sst_near_up)) == NULL
+				       || p->sst_lnum != buf->b_sst_near_up))
+	    buf->b_sst_near_up = 0;
+
+	down = buf->b_sst_near_up == 0 && buf->b_sst_near_bot < count
+		&& (buf->b_sst_near_top <= 1
+		    || buf->b_sst_near_bot - lnum <= lnum - buf->b_sst_near_top);
+	if (down)
+	{
+	    from = buf->b_sst_near_bot;
+	    to = from + size < count ? from + size : count;
+	    stop = to;
+	}
+	else
+	{
+	    from = buf->b_sst_near_top > size ? buf->b_sst_near_top - size : 1;
+	    to = buf->b_sst_near_top;
+	    stop = buf->b_sst_near_bot;
+	}
+	start = buf->b_sst_near_up != 0 ? buf->b_sst_near_up : from;
+
+	/* Get the state at "start", either a stored one or by syncing. */
+	invalidate_current_state();
+	syntax_start(wp, start);
+	if (got_int || buf->b_sst_array == NULL)
+	    break;
+
+	if (buf->b_sst_len <= Rows)
+	    dist = 999999;
+	else
+	    dist = count / (buf->b_sst_len - Rows) + 1;
+	prev = sp = syn_stack_find_entry(current_lnum);
+	equal = FALSE;
+	timeout = FALSE;
+	while (current_lnum < count && (current_lnum < to
+					     || (current_lnum < stop && !equal)))
+	{
+	    (void)syn_finish_line(FALSE);
+	    ++current_lnum;
+
+	    /* Same as in syn_idle_parse(), also store a state at the end of
+	     * the region, where the next one continues. */
+	    p = sp == NULL ? buf->b_sst_first : sp->sst_next;
+	    equal = (p != NULL && p->sst_lnum == current_lnum
+						       && syn_stack_equal(p));
+	    if (equal)
+	    {
+		p->sst_change_lnum = 0;
+		prev = sp = p;
+	    }
+	    else if ((p != NULL && p->sst_lnum == current_lnum)
+		    || prev == NULL
+		    || current_lnum >= prev->sst_lnum + dist
+		    || current_lnum == to)
+	    {
+		p = store_current_state();
+		if (p != NULL)
+		    prev = p;
+		/* Storing may have removed entries, find our place again. */
+		sp = syn_stack_find_entry(current_lnum);
+	    }
+	    if (got_int)
+		break;
+	    /* The next call can continue at a stored state. */
+	    if (prev != NULL && prev->sst_lnum == current_lnum
+						   && profile_passed_limit(tm))
+	    {
+		timeout = TRUE;
+		break;
+	    }
+	    syn_start_line();
+	}
+	if (got_int)
+	    break;
+
+	if (down)
+	    buf->b_sst_near_bot = current_lnum;
+	else if (timeout && current_lnum < count
+		      && (current_lnum < to || (current_lnum < stop && !equal)))
+	{
+	    /* Lines from "from" are not known to be right yet. */
+	    buf->b_sst_near_up = current_lnum;
+	    break;
+	}
+	else
+	{
+	    buf->b_sst_near_top = from;
+	    buf->b_sst_near_up = 0;
+	}
+	if (profile_passed_limit(tm))
+	    break;
+    }
+
+    /* After an error or interrupt the states can't be trusted, stop parsing
+     * this buffer. */
+    if (got_int)
+    {
+	buf->b_sst_near_top = 1;
+	buf->b_sst_near_bot = count;
+	buf->b_sst_near_up = 0;
+    }
+    --emsg_off;
+    got_int = save_got_int;
+
+    /* syntax_start() must not continue from this state. */
+    invalidate_current_state();
+
+    return buf->b_sst_near_top > 1 || buf->b_sst_near_bot < count;
+}
+#endif
+
 /*
  * End of handling of the state stack.
  ****************************************/
@@ -1999,8 +2763,10 @@ syn_current_attr(syncing, displaying, can_spell, keep_state)
 
 			    regmatch.rmm_ic = spp->sp_ic;
 			    regmatch.regprog = spp->sp_prog;
-			    if (!syn_regexec(&regmatch, current_lnum,
-							     (colnr_T)lc_col))
+			    if (!syn_may_match(spp, current_lnum,
+							      (colnr_T)lc_col)
+				    || !syn_regexec(&regmatch, current_lnum,
+							(colnr_T)lc_col, spp))
 			    {
 				/* no match in this line, try another one */
 				spp->sp_startcol = MAXCOL;
@@ -2846,7 +3612,8 @@ find_endpos(idx, startpos, m_endpos, hl_endpos, flagsp, end_endpos,
 
 	    regmatch.rmm_ic = spp->sp_ic;
 	    regmatch.regprog = spp->sp_prog;
-	    if (syn_regexec(&regmatch, startpos->lnum, lc_col))
+	    if (syn_may_match(spp, startpos->lnum, lc_col)
+		    && syn_regexec(&regmatch, startpos->lnum, lc_col, spp))
 	    {
 		if (best_idx == -1 || regmatch.startpos[0].col
 					      < best_regmatch.startpos[0].col)
@@ -2877,7 +3644,8 @@ find_endpos(idx, startpos, m_endpos, hl_endpos, flagsp, end_endpos,
 		lc_col = 0;
 	    regmatch.rmm_ic = spp_skip->sp_ic;
 	    regmatch.regprog = spp_skip->sp_prog;
-	    if (syn_regexec(&regmatch, startpos->lnum, lc_col)
+	    if (syn_may_match(spp_skip, startpos->lnum, lc_col)
+		    && syn_regexec(&regmatch, startpos->lnum, lc_col, spp_skip)
 		    && regmatch.startpos[0].col
 					     <= best_regmatch.startpos[0].col)
 	    {
@@ -3116,16 +3884,41 @@ syn_getcurline()
 
 /*
  * Call vim_regexec() to find a match with "rmp" in "syn_buf".
+ * "spp" is the pattern being tried, for ":syntime", or NULL.
  * Returns TRUE when there is a match.
  */
     static int
-syn_regexec(rmp, lnum, col)
+syn_regexec(rmp, lnum, col, spp)
     regmmatch_T	*rmp;
     linenr_T	lnum;
     colnr_T	col;
+    synpat_T	*spp UNUSED;
 {
+    int		r;
+#ifdef FEAT_PROFILE
+    proftime_T	pt;
+
+    if (syn_time_on && spp != NULL)
+	profile_start(&pt);
+#endif
+
     rmp->rmm_maxcol = syn_buf->b_p_smc;
-    if (vim_regexec_multi(rmp, syn_win, syn_buf, lnum, col, NULL) > 0)
+    r = vim_regexec_multi(rmp, syn_win, syn_buf, lnum, col, NULL);
+
+#ifdef FEAT_PROFILE
+    if (syn_time_on && spp != NULL)
+    {
+	profile_end(&pt);
+	profile_add(&spp->sp_time.st_total, &pt);
+	if (profile_cmp(&spp->sp_time.st_slowest, &pt) > 0)
+	    spp->sp_time.st_slowest = pt;
+	++spp->sp_time.st_count;
+	if (r > 0)
+	    ++spp->sp_time.st_match;
+    }
+#endif
+
+    if (r > 0)
     {
 	rmp->startpos[0].lnum += lnum;
 	rmp->endpos[0].lnum += lnum;
@@ -3134,6 +3927,65 @@ syn_regexec(rmp, lnum, col)
     return FALSE;
 }
 
+/*
+ * Return FALSE when pattern "spp" can't match in line "lnum" at or after
+ * column "col" of "syn_buf", because none of the bytes a match may start with
+ * appear there.  This is much cheaper than calling syn_regexec().
+ */
+    static int
+syn_may_match(spp, lnum, col)
+    synpat_T	*spp;
+    linenr_T	lnum;
+    colnr_T	col;
+{
+    char_u	*line;
+    colnr_T	i;
+    int		c;
+    int		bits;
+
+    if (!spp->sp_has_first)
+	return TRUE;
+
+    if (syn_first_line_id != current_line_id || syn_first_lnum != lnum
+						    || syn_first_buf != syn_buf)
+    {
+	vim_memset(syn_first_bytes, 0, sizeof(syn_first_bytes));
+	line = ml_get_buf(syn_buf, lnum, FALSE);
+	/* A match doesn't start at or after 'synmaxcol'. */
+	for (i = 0; line[i] != NUL
+			 && (syn_buf->b_p_smc == 0 || i < syn_buf->b_p_smc); ++i)
+	{
+	    syn_first_bytes[line[i] >> 3] |= 1 << (line[i] & 7);
+	    syn_first_col[line[i]] = i + 1;
+	}
+	syn_first_line_id = current_line_id;
+	syn_first_lnum = lnum;
+	syn_first_buf = syn_buf;
+    }
+
+    /* Check the bytes that are in the line and may start a match. */
+    for (i = 0; i < 32; ++i)
+    {
+	bits = syn_first_bytes[i] & spp->sp_first[i];
+	for (c = i << 3; bits != 0; ++c, bits >>= 1)
+	    if ((bits & 1) && syn_first_col[c] > col)
+		return TRUE;
+    }
+    return FALSE;
+}
+
+/*
+ * Set "sp_first" of "spp" to the bytes a match may start with, for
+ * syn_may_match().
+ */
+    static void
+syn_set_first(spp)
+    synpat_T	*spp;
+{
+    spp->sp_has_first = vim_regfirst(spp->sp_prog, spp->sp_ic, spp->sp_first)
+									== OK;
+}
+
 /*
  * Check one position in a line for a matching keyword.
  * The caller must check if a keyword can start at startcol.
@@ -3306,7 +4158,7 @@ syntax_clear(buf)
     buf->b_syn_sync_maxlines = 0;
     buf->b_syn_sync_linebreaks = 0;
 
-    vim_free(buf->b_syn_linecont_prog);
+    vim_regfree(buf->b_syn_linecont_prog);
     buf->b_syn_linecont_prog = NULL;
     vim_free(buf->b_syn_linecont_pat);
     buf->b_syn_linecont_pat = NULL;
@@ -3337,7 +4189,7 @@ syntax_sync_clear()
     curbuf->b_syn_sync_maxlines = 0;
     curbuf->b_syn_sync_linebreaks = 0;
 
-    vim_free(curbuf->b_syn_linecont_prog);
+    vim_regfree(curbuf->b_syn_linecont_prog);
     curbuf->b_syn_linecont_prog = NULL;
     vim_free(curbuf->b_syn_linecont_pat);
     curbuf->b_syn_linecont_pat = NULL;
@@ -3376,7 +4228,7 @@ syn_clear_pattern(buf, i)
     int		i;
 {
     vim_free(SYN_ITEMS(buf)[i].sp_pattern);
-    vim_free(SYN_ITEMS(buf)[i].sp_prog);
+    vim_regfree(SYN_ITEMS(buf)[i].sp_prog);
     /* Only free sp_cont_list and sp_next_list of first start pattern */
     if (i == 0 || SYN_ITEMS(buf)[i - 1].sp_type != SPTYPE_START)
     {
@@ -3609,7 +4461,7 @@ syn_cmd_list(eap, syncing)
 
     if (!syntax_present(curbuf))
     {
-	MSG(_("No Syntax items defined for this buffer"));
+	MSG(_(msg_no_items));
 	return;
     }
 
@@ -4733,7 +5585,7 @@ syn_cmd_match(eap, syncing)
     /*
      * Something failed, free the allocated memory.
      */
-    vim_free(item.sp_prog);
+    vim_regfree(item.sp_prog);
     vim_free(item.sp_pattern);
     vim_free(syn_opt_arg.cont_list);
     vim_free(syn_opt_arg.cont_in_list);
@@ -4985,7 +5837,7 @@ syn_cmd_region(eap, syncing)
 	{
 	    if (!success)
 	    {
-		vim_free(ppp->pp_synp->sp_prog);
+		vim_regfree(ppp->pp_synp->sp_prog);
 		vim_free(ppp->pp_synp->sp_pattern);
 	    }
 	    vim_free(ppp->pp_synp);
@@ -5386,6 +6238,7 @@ get_syn_pattern(arg, ci)
     if (ci->sp_prog == NULL)
 	return NULL;
     ci->sp_ic = curbuf->b_syn_ic;
+    syn_set_first(ci);
 
     /*
      * Check for a match, highlight or region offset.
@@ -5744,7 +6597,7 @@ get_id_list(arg, keylen, list)
 			    id = -1;	    /* remember that we found one */
 			}
 		    }
-		    vim_free(regmatch.regprog);
+		    vim_regfree(regmatch.regprog);
 		}
 	    }
 	    vim_free(name);
@@ -6001,6 +6854,151 @@ ex_syntax(eap)
     }
 }
 
+#if defined(FEAT_PROFILE) || defined(PROTO)
+/*
+ * ":syntime on": start collecting the time used by each syntax pattern.
+ * ":syntime off": stop collecting.
+ * ":syntime clear": reset the times for the current buffer.
+ * ":syntime report": list the times for the current buffer.
+ */
+    void
+ex_syntime(eap)
+    exarg_T	*eap;
+{
+    if (STRCMP(eap->arg, "on") == 0)
+	syn_time_on = TRUE;
+    else if (STRCMP(eap->arg, "off") == 0)
+	syn_time_on = FALSE;
+    else if (STRCMP(eap->arg, "clear") == 0)
+	syntime_clear();
+    else if (STRCMP(eap->arg, "report") == 0)
+	syntime_report();
+    else
+	EMSG2(_(e_invarg2), eap->arg);
+}
+
+    static void
+syn_clear_time(st)
+    syn_time_T	*st;
+{
+    profile_zero(&st->st_total);
+    profile_zero(&st->st_slowest);
+    st->st_count = 0;
+    st->st_match = 0;
+}
+
+/*
+ * Clear the syntax timing for the current buffer.
+ */
+    static void
+syntime_clear()
+{
+    int		idx;
+
+    if (!syntax_present(curbuf))
+    {
+	MSG(_(msg_no_items));
+	return;
+    }
+    for (idx = 0; idx < curbuf->b_syn_patterns.ga_len; ++idx)
+	syn_clear_time(&SYN_ITEMS(curbuf)[idx].sp_time);
+}
+
+static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+syn_compare_time __ARGS((const void *s1, const void *s2));
+
+/*
+ * Compare two patterns for qsort(), the one that used the most time comes
+ * first.
+ */
+    static int
+#ifdef __BORLANDC__
+_RTLENTRYF
+#endif
+syn_compare_time(s1, s2)
+    const void	*s1;
+    const void	*s2;
+{
+    synpat_T	*spp1 = *(synpat_T **)s1;
+    synpat_T	*spp2 = *(synpat_T **)s2;
+
+    return profile_cmp(&spp1->sp_time.st_total, &spp2->sp_time.st_total);
+}
+
+/*
+ * List the syntax patterns of the current buffer that were tried, the one
+ * that used the most time first, with the total time at the end.
+ */
+    static void
+syntime_report()
+{
+    synpat_T	**list;
+    synpat_T	*spp;
+    proftime_T	total;
+    long	count = 0;
+    int		len = 0;
+    int		idx;
+
+    if (!syntax_present(curbuf))
+    {
+	MSG(_(msg_no_items));
+	return;
+    }
+
+    list = (synpat_T **)alloc((unsigned)(sizeof(synpat_T *)
+					   * (curbuf->b_syn_patterns.ga_len + 1)));
+    if (list == NULL)
+	return;
+    profile_zero(&total);
+    for (idx = 0; idx < curbuf->b_syn_patterns.ga_len; ++idx)
+    {
+	spp = &SYN_ITEMS(curbuf)[idx];
+	if (spp->sp_time.st_count > 0)
+	{
+	    list[len++] = spp;
+	    profile_add(&total, &spp->sp_time.st_total);
+	    count += spp->sp_time.st_count;
+	}
+    }
+    qsort((void *)list, (size_t)len, sizeof(synpat_T *), syn_compare_time);
+
+    MSG_PUTS_TITLE(_("\n  TOTAL         COUNT  MATCH      SLOWEST         AVERAGE   NAME        PATTERN"));
+    for (idx = 0; idx < len && !got_int; ++idx)
+    {
+	spp = list[idx];
+	msg_putchar('\n');
+	msg_puts((char_u *)profile_msg(&spp->sp_time.st_total));
+	vim_snprintf((char *)IObuff, IOSIZE, " %10ld %6ld   ",
+			       spp->sp_time.st_count, spp->sp_time.st_match);
+	msg_puts(IObuff);
+	msg_puts((char_u *)profile_msg(&spp->sp_time.st_slowest));
+	/* Most patterns take less than a microsecond, show nanoseconds. */
+	sprintf((char *)IObuff, "   %13.9f   ",
+		      (double)profile_usec(&spp->sp_time.st_total) / 1000000.0
+					    / (double)spp->sp_time.st_count);
+	msg_puts(IObuff);
+	msg_outtrans(HL_TABLE()[spp->sp_syn.id - 1].sg_name);
+	msg_advance(72);
+	msg_outtrans(spp->sp_pattern);
+	out_flush();
+	ui_breakcheck();
+    }
+    vim_free(list);
+
+    if (!got_int)
+    {
+	msg_puts((char_u *)"\n\n");
+	msg_puts((char_u *)profile_msg(&total));
+	vim_snprintf((char *)IObuff, IOSIZE, " %10ld", count);
+	msg_puts(IObuff);
+	msg_putchar('\n');
+    }
+}
+#endif
+
     int
 syntax_present(buf)
     buf_T	*buf;
@@ -26,7 +26,9 @@ SCRIPTS = test1.out test3.out test4.out test5.out test6.out \
 		test48.out test51.out test53.out test54.out test55.out \
 		test56.out test57.out test58.out test59.out test60.out \
 		test61.out test62.out test63.out test64.out test65.out \
-		test66.out test67.out test68.out test69.out
+		test66.out test67.out test68.out test69.out test70.out \
+		test71.out test72.out test73.out test74.out test75.out \
+		test76.out test77.out test78.out
 
 .SUFFIXES: .in .out
 
@@ -0,0 +1,44 @@
+" Benchmark for the byte offset index: make a buffer with many lines, then
+" insert, delete and change lines at random places and after each change ask
+" for the byte offset of a line and the line at a byte offset.
+"
+" Run with "make benchmark" in this directory.  The number of lines is set
+" with BENCH_BYTEOFF_LINES in the Makefile.
+
+set nocp undolevels=-1
+let s:results = []
+
+let s:start = reltime()
+edit Xbench_byteoff
+call add(s:results, 'byteoff: loading ' . line('$') . ' lines: '
+      \ . reltimestr(reltime(s:start)) . ' sec')
+
+" Simple linear congruential generator, the numbers stay below 2^31.  Two
+" of them are combined to get numbers up to 2^30.
+let s:seed = 4711
+func s:Random(n)
+  let s:seed = (s:seed * 75 + 74) % 65537
+  let r = s:seed % 32768
+  let s:seed = (s:seed * 75 + 74) % 65537
+  return (r * 32768 + s:seed % 32768) % a:n
+endfunc
+
+let s:start = reltime()
+let s:total = 0
+for s:i in range(1, 20000)
+  let s:lnum = s:Random(line('$')) + 1
+  if s:i % 4 == 0
+    exe s:lnum . 'delete _ ' . (s:Random(20) + 1)
+  elseif s:i % 4 == 1
+    call append(s:lnum, repeat(['inserted line ' . s:i], s:Random(20) + 1))
+  else
+    call setline(s:lnum, 'changed line ' . s:i)
+  endif
+  let s:total += line2byte(s:Random(line('$')) + 1)
+  let s:total += byte2line(s:Random(line2byte(line('$'))) + 1)
+endfor
+call add(s:results, 'byteoff: 20000 edits with offset lookups: '
+      \ . reltimestr(reltime(s:start)) . ' sec')
+
+call writefile(s:results, 'benchmark.out')
+qa!
@@ -0,0 +1,46 @@
+" Benchmark for the memfile block cache: load a big file, then fetch lines
+" in pseudo-random order, so that most mf_get() calls have to look up a block
+" in the hash table and many have to read it back from the swap file.
+"
+" Run with "make benchmark" in this directory.  The size of the generated file
+" is set with BENCH_MF_SIZE in the Makefile (in Mbyte).
+
+set nocp
+let s:results = []
+
+let s:start = reltime()
+edit Xbench_mf
+call add(s:results, 'memfile: loading ' . line('$') . ' lines: '
+      \ . reltimestr(reltime(s:start)) . ' sec')
+
+" Simple linear congruential generator, the numbers stay below 2^31.
+let s:seed = 4711
+func s:Random()
+  let s:seed = (s:seed * 75 + 74) % 65537
+  return s:seed
+endfunc
+
+let s:lnum_max = line('$')
+for s:count in [10000, 100000]
+  let s:start = reltime()
+  for s:i in range(s:count)
+    let s:lnum = ((s:Random() % 32768) * 65536 + s:Random()) % s:lnum_max + 1
+    call getline(s:lnum)
+  endfor
+  call add(s:results, 'memfile: ' . s:count . ' random line lookups: '
+	\ . reltimestr(reltime(s:start)) . ' sec')
+endfor
+
+" Jump around like a user would, this also updates the screen.
+let s:start = reltime()
+for s:i in range(1000)
+  let s:lnum = ((s:Random() % 32768) * 65536 + s:Random()) % s:lnum_max + 1
+  exe s:lnum
+  redraw
+endfor
+call add(s:results, 'memfile: 1000 random jumps with redraw: '
+      \ . reltimestr(reltime(s:start)) . ' sec')
+
+bwipe!
+call writefile(s:results, 'benchmark.out')
+qa!
@@ -0,0 +1,25 @@
+" Benchmark for reading files: edit a file with short lines and one with long
+" lines, then append them to a buffer with ":read".
+"
+" Run with "make benchmark" in this directory.  The size of the generated
+" files is set with BENCH_READ_SIZE in the Makefile (in Mbyte).
+
+set nocp noswapfile undolevels=-1
+let s:results = []
+
+for s:name in ['Xbench_short', 'Xbench_long']
+  let s:start = reltime()
+  exe 'edit ' . s:name
+  call add(s:results, 'read: editing ' . s:name . ', ' . line('$')
+	\ . ' lines: ' . reltimestr(reltime(s:start)) . ' sec')
+  bwipe!
+
+  let s:start = reltime()
+  exe 'read ' . s:name
+  call add(s:results, 'read: ":read ' . s:name . '", ' . line('$')
+	\ . ' lines: ' . reltimestr(reltime(s:start)) . ' sec')
+  enew!
+endfor
+
+call writefile(s:results, 'benchmark.out')
+qa!
@@ -0,0 +1,217 @@
+" Benchmark for the regexp engines: generate a few kinds of text, then run a
+" set of search patterns, patterns taken from the syntax files and some
+" pathological patterns over them with ":s///n", once with each engine that can
+" run the pattern.
+" For every pattern this reports the time, the number of Mbyte per second
+" and the number of matches.  When the +profile feature is available it also
+" reports the number of steps and backtracks from regstats(), these don't
+" depend on the speed of the machine and can be compared between versions.
+"
+" Run with "make benchmark" in this directory.  The number of lines of each
+" text is set with BENCH_REGEXP_LINES in the Makefile.
+
+set nocp undolevels=-1 nohlsearch noincsearch
+set encoding=utf-8
+if !exists('bench_lines')
+  let bench_lines = 20000
+endif
+let s:results = []
+
+" Simple linear congruential generator, the numbers stay below 2^31.
+let s:seed = 4711
+func s:Random(n)
+  let s:seed = (s:seed * 75 + 74) % 65537
+  return s:seed % a:n
+endfunc
+
+func s:Pick(list)
+  return a:list[s:Random(len(a:list))]
+endfunc
+
+" C-like source code.
+func s:MakeCode(n)
+  let lines = []
+  let names = ['buf', 'len', 'ptr', 'count', 'lnum', 'col', 'idx', 'flags']
+  for i in range(a:n)
+    let k = i % 8
+    let name = s:Pick(names)
+    if k == 0
+      call add(lines, '/*')
+      call add(lines, ' * Function number ' . i . ', it handles ' . name . '.')
+      call add(lines, ' */')
+      call add(lines, '    static int')
+      call add(lines, 'func_' . i . '(char_u *' . name . ', long n)')
+      call add(lines, '{')
+    elseif k == 1
+      call add(lines, "\tint\t\t" . name . '_' . i . ' = 0x' . printf('%x', s:Random(65536)) . 'L;')
+    elseif k == 2
+      call add(lines, "\tif (" . name . '[' . s:Random(100) . "] == '\\n' && n > " . s:Random(1000) . ')')
+    elseif k == 3
+      call add(lines, "\t    return vim_strsave((char_u *)\"" . name . " is %d\\n\");  ")
+    elseif k == 4
+      call add(lines, "\tfor (i = 0; i < " . s:Random(500) . '; ++i)   /* loop over ' . name . ' */')
+    elseif k == 5
+      call add(lines, "\t    " . name . ' += ' . s:Random(10) . '.' . s:Random(100) . 'f * ' . name . '_' . s:Random(i + 1) . ';')
+    elseif k == 6
+      call add(lines, "\tcase '" . nr2char(char2nr('a') + s:Random(26)) . "': break;")
+    else
+      call add(lines, '}')
+      call add(lines, '')
+    endif
+  endfor
+  return lines[: a:n - 1]
+endfunc
+
+" Log file lines.
+func s:MakeLog(n)
+  let lines = []
+  let levels = ['INFO', 'INFO', 'INFO', 'DEBUG', 'WARNING', 'ERROR']
+  let paths = ['/api/v1/items/', '/api/v1/users/', '/static/img/', '/login']
+  for i in range(a:n)
+    call add(lines, printf('2009-%02d-%02d %02d:%02d:%02d %s [worker-%d] GET %s%d took %d ms status=%d',
+	  \ s:Random(12) + 1, s:Random(28) + 1, s:Random(24), s:Random(60),
+	  \ s:Random(60), s:Pick(levels), s:Random(16), s:Pick(paths),
+	  \ s:Random(100000), s:Random(2000), s:Pick([200, 200, 200, 304, 404, 500])))
+  endfor
+  return lines
+endfunc
+
+" English-like prose.
+func s:MakeProse(n)
+  let lines = []
+  let words = ['the', 'quick', 'brown', 'fox', 'jumps', 'over', 'lazy', 'dog',
+	\ 'and', 'then', 'it', 'was', 'a', 'very', 'long', 'day', 'for', 'everyone',
+	\ 'in', 'village', 'where', 'nothing', 'ever', 'happened', 'before']
+  for i in range(a:n)
+    let line = toupper(s:Pick(words)[0]) . s:Pick(words)[1:]
+    for j in range(s:Random(14))
+      let line .= ' ' . s:Pick(words)
+    endfor
+    call add(lines, line . s:Pick(['.', '.', ',', ';', '!', '?', ' the the']))
+  endfor
+  return lines
+endfunc
+
+" UTF-8 text with Japanese and Chinese characters mixed with ASCII.
+func s:MakeCJK(n)
+  let lines = []
+  let chars = []
+  for c in [0x3042, 0x3044, 0x3046, 0x3048, 0x304a, 0x304b, 0x306e, 0x3092,
+	\ 0x30a2, 0x30ab, 0x30c6, 0x65e5, 0x672c, 0x8a9e, 0x4e2d, 0x6587,
+	\ 0x5b57, 0x5e74, 0x6708, 0x3001, 0x3002, 0xff01]
+    call add(chars, nr2char(c))
+  endfor
+  for i in range(a:n)
+    let line = ''
+    for j in range(s:Random(30) + 5)
+      let line .= s:Pick(chars)
+      if s:Random(8) == 0
+	let line .= ' vim' . s:Random(100) . ' '
+      endif
+    endfor
+    call add(lines, line)
+  endfor
+  return lines
+endfunc
+
+" Short lines on which backtracking patterns take a long time.
+func s:MakePatho(n)
+  let lines = []
+  for i in range(a:n)
+    call add(lines, repeat('a', 10 + i % 5) . ['cd', 'c d', 'ac', 'xc'][i % 4])
+  endfor
+  return lines
+endfunc
+
+" Patterns for each kind of text.  Search patterns first, then patterns
+" from runtime/syntax/c.vim and others.
+let s:patterns = {}
+let s:patterns.code = ['ptr', '\<count\>', 'func_\d\+', '\s\+$', '^\s*$',
+      \ '\k\+(', '\/\*.\{-}\*\/', '"\(\\.\|[^"\\]\)*"',
+      \ '\d\+\(u\=l\{0,2}\|ll\=u\)\>', '0x\x\+\(u\=l\{0,2}\|ll\=u\)\>',
+      \ '\d\+\.\d*\(e[-+]\=\d\+\)\=[fl]\=', "L\\='[^\\\\]'",
+      \ '\<\(if\|for\|while\|return\|case\)\>', '%\(\d\+\$\)\=[-+'' #0*]*\(\d*\|\*\)\([hlL]\|ll\)\=\([diuoxXfeEgGcsp]\)',
+      \ '^\s*\(%:\|#\)\s*\(if\|ifdef\|ifndef\|elif\)\>']
+let s:patterns.log = ['ERROR', '\cerror\|warning', '^\d\{4}-\d\d-\d\d',
+      \ '\d\+:\d\+:\d\+', 'status=[45]\d\d', '/api/v1/\w\+/\d\+',
+      \ 'took \d\{4} ms', '\[worker-\d\+\]', '\v<(\d+)-(\d+)-\2>']
+let s:patterns.prose = ['the', '\<the\>', '\cTHE', 'fox\|dog\|day', '\<\(\w\+\) \1\>',
+      \ '[.!?]$', '\<\u\l*', '\w\+ing\>', 'ever.*ever', '\(a\|e\|i\|o\|u\)\{2}']
+let s:patterns.cjk = ['vim', nr2char(0x65e5) . nr2char(0x672c), '[^ -~]\+',
+      \ '\k\+', '\%u3042\|\%u3044', '[' . nr2char(0x3041) . '-' . nr2char(0x3093) . ']\+',
+      \ 'vim\d\+', '.\{20}$']
+let s:patterns.patho = ['\(a*\)*c$', '\(a\|aa\)*c$', '\v(a+)+c$',
+      \ '\(a\|a\)*d', 'a*a*a*a*a*c$']
+
+let s:texts = [['code', function('s:MakeCode')], ['log', function('s:MakeLog')],
+      \ ['prose', function('s:MakeProse')], ['cjk', function('s:MakeCJK')],
+      \ ['patho', function('s:MakePatho')]]
+let s:engines = [['backtracking', '\%#=1'], ['nfa', '\%#=2']]
+let s:has_stats = exists('*regstats')
+
+" Run ":s///n" with pattern "pat" over the whole buffer, return the number
+" of matches.  Returns -1 when matching was interrupted, e.g. because of
+" 'maxmempattern'.  CTRL-A is used as the separator, it isn't in any pattern.
+func s:Count(pat)
+  let msg = ''
+  try
+    redir => msg
+    silent exe "%s\x01" . a:pat . "\x01\x01gne"
+  catch /^Vim:Interrupt$/
+    return -1
+  finally
+    redir END
+  endtry
+  return str2nr(matchstr(msg, '\d\+'))
+endfunc
+
+for [s:name, s:Make] in s:texts
+  enew!
+  let s:lines = s:name == 'patho' ? 200 : bench_lines
+  call setline(1, s:Make(s:lines))
+  let s:bytes = line2byte(line('$') + 1) - 1
+  call add(s:results, printf('regexp: %s text, %d lines, %d bytes',
+	\ s:name, line('$'), s:bytes))
+  for s:pat in s:patterns[s:name]
+    for [s:engine, s:prefix] in s:engines
+      " Back references, look-around and complex braces always use the
+      " backtracking engine, timing them again would be misleading.
+      if regengine(s:prefix . s:pat) != s:engine
+	call add(s:results, printf('  %-12s %s  %s', s:engine,
+	      \ 'not used, runs with ' . regengine(s:prefix . s:pat), s:pat))
+	continue
+      endif
+      " Use the best of three times.
+      let s:best = -1.0
+      for s:i in range(3)
+	let s:start = reltime()
+	let s:count = s:Count(s:prefix . s:pat)
+	let s:time = str2float(reltimestr(reltime(s:start)))
+	if s:best < 0 || s:time < s:best
+	  let s:best = s:time
+	endif
+      endfor
+      let s:line = printf('  %-12s %8.4f sec %8.2f Mbyte/s %7s matches',
+	    \ s:engine, s:best,
+	    \ s:best > 0 ? s:bytes / s:best / 1048576.0 : 0.0,
+	    \ s:count < 0 ? 'aborted' : s:count)
+      if s:has_stats
+	regstats clear
+	regstats on
+	call s:Count(s:prefix . s:pat)
+	regstats off
+	let s:steps = 0
+	let s:backtracks = 0
+	for s:stat in regstats()
+	  let s:steps += s:stat.steps
+	  let s:backtracks += s:stat.backtracks
+	endfor
+	let s:line .= printf(' %10d steps %10d backtracks', s:steps, s:backtracks)
+      endif
+      call add(s:results, s:line . '  ' . s:pat)
+    endfor
+  endfor
+endfor
+
+call writefile(s:results, 'benchmark.out')
+qa!
@@ -0,0 +1,145 @@
+" Benchmark for syntax highlighting: parse text with the syntax files from
+" the runtime directory, C, Vim script, help, shell, make and HTML with
+" embedded JavaScript and CSS.  Most of the text is taken from the
+" distribution itself, the HTML is generated.
+" For every syntax this reports the time to parse all lines, the number of
+" lines per second and the number of times a syntax pattern was tried.  The
+" last one is only available with the +profile feature, it doesn't depend on
+" the speed of the machine and can be compared between versions.
+"
+" Run with "make benchmark" in this directory.  The maximum number of lines
+" of each text is set with BENCH_SYNTAX_LINES in the Makefile.
+
+set nocp undolevels=-1 nohlsearch noincsearch
+if !exists('bench_lines')
+  let bench_lines = 50000
+endif
+let s:results = []
+let s:top = expand('<sfile>:p:h:h:h')
+let $VIMRUNTIME = s:top . '/runtime'
+let &rtp = $VIMRUNTIME
+syntax on
+
+" Simple linear congruential generator, the numbers stay below 2^31.
+let s:seed = 4711
+func s:Random(n)
+  let s:seed = (s:seed * 75 + 74) % 65537
+  return s:seed % a:n
+endfunc
+
+func s:Pick(list)
+  return a:list[s:Random(len(a:list))]
+endfunc
+
+" Concatenate the files matching "pat" under the top directory.
+func s:ReadFiles(pat)
+  let lines = []
+  for fname in split(glob(s:top . '/' . a:pat), "\n")
+    call extend(lines, readfile(fname))
+    if len(lines) >= g:bench_lines
+      break
+    endif
+  endfor
+  return lines
+endfunc
+
+" HTML with embedded JavaScript and CSS.
+func s:MakeHtml(n)
+  let lines = ['<!DOCTYPE html PUBLIC "-//W3C//DTD HTML 4.01//EN">', '<html>', '<head>']
+  let names = ['item', 'count', 'node', 'list', 'value', 'title']
+  let i = 0
+  while len(lines) < a:n
+    let name = s:Pick(names)
+    let k = i % 6
+    if k == 0
+      call add(lines, '<style type="text/css">')
+      call add(lines, '  div.' . name . ' { color: #' . printf('%06x', s:Random(65536) * 256) . '; margin: ' . s:Random(20) . 'px 0 }')
+      call add(lines, '  a:hover, p > em { font-weight: bold; background: url("img/' . name . '.png") }')
+      call add(lines, '</style>')
+    elseif k == 1
+      call add(lines, '<script type="text/javascript">')
+      call add(lines, '  // update the ' . name . ' when the page is loaded')
+      call add(lines, '  function update_' . i . '(' . name . ') {')
+      call add(lines, '    var n = ' . s:Random(1000) . ', s = "' . name . ' &amp; more";')
+      call add(lines, '    if (' . name . '.length > n) { return document.getElementById(''' . name . '''); }')
+      call add(lines, '    for (var j = 0; j < n; j++) ' . name . '[j] = /^[a-z]+\d*$/.test(s);')
+      call add(lines, '  }')
+      call add(lines, '</script>')
+    elseif k == 2
+      call add(lines, '<!-- ' . name . ' number ' . i . ' -->')
+      call add(lines, '<div class="' . name . '" id="d' . i . '" onclick="update_' . i . '(this)">')
+    elseif k == 3
+      call add(lines, '  <p>The <em>' . name . '</em> is &lt;' . s:Random(100) . '&gt; and <a href="http://www.vim.org/' . name . '.html">a link</a>.</p>')
+      call add(lines, '  <table border="1"><tr><td>' . name . '</td><td>' . s:Random(1000) . '</td></tr></table>')
+    elseif k == 4
+      call add(lines, '  <ul>')
+      for j in range(s:Random(4) + 1)
+	call add(lines, '    <li><b>' . s:Pick(names) . '</b> &nbsp; ' . s:Pick(names) . '</li>')
+      endfor
+      call add(lines, '  </ul>')
+    else
+      call add(lines, '</div>')
+    endif
+    let i += 1
+  endwhile
+  return lines
+endfunc
+
+let s:texts = [['c', 'src/*.c'], ['vim', 'runtime/syntax/*.vim'],
+      \ ['help', 'runtime/doc/*.txt'], ['sh', 'src/auto/configure'],
+      \ ['make', 'src/Makefile'], ['html', '']]
+let s:has_syntime = exists(':syntime') == 2 && has('profile')
+
+" Parse all lines from the start, return the time used.  Going through the
+" lines in sequence parses each line once.
+func s:Parse()
+  " Reloading the syntax drops the syntax states, parse from scratch.
+  let syn = &syntax
+  set syntax=OFF
+  let &syntax = syn
+  syn sync fromstart
+  let start = reltime()
+  for lnum in range(1, line('$'))
+    call synID(lnum, 1, 0)
+  endfor
+  return str2float(reltimestr(reltime(start)))
+endfunc
+
+for [s:name, s:pat] in s:texts
+  enew!
+  if s:pat == ''
+    call setline(1, s:MakeHtml(bench_lines))
+  else
+    call setline(1, s:ReadFiles(s:pat))
+  endif
+  if line('$') > bench_lines
+    silent exe (bench_lines + 1) . ',$d'
+  endif
+  let &syntax = s:name
+
+  " Use the best of three times.
+  let s:best = -1.0
+  for s:i in range(3)
+    let s:time = s:Parse()
+    if s:best < 0 || s:time < s:best
+      let s:best = s:time
+    endif
+  endfor
+  let s:line = printf('syntax: %-5s %6d lines %8.4f sec %9.0f lines/s',
+	\ s:name, line('$'), s:best, s:best > 0 ? line('$') / s:best : 0.0)
+
+  if s:has_syntime
+    syntime on
+    call s:Parse()
+    syntime off
+    " The last line of the report has the total time and number of tries.
+    redir => s:out
+    silent syntime report
+    redir END
+    let s:line .= printf(' %10d tries', str2nr(split(s:out, ' \+')[-1]))
+  endif
+  call add(s:results, s:line)
+endfor
+
+call writefile(s:results, 'benchmark.out')
+qa!
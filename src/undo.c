@@ -1158,18 +1158,17 @@ u_undoredo(undo)
 		}
 		break;
 	    }
-	    /* delete backwards, it goes faster in most cases */
 	    for (lnum = bot - 1, i = oldsize; --i >= 0; --lnum)
 	    {
 		/* what can we do when we run out of memory? */
 		if ((newarray[i] = u_save_line(lnum)) == NULL)
 		    do_outofmem_msg((long_u)0);
-		/* remember we deleted the last line in the buffer, and a
-		 * dummy empty line will be inserted */
-		if (curbuf->b_ml.ml_line_count == 1)
-		    empty_buffer = TRUE;
-		ml_delete(lnum, FALSE);
 	    }
+	    /* remember we delete the last line in the buffer, and a dummy
+	     * empty line will be inserted */
+	    if (oldsize >= curbuf->b_ml.ml_line_count)
+		empty_buffer = TRUE;
+	    ml_delete_lines(top + 1, oldsize, FALSE);
 	}
 	else
 	    newarray = NULL;
@@ -1177,18 +1176,17 @@ u_undoredo(undo)
 	/* insert the lines in u_array between top and bot */
 	if (newsize)
 	{
-	    for (lnum = top, i = 0; i < newsize; ++i, ++lnum)
-	    {
-		/*
-		 * If the file is empty, there is an empty line 1 that we
-		 * should get rid of, by replacing it with the new line
-		 */
-		if (empty_buffer && lnum == 0)
-		    ml_replace((linenr_T)1, uep->ue_array[i], TRUE);
-		else
-		    ml_append(lnum, uep->ue_array[i], (colnr_T)0, FALSE);
+	    i = 0;
+	    /*
+	     * If the file is empty, there is an empty line 1 that we
+	     * should get rid of, by replacing it with the new line
+	     */
+	    if (empty_buffer && top == 0)
+		ml_replace((linenr_T)1, uep->ue_array[i++], TRUE);
+	    ml_append_array(top + i, uep->ue_array + i,
+						   (linenr_T)(newsize - i), FALSE);
+	    for (i = 0; i < newsize; ++i)
 		U_FREE_LINE(uep->ue_array[i]);
-	    }
 	    U_FREE_LINE((char_u *)uep->ue_array);
 	}
 
@@ -314,6 +314,11 @@ static char *(features[]) =
 #else
 	"-mksession",
 #endif
+#ifdef FEAT_MMAP
+	"+mmap",
+#else
+	"-mmap",
+#endif
 #ifdef FEAT_MODIFY_FNAME
 	"+modify_fname",
 #else
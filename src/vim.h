@@ -797,11 +797,20 @@ extern char *(*dyn_libintl_textdomain)(const char *domainname);
 # define SST_MIN_ENTRIES 150	/* minimal size for state stack array */
 # ifdef FEAT_GUI_W16
 #  define SST_MAX_ENTRIES 500	/* (only up to 64K blocks) */
+#  define SST_SAVE_MEM	 0L	/* don't keep states of unloaded buffers */
 # else
-#  define SST_MAX_ENTRIES 1000	/* maximal size for state stack array */
+#  define SST_MAX_MEM	 (1024L * 1024L)  /* memory for state stack array */
+#  define SST_MAX_ENTRIES ((int)(SST_MAX_MEM / sizeof(synstate_T)))
+#  define SST_SAVE_MEM	 (4L * SST_MAX_MEM) /* memory for states kept for
+					       all unloaded buffers */
 # endif
 # define SST_FIX_STATES	 7	/* size of sst_stack[]. */
 # define SST_DIST	 16	/* normal distance between entries */
+# define SST_IDLE_MAXPARSE 1000	/* when syntax_idle() is behind, parse at
+				   most this many lines for the display */
+# define SST_IDLE_MINLINES 200	/* "minlines" for the shortened sync */
+# define SST_IDLE_REGION 300	/* lines syntax_idle() parses at a time
+				   around the cursor, plus "minlines" */
 #endif
 
 /* Values for 'options' argument in do_search() and searchit() */
@@ -875,6 +884,12 @@ extern char *(*dyn_libintl_textdomain)(const char *domainname);
 #define READ_BUFFER	0x08	/* read from curbuf (converting stdin) */
 #define READ_DUMMY	0x10	/* reading into a dummy buffer */
 
+/* Values for ml_map_file() */
+#define MLMAP_UTF8	0x01	/* every line must be valid UTF-8 */
+#define MLMAP_DETECT	0x02	/* 'fileformat' must be detected */
+#define MLMAP_TRY_DOS	0x04	/* detecting "dos" is possible */
+#define MLMAP_TRY_MAC	0x08	/* detecting "mac" is possible */
+
 /* Values for change_indent() */
 #define INDENT_SET	1	/* set indent */
 #define INDENT_INC	2	/* increase indent */
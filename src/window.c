@@ -4376,6 +4376,7 @@ win_free(wp, tp)
 
 #ifdef FEAT_SEARCH_EXTRA
     clear_matches(wp);
+    hlcache_free(wp);
 #endif
 
 #ifdef FEAT_JUMPLIST
@@ -6503,7 +6504,7 @@ match_delete(wp, id, perr)
 	wp->w_match_head = cur->next;
     else
 	prev->next = cur->next;
-    vim_free(cur->match.regprog);
+    vim_regfree(cur->match.regprog);
     vim_free(cur->pattern);
     vim_free(cur);
     redraw_later(SOME_VALID);
@@ -6522,7 +6523,7 @@ clear_matches(wp)
     while (wp->w_match_head != NULL)
     {
 	m = wp->w_match_head->next;
-	vim_free(wp->w_match_head->match.regprog);
+	vim_regfree(wp->w_match_head->match.regprog);
 	vim_free(wp->w_match_head->pattern);
 	vim_free(wp->w_match_head);
 	wp->w_match_head = m;